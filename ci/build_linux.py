@@ -0,0 +1,50 @@
+# -*- coding:utf-8 -*-
+
+import os
+import sys
+
+class Builder:
+    def __init__(self, bench_args):
+        self.projectPath = os.path.join(os.getcwd())
+        self.CompilePath = os.path.join(self.projectPath, 'dii_linux')
+        self.BenchPath = os.path.join(self.projectPath, 'dii_bench')
+        self.bench_args = bench_args
+
+    def run(self):
+        self.build()
+        self.test()
+        self.bench()
+
+    def make(self, path, target):
+        if not os.path.exists(path):
+            print '%s are not exist!' %path
+            exit(1)
+        os.chdir(path)
+        print 'Change dir to ' + path
+        ret = os.system('make ' + target)
+        if ret != 0 :
+            exit(1)
+
+    def build(self):
+        # host build of dii media kit, the rtmp pipeline without a view
+        self.make(self.CompilePath, '')
+        # the bench tools, decoder needs FFMPEG_DIR to run but always builds
+        self.make(self.BenchPath, 'server bench replay decoder aac')
+
+    def test(self):
+        self.make(self.CompilePath, 'test')
+        self.make(self.BenchPath, 'test')
+
+    def bench(self):
+        # players against the loopback server, the table goes to stdout
+        self.make(self.BenchPath, 'run-bench BENCH_ARGS="' + self.bench_args + '"')
+        # video ingest copies and allocations at 8 Mbps, pool on and off
+        self.make(self.BenchPath, 'run-ingest INGEST_ARGS="-s 10 -n 1"')
+        self.make(self.BenchPath, 'run-aac AAC_ARGS="-s 20 -n 1"')
+
+if __name__=='__main__' :
+    bench_args = '-s 10 -n 16'
+    if len(sys.argv) == 2:
+        bench_args = sys.argv[1]
+    builder = Builder(bench_args)
+    builder.run()
@@ -0,0 +1,184 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+// Decodes the same aac with every DiiRtmpAacDecoder backend of this build
+// and prints the cpu each spends per second of audio. The aac is made here
+// with faac from a few tones over noise, closer to music than one tone.
+//
+//  dii_bench_aac [-s seconds] [-r rate] [-c channels] [-b bitrate] [-n loops]
+//
+// faad is always there, libavcodec needs the kit built with FFMPEG_DIR.
+#include "dii_rtmp_aac_decoder.h"
+#include "faac.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace dii_media_kit;
+
+static int64_t CpuUs() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (int64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 +
+           usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+// raw aac frames of |seconds| of audio and their AudioSpecificConfig
+static bool EncodeAac(int seconds, int rate, int channels, int bitrate,
+                      std::vector<std::vector<uint8_t>>& frames, std::vector<uint8_t>& asc) {
+    unsigned long input_samples = 0;
+    unsigned long max_output = 0;
+    faacEncHandle encoder = faacEncOpen(rate, channels, &input_samples, &max_output);
+    if (!encoder) {
+        return false;
+    }
+    faacEncConfigurationPtr config = faacEncGetCurrentConfiguration(encoder);
+    config->inputFormat = FAAC_INPUT_16BIT;
+    config->outputFormat = 0;   // raw
+    config->aacObjectType = LOW;
+    config->mpegVersion = MPEG4;
+    config->bitRate = bitrate / channels;
+    faacEncSetConfiguration(encoder, config);
+    unsigned char* info = nullptr;
+    unsigned long info_len = 0;
+    faacEncGetDecoderSpecificInfo(encoder, &info, &info_len);
+    asc.assign(info, info + info_len);
+    free(info);
+
+    static const double kTones[] = {220.0, 330.0, 440.0, 554.4, 659.3, 1760.0};
+    std::vector<int16_t> pcm(input_samples);
+    std::vector<uint8_t> aac(max_output);
+    int64_t samples = 0;
+    int64_t end = (int64_t)seconds * rate;
+    uint32_t noise = 1;
+    // past the end, the encoder holds back a frame or two
+    while ((int64_t)frames.size() * 1024 < end) {
+        for (size_t i = 0; i < pcm.size(); i += channels) {
+            double t = (double)(samples + i / channels) / rate;
+            for (int c = 0; c < channels; c++) {
+                double s = 0;
+                for (size_t k = 0; k < sizeof(kTones) / sizeof(kTones[0]); k++) {
+                    // the tones swell in and out at different speeds and sides
+                    s += sin(2 * M_PI * kTones[k] * t) * (0.5 + 0.5 * sin(t * (k + 1 + c)));
+                }
+                noise = noise * 1664525 + 1013904223;
+                pcm[i + c] = (int16_t)(s * 3000 + (int16_t)(noise >> 16) / 16);
+            }
+        }
+        samples += pcm.size() / channels;
+        int len = faacEncEncode(encoder, (int32_t*)pcm.data(), (unsigned int)pcm.size(),
+                                aac.data(), (unsigned int)aac.size());
+        if (len < 0) {
+            break;
+        }
+        if (len > 0) {
+            frames.push_back(std::vector<uint8_t>(aac.begin(), aac.begin() + len));
+        }
+    }
+    faacEncClose(encoder);
+    return !frames.empty() && !asc.empty();
+}
+
+static void Usage(const char* name) {
+    fprintf(stderr, "usage: %s [-s seconds] [-r rate] [-c channels] [-b bitrate] [-n loops]\n", name);
+}
+
+int main(int argc, char** argv) {
+    int seconds = 60;
+    int rate = 44100;
+    int channels = 2;
+    int bitrate = 128000;
+    int loops = 3;
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "s:r:c:b:n:h")) != -1) {
+        switch (opt) {
+            case 's': seconds = atoi(optarg); break;
+            case 'r': rate = atoi(optarg); break;
+            case 'c': channels = atoi(optarg); break;
+            case 'b': bitrate = atoi(optarg); break;
+            case 'n': loops = atoi(optarg); break;
+            default: Usage(argv[0]); return 1;
+        }
+    }
+    if (seconds <= 0 || rate <= 0 || channels < 1 || channels > 2 || bitrate <= 0 || loops <= 0) {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<std::vector<uint8_t>> frames;
+    std::vector<uint8_t> asc;
+    if (!EncodeAac(seconds, rate, channels, bitrate, frames, asc)) {
+        fprintf(stderr, "can't encode %d Hz %d channels\n", rate, channels);
+        return 1;
+    }
+    double audio_seconds = (double)frames.size() * 1024 / rate;
+
+    printf("%-12s %6s %3s %5s %7s %9s %10s %9s\n", "decoder", "rate", "ch", "kbps", "audio",
+           "cpu", "cpu/audio", "realtime");
+    printf("%-12s %6s %3s %5s %7s %9s %10s %9s\n", "", "Hz", "", "", "s", "ms", "ms/s", "x");
+    const DiiAudioDecoderType types[] = {DII_AUDIO_DECODER_FAAD, DII_AUDIO_DECODER_FFMPEG};
+    std::string first_name;
+    for (DiiAudioDecoderType type : types) {
+        std::unique_ptr<DiiRtmpAacDecoder> probe(DiiRtmpAacDecoder::Create(type, asc.data(), (int)asc.size()));
+        if (!probe) {
+            fprintf(stderr, "no decoder for type %d\n", (int)type);
+            continue;
+        }
+        // FFMPEG falls back to faad when libavcodec isn't built in
+        if (first_name == probe->ImplementationName()) {
+            printf("%-12s not in this build, build the kit with FFMPEG_DIR\n", "libavcodec");
+            continue;
+        }
+        if (first_name.empty()) {
+            first_name = probe->ImplementationName();
+        }
+        for (int loop = 0; loop < loops; loop++) {
+            std::unique_ptr<DiiRtmpAacDecoder> decoder(DiiRtmpAacDecoder::Create(type, asc.data(), (int)asc.size()));
+            int64_t samples = 0;
+            int32_t errors = 0;
+            int64_t cpu_start = CpuUs();
+            for (const std::vector<uint8_t>& frame : frames) {
+                const int16_t* pcm = nullptr;
+                int n = decoder->Decode(frame.data(), (int)frame.size(), &pcm);
+                if (n < 0) {
+                    errors++;
+                } else {
+                    samples += n;
+                }
+            }
+            double cpu_ms = (CpuUs() - cpu_start) / 1000.0;
+            if (errors > 0 || samples == 0) {
+                fprintf(stderr, "%s: %d of %zu frames failed\n", decoder->ImplementationName(), errors,
+                        frames.size());
+            }
+            printf("%-12s %6d %3d %5d %7.1f %9.1f %10.3f %9.0f\n", decoder->ImplementationName(),
+                   decoder->SampleRate(), decoder->Channels(), bitrate / 1000, audio_seconds, cpu_ms,
+                   cpu_ms / audio_seconds, cpu_ms > 0 ? audio_seconds * 1000 / cpu_ms : 0);
+            fflush(stdout);
+        }
+    }
+    return 0;
+}
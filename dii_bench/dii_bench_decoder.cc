@@ -0,0 +1,409 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+// Decodes the video of flv files as fast as the decoder takes it and prints,
+// per file, the decoder, frames per second, cpu per frame, the latency from
+// Decode to the decoded frame and the memory the decoder grew by. Every
+// file is demuxed by DiiRtmpPuller first, so the decoder gets the same
+// annex-b frames it gets when playing, and every decoder config gets the
+// same frames.
+//
+//  dii_bench_decoder -f 1080p.flv [-f 4k.flv ..] [-t 1,2,4,8] [-m slice|frame|both] [-n loops]
+//                    [-r seconds] [-c]
+//
+// -t runs every file once per thread count, -m picks slice threading, frame
+// threading (more fps, a frame of latency per thread) or a row of each.
+// -r plays the file in real time instead, looped for |seconds|: frames go in
+// at their timestamps and come out due at their presentation time, behind by
+// as much as the first frame was. Frames later than that by more than a
+// frame interval count as late, the lag column is the most any frame was
+// behind. That is whether a 4K60 or 8K30 stream can be sustained. -c adds
+// the ABGR conversion of every frame a player with a frame callback does.
+//
+// libavcodec (H264DecoderImpl) is the only backend the kit ships, the tool
+// needs the kit built with FFMPEG_DIR.
+#include "dii_player.h"
+#include "dii_rtmp_flv_reader.h"
+#include "dii_rtmp_puller.h"
+#include "webrtc/modules/video_coding/codecs/h264/include/h264.h"
+#include "webrtc/base/timeutils.h"
+#include "webrtc/common_video/libyuv/include/webrtc_libyuv.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace dii_media_kit;
+
+struct BenchFrame {
+    dii_rtc::scoped_refptr<PlyBuffer> data;
+    uint32_t        ts = 0;
+    int32_t         cts = 0;
+    PlyVideoInfo    info;
+};
+
+struct BenchConfig {
+    int32_t threads = 1;
+    bool    frame_threading = false;
+    int32_t realtime_seconds = 0;   // 0 as fast as the decoder takes it
+    bool    convert = false;
+};
+
+struct BenchResult {
+    std::string     decoder;
+    int32_t         width = 0;
+    int32_t         height = 0;
+    int32_t         frames_in = 0;
+    int32_t         frames_out = 0;
+    int64_t         wall_us = 0;
+    int64_t         cpu_us = 0;
+    std::vector<int32_t> latency_us;
+    int64_t         memory_kb = 0;
+    int32_t         late = 0;
+    int64_t         max_lag_us = 0;
+};
+
+static int64_t CpuUs() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (int64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 +
+           usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+// a "Name: value" line of /proc/self/status
+static int64_t ProcStatus(const char* name) {
+    FILE* file = fopen("/proc/self/status", "r");
+    if (!file) {
+        return -1;
+    }
+    char line[256];
+    int64_t value = -1;
+    size_t len = strlen(name);
+    while (fgets(line, sizeof(line), file)) {
+        if (strncmp(line, name, len) == 0 && line[len] == ':') {
+            value = atoll(line + len + 1);
+            break;
+        }
+    }
+    fclose(file);
+    return value;
+}
+
+// starts VmHWM over at the current rss
+static void ResetPeakRss() {
+    FILE* file = fopen("/proc/self/clear_refs", "w");
+    if (file) {
+        fputs("5", file);
+        fclose(file);
+    }
+}
+
+static int32_t Percentile(std::vector<int32_t> values, int32_t percent) {
+    if (values.empty()) {
+        return 0;
+    }
+    size_t n = std::min(values.size() - 1, values.size() * percent / 100);
+    std::nth_element(values.begin(), values.begin() + n, values.end());
+    return values[n];
+}
+
+// the video frames of an flv file as the puller hands them to the player
+class FlvVideoLoader : public DiiPullerCallback {
+public:
+    bool Load(const std::string& path, std::vector<BenchFrame>& frames) {
+        FILE* file = fopen(path.c_str(), "rb");
+        if (!file) {
+            return false;
+        }
+        frames_ = &frames;
+        DiiRtmpPuller puller(0, *this, false);
+        // the puller takes tags like any transport hands them over
+        DiiTransportCallback& transport = puller;
+        DiiFlvTagReader reader;
+        std::vector<char> buf(1 << 20);
+        size_t len = 0;
+        int32_t ret = 0;
+        while (ret >= 0 && (len = fread(buf.data(), 1, buf.size(), file)) > 0) {
+            reader.Append(buf.data(), (int)len);
+            char type = 0;
+            uint32_t timestamp = 0;
+            char* data = nullptr;
+            int size = 0;
+            while ((ret = reader.ReadTag(type, timestamp, data, size)) > 0) {
+                transport.OnTransportPacket(type, timestamp, data, size);
+            }
+        }
+        fclose(file);
+        return ret >= 0 && !frames.empty();
+    }
+
+    void OnServerConnected() override {}
+    void OnPullFailed(int32_t errCode, int32_t eventid, const char* errmsg) override {}
+    void OnPullVideoData(const dii_rtc::scoped_refptr<PlyBuffer>& frame, uint32_t ts, int32_t cts,
+                         const PlyVideoInfo& info) override {
+        BenchFrame bench_frame;
+        bench_frame.data = frame;
+        bench_frame.ts = ts;
+        bench_frame.cts = cts;
+        bench_frame.info = info;
+        frames_->push_back(bench_frame);
+    }
+    void OnPullAudioData(const dii_rtc::scoped_refptr<PlyBuffer>& frame, uint32_t ts, uint64_t sync_ts) override {}
+    void OnPullAudioConfig(const uint8_t* config, int len) override {}
+
+private:
+    std::vector<BenchFrame>* frames_ = nullptr;
+};
+
+class DecodeBench : public DecodedImageCallback {
+public:
+    bool Run(const std::vector<BenchFrame>& frames, const BenchConfig& config, BenchResult& result) {
+        VideoCodecType codec = frames[0].info.codec;
+        std::unique_ptr<H264Decoder> decoder(codec == kVideoCodecH265 ? H264Decoder::CreateH265()
+                                             : H264Decoder::IsSupported() ? H264Decoder::Create() : nullptr);
+        if (!decoder) {
+            return false;
+        }
+        decoder->SetFrameThreading(config.frame_threading);
+        result_ = &result;
+        submits_.clear();
+        ResetPeakRss();
+        int64_t rss_kb = ProcStatus("VmRSS");
+        int64_t cpu_start = CpuUs();
+        start_us_ = dii_rtc::TimeMicros();
+
+        VideoCodec settings;
+        settings.codecType = codec;
+        settings.width = 320;
+        settings.height = 240;
+        decoder->InitDecode(&settings, config.threads);
+        decoder->RegisterDecodeCompleteCallback(this);
+        result.decoder = decoder->ImplementationName();
+
+        convert_ = config.convert;
+        realtime_ = config.realtime_seconds > 0;
+        first_pts_ = frames[0].ts + frames[0].cts;
+        got_first_ = false;
+        // the file repeats every |period| ms, one frame interval after its last frame
+        uint32_t span = frames.back().ts - frames[0].ts;
+        interval_us_ = frames.size() > 1 ? span * 1000 / (frames.size() - 1) : 0;
+        uint32_t period = span + (uint32_t)(interval_us_ / 1000);
+        bool done = false;
+        for (uint32_t pass = 0; !done; pass++) {
+            for (const BenchFrame& frame : frames) {
+                uint32_t offset = pass * period;
+                int64_t due_us = start_us_ + (int64_t)(offset + frame.ts - frames[0].ts) * 1000;
+                if (realtime_) {
+                    if (due_us - start_us_ >= config.realtime_seconds * 1000000LL) {
+                        done = true;
+                        break;
+                    }
+                    int64_t wait_us = due_us - dii_rtc::TimeMicros();
+                    if (wait_us > 0) {
+                        usleep((useconds_t)wait_us);
+                    }
+                }
+                EncodedImage image;
+                image._buffer = frame.data->data();
+                image._length = frame.data->size();
+                image._size = frame.data->size();
+                image._timeStamp = offset + frame.ts + frame.cts;
+                image._frameType = frame.info.keyframe ? kVideoFrameKey : kVideoFrameDelta;
+                image._completeFrame = true;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    submits_[image._timeStamp] = dii_rtc::TimeMicros();
+                }
+                result.frames_in++;
+                RTPFragmentationHeader fragmentation;
+                decoder->Decode(image, false, &fragmentation);
+            }
+            done = done || !realtime_;
+        }
+        decoder->Release();
+        decoder.reset();
+        result.cpu_us = CpuUs() - cpu_start;
+        result.memory_kb = ProcStatus("VmHWM") - rss_kb;
+        return true;
+    }
+
+    int32_t Decoded(VideoFrame& frame) override {
+        int64_t now = dii_rtc::TimeMicros();
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = submits_.find(frame.timestamp());
+        if (it != submits_.end()) {
+            result_->latency_us.push_back((int32_t)(now - it->second));
+            submits_.erase(it);
+        }
+        if (realtime_) {
+            // behind its presentation time by more than the first frame was
+            int64_t lag_us = now - start_us_ - (int64_t)(frame.timestamp() - first_pts_) * 1000;
+            if (!got_first_) {
+                first_lag_us_ = lag_us;
+                got_first_ = true;
+            }
+            lag_us -= first_lag_us_;
+            result_->max_lag_us = std::max(result_->max_lag_us, lag_us);
+            if (lag_us > interval_us_) {
+                result_->late++;
+            }
+        }
+        if (convert_) {
+            rgba_.resize(frame.width() * frame.height() * 4);
+            ConvertFromI420(frame, kABGR, 0, rgba_.data());
+        }
+        result_->width = frame.width();
+        result_->height = frame.height();
+        result_->frames_out++;
+        // until the last frame out, what frame threads still hold isn't waited for
+        result_->wall_us = now - start_us_;
+        return 0;
+    }
+
+private:
+    std::mutex                  mutex_;
+    std::map<uint32_t, int64_t> submits_;
+    BenchResult*                result_ = nullptr;
+    int64_t                     start_us_ = 0;
+    bool                        realtime_ = false;
+    bool                        convert_ = false;
+    std::vector<uint8_t>        rgba_;
+    uint32_t                    first_pts_ = 0;
+    bool                        got_first_ = false;
+    int64_t                     first_lag_us_ = 0;
+    int64_t                     interval_us_ = 0;
+};
+
+static void Usage(const char* name) {
+    fprintf(stderr, "usage: %s -f flv [-f flv ..] [-t 1,2,4,8] [-m slice|frame|both] [-n loops]\n"
+            "       [-r seconds] [-c]\n", name);
+}
+
+// "1,2,4" to {1, 2, 4}, empty when a count isn't positive
+static std::vector<int32_t> ParseThreads(const char* list) {
+    std::vector<int32_t> threads;
+    for (const char* p = list; *p; ) {
+        int32_t count = atoi(p);
+        if (count <= 0) {
+            return std::vector<int32_t>();
+        }
+        threads.push_back(count);
+        p = strchr(p, ',');
+        if (!p) {
+            break;
+        }
+        p++;
+    }
+    return threads;
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> paths;
+    std::vector<int32_t> threads(1, 1);
+    std::string mode = "slice";
+    int loops = 1;
+    int32_t realtime_seconds = 0;
+    bool convert = false;
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "f:t:m:n:r:ch")) != -1) {
+        switch (opt) {
+            case 'f': paths.push_back(optarg); break;
+            case 't': threads = ParseThreads(optarg); break;
+            case 'm': mode = optarg; break;
+            case 'n': loops = atoi(optarg); break;
+            case 'r': realtime_seconds = atoi(optarg); break;
+            case 'c': convert = true; break;
+            default: Usage(argv[0]); return 1;
+        }
+    }
+    std::vector<BenchConfig> configs;
+    for (int32_t count : threads) {
+        for (int frame = 0; frame < 2; frame++) {
+            if ((frame == 0 && mode == "frame") || (frame == 1 && mode == "slice")) {
+                continue;
+            }
+            BenchConfig config;
+            config.threads = count;
+            config.frame_threading = frame == 1;
+            config.realtime_seconds = realtime_seconds;
+            config.convert = convert;
+            configs.push_back(config);
+        }
+    }
+    if (paths.empty() || configs.empty() || loops <= 0 || realtime_seconds < 0 ||
+        (mode != "slice" && mode != "frame" && mode != "both")) {
+        Usage(argv[0]);
+        return 1;
+    }
+    DiiMediaKit::SetDebugLog(LOG_WARNING);
+    if (!H264Decoder::IsSupported()) {
+        fprintf(stderr, "no video decoder in this build, build the kit with FFMPEG_DIR\n");
+        return 1;
+    }
+
+    printf("%-24s %-16s %9s %7s %7s %7s %8s %7s %7s %7s %8s %6s %7s\n", "file", "decoder", "size",
+           "threads", "frames", "fps", "cpu/f", "lat", "lat", "lat", "mem", "late", "lag");
+    printf("%-24s %-16s %9s %7s %7s %7s %8s %7s %7s %7s %8s %6s %7s\n", "", "", "", "", "", "", "ms",
+           "p50", "p95", "max", "MB", "", "ms");
+    for (const std::string& path : paths) {
+        std::vector<BenchFrame> frames;
+        FlvVideoLoader loader;
+        if (!loader.Load(path, frames)) {
+            fprintf(stderr, "no video in %s\n", path.c_str());
+            continue;
+        }
+        std::string name = path.substr(path.find_last_of('/') + 1);
+        for (size_t i = 0; i < configs.size() * loops; i++) {
+            const BenchConfig& config = configs[i / loops];
+            DecodeBench bench;
+            BenchResult result;
+            if (!bench.Run(frames, config, result)) {
+                fprintf(stderr, "can't decode %s\n", path.c_str());
+                break;
+            }
+            char size[32], thread_mode[16];
+            snprintf(thread_mode, sizeof(thread_mode), "%d%s", config.threads,
+                     config.frame_threading ? " frm" : "");
+            snprintf(size, sizeof(size), "%dx%d", result.width, result.height);
+            double fps = result.wall_us > 0 ? result.frames_out * 1e6 / result.wall_us : 0;
+            double cpu_ms = result.frames_out > 0 ? result.cpu_us / 1000.0 / result.frames_out : 0;
+            int32_t max_latency = result.latency_us.empty() ? 0
+                : *std::max_element(result.latency_us.begin(), result.latency_us.end());
+            char late[16] = "-", lag[16] = "-";
+            if (config.realtime_seconds > 0) {
+                snprintf(late, sizeof(late), "%d", result.late);
+                snprintf(lag, sizeof(lag), "%.1f", result.max_lag_us / 1000.0);
+            }
+            printf("%-24.24s %-16.16s %9s %7s %7d %7.1f %8.2f %7.1f %7.1f %7.1f %8.1f %6s %7s\n", name.c_str(),
+                   result.decoder.c_str(), size, thread_mode, result.frames_out, fps, cpu_ms,
+                   Percentile(result.latency_us, 50) / 1000.0, Percentile(result.latency_us, 95) / 1000.0,
+                   max_latency / 1000.0, result.memory_kb / 1024.0, late, lag);
+            fflush(stdout);
+        }
+    }
+    return 0;
+}
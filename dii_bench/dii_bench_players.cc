@@ -0,0 +1,304 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+// Plays 1, 2, 4 .. 64 headless streams from one server at once and prints,
+// per stream count, the process cpu, memory and threads, the time to the
+// first video frame, the end-to-end latency and the ingest cost of video:
+// bytes copied per second over all streams and heap allocations per packet.
+// Latency is the wall clock now minus the sync timestamp of the audio being
+// played, so the server has to stamp its wall clock into onMetaData the way
+// dii_rtmp_loopback_server does, on the same host.
+//
+//  dii_bench_players -u rtmp://127.0.0.1:1935/live [-s 20] [-n 64] [-x] [-p]
+//
+// Stream i plays <url>/bench<i>. Audio is pulled every 10 ms as a mixer would.
+// -p turns packet recycling off, every packet is allocated and freed as it
+// was before PlyPacketPool.
+#include "dii_player.h"
+#include "dii_rtmp_packet_pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace dii_media_kit;
+
+#define BENCH_DEFAULT_SECONDS       20
+#define BENCH_DEFAULT_MAX_STREAMS   64
+// the start of every step is left out of the cpu and latency numbers
+#define BENCH_WARMUP_MS             3000
+#define BENCH_SAMPLE_RATE           48000
+#define BENCH_CHANNELS              2
+
+struct BenchStream {
+    std::unique_ptr<DiiPlayer>  player;
+    std::atomic<int32_t>        first_frame_ms{0};
+    std::atomic<int32_t>        stalls{0};
+    // sums of the statistics taken while measuring
+    std::atomic<int64_t>        copy_bytes{0};
+    std::atomic<int64_t>        video_bytes{0};
+    std::atomic<int64_t>        allocs_per_packet_milli{0};
+    std::atomic<int32_t>        ingest_samples{0};
+};
+
+static std::vector<std::unique_ptr<BenchStream>> streams;
+static std::mutex streams_mutex;
+static std::atomic<bool> measuring(false);
+static std::mutex latency_mutex;
+static std::vector<int32_t> latency_samples;
+
+static int64_t WallMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static int64_t CpuUs() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (int64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 +
+           usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+// a "Name: value" line of /proc/self/status
+static int64_t ProcStatus(const char* name) {
+    FILE* file = fopen("/proc/self/status", "r");
+    if (!file) {
+        return -1;
+    }
+    char line[256];
+    int64_t value = -1;
+    size_t len = strlen(name);
+    while (fgets(line, sizeof(line), file)) {
+        if (strncmp(line, name, len) == 0 && line[len] == ':') {
+            value = atoll(line + len + 1);
+            break;
+        }
+    }
+    fclose(file);
+    return value;
+}
+
+static int32_t Percentile(std::vector<int32_t>& values, int32_t percent) {
+    if (values.empty()) {
+        return 0;
+    }
+    size_t n = std::min(values.size() - 1, values.size() * percent / 100);
+    std::nth_element(values.begin(), values.begin() + n, values.end());
+    return values[n];
+}
+
+static BenchStream* StartStream(const std::string& url) {
+    BenchStream* stream = new BenchStream();
+    // no view, pcm is pulled below instead of played
+    stream->player.reset(new DiiPlayer(nullptr, true));
+
+    DiiPlayerCallback callback;
+    callback.statistics_callback = [stream](DiiPlayerStatistics& statistics) {
+        if (stream->first_frame_ms == 0 && statistics.first_video_frame_ms_ > 0) {
+            stream->first_frame_ms = statistics.first_video_frame_ms_;
+        }
+        if (measuring) {
+            stream->copy_bytes += statistics.video_copy_bytes_;
+            // frame bytes since the previous statistics, one per second
+            stream->video_bytes += statistics.video_bps_;
+            stream->allocs_per_packet_milli += (int64_t)(statistics.video_allocs_per_packet_ * 1000);
+            stream->ingest_samples++;
+        }
+    };
+    callback.state_callback = [stream](DiiPlayerState state, int32_t code, const char* msg, void* custom_data) {
+        if (state == DII_STATE_STUCK && measuring) {
+            stream->stalls++;
+        }
+    };
+    callback.sync_ts_callback = [](uint64_t ts) {
+        if (measuring) {
+            std::lock_guard<std::mutex> lock(latency_mutex);
+            latency_samples.push_back((int32_t)(WallMs() - (int64_t)ts));
+        }
+    };
+    stream->player->SetPlayerCallback(&callback);
+    if (stream->player->Start(url.c_str()) != 0) {
+        fprintf(stderr, "can't start %s\n", url.c_str());
+    }
+    return stream;
+}
+
+// every player gets 10 ms of pcm every 10 ms, like the mixer of an app
+static void PumpAudio(std::atomic<bool>* running) {
+    std::vector<uint8_t> pcm(BENCH_SAMPLE_RATE / 100 * BENCH_CHANNELS * sizeof(int16_t));
+    auto next = std::chrono::steady_clock::now();
+    while (*running) {
+        {
+            std::lock_guard<std::mutex> lock(streams_mutex);
+            for (auto& stream : streams) {
+                stream->player->Get10msAudioData(pcm.data(), BENCH_SAMPLE_RATE, BENCH_CHANNELS);
+            }
+        }
+        next += std::chrono::milliseconds(10);
+        std::this_thread::sleep_until(next);
+    }
+}
+
+static void RunStep(const std::string& url, int32_t count, int32_t seconds) {
+    int64_t start_ms = WallMs();
+    for (int32_t i = 0; i < count; i++) {
+        BenchStream* stream = StartStream(url + "/bench" + std::to_string(i));
+        std::lock_guard<std::mutex> lock(streams_mutex);
+        streams.emplace_back(stream);
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(std::min(BENCH_WARMUP_MS, seconds * 1000 / 2)));
+    {
+        std::lock_guard<std::mutex> lock(latency_mutex);
+        latency_samples.clear();
+    }
+    measuring = true;
+    int64_t cpu_start_us = CpuUs();
+    int64_t measure_start_ms = WallMs();
+    int64_t rss_peak_kb = 0;
+    int64_t threads_peak = 0;
+    while (WallMs() - start_ms < seconds * 1000) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        rss_peak_kb = std::max(rss_peak_kb, ProcStatus("VmRSS"));
+        threads_peak = std::max(threads_peak, ProcStatus("Threads"));
+    }
+    measuring = false;
+    int64_t measure_ms = std::max<int64_t>(WallMs() - measure_start_ms, 1);
+    double cpu = (CpuUs() - cpu_start_us) / 10.0 / measure_ms;
+
+    std::vector<int32_t> first_frames;
+    int32_t stalls = 0;
+    // per second, summed over the streams
+    double copy_bytes = 0;
+    double video_bytes = 0;
+    double allocs_per_packet = 0;
+    int32_t ingest_streams = 0;
+    {
+        std::lock_guard<std::mutex> lock(streams_mutex);
+        for (auto& stream : streams) {
+            if (stream->first_frame_ms > 0) {
+                first_frames.push_back(stream->first_frame_ms);
+            }
+            stalls += stream->stalls;
+            if (stream->ingest_samples > 0) {
+                copy_bytes += (double)stream->copy_bytes / stream->ingest_samples;
+                video_bytes += (double)stream->video_bytes / stream->ingest_samples;
+                allocs_per_packet += stream->allocs_per_packet_milli / 1000.0 / stream->ingest_samples;
+                ingest_streams++;
+            }
+        }
+    }
+    if (ingest_streams > 0) {
+        allocs_per_packet /= ingest_streams;
+    }
+    std::vector<int32_t> latencies;
+    {
+        std::lock_guard<std::mutex> lock(latency_mutex);
+        latencies.swap(latency_samples);
+    }
+    int64_t first_frame_sum = 0;
+    for (int32_t ms : first_frames) {
+        first_frame_sum += ms;
+    }
+    int32_t first_frame_avg = first_frames.empty() ? 0 : (int32_t)(first_frame_sum / first_frames.size());
+    int32_t first_frame_max = first_frames.empty() ? 0 : *std::max_element(first_frames.begin(), first_frames.end());
+    int32_t latency_max = latencies.empty() ? 0 : *std::max_element(latencies.begin(), latencies.end());
+
+    printf("%7d %7.1f %7.1f %7d %4d/%-4d %7d %7d %7d %7d %7d %6d %7.1f %7.1f %7.2f\n",
+           count, cpu, rss_peak_kb / 1024.0, (int)threads_peak,
+           (int)first_frames.size(), count, first_frame_avg, first_frame_max,
+           Percentile(latencies, 50), Percentile(latencies, 95), latency_max, stalls,
+           video_bytes / (1024 * 1024), copy_bytes / (1024 * 1024), allocs_per_packet);
+    fflush(stdout);
+
+    // stop outside the lock, the audio pump keeps going meanwhile
+    std::vector<std::unique_ptr<BenchStream>> stopping;
+    {
+        std::lock_guard<std::mutex> lock(streams_mutex);
+        stopping.swap(streams);
+    }
+    for (auto& stream : stopping) {
+        stream->player->Stop();
+        // no callbacks into the stream once the player is gone
+        stream->player.reset();
+    }
+}
+
+static void Usage(const char* name) {
+    fprintf(stderr, "usage: %s -u rtmp://host:port/app [-s seconds per step] [-n max streams] [-x shared io] [-p no packet recycling] [-l trace log]\n", name);
+}
+
+int main(int argc, char** argv) {
+    std::string url;
+    int32_t seconds = BENCH_DEFAULT_SECONDS;
+    int32_t max_streams = BENCH_DEFAULT_MAX_STREAMS;
+    const char* trace_log = nullptr;
+    bool recycle = true;
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "u:s:n:xpl:h")) != -1) {
+        switch (opt) {
+            case 'u': url = optarg; break;
+            case 's': seconds = atoi(optarg); break;
+            case 'n': max_streams = atoi(optarg); break;
+            case 'x': DiiPlayer::SetRtmpSharedIo(true); break;
+            case 'p': recycle = false; break;
+            case 'l': trace_log = optarg; break;
+            default: Usage(argv[0]); return 1;
+        }
+    }
+    if (url.empty() || seconds <= 0 || max_streams <= 0) {
+        Usage(argv[0]);
+        return 1;
+    }
+    PlyPacketPool::SetRecycle(recycle);
+    DiiMediaKit::SetDebugLog(LOG_WARNING);
+    if (trace_log) {
+        DiiMediaKit::SetTraceLog(trace_log, LOG_INFO);
+    }
+
+    std::atomic<bool> running(true);
+    std::thread pump(PumpAudio, &running);
+
+    printf("dii media kit %s, %s/bench<i>, %d s per step, packet recycling %s\n", DiiMediaKit::Version(),
+           url.c_str(), seconds, recycle ? "on" : "off");
+    // cpu in % of one core; first frame and latency in ms; video ingest and
+    // bytes copied in MB/s over all streams, allocations per video packet
+    printf("%7s %7s %7s %7s %9s %7s %7s %7s %7s %7s %6s %7s %7s %7s\n",
+           "streams", "cpu", "rss(MB)", "threads", "started", "first", "first", "lat", "lat", "lat", "stalls",
+           "video", "copied", "allocs");
+    printf("%7s %7s %7s %7s %9s %7s %7s %7s %7s %7s %6s %7s %7s %7s\n",
+           "", "", "", "", "", "avg", "max", "p50", "p95", "max", "", "MB/s", "MB/s", "/packet");
+    for (int32_t count = 1; count <= max_streams; count *= 2) {
+        RunStep(url, count, seconds);
+    }
+
+    running = false;
+    pump.join();
+    return 0;
+}
@@ -0,0 +1,361 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+// Writes an flv for the load tests without any encoder outside this tree:
+// aac from faac (a tone), h264 built by hand from I_PCM keyframes and all
+// skipped P frames. Any h264 decoder plays it, the keyframes are large
+// (384 bytes per macroblock) and the P frames a few bytes. With -b every
+// frame is padded with filler data up to an even video bitrate.
+//
+//  dii_make_test_flv -o test.flv [-s 30] [-w 320] [-h 240] [-r 25] [-g 50] [-b 8000]
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "faac.h"
+}
+
+#define TEST_FLV_SAMPLE_RATE    44100
+#define TEST_FLV_CHANNELS       2
+#define TEST_FLV_TONE_HZ        440
+#define TEST_FLV_FRAME_NUM_BITS 4   // log2_max_frame_num_minus4 = 0
+
+// rbsp writer, exp-golomb as in H.264 9.1
+class BitWriter {
+public:
+    void PutBits(uint32_t value, int bits) {
+        for (int i = bits - 1; i >= 0; i--) {
+            PutBit((value >> i) & 1);
+        }
+    }
+    void PutBit(int bit) {
+        cur_ = (uint8_t)((cur_ << 1) | bit);
+        if (++filled_ == 8) {
+            data_.push_back(cur_);
+            cur_ = 0;
+            filled_ = 0;
+        }
+    }
+    void PutUe(uint32_t value) {
+        uint32_t v = value + 1;
+        int len = 0;
+        for (uint32_t t = v; t > 1; t >>= 1) {
+            len++;
+        }
+        PutBits(0, len);
+        PutBits(v, len + 1);
+    }
+    void PutSe(int32_t value) {
+        PutUe(value <= 0 ? (uint32_t)(-2 * value) : (uint32_t)(2 * value - 1));
+    }
+    void AlignZero() {
+        while (filled_ != 0) {
+            PutBit(0);
+        }
+    }
+    void PutByte(uint8_t byte) {
+        data_.push_back(byte);
+    }
+    void Trailing() {
+        PutBit(1);
+        AlignZero();
+    }
+    // nal unit with emulation prevention, no start code
+    std::vector<uint8_t> Nal(uint8_t header) const {
+        std::vector<uint8_t> nal(1, header);
+        int zeros = 0;
+        for (uint8_t b : data_) {
+            if (zeros >= 2 && b <= 3) {
+                nal.push_back(3);
+                zeros = 0;
+            }
+            nal.push_back(b);
+            zeros = b == 0 ? zeros + 1 : 0;
+        }
+        return nal;
+    }
+
+private:
+    std::vector<uint8_t> data_;
+    uint8_t cur_ = 0;
+    int filled_ = 0;
+};
+
+static std::vector<uint8_t> MakeSps(int mb_width, int mb_height) {
+    BitWriter w;
+    w.PutBits(66, 8);   // baseline
+    w.PutBits(0, 8);
+    w.PutBits(30, 8);   // level 3.0
+    w.PutUe(0);         // seq_parameter_set_id
+    w.PutUe(TEST_FLV_FRAME_NUM_BITS - 4);
+    w.PutUe(2);         // pic_order_cnt_type, output order is decode order
+    w.PutUe(1);         // max_num_ref_frames
+    w.PutBit(0);
+    w.PutUe(mb_width - 1);
+    w.PutUe(mb_height - 1);
+    w.PutBit(1);        // frame_mbs_only_flag
+    w.PutBit(1);        // direct_8x8_inference_flag
+    w.PutBit(0);        // frame_cropping_flag
+    w.PutBit(0);        // vui_parameters_present_flag
+    w.Trailing();
+    return w.Nal(0x67);
+}
+
+static std::vector<uint8_t> MakePps() {
+    BitWriter w;
+    w.PutUe(0);         // pic_parameter_set_id
+    w.PutUe(0);         // seq_parameter_set_id
+    w.PutBit(0);        // cavlc
+    w.PutBit(0);
+    w.PutUe(0);         // num_slice_groups_minus1
+    w.PutUe(0);
+    w.PutUe(0);
+    w.PutBit(0);
+    w.PutBits(0, 2);
+    w.PutSe(0);         // pic_init_qp_minus26
+    w.PutSe(0);
+    w.PutSe(0);
+    w.PutBit(0);        // deblocking_filter_control_present_flag
+    w.PutBit(0);
+    w.PutBit(0);
+    w.Trailing();
+    return w.Nal(0x68);
+}
+
+// every macroblock I_PCM, a gradient that moves with |picture|
+static std::vector<uint8_t> MakeIdr(int mb_width, int mb_height, int picture) {
+    BitWriter w;
+    w.PutUe(0);         // first_mb_in_slice
+    w.PutUe(7);         // I, all slices
+    w.PutUe(0);
+    w.PutBits(0, TEST_FLV_FRAME_NUM_BITS);
+    w.PutUe(picture & 0xffff);  // idr_pic_id
+    w.PutBit(0);        // no_output_of_prior_pics_flag
+    w.PutBit(0);        // long_term_reference_flag
+    w.PutSe(0);         // slice_qp_delta
+    for (int mby = 0; mby < mb_height; mby++) {
+        for (int mbx = 0; mbx < mb_width; mbx++) {
+            w.PutUe(25);    // I_PCM
+            w.AlignZero();
+            for (int y = 0; y < 16; y++) {
+                for (int x = 0; x < 16; x++) {
+                    // 0 is not a valid pcm sample before H.264 2005
+                    w.PutByte((uint8_t)(16 + ((mbx * 16 + x + mby * 16 + y + picture * 8) % 220)));
+                }
+            }
+            for (int c = 0; c < 2 * 64; c++) {
+                w.PutByte((uint8_t)(c < 64 ? 96 + (picture * 4) % 64 : 160));
+            }
+        }
+    }
+    w.Trailing();
+    return w.Nal(0x65);
+}
+
+// every macroblock skipped, repeats the reference picture
+static std::vector<uint8_t> MakeSkippedP(int mb_width, int mb_height, int frame_num) {
+    BitWriter w;
+    w.PutUe(0);
+    w.PutUe(5);         // P, all slices
+    w.PutUe(0);
+    w.PutBits(frame_num % (1 << TEST_FLV_FRAME_NUM_BITS), TEST_FLV_FRAME_NUM_BITS);
+    w.PutBit(0);        // num_ref_idx_active_override_flag
+    w.PutBit(0);        // ref_pic_list_modification_flag_l0
+    w.PutBit(0);        // adaptive_ref_pic_marking_mode_flag
+    w.PutSe(0);
+    w.PutUe(mb_width * mb_height);  // mb_skip_run
+    w.Trailing();
+    return w.Nal(0x41);
+}
+
+// filler data (nal type 12) of |size| bytes with header and trailing bits,
+// 0xff never needs emulation prevention
+static std::vector<uint8_t> MakeFiller(int size) {
+    std::vector<uint8_t> nal(size < 2 ? 2 : size, 0xff);
+    nal.front() = 0x0c;
+    nal.back() = 0x80;
+    return nal;
+}
+
+class FlvWriter {
+public:
+    bool Open(const char* path) {
+        file_ = fopen(path, "wb");
+        if (!file_) {
+            return false;
+        }
+        static const uint8_t header[13] = {'F', 'L', 'V', 1, 5, 0, 0, 0, 9, 0, 0, 0, 0};
+        fwrite(header, 1, sizeof(header), file_);
+        return true;
+    }
+    void Close() {
+        if (file_) {
+            fclose(file_);
+            file_ = nullptr;
+        }
+    }
+    void Tag(uint8_t type, uint32_t ts, const std::vector<uint8_t>& body) {
+        uint8_t head[11] = {type,
+                            (uint8_t)(body.size() >> 16), (uint8_t)(body.size() >> 8), (uint8_t)body.size(),
+                            (uint8_t)(ts >> 16), (uint8_t)(ts >> 8), (uint8_t)ts, (uint8_t)(ts >> 24),
+                            0, 0, 0};
+        fwrite(head, 1, sizeof(head), file_);
+        fwrite(body.data(), 1, body.size(), file_);
+        uint32_t size = (uint32_t)(body.size() + sizeof(head));
+        uint8_t prev[4] = {(uint8_t)(size >> 24), (uint8_t)(size >> 16), (uint8_t)(size >> 8), (uint8_t)size};
+        fwrite(prev, 1, sizeof(prev), file_);
+    }
+
+private:
+    FILE* file_ = nullptr;
+};
+
+static void PutNal(std::vector<uint8_t>& body, const std::vector<uint8_t>& nal) {
+    uint32_t size = (uint32_t)nal.size();
+    body.push_back((uint8_t)(size >> 24));
+    body.push_back((uint8_t)(size >> 16));
+    body.push_back((uint8_t)(size >> 8));
+    body.push_back((uint8_t)size);
+    body.insert(body.end(), nal.begin(), nal.end());
+}
+
+static void Usage(const char* name) {
+    fprintf(stderr, "usage: %s -o out.flv [-s seconds] [-w width] [-h height] [-r fps] [-g gop frames] [-b video kbps]\n", name);
+}
+
+int main(int argc, char** argv) {
+    const char* path = nullptr;
+    int seconds = 30;
+    int width = 320;
+    int height = 240;
+    int fps = 25;
+    int gop = 50;
+    int kbps = 0;
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "o:s:w:h:r:g:b:")) != -1) {
+        switch (opt) {
+            case 'o': path = optarg; break;
+            case 's': seconds = atoi(optarg); break;
+            case 'w': width = atoi(optarg); break;
+            case 'h': height = atoi(optarg); break;
+            case 'r': fps = atoi(optarg); break;
+            case 'g': gop = atoi(optarg); break;
+            case 'b': kbps = atoi(optarg); break;
+            default: Usage(argv[0]); return 1;
+        }
+    }
+    if (!path || seconds <= 0 || fps <= 0 || gop <= 0 || kbps < 0 || width <= 0 || height <= 0 ||
+        width % 16 != 0 || height % 16 != 0) {
+        Usage(argv[0]);
+        fprintf(stderr, "width and height are multiples of 16\n");
+        return 1;
+    }
+
+    unsigned long input_samples = 0;
+    unsigned long max_output = 0;
+    faacEncHandle encoder = faacEncOpen(TEST_FLV_SAMPLE_RATE, TEST_FLV_CHANNELS, &input_samples, &max_output);
+    faacEncConfigurationPtr config = faacEncGetCurrentConfiguration(encoder);
+    config->inputFormat = FAAC_INPUT_16BIT;
+    config->outputFormat = 0;   // raw
+    config->aacObjectType = LOW;
+    config->mpegVersion = MPEG4;
+    config->bitRate = 64000 / TEST_FLV_CHANNELS;
+    faacEncSetConfiguration(encoder, config);
+    unsigned char* asc = nullptr;
+    unsigned long asc_len = 0;
+    faacEncGetDecoderSpecificInfo(encoder, &asc, &asc_len);
+
+    FlvWriter flv;
+    if (!flv.Open(path)) {
+        fprintf(stderr, "can't create %s\n", path);
+        return 1;
+    }
+    int mb_width = width / 16;
+    int mb_height = height / 16;
+    std::vector<uint8_t> sps = MakeSps(mb_width, mb_height);
+    std::vector<uint8_t> pps = MakePps();
+
+    std::vector<uint8_t> body = {0x17, 0, 0, 0, 0, 1, sps[1], sps[2], sps[3], 0xff, 0xe1,
+                                 (uint8_t)(sps.size() >> 8), (uint8_t)sps.size()};
+    body.insert(body.end(), sps.begin(), sps.end());
+    body.push_back(1);
+    body.push_back((uint8_t)(pps.size() >> 8));
+    body.push_back((uint8_t)pps.size());
+    body.insert(body.end(), pps.begin(), pps.end());
+    flv.Tag(9, 0, body);
+    body = {0xaf, 0};
+    body.insert(body.end(), asc, asc + asc_len);
+    flv.Tag(8, 0, body);
+    free(asc);
+
+    // samples are interleaved, |input_samples| counts all channels
+    std::vector<int16_t> pcm(input_samples);
+    std::vector<uint8_t> aac(max_output);
+    int64_t samples_in = 0;
+    int64_t aac_frames = 0;
+    int64_t video_bytes = 0;
+    int frames = seconds * fps;
+    int64_t audio_end = (int64_t)seconds * TEST_FLV_SAMPLE_RATE;
+    for (int frame = 0; frame < frames; frame++) {
+        uint32_t video_ts = (uint32_t)((int64_t)frame * 1000 / fps);
+        // audio up to the video frame, one aac frame is 1024 samples per channel
+        while (aac_frames * 1024 * 1000 / TEST_FLV_SAMPLE_RATE <= video_ts && samples_in < audio_end + 4096) {
+            for (size_t i = 0; i < pcm.size(); i += TEST_FLV_CHANNELS) {
+                double t = (double)(samples_in + i / TEST_FLV_CHANNELS) / TEST_FLV_SAMPLE_RATE;
+                int16_t s = (int16_t)(8000 * sin(2 * M_PI * TEST_FLV_TONE_HZ * t));
+                for (int c = 0; c < TEST_FLV_CHANNELS; c++) {
+                    pcm[i + c] = s;
+                }
+            }
+            samples_in += pcm.size() / TEST_FLV_CHANNELS;
+            int len = faacEncEncode(encoder, (int32_t*)pcm.data(), (unsigned int)pcm.size(),
+                                    aac.data(), (unsigned int)aac.size());
+            if (len > 0) {
+                body = {0xaf, 1};
+                body.insert(body.end(), aac.begin(), aac.begin() + len);
+                flv.Tag(8, (uint32_t)(aac_frames * 1024 * 1000 / TEST_FLV_SAMPLE_RATE), body);
+                aac_frames++;
+            }
+        }
+
+        int in_gop = frame % gop;
+        body = {(uint8_t)(in_gop == 0 ? 0x17 : 0x27), 1, 0, 0, 0};
+        PutNal(body, in_gop == 0 ? MakeIdr(mb_width, mb_height, frame / gop)
+                                 : MakeSkippedP(mb_width, mb_height, in_gop));
+        // video bytes due by the end of this frame, tag body and nal sizes included
+        int64_t due = (int64_t)kbps * 1000 / 8 * (frame + 1) / fps - video_bytes;
+        if (due > (int64_t)body.size() + 4 + 2) {
+            PutNal(body, MakeFiller((int)(due - body.size() - 4)));
+        }
+        video_bytes += body.size();
+        flv.Tag(9, video_ts, body);
+    }
+    flv.Close();
+    faacEncClose(encoder);
+    printf("%s: %d s, %dx%d %d fps, gop %d, %lld aac frames, video %lld kbps\n", path, seconds, width, height,
+           fps, gop, (long long)aac_frames, (long long)(video_bytes * 8 / 1000 / seconds));
+    return 0;
+}
@@ -0,0 +1,253 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+// A loopback rtmp server for load tests: every client that plays any stream
+// gets the flv file replayed in real time from its start, looping with the
+// timestamps running on. An onMetaData with sync_timestamp, the wall clock
+// time the last audio was sent, goes out every second so players report
+// their end-to-end latency through the sync timestamp callback.
+//
+//  dii_rtmp_loopback_server -f test.flv [-p 1935]
+//
+// Only needs srs_librtmp and the flv reader, see the Makefile.
+#include "srs_librtmp.h"
+#include "dii_rtmp_flv_reader.h"
+#include "webrtc/base/logging.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define LOOPBACK_DEFAULT_PORT       1935
+#define LOOPBACK_READ_SIZE          (64 * 1024)
+// a gap longer than this in the file's timestamps is skipped instead of waited out
+#define LOOPBACK_MAX_WAIT           3000    // ms
+// between the last tag of a pass and the first of the next one
+#define LOOPBACK_LOOP_GAP           40      // ms
+#define LOOPBACK_SYNC_INTERVAL      1000    // ms
+
+struct FlvTag {
+    char                type;
+    uint32_t            timestamp;
+    std::vector<char>   data;
+};
+
+static std::vector<FlvTag> flv_tags;
+static std::atomic<int32_t> client_count(0);
+
+static int64_t WallMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static bool LoadFlv(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "can't open %s\n", path);
+        return false;
+    }
+    DiiFlvTagReader reader;
+    std::vector<char> chunk(LOOPBACK_READ_SIZE);
+    size_t len = 0;
+    while ((len = fread(chunk.data(), 1, chunk.size(), file)) > 0) {
+        reader.Append(chunk.data(), (int)len);
+        for (;;) {
+            FlvTag tag;
+            char* data = nullptr;
+            int size = 0;
+            int32_t ret = reader.ReadTag(tag.type, tag.timestamp, data, size);
+            if (ret < 0) {
+                fprintf(stderr, "%s is not flv\n", path);
+                fclose(file);
+                return false;
+            }
+            if (ret == 0) {
+                break;
+            }
+            tag.data.assign(data, data + size);
+            free(data);
+            flv_tags.push_back(std::move(tag));
+        }
+    }
+    fclose(file);
+    if (flv_tags.empty()) {
+        fprintf(stderr, "%s has no media\n", path);
+        return false;
+    }
+    return true;
+}
+
+// onMetaData carrying the wall clock time of the audio sent last, read by the
+// puller as the sync timestamp of that audio
+static int SendSyncMetadata(srs_rtmp_server_t server, uint32_t timestamp, int64_t sync_ms) {
+    srs_amf0_t name = srs_amf0_create_string("onMetaData");
+    srs_amf0_t metadata = srs_amf0_create_object();
+    srs_amf0_object_property_set(metadata, "sync_timestamp", srs_amf0_create_number((srs_amf0_number)sync_ms));
+
+    int name_size = srs_amf0_size(name);
+    std::vector<char> data(name_size + srs_amf0_size(metadata));
+    int ret = srs_amf0_serialize(name, data.data(), name_size);
+    if (ret == 0) {
+        ret = srs_amf0_serialize(metadata, data.data() + name_size, (int)data.size() - name_size);
+    }
+    srs_amf0_free(name);
+    srs_amf0_free(metadata);
+    if (ret != 0) {
+        return ret;
+    }
+    return srs_rtmp_server_write_packet(server, SRS_RTMP_TYPE_SCRIPT, timestamp, data.data(), (int)data.size());
+}
+
+// replays the file to one client until it goes away
+static int Replay(srs_rtmp_server_t server) {
+    uint32_t ts_offset = 0;
+    uint32_t last_ts = 0;
+    uint32_t anchor_ts = 0;
+    int64_t anchor_ms = -1;
+    uint32_t last_audio_ts = 0;
+    int64_t last_audio_ms = 0;
+    int64_t last_sync_ms = 0;
+    for (;;) {
+        for (size_t i = 0; i < flv_tags.size(); i++) {
+            const FlvTag& tag = flv_tags[i];
+            if (i == 0 && last_ts > 0) {
+                ts_offset = last_ts + LOOPBACK_LOOP_GAP - tag.timestamp;
+            }
+            uint32_t timestamp = tag.timestamp + ts_offset;
+            last_ts = std::max(last_ts, timestamp);
+
+            int64_t now = WallMs();
+            int64_t wait = anchor_ms < 0 ? 0 : anchor_ms + (int32_t)(timestamp - anchor_ts) - now;
+            if (anchor_ms < 0 || wait > LOOPBACK_MAX_WAIT || wait < -LOOPBACK_MAX_WAIT) {
+                // the first tag, or a jump in the file's timestamps: pace from here
+                anchor_ts = timestamp;
+                anchor_ms = now;
+                wait = 0;
+            }
+            if (wait > 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(wait));
+            }
+
+            int ret = srs_rtmp_server_write_packet(server, tag.type, timestamp, tag.data.data(), (int)tag.data.size());
+            if (ret != 0) {
+                return ret;
+            }
+            if (tag.type != SRS_RTMP_TYPE_AUDIO) {
+                continue;
+            }
+            last_audio_ts = timestamp;
+            last_audio_ms = anchor_ms + (int32_t)(timestamp - anchor_ts);
+            if (last_audio_ms - last_sync_ms >= LOOPBACK_SYNC_INTERVAL) {
+                last_sync_ms = last_audio_ms;
+                if ((ret = SendSyncMetadata(server, last_audio_ts, last_audio_ms)) != 0) {
+                    return ret;
+                }
+            }
+        }
+    }
+}
+
+static void ServeClient(int fd, int32_t id) {
+    client_count++;
+    srs_rtmp_server_t server = srs_rtmp_server_create(fd);
+    char app[128] = {0};
+    char stream[128] = {0};
+    int ret = srs_rtmp_server_accept_play(server, app, stream);
+    if (ret == 0) {
+        printf("client %d: play %s/%s, %d clients\n", id, app, stream, client_count.load());
+        fflush(stdout);
+        ret = Replay(server);
+    }
+    srs_rtmp_server_destroy(server);
+    client_count--;
+    printf("client %d: gone, ret=%d, %d clients\n", id, ret, client_count.load());
+    fflush(stdout);
+}
+
+static void Usage(const char* name) {
+    fprintf(stderr, "usage: %s -f file.flv [-p port]\n", name);
+}
+
+int main(int argc, char** argv) {
+    const char* path = nullptr;
+    int port = LOOPBACK_DEFAULT_PORT;
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "f:p:h")) != -1) {
+        switch (opt) {
+            case 'f': path = optarg; break;
+            case 'p': port = atoi(optarg); break;
+            default: Usage(argv[0]); return 1;
+        }
+    }
+    if (!path || port <= 0 || port > 65535) {
+        Usage(argv[0]);
+        return 1;
+    }
+    // srs_librtmp logs every session step, keep the warnings
+    dii_rtc::LogMessage::LogToDebug(dii_rtc::LS_WARNING);
+    if (!LoadFlv(path)) {
+        return 1;
+    }
+    // a client going away fails the write instead of killing the server
+    signal(SIGPIPE, SIG_IGN);
+
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(listen_fd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listen_fd, 128) < 0) {
+        fprintf(stderr, "can't listen on 127.0.0.1:%d, %s\n", port, strerror(errno));
+        return 1;
+    }
+    printf("replaying %s, %d tags, on rtmp://127.0.0.1:%d/live/<any>\n", path, (int)flv_tags.size(), port);
+    fflush(stdout);
+
+    int32_t next_id = 0;
+    for (;;) {
+        int fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "accept failed, %s\n", strerror(errno));
+            return 1;
+        }
+        int nodelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+        std::thread(ServeClient, fd, ++next_id).detach();
+    }
+    return 0;
+}
@@ -0,0 +1,271 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#include "dii_com_def.h"
+#include "dii_rtmp_trace_replay.h"
+#include "dii_rtmp_decoder.h"
+#include "srs_librtmp.h"
+#include "webrtc/base/logging.h"
+#include "webrtc/base/timeutils.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#define REPLAY_PULL_INTERVAL        10      // ms of pcm per pull, like the audio device
+#define REPLAY_SAMPLE_INTERVAL      1000
+#define REPLAY_TS_JUMP_LEN          4000    // timestamp discontinuity, the steady pace starts over
+
+namespace {
+
+// the time of the replay, only moved by it
+class ReplayClock : public dii_rtc::ClockInterface {
+public:
+    explicit ReplayClock(uint64_t start_nanos) : start_nanos_(start_nanos), nanos_(start_nanos) {}
+    uint64_t TimeNanos() const override { return nanos_; }
+    void SetElapsedMs(int64_t ms) { nanos_ = start_nanos_ + (uint64_t)ms * dii_rtc::kNumNanosecsPerMillisec; }
+
+private:
+    const uint64_t          start_nanos_;
+    std::atomic<uint64_t>   nanos_;
+};
+
+}  // namespace
+
+namespace dii_media_kit {
+
+DiiRtmpTraceReplay::DiiRtmpTraceReplay(int32_t stream_id)
+    : stream_id_(stream_id) {
+}
+
+DiiRtmpTraceReplay::~DiiRtmpTraceReplay() {
+}
+
+int32_t DiiRtmpTraceReplay::Run(const std::string& path, const Options& options, Result& result,
+                                SampleCallback callback) {
+    result = Result();
+    if (!reader_.Open(path)) {
+        DII_LOG(LS_ERROR, stream_id_, DII_CODE_COMMON_ERROR) << "Trace replay can't read " << path;
+        return DII_ERROR;
+    }
+    DII_LOG(LS_INFO, stream_id_, DII_CODE_COMMON_INFO) << "Trace replay of " << path << ", pulled from "
+                    << reader_.Url() << ", jitter scale: " << options.jitter_scale;
+    options_ = options;
+    got_media_ = false;
+    last_arrival_ms_ = 0;
+    last_scaled_ms_ = 0;
+    last_ts_ = 0;
+    min_lateness_ms_ = 0;
+    video_frames_ = 0;
+
+    int64_t wall_start_ms = dii_rtc::SystemTimeMillis();
+    ReplayClock clock(dii_rtc::TimeNanos());
+    dii_rtc::ClockInterface* prev_clock = dii_rtc::SetClockForTesting(&clock);
+
+    // the puller only demuxes, it never connects
+    puller_.reset(new DiiRtmpPuller(stream_id_, *this, false));
+    decoder_.reset(new DiiRtmpDecoder(stream_id_, false));
+    if (options_.video) {
+        decoder_->SetVideoFrameCallback([this](dii_media_kit::VideoFrame& frame) { video_frames_++; });
+    }
+    decoder_->Start(false);
+
+    std::vector<int16_t> pcm(options_.sample_rate / 100 * options_.channels);
+    DiiTraceRecord record;
+    int64_t arrival_ms = 0;
+    int32_t ret = NextRecord(record, arrival_ms);
+    // replay time starts with the first arrival
+    const int64_t first_ms = ret > 0 ? arrival_ms : 0;
+    int64_t now = first_ms;
+    int64_t next_sample_ms = first_ms;
+    bool started = false;
+    bool stalled = false;
+    float last_speed = 1.0f;
+    result.target_min_ms = std::numeric_limits<int32_t>::max();
+
+    for (;;) {
+        while (ret > 0 && arrival_ms <= now) {
+            // HandlePacket frees it like a packet of srs_librtmp
+            char* data = (char*)malloc(std::max<size_t>(record.data.size(), 1));
+            memcpy(data, record.data.data(), record.data.size());
+            puller_->HandlePacket(record.type, record.timestamp, data, (int)record.data.size());
+            result.packets++;
+            // the audio thread reads the delay manager the ingest updates, one
+            // packet at a time they see each other in the same order every run
+            WaitAudioDecoded();
+            ret = NextRecord(record, arrival_ms);
+        }
+
+        uint64_t sync_ts = 0;
+        bool playing = decoder_->GetMorePcmData(pcm.data(), options_.sample_rate, options_.channels, sync_ts) > 0;
+        WaitVideoDecoded();
+        if (ret <= 0 && !playing) {
+            // the trace is over and played out
+            break;
+        }
+
+        DiiRtmpBuffer* buffer = decoder_->ply_buffer_;
+        int32_t target_ms = buffer->PlayReadyBufferLen();
+        int32_t cache_ms = buffer->GetPlayCacheTime();
+        float speed = decoder_->cur_audio_speed_;
+        if (playing) {
+            if (!started) {
+                result.first_audio_ms = (int32_t)(now - first_ms);
+            }
+            started = true;
+            stalled = false;
+        } else if (started) {
+            if (!stalled) {
+                result.stalls++;
+                stalled = true;
+            }
+            result.stall_ms += REPLAY_PULL_INTERVAL;
+        }
+        if (speed > 1.0f) {
+            result.speed_up_ms += REPLAY_PULL_INTERVAL;
+        } else if (speed < 1.0f) {
+            result.slow_down_ms += REPLAY_PULL_INTERVAL;
+        }
+        if (speed != 1.0f && last_speed == 1.0f) {
+            result.speed_changes++;
+        }
+        last_speed = speed;
+        result.target_min_ms = std::min(result.target_min_ms, target_ms);
+        result.target_max_ms = std::max(result.target_max_ms, target_ms);
+        result.cache_max_ms = std::max(result.cache_max_ms, cache_ms);
+        if (now >= next_sample_ms) {
+            if (callback) {
+                Sample sample;
+                sample.ms = now - first_ms;
+                sample.cache_ms = cache_ms;
+                sample.target_ms = target_ms;
+                sample.speed = speed;
+                sample.playing = playing;
+                callback(sample);
+            }
+            while (next_sample_ms <= now) {
+                next_sample_ms += REPLAY_SAMPLE_INTERVAL;
+            }
+        }
+
+        int64_t next = now + REPLAY_PULL_INTERVAL;
+        if (!playing && ret > 0 && arrival_ms > next) {
+            // nothing plays until the next packet, skip the pulls in between
+            int64_t skip_to = now + (arrival_ms - now) / REPLAY_PULL_INTERVAL * REPLAY_PULL_INTERVAL;
+            if (started) {
+                result.stall_ms += skip_to - next;
+            }
+            next = skip_to;
+        }
+        now = next;
+        clock.SetElapsedMs(now - first_ms);
+    }
+    if (ret < 0) {
+        DII_LOG(LS_WARNING, stream_id_, DII_CODE_COMMON_WARN) << "Trace " << path << " is cut short, replayed up to the cut.";
+    }
+    if (result.target_min_ms == std::numeric_limits<int32_t>::max()) {
+        result.target_min_ms = 0;
+    }
+    result.target_end_ms = decoder_->ply_buffer_->PlayReadyBufferLen();
+    result.duration_ms = now - first_ms;
+    result.video_frames = video_frames_;
+
+    decoder_->Shutdown();
+    decoder_.reset();
+    puller_.reset();
+    dii_rtc::SetClockForTesting(prev_clock);
+    reader_.Close();
+    result.wall_ms = dii_rtc::SystemTimeMillis() - wall_start_ms;
+    DII_LOG(LS_INFO, stream_id_, DII_CODE_COMMON_INFO) << "Trace replay done, " << result.duration_ms << " ms in "
+                    << result.wall_ms << " ms, stalls: " << result.stalls << ", " << result.stall_ms << " ms.";
+    return DII_DONE;
+}
+
+int32_t DiiRtmpTraceReplay::NextRecord(DiiTraceRecord& record, int64_t& arrival_ms) {
+    int32_t ret = 0;
+    do {
+        ret = reader_.Read(record);
+    } while (ret > 0 && record.type == SRS_RTMP_TYPE_VIDEO && !options_.video);
+    if (ret <= 0) {
+        return ret;
+    }
+
+    int64_t arrival = record.arrival_ms;
+    if (options_.jitter_scale == 1.0) {
+        arrival_ms = arrival;
+        return 1;
+    }
+    int64_t scaled = last_scaled_ms_ + (arrival - last_arrival_ms_);
+    if (record.type == SRS_RTMP_TYPE_AUDIO || record.type == SRS_RTMP_TYPE_VIDEO) {
+        // lateness against the timestamps, the least of it is the steady pace
+        int64_t lateness = arrival - (int64_t)record.timestamp;
+        int32_t dts = (int32_t)(record.timestamp - last_ts_);
+        if (!got_media_ || dts < -REPLAY_TS_JUMP_LEN || dts > arrival - last_arrival_ms_ + REPLAY_TS_JUMP_LEN) {
+            min_lateness_ms_ = lateness;
+            got_media_ = true;
+        }
+        min_lateness_ms_ = std::min(min_lateness_ms_, lateness);
+        scaled = (int64_t)record.timestamp + min_lateness_ms_
+               + (int64_t)std::llround(options_.jitter_scale * (double)(lateness - min_lateness_ms_));
+        last_ts_ = record.timestamp;
+    }
+    // packets come in order
+    scaled = std::max(scaled, last_scaled_ms_);
+    last_arrival_ms_ = arrival;
+    last_scaled_ms_ = scaled;
+    arrival_ms = scaled;
+    return 1;
+}
+
+void DiiRtmpTraceReplay::WaitAudioDecoded() {
+    while (decoder_->audio_pending_ > 0) {
+        std::this_thread::yield();
+    }
+}
+
+void DiiRtmpTraceReplay::WaitVideoDecoded() {
+    if (!options_.video) {
+        return;
+    }
+    // the clock holds still, so what is due now is released and decoded before it moves on
+    while (decoder_->ply_buffer_->VideoDue() || !decoder_->VideoIdle()) {
+        std::this_thread::yield();
+    }
+}
+
+void DiiRtmpTraceReplay::OnPullFailed(int32_t errCode, int32_t eventid, const char* errmsg) {
+    DII_LOG(LS_WARNING, stream_id_, eventid) << "Trace replay: " << errmsg << ", err code: " << errCode;
+}
+
+void DiiRtmpTraceReplay::OnPullVideoData(const dii_rtc::scoped_refptr<PlyBuffer>& frame, uint32_t ts, int32_t cts,
+                                         const PlyVideoInfo& info) {
+    decoder_->CacheAvcData(frame, ts, cts, info);
+}
+
+void DiiRtmpTraceReplay::OnPullAudioData(const dii_rtc::scoped_refptr<PlyBuffer>& frame, uint32_t ts, uint64_t sync_ts) {
+    decoder_->CacheAacData(frame, ts, sync_ts);
+}
+
+void DiiRtmpTraceReplay::OnPullAudioConfig(const uint8_t* config, int len) {
+    decoder_->SetAacConfig(config, len);
+}
+}	// namespace dii_media_kit
@@ -0,0 +1,121 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#ifndef __DII_RTMP_TRACE_REPLAY_H__
+#define __DII_RTMP_TRACE_REPLAY_H__
+
+#include "dii_rtmp_puller.h"
+#include "dii_rtmp_trace.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace dii_media_kit {
+class DiiRtmpDecoder;
+
+// Plays a packet trace written by DiiRtmpTraceWriter into a DiiRtmpDecoder
+// with the arrival pattern it was recorded with, to try buffering policies
+// on real network conditions. Time is virtual: pcm is pulled every 10 ms
+// like the audio device does, each packet is fed once the audio before it is
+// decoded, and while nothing can play the clock jumps to the next arrival.
+// Video (off by default) is released by the buffer on the same clock, and it
+// only moves on once the frames due are decoded. A run takes as long as
+// decoding does, and two runs of one trace come out the same.
+// Replaces the global dii_rtc clock while it runs, nothing else in the
+// process may play meanwhile. That is why it is a dii_bench tool and not
+// part of the media kit.
+class DiiRtmpTraceReplay : public DiiPullerCallback {
+public:
+    struct Options {
+        // how late packets are against the steady pace of their timestamps is
+        // scaled by this, 2 doubles the jitter, 0 replays a perfect network
+        double  jitter_scale = 1.0;
+        bool    video = false;
+        int32_t sample_rate = 48000;
+        int32_t channels = 2;
+    };
+    // the buffer once per second of replay time
+    struct Sample {
+        int64_t ms = 0;             // since the first arrival
+        int32_t cache_ms = 0;
+        int32_t target_ms = 0;      // jitter target of the delay manager
+        float   speed = 1.0f;       // soundtouch tempo
+        bool    playing = false;
+    };
+    struct Result {
+        int32_t packets = 0;
+        int64_t duration_ms = 0;    // replay time
+        int64_t wall_ms = 0;
+        int32_t first_audio_ms = 0;
+        // playout ran dry after it had started
+        int32_t stalls = 0;
+        int64_t stall_ms = 0;
+        int32_t target_min_ms = 0;
+        int32_t target_max_ms = 0;
+        int32_t target_end_ms = 0;
+        int32_t cache_max_ms = 0;
+        // soundtouch kicks, the tempo leaving 1.0
+        int32_t speed_changes = 0;
+        int64_t speed_up_ms = 0;
+        int64_t slow_down_ms = 0;
+        int32_t video_frames = 0;
+    };
+    typedef std::function<void (const Sample& sample)> SampleCallback;
+
+    explicit DiiRtmpTraceReplay(int32_t stream_id);
+    ~DiiRtmpTraceReplay();
+
+    // DII_DONE when the trace was played to its end or a cut in it,
+    // DII_ERROR when it can't be read
+    int32_t Run(const std::string& path, const Options& options, Result& result,
+                SampleCallback callback = nullptr);
+
+    //* For DiiPullerCallback
+    void OnServerConnected() override {}
+    void OnPullFailed(int32_t errCode, int32_t eventid, const char* errmsg) override;
+    void OnPullVideoData(const dii_rtc::scoped_refptr<PlyBuffer>& frame, uint32_t ts, int32_t cts,
+                         const PlyVideoInfo& info) override;
+    void OnPullAudioData(const dii_rtc::scoped_refptr<PlyBuffer>& frame, uint32_t ts, uint64_t sync_ts) override;
+    void OnPullAudioConfig(const uint8_t* config, int len) override;
+
+private:
+    // 1 with the next record to feed and its arrival after jitter scaling
+    int32_t NextRecord(DiiTraceRecord& record, int64_t& arrival_ms);
+    // until the audio thread has put everything handed in into the buffer
+    void WaitAudioDecoded();
+    // until no video frame is due and the decode thread is idle
+    void WaitVideoDecoded();
+
+private:
+    int32_t                         stream_id_ = -1;
+    Options                         options_;
+    DiiRtmpTraceReader              reader_;
+    std::unique_ptr<DiiRtmpPuller>  puller_;
+    std::unique_ptr<DiiRtmpDecoder> decoder_;
+    std::atomic<int32_t>            video_frames_{0};
+    // jitter scaling, arrivals and timestamps of the previous media packet
+    bool                            got_media_ = false;
+    int64_t                         last_arrival_ms_ = 0;
+    int64_t                         last_scaled_ms_ = 0;
+    uint32_t                        last_ts_ = 0;
+    int64_t                         min_lateness_ms_ = 0;
+};
+}	// namespace dii_media_kit
+
+#endif	// __DII_RTMP_TRACE_REPLAY_H__
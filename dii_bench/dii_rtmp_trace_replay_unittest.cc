@@ -0,0 +1,225 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#include "dii_common.h"
+#include "dii_rtmp_trace_replay.h"
+#include "faac.h"
+#include "srs_librtmp.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "webrtc/base/fakeclock.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+using namespace dii_media_kit;
+
+namespace {
+
+const int kSampleRate = 48000;
+const int kChannels = 2;
+
+std::string TracePath(const char* name) {
+    return ::testing::TempDir() + name;
+}
+
+// |seconds| of a tone as aac packets arriving at the pace of their timestamps,
+// except the ones due in [hole_ms, hole_ms + hole_len_ms) which all arrive at
+// its end. Every 40 ms a video packet goes in between. Returns the audio
+// packets written, the sequence header included.
+int MakeTrace(const std::string& path, int seconds, int64_t hole_ms, int64_t hole_len_ms) {
+    dii_rtc::ScopedFakeClock clock;
+    DiiRtmpTraceWriter writer(0);
+    if (!writer.Open(path, "rtmp://127.0.0.1/live/test")) {
+        return 0;
+    }
+    unsigned long input_samples = 0;
+    unsigned long max_output = 0;
+    faacEncHandle encoder = faacEncOpen(kSampleRate, kChannels, &input_samples, &max_output);
+    faacEncConfigurationPtr config = faacEncGetCurrentConfiguration(encoder);
+    config->inputFormat = FAAC_INPUT_16BIT;
+    config->outputFormat = 0;
+    config->aacObjectType = LOW;
+    config->mpegVersion = MPEG4;
+    config->bitRate = 32000;
+    faacEncSetConfiguration(encoder, config);
+    unsigned char* asc = nullptr;
+    unsigned long asc_len = 0;
+    faacEncGetDecoderSpecificInfo(encoder, &asc, &asc_len);
+    std::vector<char> body = {'\xaf', 0};
+    body.insert(body.end(), asc, asc + asc_len);
+    free(asc);
+    writer.Write(SRS_RTMP_TYPE_AUDIO, 0, body.data(), (int)body.size());
+    int packets = 1;
+
+    std::vector<int16_t> pcm(input_samples);
+    std::vector<unsigned char> aac(max_output);
+    const char video[] = {0x27, 1, 0, 0, 0, 0, 0, 0, 1, 0x41};
+    int64_t samples_in = 0;
+    int64_t frames = 0;
+    uint32_t next_video_ts = 0;
+    int64_t now_ms = 0;
+    while (frames * 1024 * 1000 / kSampleRate < seconds * 1000) {
+        for (size_t i = 0; i < pcm.size(); i += kChannels) {
+            double t = (double)(samples_in + i / kChannels) / kSampleRate;
+            int16_t s = (int16_t)(8000 * sin(2 * M_PI * 440 * t));
+            for (int c = 0; c < kChannels; c++) {
+                pcm[i + c] = s;
+            }
+        }
+        samples_in += pcm.size() / kChannels;
+        int len = faacEncEncode(encoder, (int32_t*)pcm.data(), (unsigned int)pcm.size(),
+                                aac.data(), (unsigned int)aac.size());
+        if (len <= 0) {
+            continue;
+        }
+        uint32_t ts = (uint32_t)(frames * 1024 * 1000 / kSampleRate);
+        int64_t arrival = ts;
+        if (arrival >= hole_ms && arrival < hole_ms + hole_len_ms) {
+            arrival = hole_ms + hole_len_ms;
+        }
+        if (arrival > now_ms) {
+            clock.AdvanceTime(dii_rtc::TimeDelta::FromMilliseconds(arrival - now_ms));
+            now_ms = arrival;
+        }
+        while (next_video_ts <= ts) {
+            writer.Write(SRS_RTMP_TYPE_VIDEO, next_video_ts, video, sizeof(video));
+            next_video_ts += 40;
+        }
+        body = {'\xaf', 1};
+        body.insert(body.end(), aac.begin(), aac.begin() + len);
+        writer.Write(SRS_RTMP_TYPE_AUDIO, ts, body.data(), (int)body.size());
+        packets++;
+        frames++;
+    }
+    faacEncClose(encoder);
+    writer.Close();
+    return packets;
+}
+
+DiiRtmpTraceReplay::Options AudioOptions(double jitter_scale) {
+    DiiRtmpTraceReplay::Options options;
+    options.jitter_scale = jitter_scale;
+    options.sample_rate = kSampleRate;
+    options.channels = kChannels;
+    return options;
+}
+
+}  // namespace
+
+TEST(DiiRtmpTraceReplayTest, SteadyTracePlaysWithoutStalls) {
+    const std::string path = TracePath("replay_steady.trace");
+    int packets = MakeTrace(path, 6, 0, 0);
+    ASSERT_GT(packets, 1);
+
+    DiiRtmpTraceReplay replay(0);
+    DiiRtmpTraceReplay::Result result;
+    std::vector<DiiRtmpTraceReplay::Sample> samples;
+    ASSERT_EQ(DII_DONE, replay.Run(path, AudioOptions(1.0), result,
+                                   [&samples](const DiiRtmpTraceReplay::Sample& sample) { samples.push_back(sample); }));
+    // video is off, its packets are skipped
+    EXPECT_EQ(packets, result.packets);
+    EXPECT_EQ(0, result.stalls);
+    EXPECT_EQ(0, result.stall_ms);
+    EXPECT_EQ(0, result.video_frames);
+    EXPECT_GE(result.duration_ms, 6000);
+    EXPECT_LT(result.first_audio_ms, 2000);
+    EXPECT_LE(result.target_min_ms, result.target_max_ms);
+
+    // once per replayed second
+    ASSERT_GE(samples.size(), 6u);
+    for (size_t i = 0; i < samples.size(); i++) {
+        EXPECT_EQ((int64_t)i * 1000, samples[i].ms);
+    }
+    EXPECT_TRUE(samples.back().playing);
+    // the replay clock is gone
+    EXPECT_EQ(nullptr, dii_rtc::SetClockForTesting(nullptr));
+    remove(path.c_str());
+}
+
+TEST(DiiRtmpTraceReplayTest, HoleInArrivalsStalls) {
+    const std::string path = TracePath("replay_hole.trace");
+    ASSERT_GT(MakeTrace(path, 8, 3000, 2000), 1);
+
+    DiiRtmpTraceReplay replay(0);
+    DiiRtmpTraceReplay::Result result;
+    ASSERT_EQ(DII_DONE, replay.Run(path, AudioOptions(1.0), result));
+    EXPECT_GE(result.stalls, 1);
+    EXPECT_GT(result.stall_ms, 500);
+    EXPECT_GE(result.duration_ms, 8000);
+
+    // without the jitter the same packets play through
+    DiiRtmpTraceReplay::Result steady;
+    ASSERT_EQ(DII_DONE, replay.Run(path, AudioOptions(0.0), steady));
+    EXPECT_EQ(result.packets, steady.packets);
+    EXPECT_EQ(0, steady.stalls);
+    EXPECT_LE(steady.target_max_ms, result.target_max_ms);
+    remove(path.c_str());
+}
+
+TEST(DiiRtmpTraceReplayTest, RunsAreTheSame) {
+    const std::string path = TracePath("replay_repeat.trace");
+    ASSERT_GT(MakeTrace(path, 8, 3000, 1500), 1);
+
+    DiiRtmpTraceReplay replay(0);
+    DiiRtmpTraceReplay::Result first;
+    DiiRtmpTraceReplay::Result second;
+    ASSERT_EQ(DII_DONE, replay.Run(path, AudioOptions(1.5), first));
+    ASSERT_EQ(DII_DONE, replay.Run(path, AudioOptions(1.5), second));
+    EXPECT_EQ(first.packets, second.packets);
+    EXPECT_EQ(first.duration_ms, second.duration_ms);
+    EXPECT_EQ(first.first_audio_ms, second.first_audio_ms);
+    EXPECT_EQ(first.stalls, second.stalls);
+    EXPECT_EQ(first.stall_ms, second.stall_ms);
+    EXPECT_EQ(first.target_min_ms, second.target_min_ms);
+    EXPECT_EQ(first.target_max_ms, second.target_max_ms);
+    EXPECT_EQ(first.target_end_ms, second.target_end_ms);
+    EXPECT_EQ(first.cache_max_ms, second.cache_max_ms);
+    EXPECT_EQ(first.speed_changes, second.speed_changes);
+    remove(path.c_str());
+}
+
+TEST(DiiRtmpTraceReplayTest, CutTracePlaysUpToTheCut) {
+    const std::string path = TracePath("replay_cut.trace");
+    int packets = MakeTrace(path, 4, 0, 0);
+    ASSERT_GT(packets, 1);
+    FILE* file = fopen(path.c_str(), "rb+");
+    ASSERT_TRUE(file != nullptr);
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    ASSERT_EQ(0, truncate(path.c_str(), size / 2));
+
+    DiiRtmpTraceReplay replay(0);
+    DiiRtmpTraceReplay::Result result;
+    ASSERT_EQ(DII_DONE, replay.Run(path, AudioOptions(1.0), result));
+    EXPECT_GT(result.packets, 1);
+    EXPECT_LT(result.packets, packets);
+    EXPECT_EQ(nullptr, dii_rtc::SetClockForTesting(nullptr));
+    remove(path.c_str());
+}
+
+TEST(DiiRtmpTraceReplayTest, MissingTraceIsAnError) {
+    DiiRtmpTraceReplay replay(0);
+    DiiRtmpTraceReplay::Result result;
+    EXPECT_EQ(DII_ERROR, replay.Run(TracePath("replay_missing.trace"), AudioOptions(1.0), result));
+    EXPECT_EQ(0, result.packets);
+    EXPECT_EQ(nullptr, dii_rtc::SetClockForTesting(nullptr));
+}
@@ -0,0 +1,103 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+// Replays a trace recorded with DiiPlayer::SetRtmpTraceDir into the rtmp
+// decoder on a virtual clock, so a buffer policy change can be checked
+// against real network captures much faster than real time.
+//
+//  dii_trace_replay -f dii_trace_1_1700000000000.trace [-j 1.0] [-v] [-c samples.csv]
+//
+// -j scales the arrival jitter, 0 replays the stream at a steady pace and
+// 2 doubles every delay the capture had. -c writes cache, buffer target
+// and tempo once per replayed second.
+
+#include "dii_player.h"
+#include "dii_rtmp_trace_replay.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <string>
+
+using namespace dii_media_kit;
+
+static void Usage(const char* name) {
+    fprintf(stderr, "usage: %s -f trace [-j jitter scale] [-v video] [-c samples csv]\n", name);
+}
+
+int main(int argc, char** argv) {
+    std::string path;
+    const char* csv_path = nullptr;
+    DiiRtmpTraceReplay::Options options;
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "f:j:vc:h")) != -1) {
+        switch (opt) {
+            case 'f': path = optarg; break;
+            case 'j': options.jitter_scale = atof(optarg); break;
+            case 'v': options.video = true; break;
+            case 'c': csv_path = optarg; break;
+            default: Usage(argv[0]); return 1;
+        }
+    }
+    if (path.empty() || options.jitter_scale < 0) {
+        Usage(argv[0]);
+        return 1;
+    }
+    DiiMediaKit::SetDebugLog(LOG_WARNING);
+
+    FILE* csv = nullptr;
+    if (csv_path) {
+        csv = fopen(csv_path, "w");
+        if (!csv) {
+            fprintf(stderr, "can't write %s\n", csv_path);
+            return 1;
+        }
+        fprintf(csv, "ms,cache_ms,target_ms,speed,playing\n");
+    }
+
+    DiiRtmpTraceReplay replay(0);
+    DiiRtmpTraceReplay::Result result;
+    int32_t ret = replay.Run(path, options, result, [csv](const DiiRtmpTraceReplay::Sample& sample) {
+        if (csv) {
+            fprintf(csv, "%lld,%d,%d,%.3f,%d\n", (long long)sample.ms, sample.cache_ms, sample.target_ms,
+                    sample.speed, sample.playing ? 1 : 0);
+        }
+    });
+    if (csv) {
+        fclose(csv);
+    }
+    if (ret != 0) {
+        fprintf(stderr, "can't replay %s\n", path.c_str());
+        return 1;
+    }
+
+    printf("packets        %d\n", result.packets);
+    printf("replayed       %lld ms in %lld ms\n", (long long)result.duration_ms, (long long)result.wall_ms);
+    printf("first audio    %d ms\n", result.first_audio_ms);
+    printf("stalls         %d, %lld ms\n", result.stalls, (long long)result.stall_ms);
+    printf("target         %d..%d ms, %d ms at the end\n", result.target_min_ms, result.target_max_ms,
+           result.target_end_ms);
+    printf("cache max      %d ms\n", result.cache_max_ms);
+    printf("tempo changes  %d, faster %lld ms, slower %lld ms\n", result.speed_changes,
+           (long long)result.speed_up_ms, (long long)result.slow_down_ms);
+    if (options.video) {
+        printf("video frames   %d\n", result.video_frames);
+    }
+    return 0;
+}
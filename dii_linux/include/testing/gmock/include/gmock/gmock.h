@@ -0,0 +1,3 @@
+// The unit tests include gmock by its chromium path, the host build takes
+// the system one.
+#include <gmock/gmock.h>
@@ -0,0 +1,3 @@
+// The unit tests include gtest by its chromium path, the host build takes
+// the system one.
+#include <gtest/gtest.h>
@@ -29,11 +29,23 @@ LOCAL_SRC_FILES := \
         $(LOCAL_PATH)/dii_audio_manager.cc \
         $(LOCAL_PATH)/dii_audio_mixer_io.cc \
         $(LOCAL_PATH)/dii_rtmp/dii_rtmp_player.cc \
+        $(LOCAL_PATH)/dii_rtmp/dii_rtmp_source.cc \
         $(LOCAL_PATH)/dii_rtmp/dii_rtmp_puller.cc \
+        $(LOCAL_PATH)/dii_rtmp/dii_rtmp_connection.cc \
         $(LOCAL_PATH)/dii_rtmp/aacdecode.cc \
         $(LOCAL_PATH)/dii_rtmp/aacencode.cc \
         $(LOCAL_PATH)/dii_rtmp/dii_rtmp_buffer.cc \
+        $(LOCAL_PATH)/dii_rtmp/dii_rtmp_packet_pool.cc \
         $(LOCAL_PATH)/dii_rtmp/dii_rtmp_decoder.cc \
+        $(LOCAL_PATH)/dii_rtmp/dii_rtmp_delay_manager.cc \
+        $(LOCAL_PATH)/dii_rtmp/dii_rtmp_video_info.cc \
+        $(LOCAL_PATH)/dii_rtmp/dii_rtmp_timeshift.cc \
+        $(LOCAL_PATH)/dii_rtmp/dii_rtmp_recorder.cc \
+        $(LOCAL_PATH)/dii_rtmp/dii_rtmp_trace.cc \
+        $(LOCAL_PATH)/dii_rtmp/dii_rtmp_sync_multi_stream.cc \
+        $(LOCAL_PATH)/dii_rtmp/dii_rtmp_flv_transport.cc \
+        $(LOCAL_PATH)/dii_rtmp/dii_rtmp_flv_reader.cc \
+        $(LOCAL_PATH)/dii_rtmp/dii_rtmp_aac_decoder.cc \
         $(LOCAL_PATH)/dii_rtmp/avcodec.cc \
         $(LOCAL_PATH)/dii_rtmp/videofilter.cc \
         $(LOCAL_PATH)/../third_party/srs_librtmp/srs_librtmp.cpp \
@@ -220,6 +220,7 @@ void DiiAudioManager::RegAudioTrack(DiiAudioTracker* tracker, bool restart) {
     }
     mixer_ptr->AddSource(audio_src);
     mixer_tacker_map_.insert(std::pair<DiiAudioTracker*, AudioMixer::Source*>(tracker, audio_src));
+    tracker->OnPlayoutDelay(playout_delay_ms_);
 }
  
 void DiiAudioManager::UnregAudioTrack(DiiAudioTracker* tracker) {
@@ -308,14 +309,14 @@ int32_t DiiAudioManager::RecordedDataIsAvailable(const void* audioSamples, const
 {
 	dii_rtc::CritScope cs(&cs_audio_record_);
 	if (audio_record_callback_) {
-		if (audio_record_sample_hz_ != samplesPerSec || nChannels != audio_record_channels_) {
+		if (audio_record_sample_hz_ != (int)samplesPerSec || (int)nChannels != audio_record_channels_) {
 			int16_t output[kMaxDataSizeSamples];
-			int samples_per_channel_int = resampler_record_.Resample10Msec((int16_t*)audioSamples,
-                                                                           samplesPerSec * nChannels,
-                                                                           audio_record_sample_hz_ * audio_record_channels_,
-                                                                           1,
-                                                                           kMaxDataSizeSamples,
-                                                                           output);
+			resampler_record_.Resample10Msec((int16_t*)audioSamples,
+                                             samplesPerSec * nChannels,
+                                             audio_record_sample_hz_ * audio_record_channels_,
+                                             1,
+                                             kMaxDataSizeSamples,
+                                             output);
 			audio_record_callback_(output,
                                    audio_record_sample_hz_ / 100,
                                    nBytesPerSample,
@@ -345,6 +346,7 @@ int32_t DiiAudioManager::NeedMorePlayData(const size_t nSamples,
                                                 int64_t* elapsed_time_ms,
                                                 int64_t* ntp_time_ms, 
 												int32_t delayMs) {
+    UpdatePlayoutDelay(delayMs);
     if(mixer_ptr.get()) {
         *elapsed_time_ms = 0;
         *ntp_time_ms = 0;
@@ -374,4 +376,28 @@ int32_t DiiAudioManager::NeedMorePlayData(const size_t nSamples,
 
     return 0;
 }
+
+// some devices pass the delay with each callback, the others are polled once a second.
+void DiiAudioManager::UpdatePlayoutDelay(int32_t device_delay_ms) {
+    int32_t delay_ms = device_delay_ms;
+    if(delay_ms <= 0) {
+        if(playout_delay_poll_cnt_++ % 100 != 0) {
+            return;
+        }
+        uint16_t adm_delay_ms = 0;
+        if(!audio_device_ptr_.get() || audio_device_ptr_->PlayoutDelay(&adm_delay_ms) != 0) {
+            return;
+        }
+        delay_ms = adm_delay_ms;
+    }
+    if(delay_ms == playout_delay_ms_) {
+        return;
+    }
+    playout_delay_ms_ = delay_ms;
+
+    std::unique_lock<std::mutex> tracker_lck(tracker_map_mtx_);
+    for(auto it : mixer_tacker_map_) {
+        it.first->OnPlayoutDelay(delay_ms);
+    }
+}
 }	// namespace dii_media_kit
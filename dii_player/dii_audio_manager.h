@@ -49,6 +49,8 @@ public:
     virtual ~DiiAudioTracker(void){};
 
     virtual int32_t OnNeedPlayAudio(void* audioSamples, size_t samplesPerSec, size_t nChannels) = 0;
+    // Called from the playout thread when the device output latency changes, must not block.
+    virtual void OnPlayoutDelay(int32_t delay_ms) {};
 };
 
  
@@ -85,6 +87,7 @@ private:
     int32_t SwitchPlayoutDevice(std::string device_id);
     int32_t GetPlayoutDeviceIdex(std::string devid);
     void StopAudioDevice();
+    void UpdatePlayoutDelay(int32_t device_delay_ms);
                               
 protected:
 	//* For dii_media_kit::AudioTransport
@@ -130,6 +133,9 @@ protected:
     std::map<DiiAudioTracker*, AudioMixer::Source*> mixer_tacker_map_;
     int                        audio_play_sample_hz_ = 48000;
     int                        audio_play_channels_ = 1;
+    // output latency of the playout device
+    int32_t                    playout_delay_ms_ = 0;
+    int32_t                    playout_delay_poll_cnt_ = 0;
                               
     dii_media_kit::acm2::ACMResampler resampler_playout_;
 };
@@ -13,9 +13,9 @@
 namespace dii_media_kit {
 
     DiiAudioSource::DiiAudioSource(DiiAudioTracker *tracker, int sample_rate, int channels, int ssrc)
-            : ssrc_(ssrc)
+            : audio_tracker_(tracker)
+            , ssrc_(ssrc)
             , sample_rate_(sample_rate)
-            , audio_tracker_(tracker)
             , channel_nb_(channels)
             , frame_id_(0) {
             
@@ -26,10 +26,9 @@ namespace dii_media_kit {
     }
 
     AudioMixer::Source::AudioFrameInfo DiiAudioSource::GetAudioFrameWithInfo(int sample_rate_hz, AudioFrame* audio_frame) {
-        int readed_bytes = 0;
         if (audio_tracker_ != NULL) {
                 int16_t buffer[2000] = {0};
-                readed_bytes = audio_tracker_->OnNeedPlayAudio(buffer,  sample_rate_, channel_nb_);
+                audio_tracker_->OnNeedPlayAudio(buffer,  sample_rate_, channel_nb_);
                 audio_frame->UpdateFrame(frame_id_++,
                                          (int32_t)DiiUnixTimestampMs(),
                                          buffer,
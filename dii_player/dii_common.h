@@ -2,6 +2,7 @@
 #define __DII_COMMON_H__
 
 #include <stdint.h>
+#include <string.h>
 #include <functional>
 #include <string>
 
@@ -46,9 +47,8 @@ typedef enum {
         DiiAudioFrameMetadataCallback         RenderAudioCallback; // 音频渲染帧信息callback
         DiiVideoFrameMetadataCallback         RenderVideoCallback; // 视频渲染帧信息callback
 
-        DiiRadarCallback() {
-            memset(this, 0, sizeof(DiiRadarCallback));
-        }
+        // std::function members start out empty, no memset over them
+        DiiRadarCallback() {}
     } DiiRadarCallback; // 播放器帧元数据 Callback
 }
 
@@ -102,6 +102,17 @@ namespace dii_media_kit {
         FLUENCY     // 流畅
     } DiiFluency; // 流畅度(尚不支持)
 
+    typedef enum {
+        DII_AUDIO_DECODER_AUTO = 0,   // libavcodec 可用时优先，否则 faad
+        DII_AUDIO_DECODER_FFMPEG,     // libavcodec 软解（SIMD 优化）
+        DII_AUDIO_DECODER_FAAD        // faad2 软解
+    } DiiAudioDecoderType; // 音频解码器
+
+    typedef enum {
+        DII_RECORD_FORMAT_FLV = 0,    // flv，按直播流写入
+        DII_RECORD_FORMAT_MP4         // 分片 mp4，异常退出时已写完的分片仍可播放
+    } DiiRecordFormat; // 录制文件格式
+
 	enum DiiAudioDevice {
 		DEVICE_NONE = 0,
 		DEVICE_MIC,
@@ -116,16 +127,58 @@ namespace dii_media_kit {
         int32_t video_height_;
         int32_t video_decode_framerate;
         int32_t video_render_framerate;
+        const char* video_decoder_;        // implementation name of the video decoder in use
+        int32_t video_decode_time_us_;     // average decode time per frame
+        int32_t video_pacing_p50_ms_;      // release lateness against the audio clock
+        int32_t video_pacing_p90_ms_;
+        int32_t video_pacing_p99_ms_;
+        int32_t video_catchup_events_;     // times decoding fell too far behind and jumped ahead
+        int32_t video_skipped_frames_;     // late frames dropped without decoding
+        int32_t video_reorder_depth_;      // frames held back to show b-frames in order, 0 without b-frames
+        int32_t video_decode_threads_;
+        int32_t video_decode_delay_ms_;    // time frames spend in the decoder, video is released this much earlier
+        int32_t video_pool_hit_rate_;      // % of decoded frames that reused a pooled buffer, process wide
+        int32_t video_pool_kb_;            // held by decoded frame buffers, in use or idle, process wide
+        int32_t video_pool_idle_kb_;
+        int32_t shared_io_streams_;        // rtmp streams on the shared io thread, 0 when not in use
+        const char* ingest_transport_;     // where the flv tags come from: rtmp, http-flv or flv-file
+        // phases of the last rtmp connect, ms. on the shared io thread dns is part of
+        // tcp connect, and handshake and connect app are part of play.
+        int32_t rtmp_dns_ms_;
+        int32_t rtmp_tcp_connect_ms_;
+        int32_t rtmp_handshake_ms_;
+        int32_t rtmp_connect_app_ms_;
+        int32_t rtmp_play_ms_;
+        int32_t rtmp_reconnects_;          // reconnect attempts since the stream started
+        int32_t first_video_frame_ms_;     // open speed: start to first frame rendered, 0 until then
+        int32_t first_audio_ms_;           // start to first audio played, 0 until then
 
         // audio
         int32_t audio_samplerate_ = 0;
+        int32_t audio_playout_delay_ms_;   // output latency of the audio device
+        int32_t jitter_delay_ms_;          // adaptive buffer target derived from arrival jitter
+        float   audio_play_speed_;         // time-stretch tempo, > 1 catching up, < 1 refilling
+        const char* audio_decoder_;        // implementation name of the aac decoder in use
+        int32_t audio_decode_us_per_s_;    // decode time per second of audio
 
         // network
         int32_t cache_len_;
         int32_t audio_bps_;
         int32_t video_bps_;
+        int32_t video_copy_bytes_;         // payload bytes memcpy'd per second on video ingest
+        float   video_allocs_per_packet_;  // heap allocations per video packet on ingest
         
         int64_t sync_ts_;
+        int32_t shared_players_;           // players attached to the same rtmp ingest
+        int32_t sync_group_;               // multi-stream sync group, 0 when free running
+        int32_t sync_group_skew_ms_;       // ahead of the group stream furthest behind
+        int32_t sync_group_delay_ms_;      // buffered on top of the jitter target to stay aligned
+        int32_t timeshift_window_ms_;      // seekable span kept for pause and seek, 0 when off
+        int32_t timeshift_behind_live_ms_;
+        int32_t timeshift_memory_kb_;
+        int32_t timeshift_disk_kb_;        // spilled to the timeshift file
+        int32_t record_kb_;                // written by this player's recording, 0 when not recording
+        int32_t record_dropped_packets_;   // left out while the writer was behind or after an error
 
 
 		int64_t start_to_render_time_;
@@ -207,9 +260,7 @@ namespace dii_media_kit {
         DiiPlayerStatisticsCallback   statistics_callback; // 播放器统计回调
         void* custom_data;                                   // 自定义数据端，回调会原样带回该指针
         
-        DiiPlayerCallback() {
-            memset(this, 0, sizeof(DiiPlayerCallback));
-        }
+        DiiPlayerCallback() : custom_data(nullptr) {}
     } DiiPlayerCallback; // 播放器回调
 
     typedef std::function<void (const void* audioSamples,
@@ -47,6 +47,11 @@ extern "C" {
 using namespace dii_media_kit;
 
 #define MAX_QUEUE_SIZE (10 * 1024 * 1024)
+/* high bitrate streams may buffer up to 2 seconds of packets, within this limit */
+#define MAX_QUEUE_SIZE_HIGH_BITRATE (64 * 1024 * 1024)
+/* largest picture uploaded, 8K DCI */
+#define MAX_VIDEO_WIDTH  8192
+#define MAX_VIDEO_HEIGHT 4320
 #define MIN_FRAMES 50000
 #define EXTERNAL_CLOCK_MIN_FRAMES 2
 #define EXTERNAL_CLOCK_MAX_FRAMES 10
@@ -113,10 +118,34 @@ typedef struct PacketQueue {
     std::condition_variable *cond;
 } PacketQueue;
 
+enum {
+    LOOP_CACHE_DISABLED,
+    LOOP_CACHE_FILLING,  /* first pass, demuxed packets are being cached */
+    LOOP_CACHE_READY,    /* whole clip is cached, loops replay from memory */
+};
+
+/* Demuxed packets of a short clip, replayed on loop instead of seeking the demuxer. */
+typedef struct LoopCache {
+    MyAVPacketList *first_pkt, *last_pkt;
+    MyAVPacketList *replay_pkt;   /* next packet to replay, NULL at the end of a pass */
+    int64_t size;                 /* cached bytes */
+    int64_t max_size;             /* give up caching above this size */
+    int64_t start_ts;             /* first packet time, AV_TIME_BASE */
+    int64_t end_ts;               /* last packet end time, AV_TIME_BASE */
+    int64_t replay_offset;        /* added to the timestamps of replayed packets, AV_TIME_BASE */
+    int state;
+    int replaying;
+    int loop_count;
+} LoopCache;
+
 #define VIDEO_PICTURE_QUEUE_SIZE 3
+#define VIDEO_PICTURE_QUEUE_SIZE_MAX 8
+/* decoded pictures kept ahead, in seconds, bounded by the memory limit below */
+#define VIDEO_PICTURE_QUEUE_DURATION 0.1
+#define VIDEO_PICTURE_QUEUE_MAX_BYTES (192 * 1024 * 1024)
 #define SUBPICTURE_QUEUE_SIZE 16
 #define SAMPLE_QUEUE_SIZE 9
-#define FRAME_QUEUE_SIZE FFMAX(SAMPLE_QUEUE_SIZE, FFMAX(VIDEO_PICTURE_QUEUE_SIZE, SUBPICTURE_QUEUE_SIZE))
+#define FRAME_QUEUE_SIZE FFMAX(SAMPLE_QUEUE_SIZE, FFMAX(VIDEO_PICTURE_QUEUE_SIZE_MAX, SUBPICTURE_QUEUE_SIZE))
 
 typedef struct AudioParams {
     int freq;
@@ -291,6 +320,7 @@ typedef struct _VideoState {
     AVStream *audio_st;
     PacketQueue audioq;
     int audio_hw_buf_size;
+    int audio_playout_delay_ms;  /* output latency reported by the audio device, 0 if unknown */
     uint8_t *audio_buf;
     uint8_t *audio_buf1;
     unsigned int audio_buf_size; /* in bytes */
@@ -367,6 +397,8 @@ typedef struct _VideoState {
     
     // loop
     int loop = 1;
+    LoopCache loop_cache;
+    int64_t max_queue_size;
     int ff_stream_id;
 } VideoState;
 
@@ -471,32 +503,31 @@ static void ffp_check_buffering_l(VideoState* is) {
     if(is->video_st)
         video_time_base_valid = is->video_st->time_base.den > 0 && is->video_st->time_base.num > 0;
 
+    int64_t cached_duration_in_ms = -1;
+    int64_t audio_cached_duration = -1;
+    int64_t video_cached_duration = -1;
 
-        int64_t cached_duration_in_ms = -1;
-        int64_t audio_cached_duration = -1;
-        int64_t video_cached_duration = -1;
-
-        if (is->audio_st && audio_time_base_valid) {
-            audio_cached_duration = is->stat.audio_cache.duration;
-        }
+    if (is->audio_st && audio_time_base_valid) {
+        audio_cached_duration = is->stat.audio_cache.duration;
+    }
 
-        if (is->video_st && video_time_base_valid) {
-            video_cached_duration = is->stat.video_cache.duration;
-        }
+    if (is->video_st && video_time_base_valid) {
+        video_cached_duration = is->stat.video_cache.duration;
+    }
 
-        if (video_cached_duration > 0 && audio_cached_duration > 0) {
-            cached_duration_in_ms = FFMIN(video_cached_duration, audio_cached_duration);
-        } else if (video_cached_duration > 0) {
-            cached_duration_in_ms = (int)video_cached_duration;
-        } else if (audio_cached_duration > 0) {
-            cached_duration_in_ms = (int)audio_cached_duration;
-        }
+    if (video_cached_duration > 0 && audio_cached_duration > 0) {
+        cached_duration_in_ms = FFMIN(video_cached_duration, audio_cached_duration);
+    } else if (video_cached_duration > 0) {
+        cached_duration_in_ms = (int)video_cached_duration;
+    } else if (audio_cached_duration > 0) {
+        cached_duration_in_ms = (int)audio_cached_duration;
+    }
 
-        if (cached_duration_in_ms >= 0) {
-              buf_time_position = dii_ffplay_position(is) + cached_duration_in_ms;
-              is->playable_duration_ms = buf_time_position;
-        }
-        DII_LOG(LS_VERBOSE, is->ff_stream_id, 0) << "queue playable_duration_ms: " << is->playable_duration_ms;
+    if (cached_duration_in_ms >= 0) {
+        buf_time_position = dii_ffplay_position(is) + cached_duration_in_ms;
+        is->playable_duration_ms = buf_time_position;
+    }
+    DII_LOG(LS_VERBOSE, is->ff_stream_id, 0) << "queue playable_duration_ms: " << is->playable_duration_ms;
 }
 
 static void ffp_track_statistic_l(VideoState* is, AVStream *st, PacketQueue *q, FFTrackCacheStatistic *cache) {
@@ -664,6 +695,141 @@ static int packet_queue_get(VideoState* is, PacketQueue *q, AVPacket *pkt, int b
     return ret;
 }
 
+static void loop_cache_init(LoopCache *c, int64_t max_size)
+{
+    memset(c, 0, sizeof(LoopCache));
+    c->max_size = max_size;
+    c->start_ts = AV_NOPTS_VALUE;
+    c->end_ts = AV_NOPTS_VALUE;
+    c->state = max_size > 0 ? LOOP_CACHE_FILLING : LOOP_CACHE_DISABLED;
+}
+
+static void loop_cache_reset(LoopCache *c)
+{
+    MyAVPacketList *pkt, *pkt1;
+
+    for (pkt = c->first_pkt; pkt; pkt = pkt1) {
+        pkt1 = pkt->next;
+        av_packet_unref(&pkt->pkt);
+        av_freep(&pkt);
+    }
+    c->first_pkt = c->last_pkt = c->replay_pkt = NULL;
+    c->size = 0;
+    c->replaying = 0;
+    c->state = LOOP_CACHE_DISABLED;
+}
+
+/* keep a reference of a demuxed packet while the first pass is running */
+static void loop_cache_put(VideoState *is, AVPacket *pkt)
+{
+    LoopCache *c = &is->loop_cache;
+    AVStream *st = is->ic->streams[pkt->stream_index];
+    MyAVPacketList *pkt1;
+    int64_t pkt_ts = pkt->pts == AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
+
+    if (c->state != LOOP_CACHE_FILLING)
+        return;
+
+    if (!is->loop) {
+        /* not looping, the clip is played once and needs no copy */
+        loop_cache_reset(c);
+        return;
+    }
+    if (pkt_ts == AV_NOPTS_VALUE || c->size + pkt->size + (int64_t)sizeof(*pkt1) > c->max_size) {
+        DII_LOG(LS_INFO, is->ff_stream_id, DII_CODE_COMMON_INFO) << "loop cache disabled, clip larger than "
+                                                                  << c->max_size << " bytes or without timestamps.";
+        loop_cache_reset(c);
+        return;
+    }
+
+    pkt1 = (MyAVPacketList *)av_mallocz(sizeof(MyAVPacketList));
+    if (!pkt1 || av_packet_ref(&pkt1->pkt, pkt) < 0) {
+        av_free(pkt1);
+        loop_cache_reset(c);
+        return;
+    }
+    if (!c->last_pkt)
+        c->first_pkt = pkt1;
+    else
+        c->last_pkt->next = pkt1;
+    c->last_pkt = pkt1;
+    c->size += pkt1->pkt.size + sizeof(*pkt1);
+
+    pkt_ts = av_rescale_q(pkt_ts, st->time_base, AV_TIME_BASE_Q);
+    if (c->start_ts == AV_NOPTS_VALUE || pkt_ts < c->start_ts)
+        c->start_ts = pkt_ts;
+    pkt_ts += av_rescale_q(pkt->duration, st->time_base, AV_TIME_BASE_Q);
+    if (c->end_ts == AV_NOPTS_VALUE || pkt_ts > c->end_ts)
+        c->end_ts = pkt_ts;
+}
+
+/* a looping clip went back to its beginning without a cache, fill it on this pass */
+static void loop_cache_refill(VideoState *is)
+{
+    LoopCache *c = &is->loop_cache;
+    if (c->state != LOOP_CACHE_DISABLED || c->max_size <= 0 || !is->loop)
+        return;
+    c->start_ts = AV_NOPTS_VALUE;
+    c->end_ts = AV_NOPTS_VALUE;
+    c->replay_offset = 0;
+    c->state = LOOP_CACHE_FILLING;
+}
+
+/* the demuxer hit EOF, return 0 if the whole clip is in memory */
+static int loop_cache_complete(VideoState *is)
+{
+    LoopCache *c = &is->loop_cache;
+    if (c->state == LOOP_CACHE_FILLING) {
+        if (!is->loop || !c->first_pkt || c->end_ts <= c->start_ts) {
+            loop_cache_reset(c);
+            return -1;
+        }
+        c->state = LOOP_CACHE_READY;
+        DII_LOG(LS_INFO, is->ff_stream_id, DII_CODE_COMMON_INFO) << "loop cache ready, size: " << c->size
+                                                                  << " bytes, duration: " << fftime_to_milliseconds(c->end_ts - c->start_ts) << " ms.";
+    }
+    return c->state == LOOP_CACHE_READY ? 0 : -1;
+}
+
+/* start replaying the cached clip, its timestamps shifted by offset */
+static void loop_cache_rewind(LoopCache *c, int64_t offset)
+{
+    c->replay_pkt = c->first_pkt;
+    c->replay_offset = offset;
+    c->replaying = 1;
+    c->loop_count++;
+}
+
+/* return the next cached packet, or AVERROR_EOF at the end of the last pass */
+static int loop_cache_read(VideoState *is, AVPacket *pkt)
+{
+    LoopCache *c = &is->loop_cache;
+    AVStream *st;
+    int64_t offset;
+    int ret;
+
+    if (!c->replay_pkt) {
+        if (!is->loop) {
+            /* looping was turned off, this was the last pass */
+            loop_cache_reset(c);
+            return AVERROR_EOF;
+        }
+        /* seamless wrap, timestamps keep increasing so no decoder flush is needed */
+        loop_cache_rewind(c, c->replay_offset + c->end_ts - c->start_ts);
+    }
+
+    if ((ret = av_packet_ref(pkt, &c->replay_pkt->pkt)) < 0)
+        return ret;
+    st = is->ic->streams[pkt->stream_index];
+    offset = av_rescale_q(c->replay_offset, AV_TIME_BASE_Q, st->time_base);
+    if (pkt->pts != AV_NOPTS_VALUE)
+        pkt->pts += offset;
+    if (pkt->dts != AV_NOPTS_VALUE)
+        pkt->dts += offset;
+    c->replay_pkt = c->replay_pkt->next;
+    return 0;
+}
+
 static void decoder_init(Decoder *d, AVCodecContext *avctx, PacketQueue *queue, std::condition_variable *empty_queue_cond) {
     memset(d, 0, sizeof(Decoder));
     d->avctx = avctx;
@@ -802,8 +968,11 @@ static int frame_queue_init(FrameQueue *f, PacketQueue *pktq, int max_size, int
 static void frame_queue_destory(FrameQueue *f)
 {
     int i;
-    for (i = 0; i < f->max_size; i++) {
+    /* max_size may have been lowered after init, free every allocated frame */
+    for (i = 0; i < FRAME_QUEUE_SIZE; i++) {
         Frame *vp = &f->queue[i];
+        if (!vp->frame)
+            continue;
         frame_queue_unref_item(vp);
         av_frame_free(&vp->frame);
     }
@@ -950,15 +1119,21 @@ static int upload_texture(VideoState* is, AVFrame *frame, struct SwsContext **im
         return -1;
     }
 
-    // limit to 4k resolution
-    if (frame->linesize[0] <= 0 || frame->linesize[0] > 2160||
-        frame->linesize[1] <= 0 || frame->linesize[1] > 2160 ||
-        frame->linesize[2] <= 0 || frame->linesize[2] > 2160 ||
-        frame->data[0] == nullptr || frame->data[1] == nullptr || frame->data[2] == nullptr) {
-        DII_LOG(LS_ERROR, is->ff_stream_id, DII_CODE_COMMON_ERROR) << "upoad texture: avframe error.";
+    // limit to 8k resolution
+    if (frame->width > MAX_VIDEO_WIDTH || frame->height > MAX_VIDEO_HEIGHT) {
+        DII_LOG(LS_ERROR, is->ff_stream_id, DII_CODE_COMMON_ERROR) << "upoad texture: unsupported resolution "
+                                                                   << frame->width << "x" << frame->height;
         is->state_callback(DII_STATE_ERROR, DII_CODE_COMMON_ERROR, "upoad texture: avframe error.");
         return -1;
     }
+    int planes = av_pix_fmt_count_planes((AVPixelFormat)frame->format);
+    for (int i = 0; i < planes; i++) {
+        if (frame->linesize[i] <= 0 || frame->data[i] == nullptr) {
+            DII_LOG(LS_ERROR, is->ff_stream_id, DII_CODE_COMMON_ERROR) << "upoad texture: avframe error.";
+            is->state_callback(DII_STATE_ERROR, DII_CODE_COMMON_ERROR, "upoad texture: avframe error.");
+            return -1;
+        }
+    }
     
     dii_media_kit::VideoRotation frame_rotation = kVideoRotation_0;
     if (autorotate) {
@@ -1097,7 +1272,7 @@ static void stream_component_close(VideoState *is, int stream_index)
     AVFormatContext *ic = is->ic;
     AVCodecParameters *codecpar;
 
-    if (stream_index < 0 || stream_index >= ic->nb_streams)
+    if (stream_index < 0 || stream_index >= (int)ic->nb_streams)
         return;
     codecpar = ic->streams[stream_index]->codecpar;
 
@@ -1169,6 +1344,7 @@ static void stream_close(VideoState *is)
 
     avformat_close_input(&is->ic);
 
+    loop_cache_reset(&is->loop_cache);
     packet_queue_destroy(&is->videoq);
     packet_queue_destroy(&is->audioq);
     packet_queue_destroy(&is->subtitleq);
@@ -1503,45 +1679,6 @@ static void video_refresh(void *opaque, double *remaining_time)
     }
 
     is->force_refresh = 0;
-    if (show_status) {
-        static int64_t last_time;
-        int64_t cur_time;
-        int aqsize, vqsize, sqsize;
-        double av_diff;
-
-        cur_time = av_gettime_relative();
-        if (!last_time || (cur_time - last_time) >= 30000) {
-            aqsize = 0;
-            vqsize = 0;
-            sqsize = 0;
-            if (is->audio_st)
-                aqsize = is->audioq.size;
-            if (is->video_st)
-                vqsize = is->videoq.size;
-            if (is->subtitle_st)
-                sqsize = is->subtitleq.size;
-            av_diff = 0;
-            if (is->audio_st && is->video_st)
-                av_diff = get_clock(&is->audclk) - get_clock(&is->vidclk);
-            else if (is->video_st)
-                av_diff = get_master_clock(is) - get_clock(&is->vidclk);
-            else if (is->audio_st)
-                av_diff = get_master_clock(is) - get_clock(&is->audclk);
-            //            av_log(NULL, AV_LOG_INFO,
-            //                   "%7.2f %s:%7.3f fd=%4d aq=%5dKB vq=%5dKB sq=%5dB f=%"PRId64"/%"PRId64"   \r",
-            //                   get_master_clock(is),
-            //                   (is->audio_st && is->video_st) ? "A-V" : (is->video_st ? "M-V" : (is->audio_st ? "M-A" : "   ")),
-            //                   av_diff,
-            //                   is->frame_drops_early + is->frame_drops_late,
-            //                   aqsize / 1024,
-            //                   vqsize / 1024,
-            //                   sqsize,
-            //                   is->video_st ? is->viddec.avctx->pts_correction_num_faulty_dts : 0,
-            //                   is->video_st ? is->viddec.avctx->pts_correction_num_faulty_pts : 0);
-            fflush(stdout);
-            last_time = cur_time;
-        }
-    }
 }
 
 static int queue_picture(VideoState *is, AVFrame *src_frame, double pts, double duration, int64_t pos, int serial)
@@ -2350,7 +2487,7 @@ int32_t dii_ffplay_need_10ms_pcm_data(void *opaque, uint8_t *stream, size_t samp
     audio_callback_time = av_gettime_relative();
     int need_len = len_10ms;
     while (need_len > 0) {
-        if (is->audio_buf_index >= is->audio_buf_size) {
+        if (is->audio_buf_index >= (int)is->audio_buf_size) {
            audio_size = audio_decode_frame(is);
            if (audio_size < 0) {
                 /* if error, just output silence */
@@ -2388,9 +2525,11 @@ int32_t dii_ffplay_need_10ms_pcm_data(void *opaque, uint8_t *stream, size_t samp
 //    }
     
     is->audio_write_buf_size = is->audio_buf_size - is->audio_buf_index;
-    /* Let's assume the audio driver that is used by SDL has two periods. */
+    /* Use the device output latency if known, otherwise assume the audio driver has two periods. */
     if (!isnan(is->audio_clock)) {
-        set_clock_at(&is->audclk, is->audio_clock - (double)(2 * is->audio_hw_buf_size + is->audio_write_buf_size) / is->audio_tgt.bytes_per_sec, is->audio_clock_serial, audio_callback_time / 1000000.0);
+        double hw_latency = is->audio_playout_delay_ms > 0 ? is->audio_playout_delay_ms / 1000.0
+                                                           : (double)(2 * is->audio_hw_buf_size) / is->audio_tgt.bytes_per_sec;
+        set_clock_at(&is->audclk, is->audio_clock - hw_latency - (double)is->audio_write_buf_size / is->audio_tgt.bytes_per_sec, is->audio_clock_serial, audio_callback_time / 1000000.0);
         sync_clock_to_slave(&is->extclk, &is->audclk);		
     }
     
@@ -2398,6 +2537,19 @@ int32_t dii_ffplay_need_10ms_pcm_data(void *opaque, uint8_t *stream, size_t samp
 }
 
 /* open a given stream. Return 0 if OK */
+/* keep about VIDEO_PICTURE_QUEUE_DURATION of decoded pictures, fewer for very large frames */
+static int video_picture_queue_size(VideoState *is, AVStream *st, AVCodecContext *avctx)
+{
+    AVRational frame_rate = av_guess_frame_rate(is->ic, st, NULL);
+    double fps = frame_rate.num && frame_rate.den ? av_q2d(frame_rate) : 25.0;
+    int64_t frame_bytes = (int64_t)avctx->width * avctx->height * 3 / 2;
+    int size = av_clip((int)lrint(fps * VIDEO_PICTURE_QUEUE_DURATION), VIDEO_PICTURE_QUEUE_SIZE, VIDEO_PICTURE_QUEUE_SIZE_MAX);
+
+    if (frame_bytes > 0)
+        size = FFMAX(VIDEO_PICTURE_QUEUE_SIZE, FFMIN(size, (int)(VIDEO_PICTURE_QUEUE_MAX_BYTES / frame_bytes)));
+    return size;
+}
+
 static int stream_component_open(VideoState *is, int stream_index)
 {
     AVFormatContext *ic = is->ic;
@@ -2406,12 +2558,10 @@ static int stream_component_open(VideoState *is, int stream_index)
     const char *forced_codec_name = NULL;
     AVDictionary *opts = NULL;
     AVDictionaryEntry *t = NULL;
-    int sample_rate, nb_channels;
-    int64_t channel_layout;
     int ret = 0;
     int stream_lowres = lowres;
 
-    if (stream_index < 0 || stream_index >= ic->nb_streams)
+    if (stream_index < 0 || stream_index >= (int)ic->nb_streams)
         return -1;
 
     avctx = avcodec_alloc_context3(NULL);
@@ -2488,23 +2638,13 @@ static int stream_component_open(VideoState *is, int stream_index)
         case AVMEDIA_TYPE_AUDIO:
 #if CONFIG_AVFILTER
         {
-            AVFilterContext *sink;
-
             is->audio_filter_src.freq           = avctx->sample_rate;
             is->audio_filter_src.channels       = avctx->channels;
             is->audio_filter_src.channel_layout = get_valid_channel_layout(avctx->channel_layout, avctx->channels);
             is->audio_filter_src.fmt            = avctx->sample_fmt;
             if ((ret = configure_audio_filters(is, afilters, 0)) < 0)
                 goto fail;
-            sink = is->out_audio_filter;
-            sample_rate    = av_buffersink_get_sample_rate(sink);
-            nb_channels    = av_buffersink_get_channels(sink);
-            channel_layout = av_buffersink_get_channel_layout(sink);
         }
-#else
-            sample_rate    = avctx->sample_rate;
-            nb_channels    = avctx->channels;
-            channel_layout = avctx->channel_layout;
 #endif
 
             is->audio_hw_buf_size = 1024;
@@ -2535,6 +2675,9 @@ static int stream_component_open(VideoState *is, int stream_index)
         case AVMEDIA_TYPE_VIDEO:
             is->video_stream = stream_index;
             is->video_st = ic->streams[stream_index];
+            is->pictq.max_size = video_picture_queue_size(is, is->video_st, avctx);
+            DII_LOG(LS_INFO, is->ff_stream_id, DII_CODE_COMMON_INFO) << "video " << avctx->width << "x" << avctx->height
+                                                                      << ", picture queue size: " << is->pictq.max_size;
             decoder_init(&is->viddec, avctx, &is->videoq, is->continue_read_thread);
             if ((ret = decoder_start(&is->viddec, video_thread, "video_decoder", is)) < 0)
                 goto out1;
@@ -2625,9 +2768,7 @@ static int read_thread(void *arg)
     AVPacket pkt1, *pkt = &pkt1;
     int64_t stream_start_time;
     int pkt_in_play_range = 0;
-    AVDictionaryEntry *t;
     std::mutex wait_mutex;
-    int scan_all_pmts_set = 0;
     int64_t pkt_ts;
     
     int64_t buffer_check_timer = 0;
@@ -2683,6 +2824,10 @@ static int read_thread(void *arg)
         }
     }
 
+    is->max_queue_size = MAX_QUEUE_SIZE;
+    if (ic->bit_rate > 0)
+        is->max_queue_size = av_clip64(ic->bit_rate / 8 * 2, MAX_QUEUE_SIZE, MAX_QUEUE_SIZE_HIGH_BITRATE);
+
     if (ic->pb)
         ic->pb->eof_reached = 0; // FIXME hack, ffplay maybe should not use avio_feof() to test for the end
 
@@ -2711,11 +2856,15 @@ static int read_thread(void *arg)
     
     // 判断是否实时网络流rtp,rtsp,sdp,udp
     is->realtime = is_realtime(ic);
+    if (is->realtime || is->start_pos > 0 || duration != AV_NOPTS_VALUE) {
+        loop_cache_reset(&is->loop_cache);
+        is->loop_cache.max_size = 0;
+    }
 
     if (show_status)
         av_dump_format(ic, 0, is->filename, 0);
 
-    for (i = 0; i < ic->nb_streams; i++) {
+    for (i = 0; i < (int)ic->nb_streams; i++) {
         AVStream *st = ic->streams[i];
         enum AVMediaType type = st->codecpar->codec_type;
         st->discard = AVDISCARD_ALL;
@@ -2751,11 +2900,6 @@ static int read_thread(void *arg)
                             NULL, 0);
 
     is->show_mode = show_mode;
-    if (st_index[AVMEDIA_TYPE_VIDEO] >= 0) {
-        AVStream *st = ic->streams[st_index[AVMEDIA_TYPE_VIDEO]];
-        AVCodecParameters *codecpar = st->codecpar;
-        AVRational sar = av_guess_sample_aspect_ratio(ic, st, NULL);
-    }
 
     /* open the streams */
     if (st_index[AVMEDIA_TYPE_AUDIO] >= 0) {
@@ -2811,7 +2955,18 @@ static int read_thread(void *arg)
             // FIXME the +-2 is due to rounding being not done in the correct direction in generation
             //      of the seek_pos/seek_rel variables
 
-            ret = avformat_seek_file(is->ic, -1, seek_min, seek_target, seek_max, is->seek_flags);
+            if (is->loop_cache.state == LOOP_CACHE_READY && !(is->seek_flags & AVSEEK_FLAG_BYTE) &&
+                seek_target <= is->loop_cache.start_ts) {
+                // back to the beginning of a cached clip, replay from memory
+                loop_cache_rewind(&is->loop_cache, 0);
+                ret = 0;
+            } else {
+                loop_cache_reset(&is->loop_cache);
+                ret = avformat_seek_file(is->ic, -1, seek_min, seek_target, seek_max, is->seek_flags);
+                if (ret >= 0 && !(is->seek_flags & AVSEEK_FLAG_BYTE) &&
+                    seek_target <= (ic->start_time != AV_NOPTS_VALUE ? ic->start_time : 0))
+                    loop_cache_refill(is);
+            }
             if (ret < 0) {
                 DII_LOG(LS_ERROR, is->ff_stream_id, 600007) << is->ic->url << ": error while seeking."<<"whith error code: "<<ret;
                 is->state_callback(DII_STATE_ERROR, 600007, "error while seeking, url: %s");
@@ -2860,7 +3015,7 @@ static int read_thread(void *arg)
 
         /* if the queue are full, no need to read more */
         if (infinite_buffer<1 &&
-            (is->audioq.size + is->videoq.size + is->subtitleq.size > MAX_QUEUE_SIZE ||
+            (is->audioq.size + is->videoq.size + is->subtitleq.size > is->max_queue_size ||
             (stream_has_enough_packets(is->audio_st, is->audio_stream, &is->audioq) &&
             stream_has_enough_packets(is->video_st, is->video_stream, &is->videoq) &&
             stream_has_enough_packets(is->subtitle_st, is->subtitle_stream, &is->subtitleq)))) {
@@ -2891,10 +3046,18 @@ static int read_thread(void *arg)
         }
         //主要流程就是不停的读取帧到队列中，如果队列满了则等待。
         //同时外部播放线程不断从队列中取帧进行播放。
-        ret = av_read_frame(ic, pkt); //关键代码：读取帧
+        if (is->loop_cache.replaying)
+            ret = loop_cache_read(is, pkt);
+        else
+            ret = av_read_frame(ic, pkt); //关键代码：读取帧
 
         if (ret < 0) { //错误或者结束，队列放入一个空包
             if ((ret == AVERROR_EOF || avio_feof(ic->pb)) && !is->eof) {
+                if (loop_cache_complete(is) == 0 && is->loop && !is->loop_cache.replaying) {
+                    // the whole clip is cached, keep feeding the decoders without a seek
+                    loop_cache_rewind(&is->loop_cache, is->loop_cache.end_ts - is->loop_cache.start_ts);
+                    continue;
+                }
                 if (is->video_stream >= 0)
                     packet_queue_put_nullpacket(&is->videoq, is->video_stream);
                 if (is->audio_stream >= 0)
@@ -2931,6 +3094,11 @@ static int read_thread(void *arg)
         av_q2d(ic->streams[pkt->stream_index]->time_base) -
         (double)(is->start_pos > 0 ? is->start_pos : 0) / 1000000
         <= ((double)duration / 1000000);
+        if ((pkt->stream_index == is->audio_stream || pkt->stream_index == is->subtitle_stream ||
+             (pkt->stream_index == is->video_stream && !(is->video_st->disposition & AV_DISPOSITION_ATTACHED_PIC))) &&
+            pkt_in_play_range) {
+            loop_cache_put(is, pkt);
+        }
         if (pkt->stream_index == is->audio_stream && pkt_in_play_range) {
             packet_queue_put(&is->audioq, pkt);
         } else if (pkt->stream_index == is->video_stream && pkt_in_play_range
@@ -2986,7 +3154,7 @@ static void stream_cycle_channel(VideoState *is, int codec_type)
         if (p) {
             nb_streams = p->nb_stream_indexes;
             for (start_index = 0; start_index < nb_streams; start_index++)
-                if (p->stream_index[start_index] == stream_index)
+                if ((int)p->stream_index[start_index] == stream_index)
                     break;
             if (start_index == nb_streams)
                 start_index = -1;
@@ -3065,7 +3233,7 @@ static void seek_chapter(VideoState *is, int incr)
         return;
 
     /* find the current chapter */
-    for (i = 0; i < is->ic->nb_chapters; i++) {
+    for (i = 0; i < (int)is->ic->nb_chapters; i++) {
         AVChapter *ch = is->ic->chapters[i];
 		AVRational time_base = {1, AV_TIME_BASE};
         if (av_compare_ts(pos, time_base/*AV_TIME_BASE_Q*/, ch->start, ch->time_base) < 0) {
@@ -3076,7 +3244,7 @@ static void seek_chapter(VideoState *is, int incr)
 
     i += incr;
     i = FFMAX(i, 0);
-    if (i >= is->ic->nb_chapters)
+    if (i >= (int)is->ic->nb_chapters)
         return;
     
     DII_LOG(LS_VERBOSE, is->ff_stream_id, DII_CODE_COMMON_INFO) << "Seeking to chapter " << i;
@@ -3140,11 +3308,11 @@ static void event_loop(VideoState *cur_stream)
     }
 }
 
-#pragma open video
 static VideoState *stream_open(const char *filename,
                                AVInputFormat *iformat,
                                int64_t pos,
                                int stream_id,
+                               int64_t loop_cache_size,
                                VideoFrameCallback frame_callback,
                                StateCallback state_callback)
 {
@@ -3165,6 +3333,7 @@ static VideoState *stream_open(const char *filename,
 	is->start_pos = milliseconds_to_fftime(pos);
     // bugfix: start + pos + pause, get position api return 0;
     is->seek_pos = is->start_pos;
+    loop_cache_init(&is->loop_cache, loop_cache_size);
     is->filename = av_strdup(filename);
     if (!is->filename) {
         DII_LOG(LS_ERROR, is->ff_stream_id, 600018) << "error: file name is null.";
@@ -3178,7 +3347,7 @@ static VideoState *stream_open(const char *filename,
 
     // 创建音频，视频，字幕帧队列
     /* start video display */
-    if (frame_queue_init(&is->pictq, &is->videoq, VIDEO_PICTURE_QUEUE_SIZE, 1) < 0)
+    if (frame_queue_init(&is->pictq, &is->videoq, VIDEO_PICTURE_QUEUE_SIZE_MAX, 1) < 0)
         goto fail;
     if (frame_queue_init(&is->subpq, &is->subtitleq, SUBPICTURE_QUEUE_SIZE, 0) < 0)
         goto fail;
@@ -3231,7 +3400,6 @@ fail:
     return is;
 }
 
-#pragma player start play
 static int64_t dii_ffplay_duration(void *is) {
     VideoState *vis = (VideoState*)is;
     if (!vis || !vis->ic)
@@ -3261,6 +3429,12 @@ static int64_t dii_ffplay_position(void *is) {
     } else {
         cur_pos = pos_clock * 1000;
     }
+    // replayed loops of a cached clip keep increasing timestamps
+    if (vis->loop_cache.state == LOOP_CACHE_READY && vis->loop_cache.end_ts > vis->loop_cache.start_ts) {
+        int64_t loop_duration = fftime_to_milliseconds(vis->loop_cache.end_ts - vis->loop_cache.start_ts);
+        if (cur_pos - start_diff >= loop_duration)
+            cur_pos = start_diff + (cur_pos - start_diff) % loop_duration;
+    }
 
     if (cur_pos < 0 || cur_pos < start_diff) return 0;
     
@@ -3377,9 +3551,17 @@ static bool dii_ffplay_loop(void *is, bool loop) {
 	return false;
 }
 
+static void dii_ffplay_set_playout_delay(void *is, int32_t delay_ms) {
+    VideoState *vis = (VideoState*)is;
+    if (!vis)
+        return;
+    vis->audio_playout_delay_ms = delay_ms;
+}
+
 static void* dii_ffplay_start(const char* url,
                                 int64_t pos,
                                 int stream_id,
+                                int64_t loop_cache_size,
                                 VideoFrameCallback frame_callback,
                                 StateCallback state_callback) {
     
@@ -3388,7 +3570,7 @@ static void* dii_ffplay_start(const char* url,
     av_init_packet(&flush_pkt);
     flush_pkt.data = (uint8_t *)&flush_pkt;
 
-    VideoState *vis = stream_open(url, file_iformat, pos, stream_id, frame_callback, state_callback);
+    VideoState *vis = stream_open(url, file_iformat, pos, stream_id, loop_cache_size, frame_callback, state_callback);
     if (!vis) {
         DII_LOG(LS_ERROR, stream_id, 600009) << "Failed to initialize VideoState!";
         state_callback(DII_STATE_ERROR, 600009, "Failed to initialize VideoState!");
@@ -3424,6 +3606,7 @@ namespace dii_media_kit  {
         dii_ffplayer_ = dii_ffplay_start(url,
                                              pos,
                                              stream_id_,
+                                             loop_cache_size_,
                                              callback_.video_frame_callback_,
                                              callback_.state_callback_);
         return 0;
@@ -3467,6 +3650,12 @@ namespace dii_media_kit  {
         return ret;
     }
 
+    int32_t DiiFFPlayer::SetLoopCacheSize(int64_t max_bytes) {
+        std::unique_lock<std::mutex> lck(mtx_);
+        loop_cache_size_ = max_bytes;
+        return 0;
+    }
+
     int32_t DiiFFPlayer::Seek(int64_t pos) {
         std::unique_lock<std::mutex> lck(mtx_);
 		int ret = -1;
@@ -3504,6 +3693,13 @@ namespace dii_media_kit  {
         return len;
     }
 
+    void DiiFFPlayer::SetPlayoutDelay(int32_t delay_ms) {
+        std::unique_lock<std::mutex> lck(mtx_);
+        if (dii_ffplayer_) {
+            dii_ffplay_set_playout_delay(dii_ffplayer_, delay_ms);
+        }
+    }
+
     int32_t DiiFFPlayer::SetCallback(DiiMediaBaseCallback callback) {
         callback_ = callback;
         return 0;
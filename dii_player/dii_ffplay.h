@@ -14,6 +14,9 @@
 
 //#define CHECK_FFPLAY(ptr)  if(!ptr)  return -1;
 
+// short local clips up to this size are looped from memory
+#define DII_LOOP_CACHE_DEFAULT_SIZE (16 * 1024 * 1024)
+
 enum WorkStat {
 	WORK_NONE,
 	WORK_OK,
@@ -29,17 +32,24 @@ namespace dii_media_kit  {
         int32_t Resume() override;
         int32_t StopPlay() override;
         int32_t SetLoop(bool loop) override;
+        int32_t SetLoopCacheSize(int64_t max_bytes) override;
         int32_t Seek(int64_t pos) override;
         int64_t Position() override;
         int64_t Duration() override;
         int32_t GetMoreAudioData(void *stream, size_t sample_rate, size_t channel) override;
+        void SetPlayoutDelay(int32_t delay_ms) override;
         int32_t SetCallback(DiiMediaBaseCallback callback) override;
         void DoStatistics(DiiPlayerStatistics& statistics) override;
+        // only rtmp streams are recorded
+        int32_t StartRecord(const char* path, DiiRecordFormat format) override {return DII_ERROR;};
+        int32_t StopRecord() override {return DII_ERROR;};
+        int32_t SetSyncGroup(int32_t group_id) override {return DII_ERROR;};
     private:
         std::mutex mtx_;
         void* dii_ffplayer_ = nullptr;
         DiiMediaBaseCallback callback_;
         int32_t stream_id_ = -1;
+        int64_t loop_cache_size_ = DII_LOOP_CACHE_DEFAULT_SIZE;
         
         dii_radar::DiiRole _role;
         char * _userid;
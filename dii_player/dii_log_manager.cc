@@ -45,7 +45,6 @@ const char* DiiMediaKit::Version() {
     return DII_MEDIA_KIT_VERSION;
 }
 
-#pragma class DiiLogManager
 DiiLogManager::DiiLogManager() {
     trace_file_.reset(new dii_rtc::FileStream());
 }
@@ -8,11 +8,17 @@
 
 #include "dii_media_core.h"
 #include "dii_common.h"
+#ifndef DII_WITHOUT_FFMPEG
 #include "dii_ffplay.h"
+#endif
 #include "dii_rtmp/dii_rtmp_player.h"
+#include "dii_rtmp/dii_rtmp_flv_transport.h"
+#include "dii_rtmp/dii_rtmp_puller.h"
+#include "dii_rtmp/dii_rtmp_source.h"
 #include "webrtc/video_frame.h"
 #include "webrtc/media/engine/webrtcvideoframe.h"
 #include "webrtc/common_video/libyuv/include/webrtc_libyuv.h"
+#include "webrtc/common_video/include/i420_buffer_pool.h"
 #include "third_party/libyuv/include/libyuv.h"
 
 #include <regex>
@@ -26,6 +32,8 @@
 #define DII_MSG_STOP                  1004
 #define DII_MSG_SEEK                  1005
 #define DII_MSG_LOOP                  1006
+#define DII_MSG_RECORD                1007
+#define DII_MSG_SYNC_GROUP            1008
 
 namespace dii_media_kit  {
 DiiMediaCore::DiiMediaCore(void* render, bool outputPcmForExternalMix) {
@@ -96,7 +104,16 @@ void DiiMediaCore::OnMessage(dii_rtc::Message* msg) {
             dii_rtc::TypedMessageData<std::string>* data =
             static_cast<dii_rtc::TypedMessageData<std::string>*>(msg->pdata);
             player_ = CreatePlayer(data->data().c_str());
+            if(!player_) {
+                OnPlayerState(DII_STATE_ERROR, DII_ERROR, "no player for url");
+                break;
+            }
+            applied_playout_delay_ms_ = -1;
+            if(loop_cache_size_ >= 0)
+                player_->SetLoopCacheSize(loop_cache_size_);
             player_->Start(data->data().c_str(), this->play_pos_);
+            if(sync_group_ != 0)
+                player_->SetSyncGroup(sync_group_);
             this->StartAudioPlayout();
             break;
         } case DII_MSG_PAUSE : {
@@ -113,6 +130,23 @@ void DiiMediaCore::OnMessage(dii_rtc::Message* msg) {
             if(player_)
                 player_->SetLoop(loop_);
             break;
+        } case DII_MSG_RECORD: {
+            std::unique_lock<std::mutex> lck(mtx_);
+            if(!player_)
+                break;
+            int32_t ret = recording_ ? player_->StartRecord(record_path_.c_str(), record_format_)
+                                     : player_->StopRecord();
+            if(ret < 0 && recording_) {
+                DII_LOG(LS_ERROR, stream_id_, DII_CODE_COMMON_ERROR) << "record to " << record_path_
+                    << " failed, ret: " << ret;
+                recording_ = false;
+            }
+            break;
+        } case DII_MSG_SYNC_GROUP: {
+            std::unique_lock<std::mutex> lck(mtx_);
+            if(player_)
+                player_->SetSyncGroup(sync_group_);
+            break;
         } case DII_MSG_STOP: {
             this->StopAudioPlayout();
             std::unique_lock<std::mutex> lck(mtx_);
@@ -152,20 +186,31 @@ DiiPlayBase* DiiMediaCore::CreatePlayer(std::string url) {
 
     // create player.
     DiiPlayBase *player = nullptr;
-    if(StrRegexMatch(url, "rtmp://.*")) {
+    // live http-flv and flv files played out as live take the rtmp pipeline too
+    if(StrRegexMatch(url, "rtmp://.*") ||
+       StrRegexMatch(url, "^http://[^?#]*\\.flv($|[?#])") ||
+       StrRegexMatch(url, "^" DII_FLV_FILE_SCHEME)) {
         DII_LOG(LS_INFO, stream_id_, DII_CODE_COMMON_INFO)
         << "create player for with rtmp, this:" << this
         << ", url: " << url;
         
         real_stream_ = true;
+        timeshift_ = DiiRtmpSource::TimeshiftEnabled();
         player = new DiiRtmplayer(stream_id_);
     } else {
+#ifdef DII_WITHOUT_FFMPEG
+        DII_LOG(LS_ERROR, stream_id_, DII_CODE_COMMON_ERROR)
+        << "no ffplay in this build, can't play url: " << url;
+        return nullptr;
+#else
         DII_LOG(LS_INFO, stream_id_, DII_CODE_COMMON_INFO)
         << "create player with ffplay, this:" << this
         << ", url: " << url;
         
         real_stream_ = false;
+        timeshift_ = false;
         player = new DiiFFPlayer(stream_id_);
+#endif
     }
     DiiMediaBaseCallback callbacks;
     callbacks.state_callback_ = std::bind(&DiiMediaCore::OnPlayerState,
@@ -217,7 +262,7 @@ int32_t DiiMediaCore::Start(int32_t stream_id, const char* url, int64_t pos, boo
 }
 
 int32_t DiiMediaCore::Pause() {
-    if(!started_ || paused_ || real_stream_) {
+    if(!started_ || paused_ || (real_stream_ && !timeshift_)) {
         return DII_ERROR;
     }
     paused_ = true;
@@ -226,7 +271,7 @@ int32_t DiiMediaCore::Pause() {
 }
 
 int32_t DiiMediaCore::Resume() {
-    if(!started_ || !paused_ || real_stream_) {
+    if(!started_ || !paused_ || (real_stream_ && !timeshift_)) {
         return DII_ERROR;
     }
     paused_ = false;
@@ -243,12 +288,26 @@ int32_t DiiMediaCore::SetLoop(bool loop) {
     return DII_DONE;
 }
 
+int32_t DiiMediaCore::SetLoopCacheSize(int64_t max_bytes) {
+    if(max_bytes < 0) {
+        return DII_PARAMETER_ERROR;
+    }
+    // takes effect on next start
+    loop_cache_size_ = max_bytes;
+    return DII_DONE;
+}
+
 int32_t DiiMediaCore::StopPlay() {
     if(!started_) {
         return DII_DONE;
     }
     
     dii_rtc::Thread::Post(RTC_FROM_HERE, this, DII_MSG_STOP);
+    {
+        // the recording ends with the stream
+        std::unique_lock<std::mutex> lck(mtx_);
+        recording_ = false;
+    }
     
     started_    = false;
     paused_     = false;
@@ -256,7 +315,7 @@ int32_t DiiMediaCore::StopPlay() {
 }
 
 int32_t DiiMediaCore::Seek(int64_t pos) {
-    if(!started_ || real_stream_) {
+    if(!started_ || (real_stream_ && !timeshift_)) {
         return DII_ERROR;
     }
     
@@ -269,6 +328,51 @@ int32_t DiiMediaCore::Seek(int64_t pos) {
     return DII_DONE;
 }
 
+int32_t DiiMediaCore::StartRecord(const char* path, DiiRecordFormat format) {
+    if(!path || !path[0] || format < DII_RECORD_FORMAT_FLV || format > DII_RECORD_FORMAT_MP4) {
+        return DII_PARAMETER_ERROR;
+    }
+    if(!started_) {
+        return DII_ERROR;
+    }
+    {
+        std::unique_lock<std::mutex> lck(mtx_);
+        recording_ = true;
+        record_path_ = path;
+        record_format_ = format;
+    }
+    // after the player the pending start creates
+    dii_rtc::Thread::Post(RTC_FROM_HERE, this, DII_MSG_RECORD);
+    return DII_DONE;
+}
+
+int32_t DiiMediaCore::SetSyncGroup(int32_t group_id) {
+    if(group_id < 0) {
+        return DII_PARAMETER_ERROR;
+    }
+    {
+        std::unique_lock<std::mutex> lck(mtx_);
+        sync_group_ = group_id;
+    }
+    // kept across restarts, the start applies it otherwise
+    if(started_) {
+        dii_rtc::Thread::Post(RTC_FROM_HERE, this, DII_MSG_SYNC_GROUP);
+    }
+    return DII_DONE;
+}
+
+int32_t DiiMediaCore::StopRecord() {
+    {
+        std::unique_lock<std::mutex> lck(mtx_);
+        if(!recording_) {
+            return DII_ERROR;
+        }
+        recording_ = false;
+    }
+    dii_rtc::Thread::Post(RTC_FROM_HERE, this, DII_MSG_RECORD);
+    return DII_DONE;
+}
+
 void DiiMediaCore::SetMute(const bool mute) {
     mute_ = mute;
 }
@@ -294,6 +398,12 @@ int DiiMediaCore::OnNeedPlayAudio(void* audioSamples, size_t samplesPerSec, size
     }
     
     last_play_audio_frame_ts_ = DiiUnixTimestampMs();
+
+    int32_t playout_delay_ms = playout_delay_ms_;
+    if(playout_delay_ms != applied_playout_delay_ms_) {
+        player_->SetPlayoutDelay(playout_delay_ms);
+        applied_playout_delay_ms_ = playout_delay_ms;
+    }
     
     int len =  player_->GetMoreAudioData(audioSamples, samplesPerSec, nChannels);
     if(mute_) {
@@ -304,6 +414,11 @@ int DiiMediaCore::OnNeedPlayAudio(void* audioSamples, size_t samplesPerSec, size
     return len;
 }
 
+void DiiMediaCore::OnPlayoutDelay(int32_t delay_ms) {
+    // applied on the next audio pull, the player lock may be held here.
+    playout_delay_ms_ = delay_ms;
+}
+
 void DiiMediaCore::OnPlayerState(int state, int code, const char* msg) {
     player_cur_stat_ = (DiiPlayerState)state ;
     switch (player_cur_stat_) {
@@ -342,17 +457,58 @@ void DiiMediaCore::DoStatistics() {
         statistics_.stream_id = stream_id_;
         player_->DoStatistics(statistics_);
 		statistics_.start_to_render_time_ = start_to_render_time_;
+        statistics_.audio_playout_delay_ms_ = playout_delay_ms_;
         DII_LOG(LS_INFO, stream_id_, 0)
                     << "dii player statistics"
                     << ", stream id: "              << statistics_.stream_id
                     << ", video render framerate: " << statistics_.video_render_framerate
                     << ", video decode framerate: " << statistics_.video_decode_framerate
+                    << ", video decoder: "          << (statistics_.video_decoder_ ? statistics_.video_decoder_ : "none")
+                    << ", video decode time(us): "  << statistics_.video_decode_time_us_
+                    << ", video pacing p50/p90/p99(ms): " << statistics_.video_pacing_p50_ms_
+                    << "/" << statistics_.video_pacing_p90_ms_
+                    << "/" << statistics_.video_pacing_p99_ms_
+                    << ", video catch-ups: "        << statistics_.video_catchup_events_
+                    << ", video skipped frames: "   << statistics_.video_skipped_frames_
+                    << ", video reorder depth: "    << statistics_.video_reorder_depth_
+                    << ", video decode threads: "   << statistics_.video_decode_threads_
+                    << ", video decode delay(ms): " << statistics_.video_decode_delay_ms_
+                    << ", video pool hit rate(%): " << statistics_.video_pool_hit_rate_
+                    << ", video pool(KB): "         << statistics_.video_pool_kb_
+                    << ", video pool idle(KB): "    << statistics_.video_pool_idle_kb_
+                    << ", shared io streams: "      << statistics_.shared_io_streams_
+                    << ", ingest transport: "       << (statistics_.ingest_transport_ ? statistics_.ingest_transport_ : "none")
+                    << ", rtmp connect dns/tcp/handshake/app/play(ms): " << statistics_.rtmp_dns_ms_
+                    << "/" << statistics_.rtmp_tcp_connect_ms_
+                    << "/" << statistics_.rtmp_handshake_ms_
+                    << "/" << statistics_.rtmp_connect_app_ms_
+                    << "/" << statistics_.rtmp_play_ms_
+                    << ", rtmp reconnects: "        << statistics_.rtmp_reconnects_
+                    << ", first video frame(ms): "  << statistics_.first_video_frame_ms_
+                    << ", first audio(ms): "        << statistics_.first_audio_ms_
                     << ", video width: "            << statistics_.video_width_
                     << ", video height: "           << statistics_.video_height_
                     << ", audio samplerate: "       << statistics_.audio_samplerate_
+                    << ", audio playout delay: "    << statistics_.audio_playout_delay_ms_
                     << ", play cache len: "         << statistics_.cache_len_
+                    << ", jitter target: "          << statistics_.jitter_delay_ms_
+                    << ", audio speed: "            << statistics_.audio_play_speed_
+                    << ", audio decoder: "          << (statistics_.audio_decoder_ ? statistics_.audio_decoder_ : "none")
+                    << ", audio decode(us/s): "     << statistics_.audio_decode_us_per_s_
                     << ", audio bps: "              << statistics_.audio_bps_
-                    << ", video bps: "              << statistics_.video_bps_ ;
+                    << ", video bps: "              << statistics_.video_bps_
+                    << ", video copy bytes/s: "     << statistics_.video_copy_bytes_
+                    << ", video allocs/packet: "    << statistics_.video_allocs_per_packet_
+                    << ", shared players: "         << statistics_.shared_players_
+                    << ", sync group: "             << statistics_.sync_group_
+                    << ", sync group skew(ms): "    << statistics_.sync_group_skew_ms_
+                    << ", sync group delay(ms): "   << statistics_.sync_group_delay_ms_
+                    << ", timeshift window(ms): "   << statistics_.timeshift_window_ms_
+                    << ", timeshift behind live(ms): " << statistics_.timeshift_behind_live_ms_
+                    << ", timeshift memory(KB): "   << statistics_.timeshift_memory_kb_
+                    << ", timeshift disk(KB): "     << statistics_.timeshift_disk_kb_
+                    << ", record(KB): "             << statistics_.record_kb_
+                    << ", record dropped packets: " << statistics_.record_dropped_packets_;
         
         if(callback_.statistics_callback)
             callback_.statistics_callback(statistics_);
@@ -468,17 +624,22 @@ void DiiMediaCore::OnVideoFrame(dii_media_kit::VideoFrame& frame) {
             scale_height_ = frame.height();
         }
         
-		if (src_rgba_frame_buf_.size() < frame.width()*frame.height()*4) {
-            src_rgba_frame_buf_.resize(frame.width()*frame.height()*4);
-        }
-        
-        if (dst_rgba_frame_buf_.size() < scale_width_ * scale_height_ * 4) {
+        if (dst_rgba_frame_buf_.size() < (size_t)(scale_width_ * scale_height_ * 4)) {
             dst_rgba_frame_buf_.resize(scale_width_ * scale_height_ * 4);
         }
-        
-           
-        //convert
-        dii_media_kit::ConvertFromI420(frame, dii_media_kit::kABGR, 0, src_rgba_frame_buf_.data());
+
+        //convert, straight into the output buffer unless it needs scaling
+        if (scale_width_ == frame.width() && scale_height_ == frame.height()) {
+            ConvertToRGBA(frame, dst_rgba_frame_buf_.data());
+        } else {
+            if (src_rgba_frame_buf_.size() < (size_t)(frame.width() * frame.height() * 4)) {
+                src_rgba_frame_buf_.resize(frame.width()*frame.height()*4);
+            }
+            ConvertToRGBA(frame, src_rgba_frame_buf_.data());
+            dii_libyuv::ARGBScale(src_rgba_frame_buf_.data(), frame.width() * 4, frame.width(), frame.height(),
+                                  dst_rgba_frame_buf_.data(), scale_width_ * 4, scale_width_, scale_height_,
+                                  dii_libyuv::kFilterBilinear);
+        }
 
         //回调
         dii_media_kit::DiiVideoFrame dst;
@@ -505,6 +666,32 @@ void DiiMediaCore::OnVideoFrame(dii_media_kit::VideoFrame& frame) {
     }
 }
 
+// large frames are converted by row slices on several threads
+void DiiMediaCore::ConvertToRGBA(const dii_media_kit::VideoFrame& frame, uint8_t* dst_rgba) {
+    const dii_rtc::scoped_refptr<dii_media_kit::VideoFrameBuffer>& buffer = frame.video_frame_buffer();
+    const int32_t width = frame.width();
+    const int32_t height = frame.height();
+    if (!buffer || buffer->native_handle() || width * height < kParallelConvertMinPixels) {
+        dii_media_kit::ConvertFromI420(frame, dii_media_kit::kABGR, 0, dst_rgba);
+        return;
+    }
+
+    if (!convert_worker_) {
+        int32_t threads = std::max(1, std::min((int32_t)std::thread::hardware_concurrency(), kMaxConvertThreads));
+        convert_worker_.reset(new DiiSliceWorker(threads));
+    }
+    convert_worker_->Run(convert_worker_->ThreadCount(), [&](int32_t slice, int32_t slice_count) {
+        // chroma rows are shared by two luma rows, keep slice borders even
+        int32_t y0 = (height * slice / slice_count) & ~1;
+        int32_t y1 = slice + 1 == slice_count ? height : (height * (slice + 1) / slice_count) & ~1;
+        dii_libyuv::I420ToABGR(buffer->DataY() + y0 * buffer->StrideY(), buffer->StrideY(),
+                               buffer->DataU() + y0 / 2 * buffer->StrideU(), buffer->StrideU(),
+                               buffer->DataV() + y0 / 2 * buffer->StrideV(), buffer->StrideV(),
+                               dst_rgba + y0 * width * 4, width * 4,
+                               width, y1 - y0);
+    });
+}
+
 int32_t DiiMediaCore::SetPlayerCallback(DiiPlayerCallback* callback) {
     if(!callback) {
         return -1;
@@ -531,6 +718,47 @@ int32_t DiiMediaCore::SetPlayoutDevice(const char* deviceId) {
 	return DII_DONE;
 }
 
+void DiiMediaCore::SetRtmpSharedIo(bool enable) {
+    DII_LOG(LS_INFO, 0, DII_CODE_COMMON_INFO) << " SetRtmpSharedIo " << enable;
+    DiiRtmpPuller::SetSharedIo(enable);
+}
+
+void DiiMediaCore::SetRtmpReconnectBackoff(int32_t initial_ms, int32_t max_ms) {
+    DII_LOG(LS_INFO, 0, DII_CODE_COMMON_INFO) << " SetRtmpReconnectBackoff " << initial_ms << "/" << max_ms;
+    DiiRtmpSource::SetReconnectBackoff(initial_ms, max_ms);
+}
+
+void DiiMediaCore::SetRtmpFastStart(bool enable) {
+    DII_LOG(LS_INFO, 0, DII_CODE_COMMON_INFO) << " SetRtmpFastStart " << enable;
+    DiiRtmpBuffer::SetFastStart(enable);
+}
+
+void DiiMediaCore::SetVideoDecodeThreads(int32_t threads, bool frame_threads) {
+    DII_LOG(LS_INFO, 0, DII_CODE_COMMON_INFO) << " SetVideoDecodeThreads " << threads << ", frame threads: " << frame_threads;
+    DiiRtmpDecoder::SetDecodeThreads(threads, frame_threads);
+}
+
+void DiiMediaCore::SetVideoBufferPoolBudget(int64_t max_bytes) {
+    DII_LOG(LS_INFO, 0, DII_CODE_COMMON_INFO) << " SetVideoBufferPoolBudget " << max_bytes;
+    dii_media_kit::I420BufferPool::SetDefaultMaxPooledBytes(max_bytes);
+}
+
+void DiiMediaCore::SetAudioDecoder(DiiAudioDecoderType type) {
+    DII_LOG(LS_INFO, 0, DII_CODE_COMMON_INFO) << " SetAudioDecoder " << type;
+    DiiRtmpDecoder::SetAudioDecoder(type);
+}
+
+void DiiMediaCore::SetRtmpTimeshift(int32_t window_ms, int64_t memory_bytes, const char* spill_dir) {
+    DII_LOG(LS_INFO, 0, DII_CODE_COMMON_INFO) << " SetRtmpTimeshift " << window_ms << " ms, memory: " << memory_bytes
+        << ", spill dir: " << (spill_dir ? spill_dir : "");
+    DiiRtmpSource::SetTimeshift(window_ms, memory_bytes, spill_dir ? spill_dir : "");
+}
+
+void DiiMediaCore::SetRtmpTraceDir(const char* dir) {
+    DII_LOG(LS_INFO, 0, DII_CODE_COMMON_INFO) << " SetRtmpTraceDir " << (dir ? dir : "");
+    DiiRtmpPuller::SetTraceDir(dir ? dir : "");
+}
+
 void DiiMediaCore::LogSdkInfo() {
     LOG(LS_INFO) << "*** av stream start ***";
     LOG(LS_INFO) << "*** " << DII_MEDIA_KIT_VERSION << " ***";
@@ -15,6 +15,8 @@
 #include "dii_audio_manager.h"
 #include "dii_media_utils.h"
 
+#include <atomic>
+
 namespace dii_media_kit  {
     class DiiMediaCore : public dii_media_kit::DiiAudioTracker,
                            public dii_rtc::Thread,
@@ -27,25 +29,39 @@ namespace dii_media_kit  {
         int32_t Pause();
         int32_t Resume();
         int32_t SetLoop(bool loop);
+        int32_t SetLoopCacheSize(int64_t max_bytes);
         int32_t StopPlay();
         int32_t Seek(int64_t pos);
         void SetMute(const bool mute);
         int64_t Position();
         int64_t Duration();
+        int32_t StartRecord(const char* path, DiiRecordFormat format);
+        int32_t StopRecord();
+        int32_t SetSyncGroup(int32_t group_id);
 
         int32_t SetPlayerCallback(DiiPlayerCallback* callback);
         int32_t ClearDisplayWithColor(int32_t width, int32_t height, uint8_t r = 0, uint8_t g = 0, uint8_t b = 0);
         
         int32_t OnNeedPlayAudio(void* audioSamples, size_t samplesPerSec, size_t nChannels) override;
+        void OnPlayoutDelay(int32_t delay_ms) override;
 		// only support for windows
 		static int32_t SetPlayoutVolume(uint32_t vol);
 		static int32_t SetPlayoutDevice(const char* deviceId);
+		static void SetRtmpSharedIo(bool enable);
+		static void SetRtmpReconnectBackoff(int32_t initial_ms, int32_t max_ms);
+		static void SetRtmpFastStart(bool enable);
+		static void SetVideoDecodeThreads(int32_t threads, bool frame_threads);
+		static void SetVideoBufferPoolBudget(int64_t max_bytes);
+		static void SetAudioDecoder(DiiAudioDecoderType type);
+		static void SetRtmpTimeshift(int32_t window_ms, int64_t memory_bytes, const char* spill_dir);
+		static void SetRtmpTraceDir(const char* dir);
        
         //* For MessageHandler
         virtual void OnMessage(dii_rtc::Message* msg) override;
 
     private:
         void OnVideoFrame(dii_media_kit::VideoFrame& frame);
+        void ConvertToRGBA(const dii_media_kit::VideoFrame& frame, uint8_t* dst_rgba);
 		void OnPlayerState(int state, int code, const char* msg);
         void DoStatistics();
         void OnStreamSyncTime(uint64_t ts);
@@ -58,6 +74,8 @@ namespace dii_media_kit  {
                                
     private:
         bool real_stream_ = false;
+        // the rtmp player can pause and seek inside its timeshift window
+        bool timeshift_ = false;
         int32_t stream_id_;
         std::mutex mtx_;
         
@@ -69,6 +87,14 @@ namespace dii_media_kit  {
         bool started_ = false;
         bool paused_  = false;
         bool loop_    = false;
+        int64_t loop_cache_size_ = -1;
+        // applied on the media thread, guarded by mtx_
+        bool recording_ = false;
+        std::string record_path_;
+        DiiRecordFormat record_format_ = DII_RECORD_FORMAT_FLV;
+        int32_t sync_group_ = 0;
+        std::atomic<int32_t> playout_delay_ms_{0};
+        int32_t applied_playout_delay_ms_ = -1;
         bool mute_    = false;
 		bool render_time_flg_ = false;
         
@@ -85,6 +111,10 @@ namespace dii_media_kit  {
         std::vector<uint8_t> src_rgba_frame_buf_;
         std::vector<uint8_t> dst_rgba_frame_buf_;
         std::vector<uint8_t> scale_rgba_frame_buf_;
+        // rgba conversion threads, created on the first frame from 1080p up
+        static const int32_t kParallelConvertMinPixels = 1920 * 1080;
+        static const int32_t kMaxConvertThreads = 4;
+        std::unique_ptr<DiiSliceWorker> convert_worker_;
         int32_t frame_width_     = 0;
         int32_t frame_height_    = 0;
 		int64_t start_to_render_time_ = 0;
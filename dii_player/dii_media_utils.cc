@@ -113,6 +113,65 @@ void DiiUtil::OnLogMessage(int code, const std::string& message)  {
         event_tracking_callback_(event);
 }
 
+DiiSliceWorker::DiiSliceWorker(int32_t thread_count) {
+    for (int32_t i = 1; i < thread_count; i++) {
+        threads_.push_back(new std::thread(&DiiSliceWorker::WorkerThread, this));
+    }
+}
+
+DiiSliceWorker::~DiiSliceWorker() {
+    {
+        std::unique_lock<std::mutex> lck(mtx_);
+        running_ = false;
+    }
+    work_cond_.notify_all();
+    for (auto thread : threads_) {
+        thread->join();
+        delete thread;
+    }
+    threads_.clear();
+}
+
+void DiiSliceWorker::Run(int32_t slice_count, const SliceTask& task) {
+    std::unique_lock<std::mutex> lck(mtx_);
+    task_ = &task;
+    slice_count_ = slice_count;
+    next_slice_ = 0;
+    pending_slices_ = slice_count;
+    work_cond_.notify_all();
+
+    while (RunNextSlice(lck)) {
+    }
+    done_cond_.wait(lck, [this] { return pending_slices_ == 0; });
+    task_ = nullptr;
+}
+
+void DiiSliceWorker::WorkerThread() {
+    std::unique_lock<std::mutex> lck(mtx_);
+    while (running_) {
+        if (!RunNextSlice(lck)) {
+            work_cond_.wait(lck);
+        }
+    }
+}
+
+// called with mtx_ held, runs one slice unlocked
+bool DiiSliceWorker::RunNextSlice(std::unique_lock<std::mutex>& lck) {
+    if (!task_ || next_slice_ >= slice_count_) {
+        return false;
+    }
+    int32_t slice = next_slice_++;
+    int32_t slice_count = slice_count_;
+    const SliceTask* task = task_;
+    lck.unlock();
+    (*task)(slice, slice_count);
+    lck.lock();
+    if (--pending_slices_ == 0) {
+        done_cond_.notify_all();
+    }
+    return true;
+}
+
 // unix timestamp, millisec
 int64_t DiiUnixTimestampMs() {
 	milliseconds ms = duration_cast<milliseconds>(system_clock::now().time_since_epoch());
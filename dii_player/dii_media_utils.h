@@ -14,6 +14,7 @@
 #include "webrtc/base/logging.h"
 
 #include <list>
+#include <vector>
 #include <functional>
 #include <thread>
 #include <mutex>
@@ -47,6 +48,34 @@ private:
     static int32_t stream_id_;
 };
 
+/** class DiiSliceWorker
+ *  Persistent threads that split one job, e.g. the rows of a frame, into slices.
+ **/
+class DiiSliceWorker {
+public:
+    typedef std::function<void (int32_t slice, int32_t slice_count)> SliceTask;
+
+    explicit DiiSliceWorker(int32_t thread_count);
+    ~DiiSliceWorker();
+    int32_t ThreadCount() const { return (int32_t)threads_.size() + 1; }
+    // run task on every slice, the caller thread takes part, returns when all slices are done.
+    void Run(int32_t slice_count, const SliceTask& task);
+
+private:
+    void WorkerThread();
+    bool RunNextSlice(std::unique_lock<std::mutex>& lck);
+
+    std::vector<std::thread*> threads_;
+    std::mutex mtx_;
+    std::condition_variable work_cond_;
+    std::condition_variable done_cond_;
+    const SliceTask* task_ = nullptr;
+    int32_t slice_count_ = 0;
+    int32_t next_slice_ = 0;
+    int32_t pending_slices_ = 0;
+    bool running_ = true;
+};
+
 /** func DiiUnixTimestampMs  **/
 int64_t DiiUnixTimestampMs();
 }
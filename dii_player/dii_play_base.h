@@ -41,13 +41,21 @@ namespace dii_media_kit  {
         virtual int32_t Resume() = 0;
         virtual int32_t StopPlay() = 0;
         virtual int32_t SetLoop(bool loop) = 0;
+        virtual int32_t SetLoopCacheSize(int64_t max_bytes) = 0;
         virtual int32_t Seek(int64_t pos) = 0;
 
         virtual int64_t Position() = 0;
         virtual int64_t Duration() = 0;
         virtual int32_t GetMoreAudioData(void *stream, size_t sample_rate, size_t channel) = 0;
+        // output latency of the audio device, for a/v sync
+        virtual void SetPlayoutDelay(int32_t delay_ms) = 0;
         virtual int32_t SetCallback(DiiMediaBaseCallback callback) = 0;
         virtual void DoStatistics(DiiPlayerStatistics& statistics) = 0;
+        // save the stream being played to |path| without transcoding
+        virtual int32_t StartRecord(const char* path, DiiRecordFormat format) = 0;
+        virtual int32_t StopRecord() = 0;
+        // play on one timeline with the other players of |group_id|, 0 leaves
+        virtual int32_t SetSyncGroup(int32_t group_id) = 0;
     };
 }
 #endif /* dii_media_interface_h */
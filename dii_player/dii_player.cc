@@ -75,6 +75,15 @@ namespace dii_media_kit {
         return ret;
     }
 
+    int32_t DiiPlayer::SetLoopCacheSize(int64_t max_bytes) {
+        DII_LOG(LS_INFO, this->stream_id_, 0) << "setLoopCacheSize, max_bytes:" << max_bytes;
+        int32_t ret = dii_player_->SetLoopCacheSize(max_bytes);
+        if(ret < 0) {
+            DII_LOG(LS_ERROR, this->stream_id_, 0) << "setLoopCacheSize faild, ret:" << ret;
+        }
+        return ret;
+    }
+
 	int32_t DiiPlayer::Stop() {
 		DII_LOG(LS_INFO, this->stream_id_, 0) << "stop.";
 		int32_t ret = dii_player_->StopPlay();
@@ -105,6 +114,33 @@ namespace dii_media_kit {
 		return dur;
 	}
 
+    int32_t DiiPlayer::StartRecord(const char* path, DiiRecordFormat format) {
+        DII_LOG(LS_INFO, this->stream_id_, 0) << "startRecord, path:" << (path ? path : "") << ", format:" << format;
+        int32_t ret = dii_player_->StartRecord(path, format);
+        if(ret < 0) {
+            DII_LOG(LS_ERROR, this->stream_id_, 0) << "startRecord failed, ret:" << ret;
+        }
+        return ret;
+    }
+
+    int32_t DiiPlayer::StopRecord() {
+        DII_LOG(LS_INFO, this->stream_id_, 0) << "stopRecord.";
+        int32_t ret = dii_player_->StopRecord();
+        if(ret < 0) {
+            DII_LOG(LS_ERROR, this->stream_id_, 0) << "stopRecord failed, ret:" << ret;
+        }
+        return ret;
+    }
+
+    int32_t DiiPlayer::SetSyncGroup(int32_t group_id) {
+        DII_LOG(LS_INFO, this->stream_id_, 0) << "setSyncGroup: " << group_id;
+        int32_t ret = dii_player_->SetSyncGroup(group_id);
+        if(ret < 0) {
+            DII_LOG(LS_ERROR, this->stream_id_, 0) << "setSyncGroup failed, ret:" << ret;
+        }
+        return ret;
+    }
+
     void DiiPlayer::SetMute(const bool mute) {
         DII_LOG(LS_INFO, this->stream_id_, 0) << "SetMute: " << mute;
         dii_player_->SetMute(mute);
@@ -144,4 +180,44 @@ namespace dii_media_kit {
         }
 		return DII_DONE;
 	}
+
+	void DiiPlayer::SetRtmpSharedIo(bool enable) {
+		LOG(LS_INFO) << "SetRtmpSharedIo, enable=" << enable;
+		DiiMediaCore::SetRtmpSharedIo(enable);
+	}
+
+	void DiiPlayer::SetRtmpReconnectBackoff(int32_t initial_ms, int32_t max_ms) {
+		LOG(LS_INFO) << "SetRtmpReconnectBackoff, initial_ms=" << initial_ms << ", max_ms=" << max_ms;
+		DiiMediaCore::SetRtmpReconnectBackoff(initial_ms, max_ms);
+	}
+
+	void DiiPlayer::SetRtmpFastStart(bool enable) {
+		LOG(LS_INFO) << "SetRtmpFastStart, enable=" << enable;
+		DiiMediaCore::SetRtmpFastStart(enable);
+	}
+
+	void DiiPlayer::SetVideoDecodeThreads(int32_t threads, bool frame_threads) {
+		LOG(LS_INFO) << "SetVideoDecodeThreads, threads=" << threads << ", frame_threads=" << frame_threads;
+		DiiMediaCore::SetVideoDecodeThreads(threads, frame_threads);
+	}
+
+	void DiiPlayer::SetVideoBufferPoolBudget(int64_t max_bytes) {
+		LOG(LS_INFO) << "SetVideoBufferPoolBudget, max_bytes=" << max_bytes;
+		DiiMediaCore::SetVideoBufferPoolBudget(max_bytes);
+	}
+
+	void DiiPlayer::SetAudioDecoder(DiiAudioDecoderType type) {
+		LOG(LS_INFO) << "SetAudioDecoder, type=" << type;
+		DiiMediaCore::SetAudioDecoder(type);
+	}
+
+	void DiiPlayer::SetRtmpTimeshift(int32_t window_ms, int64_t memory_bytes, const char* spill_dir) {
+		LOG(LS_INFO) << "SetRtmpTimeshift, window_ms=" << window_ms << ", memory_bytes=" << memory_bytes;
+		DiiMediaCore::SetRtmpTimeshift(window_ms, memory_bytes, spill_dir);
+	}
+
+	void DiiPlayer::SetRtmpTraceDir(const char* dir) {
+		LOG(LS_INFO) << "SetRtmpTraceDir, dir=" << (dir ? dir : "");
+		DiiMediaCore::SetRtmpTraceDir(dir);
+	}
 }
@@ -28,7 +28,8 @@ namespace dii_media_kit  {
 		/**
 		* Open an input stream 
 		*
-		* @param url URL of the stream to open.
+		* @param url URL of the stream to open. rtmp://, live http://....flv and flvfile://<path>
+		*            (a local flv file played out as a live stream) take the low latency pipeline.
 		* @param pos Time position(ms) to start.
 		*
 		* @return 0 on success < 0 on failure.
@@ -40,6 +41,17 @@ namespace dii_media_kit  {
 		int32_t Pause();
 		int32_t Resume();
         int32_t SetLoop(bool loop);
+
+		/**
+		* Limit the memory used to loop short clips without seeking, must be called before Start.
+		*
+		* @param max_bytes cache size in bytes, 0 to disable.
+		*
+		* @return 0 on success < 0 on failure.
+		*
+		*/
+		int32_t SetLoopCacheSize(int64_t max_bytes);
+
 		int32_t Stop();
 
 		/**
@@ -56,6 +68,37 @@ namespace dii_media_kit  {
 		int64_t Position();
 		int64_t Duration();
 
+		/**
+		* Save the rtmp stream being played to a file without transcoding, call after Start.
+		* The file begins at the next keyframe and ends with Stop or StopRecord. A recording
+		* that falls behind the disk drops packets up to the next keyframe instead of slowing
+		* playback, the statistics count them.
+		*
+		* @param path file to create, overwritten when it exists.
+		* @param format DII_RECORD_FORMAT_MP4 is written fragmented, a file cut short still plays.
+		*               h265 streams can only be recorded to mp4.
+		*
+		* @return 0 on success < 0 on failure, creating the file may still fail and is logged.
+		*
+		*/
+		int32_t StartRecord(const char* path, DiiRecordFormat format = DII_RECORD_FORMAT_FLV);
+		int32_t StopRecord();
+
+		/**
+		* Play rtmp streams on one timeline, e.g. the camera and screen share of a class.
+		* Players with the same group id line up on the onMetaData sync timestamps when
+		* every stream carries them, on the rtmp timestamps otherwise. The stream with the
+		* least buffered plays at its usual delay, the others buffer that much more to match.
+		* Kept across Stop and Start. Streams shared with another player only follow the
+		* group of the player that opened them first.
+		*
+		* @param group_id 0 leaves the group.
+		*
+		* @return 0 on success < 0 on failure. files don't take part.
+		*
+		*/
+		int32_t SetSyncGroup(int32_t group_id);
+
         int32_t Get10msAudioData(uint8_t* buffer, int32_t sample_rate, int32_t channel_nb);
         int32_t SetPlayerCallback(DiiPlayerCallback* callback);
         int32_t ClearDisplayView(int32_t width = 640, int32_t height = 480, uint8_t r = 0, uint8_t g = 0, uint8_t b = 0);
@@ -63,6 +106,40 @@ namespace dii_media_kit  {
         // support for windows & mac
         static int32_t SetPlayoutVolume(uint32_t vol);
 		static int32_t SetPlayoutDevice(const char* deviceId);
+        // pull every rtmp stream on one shared io thread instead of a thread per stream,
+        // for pages with many players. applies to streams started afterwards.
+        static void SetRtmpSharedIo(bool enable);
+        // rtmp reconnect pacing: an immediate first retry, then |initial_ms| doubling
+        // up to |max_ms| with jitter. defaults to 500 / 8000.
+        static void SetRtmpReconnectBackoff(int32_t initial_ms, int32_t max_ms);
+        // rtmp fast start: the first keyframe is shown as soon as it is decoded and audio
+        // starts after a 100 ms preroll, the buffer then grows to its target while playing
+        // slightly slow. applies to streams started afterwards.
+        static void SetRtmpFastStart(bool enable);
+        // ffmpeg video decoding threads, 0 (default) picks up to 4 by resolution, 1 decodes on one core.
+        // |frame_threads| also spreads consecutive frames over the threads, faster than slice threads
+        // alone but frames come out threads - 1 later, video is released that much earlier to stay
+        // in sync. applies to streams started afterwards.
+        static void SetVideoDecodeThreads(int32_t threads, bool frame_threads = true);
+        // idle decoded frame buffers kept for reuse per decoder, above this they are freed.
+        // 0 (default) keeps what the stream needs. applies to streams started afterwards.
+        static void SetVideoBufferPoolBudget(int64_t max_bytes);
+        // aac decoder of rtmp streams, AUTO (default) uses libavcodec and falls back to faad.
+        // the statistics log the decode time per second of audio to compare them.
+        // applies to streams started afterwards.
+        static void SetAudioDecoder(DiiAudioDecoderType type);
+        // rtmp timeshift: keep the last |window_ms| of the stream so Pause, Seek and Resume work
+        // on live streams. up to |memory_bytes| stay in memory, older data is spilled to a
+        // temporary file in |spill_dir|, or dropped when it is null. Seek positions are ms from
+        // the start of the window, Duration is its length and seeking to its end goes back to
+        // live. 0 (default) turns it off and players on the same url share one pull.
+        // applies to streams started afterwards.
+        static void SetRtmpTimeshift(int32_t window_ms, int64_t memory_bytes, const char* spill_dir);
+        // rtmp packet traces: every pulled packet is written with its arrival time to
+        // dii_trace_<stream id>_<unix ms>.trace in |dir|, to replay the arrival pattern into
+        // the decoder offline with dii_bench/dii_trace_replay. null (default) turns it off.
+        // applies to streams started afterwards.
+        static void SetRtmpTraceDir(const char* dir);
 	private:
 		DiiMediaCore * dii_player_ = nullptr;
         int32_t stream_id_ = 0;
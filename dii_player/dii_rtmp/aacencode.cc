@@ -28,10 +28,10 @@ typedef struct tagAacENC
 {
 	tagAacENC(void)
 		: hEncoder(NULL)
-		, pOutput(NULL)
-		, pPCM(NULL)
 		, nInputSamples(0)
+		, pOutput(NULL)
 		, nMaxOutputBytes(0)
+		, pPCM(NULL)
 		, nPcmSize(0)
 		, nPcmALen(0)
 	{
@@ -107,7 +107,7 @@ int aac_encoder_encode_frame(void*pHandle, unsigned char* inbuf, unsigned int in
 	int ret = 0;
 	if (pHandle != NULL) {
 		AacENC* pEnc = (AacENC*)pHandle;
-		if (pEnc->nPcmALen + inlen < pEnc->nPcmSize){
+		if (pEnc->nPcmALen + (int)inlen < pEnc->nPcmSize){
 			memcpy(pEnc->pPCM + pEnc->nPcmALen, inbuf, inlen);
 			pEnc->nPcmALen += inlen;
 			return 0;
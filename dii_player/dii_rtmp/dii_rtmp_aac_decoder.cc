@@ -0,0 +1,349 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#include "dii_rtmp_aac_decoder.h"
+#include "webrtc/base/logging.h"
+#include "third_party/faad/include/neaacdec.h"
+
+#ifndef DII_WITHOUT_FFMPEG
+extern "C" {
+    #include "libavcodec/avcodec.h"
+    #include "libavutil/channel_layout.h"
+}
+#endif
+
+#include <string.h>
+
+#define AAC_MAX_FRAME_BYTES         8192
+// 1024 per frame, twice that with SBR
+#define AAC_MAX_FRAME_SAMPLES       2048
+#define AAC_MAX_CHANNELS            8
+// center and surround channels in a stereo downmix, -3 dB
+#define AAC_MIX_SIDE_GAIN           0.7071f
+
+namespace {
+
+enum SpeakerSide {
+    SPEAKER_NONE = 0,       // lfe and unknown, left out of the downmix
+    SPEAKER_FRONT_LEFT,
+    SPEAKER_FRONT_RIGHT,
+    SPEAKER_CENTER,
+    SPEAKER_LEFT,           // surround, back and side
+    SPEAKER_RIGHT,
+};
+
+// left / right gains of every channel, scaled so a full scale input cannot clip
+void StereoMixGains(const SpeakerSide* sides, int channels, float* left, float* right) {
+    float sum_left = 0.f;
+    float sum_right = 0.f;
+    for (int c = 0; c < channels; c++) {
+        left[c] = 0.f;
+        right[c] = 0.f;
+        switch (sides[c]) {
+            case SPEAKER_FRONT_LEFT:  left[c] = 1.f; break;
+            case SPEAKER_FRONT_RIGHT: right[c] = 1.f; break;
+            case SPEAKER_CENTER:      left[c] = right[c] = AAC_MIX_SIDE_GAIN; break;
+            case SPEAKER_LEFT:        left[c] = AAC_MIX_SIDE_GAIN; break;
+            case SPEAKER_RIGHT:       right[c] = AAC_MIX_SIDE_GAIN; break;
+            default: break;
+        }
+        sum_left += left[c];
+        sum_right += right[c];
+    }
+    float scale = sum_left > sum_right ? sum_left : sum_right;
+    if (scale > 1.f) {
+        for (int c = 0; c < channels; c++) {
+            left[c] /= scale;
+            right[c] /= scale;
+        }
+    }
+}
+
+inline int16_t ClampS16(float v) {
+    if (v >= 32767.f) return 32767;
+    if (v <= -32768.f) return -32768;
+    return (int16_t)v;
+}
+
+class FaadAacDecoder : public DiiRtmpAacDecoder {
+public:
+    ~FaadAacDecoder() override {
+        if (decoder_) {
+            NeAACDecClose(decoder_);
+        }
+    }
+
+    int Decode(const uint8_t* data, int len, const int16_t** pcm) override {
+        NeAACDecFrameInfo info;
+        // decodes into a buffer faad keeps, no copy and no allocation per frame
+        int16_t* out = (int16_t*)NeAACDecDecode(decoder_, &info, const_cast<uint8_t*>(data), len);
+        if (info.error > 0) {
+            return -(int)info.error;
+        }
+        if (!out || info.samples == 0 || info.channels == 0) {
+            return 0;
+        }
+        int frames = (int)(info.samples / info.channels);
+        sample_rate_ = (int)info.samplerate;
+        if (info.channels <= 2) {
+            channels_ = info.channels;
+            *pcm = out;
+            return frames;
+        }
+
+        // 5.1 is mixed down by faad already, this is for the other layouts
+        if (info.channels > AAC_MAX_CHANNELS || frames > AAC_MAX_FRAME_SAMPLES) {
+            return -1;
+        }
+        SpeakerSide sides[AAC_MAX_CHANNELS];
+        for (int c = 0; c < info.channels; c++) {
+            switch (info.channel_position[c]) {
+                case FRONT_CHANNEL_LEFT:  sides[c] = SPEAKER_FRONT_LEFT; break;
+                case FRONT_CHANNEL_RIGHT: sides[c] = SPEAKER_FRONT_RIGHT; break;
+                case FRONT_CHANNEL_CENTER:
+                case BACK_CHANNEL_CENTER: sides[c] = SPEAKER_CENTER; break;
+                case SIDE_CHANNEL_LEFT:
+                case BACK_CHANNEL_LEFT:   sides[c] = SPEAKER_LEFT; break;
+                case SIDE_CHANNEL_RIGHT:
+                case BACK_CHANNEL_RIGHT:  sides[c] = SPEAKER_RIGHT; break;
+                default:                  sides[c] = SPEAKER_NONE; break;
+            }
+        }
+        float left[AAC_MAX_CHANNELS];
+        float right[AAC_MAX_CHANNELS];
+        StereoMixGains(sides, info.channels, left, right);
+        for (int i = 0; i < frames; i++) {
+            const int16_t* src = out + i * info.channels;
+            float l = 0.f;
+            float r = 0.f;
+            for (int c = 0; c < info.channels; c++) {
+                l += src[c] * left[c];
+                r += src[c] * right[c];
+            }
+            mix_[2 * i] = ClampS16(l);
+            mix_[2 * i + 1] = ClampS16(r);
+        }
+        channels_ = 2;
+        *pcm = mix_;
+        return frames;
+    }
+
+    int SampleRate() const override { return sample_rate_; }
+    int Channels() const override { return channels_; }
+    const char* ImplementationName() const override { return "faad"; }
+
+protected:
+    bool Init(const uint8_t* config, int len) override {
+        decoder_ = NeAACDecOpen();
+        if (!decoder_) {
+            return false;
+        }
+        NeAACDecConfigurationPtr conf = NeAACDecGetCurrentConfiguration(decoder_);
+        conf->outputFormat = FAAD_FMT_16BIT;
+        conf->downMatrix = 1;
+        NeAACDecSetConfiguration(decoder_, conf);
+
+        unsigned long sample_rate = 0;
+        unsigned char channels = 0;
+        if (NeAACDecInit2(decoder_, const_cast<uint8_t*>(config), len, &sample_rate, &channels) < 0) {
+            return false;
+        }
+        sample_rate_ = (int)sample_rate;
+        channels_ = channels > 2 ? 2 : (channels > 0 ? channels : 1);
+        return true;
+    }
+
+private:
+    NeAACDecHandle  decoder_ = nullptr;
+    int             sample_rate_ = 0;
+    int             channels_ = 0;
+    int16_t         mix_[AAC_MAX_FRAME_SAMPLES * 2];
+};
+
+#ifndef DII_WITHOUT_FFMPEG
+void FreeNothing(void* opaque, uint8_t* data) {}
+
+class FFmpegAacDecoder : public DiiRtmpAacDecoder {
+public:
+    ~FFmpegAacDecoder() override {
+        av_packet_free(&packet_);
+        av_frame_free(&frame_);
+        avcodec_free_context(&context_);
+        av_buffer_unref(&input_ref_);
+    }
+
+    int Decode(const uint8_t* data, int len, const int16_t** pcm) override {
+        if (len <= 0 || len > AAC_MAX_FRAME_BYTES) {
+            return -1;
+        }
+        // the bitstream reader may read past the end, the padding has to be zero
+        memcpy(input_, data, len);
+        memset(input_ + len, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+        // referencing the reused input keeps libavcodec from copying the packet
+        packet_->buf = av_buffer_ref(input_ref_);
+        packet_->data = input_;
+        packet_->size = len;
+        int ret = avcodec_send_packet(context_, packet_);
+        av_packet_unref(packet_);
+        if (ret < 0) {
+            return -1;
+        }
+
+        int frames = 0;
+        while (avcodec_receive_frame(context_, frame_) == 0) {
+            // one frame per packet for aac, appended in case there are more
+            int got = Convert(frame_, out_ + frames * channels_, AAC_MAX_FRAME_SAMPLES - frames);
+            av_frame_unref(frame_);
+            if (got < 0) {
+                return -1;
+            }
+            frames += got;
+        }
+        *pcm = out_;
+        return frames;
+    }
+
+    int SampleRate() const override { return sample_rate_; }
+    int Channels() const override { return channels_; }
+    const char* ImplementationName() const override { return "FFmpeg AAC"; }
+
+protected:
+    bool Init(const uint8_t* config, int len) override {
+        AVCodec* codec = avcodec_find_decoder(AV_CODEC_ID_AAC);
+        if (!codec || len <= 0) {
+            return false;
+        }
+        context_ = avcodec_alloc_context3(codec);
+        frame_ = av_frame_alloc();
+        packet_ = av_packet_alloc();
+        input_ref_ = av_buffer_create(input_, sizeof(input_), FreeNothing, nullptr, 0);
+        if (!context_ || !frame_ || !packet_ || !input_ref_) {
+            return false;
+        }
+        context_->extradata = (uint8_t*)av_mallocz(len + AV_INPUT_BUFFER_PADDING_SIZE);
+        if (!context_->extradata) {
+            return false;
+        }
+        memcpy(context_->extradata, config, len);
+        context_->extradata_size = len;
+        if (avcodec_open2(context_, codec, nullptr) < 0) {
+            return false;
+        }
+        sample_rate_ = context_->sample_rate;
+        channels_ = context_->channels > 2 ? 2 : (context_->channels > 0 ? context_->channels : 1);
+        return true;
+    }
+
+private:
+    // to interleaved int16 in |out|, at most stereo. returns samples per channel
+    int Convert(const AVFrame* frame, int16_t* out, int max_frames) {
+        int channels = frame->channels;
+        if (channels <= 0 || channels > AAC_MAX_CHANNELS || frame->nb_samples > max_frames) {
+            return -1;
+        }
+        AVSampleFormat format = (AVSampleFormat)frame->format;
+        if (format != AV_SAMPLE_FMT_FLTP && format != AV_SAMPLE_FMT_S16P) {
+            return -1;
+        }
+        bool planar_float = format == AV_SAMPLE_FMT_FLTP;
+
+        float left[AAC_MAX_CHANNELS];
+        float right[AAC_MAX_CHANNELS];
+        int out_channels = channels > 2 ? 2 : channels;
+        if (channels > 2) {
+            uint64_t layout = frame->channel_layout;
+            if (av_get_channel_layout_nb_channels(layout) != channels) {
+                layout = av_get_default_channel_layout(channels);
+            }
+            SpeakerSide sides[AAC_MAX_CHANNELS];
+            for (int c = 0; c < channels; c++) {
+                uint64_t ch = av_channel_layout_extract_channel(layout, c);
+                if (ch == AV_CH_FRONT_LEFT) {
+                    sides[c] = SPEAKER_FRONT_LEFT;
+                } else if (ch == AV_CH_FRONT_RIGHT) {
+                    sides[c] = SPEAKER_FRONT_RIGHT;
+                } else if (ch & (AV_CH_FRONT_CENTER | AV_CH_BACK_CENTER)) {
+                    sides[c] = SPEAKER_CENTER;
+                } else if (ch & (AV_CH_BACK_LEFT | AV_CH_SIDE_LEFT | AV_CH_FRONT_LEFT_OF_CENTER)) {
+                    sides[c] = SPEAKER_LEFT;
+                } else if (ch & (AV_CH_BACK_RIGHT | AV_CH_SIDE_RIGHT | AV_CH_FRONT_RIGHT_OF_CENTER)) {
+                    sides[c] = SPEAKER_RIGHT;
+                } else {
+                    sides[c] = SPEAKER_NONE;
+                }
+            }
+            StereoMixGains(sides, channels, left, right);
+        } else {
+            for (int c = 0; c < channels; c++) {
+                left[c] = c == 0 ? 1.f : 0.f;
+                right[c] = c == 1 ? 1.f : 0.f;
+            }
+        }
+
+        for (int i = 0; i < frame->nb_samples; i++) {
+            float l = 0.f;
+            float r = 0.f;
+            for (int c = 0; c < channels; c++) {
+                float v = planar_float ? ((const float*)frame->extended_data[c])[i] * 32768.f
+                                       : ((const int16_t*)frame->extended_data[c])[i];
+                l += v * left[c];
+                r += v * right[c];
+            }
+            out[i * out_channels] = ClampS16(l);
+            if (out_channels == 2) {
+                out[i * out_channels + 1] = ClampS16(r);
+            }
+        }
+        sample_rate_ = frame->sample_rate;
+        channels_ = out_channels;
+        return frame->nb_samples;
+    }
+
+    AVCodecContext* context_ = nullptr;
+    AVFrame*        frame_ = nullptr;
+    AVPacket*       packet_ = nullptr;
+    AVBufferRef*    input_ref_ = nullptr;
+    int             sample_rate_ = 0;
+    int             channels_ = 0;
+    uint8_t         input_[AAC_MAX_FRAME_BYTES + AV_INPUT_BUFFER_PADDING_SIZE];
+    int16_t         out_[AAC_MAX_FRAME_SAMPLES * 2];
+};
+#endif  // DII_WITHOUT_FFMPEG
+
+}  // namespace
+
+DiiRtmpAacDecoder* DiiRtmpAacDecoder::Create(dii_media_kit::DiiAudioDecoderType type,
+                                             const uint8_t* config, int len) {
+#ifndef DII_WITHOUT_FFMPEG
+    if (type != dii_media_kit::DII_AUDIO_DECODER_FAAD) {
+        DiiRtmpAacDecoder* decoder = new FFmpegAacDecoder();
+        if (decoder->Init(config, len)) {
+            return decoder;
+        }
+        delete decoder;
+        LOG(LS_WARNING) << "libavcodec aac decoder unavailable, falling back to faad.";
+    }
+#endif
+
+    DiiRtmpAacDecoder* decoder = new FaadAacDecoder();
+    if (decoder->Init(config, len)) {
+        return decoder;
+    }
+    delete decoder;
+    return nullptr;
+}
@@ -0,0 +1,49 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#ifndef __DII_RTMP_AAC_DECODER_H__
+#define __DII_RTMP_AAC_DECODER_H__
+
+#include "dii_common.h"
+
+#include <stdint.h>
+
+// Decodes raw AAC frames as carried in RTMP, set up from the AudioSpecificConfig
+// of the sequence header, so no ADTS header has to be built and parsed again.
+// Output is interleaved int16, at most stereo; multichannel streams are mixed down.
+class DiiRtmpAacDecoder {
+public:
+    // faad or libavcodec, AUTO prefers libavcodec and falls back to faad
+    static DiiRtmpAacDecoder* Create(dii_media_kit::DiiAudioDecoderType type,
+                                     const uint8_t* config, int len);
+    virtual ~DiiRtmpAacDecoder() {}
+
+    // one raw aac frame. |pcm| points into the decoder and stays valid until the
+    // next call. returns samples per channel, 0 when nothing came out, < 0 on error
+    virtual int Decode(const uint8_t* data, int len, const int16_t** pcm) = 0;
+    // format of the last decoded frame, implicit SBR / PS may change it from the config
+    virtual int SampleRate() const = 0;
+    virtual int Channels() const = 0;
+    virtual const char* ImplementationName() const = 0;
+
+protected:
+    DiiRtmpAacDecoder() {}
+    virtual bool Init(const uint8_t* config, int len) = 0;
+};
+
+#endif	// __DII_RTMP_AAC_DECODER_H__
@@ -20,8 +20,10 @@
 #include "dii_rtmp_buffer.h"
 #include "webrtc/base/logging.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstdlib>
+#include <limits>
 
 #define FFMAX(a,b) ((a) > (b) ? (a) : (b))
 #define FFMAX3(a,b,c) FFMAX(FFMAX(a,b),c)
@@ -37,17 +39,31 @@
 #define AUDIO_PACKET_TIME_LEN           10         // 10 ms   
 #define VIDEO_PACKET_TIME_LEN           66         // 40 ms
 #define BUFFERING_INTERVAL_LEN          1000
+#define SCHEDULER_MAX_WAIT_MS           200        // re-check even without a wakeup
+#define TIMESTAMP_JUMP_LEN              4000
+#define PACING_MAX_SAMPLES              1024
+#define PCM_RING_TIME_LEN               20000      // more than the max jitter target + speed-up margin
+#define PCM_MAX_MARKERS                 1024       // one per aac frame, ~20 s at 48 kHz
+#define FAST_START_PREROLL_LEN          100        // audio buffered before the first playout in fast start
+#define FAST_START_PLAY_RATE            0.95f      // slow-down while the buffer grows after a fast start
+
+std::atomic<bool> DiiRtmpBuffer::fast_start_default_(false);
 
 DiiRtmpBuffer::DiiRtmpBuffer(int32_t stream_id, PlyBufferCallback&callback)
-	: callback_(callback)
+	: wakeup_event_(false, false)
+	, callback_(callback)
 	, got_audio_(false)
     , cache_time_len_(0)
 	, first_pkt_real_ts_(0)
 	, first_rtmp_pkt_ts_(0)
 	, rtmp_cache_time_(0)
 	, sync_clock_(0)
-    , pcm_packets_count_(0) {
+    , sync_clock_update_ms_(0)
+    , next_video_pts_(std::numeric_limits<int64_t>::max()) {
         this->stream_id_ = stream_id;
+        pacing_samples_.reserve(PACING_MAX_SAMPLES);
+        pcm_markers_.resize(PCM_MAX_MARKERS);
+        fast_start_ = fast_start_default_;
         processing_ = true;
         dii_rtc::Thread::Start();
 }
@@ -55,37 +71,93 @@ DiiRtmpBuffer::DiiRtmpBuffer(int32_t stream_id, PlyBufferCallback&callback)
 DiiRtmpBuffer::~DiiRtmpBuffer()
 {
     processing_ = false;
+    wakeup_event_.Set();
     dii_rtc::Thread::Stop();
     this->ClearCache();
+    if (pcm_ring_) {
+        WebRtc_FreeBuffer(pcm_ring_);
+        pcm_ring_ = nullptr;
+    }
 }
 
 int DiiRtmpBuffer::GetMorePcmData(void *audioSamples, size_t samplesPerSec, size_t nChannels, uint64_t &sync_ts) {
-    int ret = 0;
-    PlyPacket* pkt_front = nullptr;
-    {
-        dii_rtc::CritScope cs(&a_mtx_);
-        if (!audio_pcm_queue_.empty()) {
-            pkt_front = audio_pcm_queue_.front();
-            audio_pcm_queue_.pop();
-        }
+    dii_rtc::CritScope cs(&a_mtx_);
+    // the decoder converts to the format asked for here, until then play silence
+    if (!pcm_ring_ || (size_t)pcm_sample_rate_ != samplesPerSec || (size_t)pcm_channels_ != nChannels) {
+        return 0;
     }
-    
-    if(pkt_front) {
-        ret = pkt_front->_data_len;
-        sync_clock_ = pkt_front->_pts;
-        sync_ts = pkt_front->_sync_ts;
-        int16_t res_out[3840];
-        int samples_out = audio_resampler_.Resample10Msec((int16_t*)pkt_front->_data,
-                                                                   src_sample_rate_*src_channel_count_,
-                                                                   samplesPerSec*nChannels,
-                                                                   1,
-                                                                   3840,
-                                                                   (int16_t*)res_out);
-        
-        memcpy(audioSamples, res_out, samples_out*2);
-        delete pkt_front;
-    }
-	return ret;
+    size_t frames = samplesPerSec / 100;
+    if (WebRtc_available_read(pcm_ring_) < frames) {
+        return 0;
+    }
+
+    // timestamp of the first frame handed out, interpolated inside its aac frame
+    while (pcm_marker_count_ > 1 &&
+           pcm_markers_[(pcm_marker_head_ + 1) % PCM_MAX_MARKERS].pos <= pcm_read_pos_) {
+        pcm_marker_head_ = (pcm_marker_head_ + 1) % PCM_MAX_MARKERS;
+        pcm_marker_count_--;
+    }
+    if (pcm_marker_count_ > 0) {
+        const PcmMarker& marker = pcm_markers_[pcm_marker_head_];
+        int64_t offset_ms = (pcm_read_pos_ - marker.pos) * 1000 / pcm_sample_rate_;
+        sync_clock_ = marker.pts + offset_ms;
+        sync_ts = marker.sync_ts > 0 ? marker.sync_ts + offset_ms : 0;
+        played_sync_ts_ = sync_ts;
+    }
+    sync_clock_update_ms_ = dii_rtc::TimeMillis();
+
+    void* data_ptr = nullptr;
+    WebRtc_ReadBuffer(pcm_ring_, &data_ptr, audioSamples, frames);
+    if (data_ptr != audioSamples) {
+        memcpy(audioSamples, data_ptr, frames * nChannels * sizeof(int16_t));
+    }
+    pcm_read_pos_ += frames;
+    UpdateAudioCacheTime();
+
+    // the clock just passed the head video frame, let the scheduler release it
+    if (next_video_pts_ <= sync_clock_ - VideoClockOffset()) {
+        wakeup_event_.Set();
+    }
+	return (int)(frames * nChannels * sizeof(int16_t));
+}
+
+void DiiRtmpBuffer::UpdateAudioCacheTime() {
+    cache_time_len_ = (int32_t)(WebRtc_available_read(pcm_ring_) * 1000 / pcm_sample_rate_);
+}
+
+bool DiiRtmpBuffer::GetPlayoutPoint(uint64_t& sync_ts, int64_t& pts, int32_t& cache_ms, int64_t& update_ms) const {
+    dii_rtc::CritScope cs(&a_mtx_);
+    update_ms = sync_clock_update_ms_;
+    if (buffer_state_ != BufferReady || update_ms == 0) {
+        return false;
+    }
+    sync_ts = played_sync_ts_;
+    pts = sync_clock_;
+    cache_ms = cache_time_len_;
+    return true;
+}
+
+float DiiRtmpBuffer::PlaybackRate() const {
+    float rate = delay_manager_.PlaybackRate(cache_time_len_, group_delay_ms_);
+    if (growing_) {
+        // the deadband and gentle slope are tuned for small corrections, grow a bit faster
+        rate = FFMIN(rate, FAST_START_PLAY_RATE);
+    }
+    return rate;
+}
+
+int64_t DiiRtmpBuffer::VideoLateMs(uint32_t pts) {
+    if (buffer_state_ != BufferReady || sync_clock_update_ms_ == 0) {
+        return 0;
+    }
+    return VideoClock(dii_rtc::TimeMillis()) - (int64_t)pts;
+}
+
+int64_t DiiRtmpBuffer::VideoClock(int64_t now) const {
+    // the audio clock only moves when pcm is consumed, extrapolate since the last update
+    int64_t update_ms = sync_clock_update_ms_;
+    int64_t elapsed = update_ms > 0 ? FFMIN(FFMAX(now - update_ms, 0), SCHEDULER_MAX_WAIT_MS) : 0;
+    return sync_clock_ + elapsed - VideoClockOffset();
 }
 
 void DiiRtmpBuffer::CacheH264Frame(PlyPacket* pkt, int type) {
@@ -103,52 +175,100 @@ void DiiRtmpBuffer::CacheH264Frame(PlyPacket* pkt, int type) {
     }
        
     h264_frame_queue_.push(pkt);
+    if (size == 0 || (fast_start_ && !poster_released_)) {
+        next_video_pts_ = pkt->_pts;
+        wakeup_event_.Set();
+    }
     if(!got_audio_) {
         cache_time_len_ = size * VIDEO_PACKET_TIME_LEN;
     }
     DII_LOG(LS_VERBOSE, stream_id_, DII_CODE_COMMON_INFO) << "Add h264 data to cache, buffer size: " << size;;
 }
 
-void DiiRtmpBuffer::CachePcmData(const uint8_t* pdata, int len, int sample_rate, int channel_cnt, uint32_t ts, uint64_t sync_ts) {
+void DiiRtmpBuffer::SetPcmFormat(int sample_rate, int channel_cnt) {
+    dii_rtc::CritScope cs(&a_mtx_);
+    if (pcm_ring_ && sample_rate == pcm_sample_rate_ && channel_cnt == pcm_channels_) {
+        return;
+    }
+    DII_LOG(LS_INFO, stream_id_, DII_CODE_COMMON_INFO) << "DiiRtmpBuffer: pcm format " << sample_rate
+                    << " Hz, " << channel_cnt << " channels.";
+
+    if (pcm_ring_) {
+        WebRtc_FreeBuffer(pcm_ring_);
+    }
+    pcm_ring_ = WebRtc_CreateBuffer(sample_rate / 1000 * PCM_RING_TIME_LEN, sizeof(int16_t) * channel_cnt);
+    pcm_sample_rate_ = sample_rate;
+    pcm_channels_ = channel_cnt;
+    pcm_marker_head_ = 0;
+    pcm_marker_count_ = 0;
+    pcm_write_pos_ = 0;
+    pcm_read_pos_ = 0;
+    cache_time_len_ = 0;
+}
+
+void DiiRtmpBuffer::CachePcmData(const int16_t* pcm, size_t frames, uint32_t ts, uint64_t sync_ts) {
     if (first_pkt_real_ts_ == 0) {
         first_pkt_real_ts_ = dii_rtc::Time();
         first_rtmp_pkt_ts_     = ts;
     }
     
-    src_sample_rate_ =  sample_rate;
-    src_channel_count_ = channel_cnt;
-    
     got_audio_ = true;
     
-    // push packet
-	PlyPacket* pkt = new PlyPacket(false);
-	pkt->SetData(pdata, len, ts, sync_ts);
-   
 	dii_rtc::CritScope cs(&a_mtx_);
-	audio_pcm_queue_.push(pkt);
-    int32_t size = (int32_t)audio_pcm_queue_.size();
-    cache_time_len_ = size * AUDIO_PACKET_TIME_LEN;
+    if (!pcm_ring_) {
+        return;
+    }
+
+    // nobody is playing out, keep the newest audio
+    size_t writable = WebRtc_available_write(pcm_ring_);
+    if (writable < frames) {
+        WebRtc_MoveReadPtr(pcm_ring_, (int)(frames - writable));
+        pcm_read_pos_ += frames - writable;
+    }
+
+    size_t last = (pcm_marker_head_ + pcm_marker_count_ + PCM_MAX_MARKERS - 1) % PCM_MAX_MARKERS;
+    if (pcm_marker_count_ == 0 || pcm_markers_[last].pts != ts) {
+        if (pcm_marker_count_ == PCM_MAX_MARKERS) {
+            pcm_marker_head_ = (pcm_marker_head_ + 1) % PCM_MAX_MARKERS;
+            pcm_marker_count_--;
+        }
+        PcmMarker& marker = pcm_markers_[(pcm_marker_head_ + pcm_marker_count_) % PCM_MAX_MARKERS];
+        marker.pos = pcm_write_pos_;
+        marker.pts = ts;
+        marker.sync_ts = sync_ts;
+        pcm_marker_count_++;
+    }
+    WebRtc_WriteBuffer(pcm_ring_, pcm, frames);
+    pcm_write_pos_ += frames;
+
+    UpdateAudioCacheTime();
     if (cache_time_len_ <= BUFFERING_TIME_LEN && buffer_state_ != Buffering) {
         buffer_state_ = Buffering;
-        caton_cnt_++;
-        if(caton_cnt_ >= 2) {
-            if(buffer_ready_len_ < 5000) {
-                buffer_ready_len_ += 1000;
-            }
-            caton_cnt_ = 0;
-        }
+        growing_ = false;
+        DII_LOG(LS_INFO, stream_id_, DII_CODE_COMMON_INFO) << "DiiRtmpBuffer: buffering, jitter target: "
+                        << delay_manager_.TargetDelayMs() << " ms.";
     }
     
-    if (cache_time_len_ >= buffer_ready_len_ && buffer_state_ != BufferReady) {
+    // a rebuffer waits for the full target, only the very first start is shortened
+    int32_t ready_len = (fast_start_ && !started_) ? FAST_START_PREROLL_LEN : delay_manager_.TargetDelayMs();
+    if (cache_time_len_ >= ready_len && buffer_state_ != BufferReady) {
+        growing_ = fast_start_ && !started_;
+        started_ = true;
         buffer_state_ = BufferReady;
+        wakeup_event_.Set();
+    }
+    if (growing_ && cache_time_len_ >= delay_manager_.TargetDelayMs()) {
+        growing_ = false;
+        DII_LOG(LS_INFO, stream_id_, DII_CODE_COMMON_INFO) << "DiiRtmpBuffer: fast start grew to the jitter target: "
+                        << delay_manager_.TargetDelayMs() << " ms.";
     }
     
     if(!got_video_ && cache_time_len_ > 15*1000) {
         DII_LOG(LS_WARNING, stream_id_, DII_CODE_COMMON_WARN) << "audio pc queue too large, len: " << cache_time_len_;
     }
-    DII_LOG(LS_VERBOSE, stream_id_, DII_CODE_COMMON_INFO) << "Add pcm data to cache, length: " << len
+    DII_LOG(LS_VERBOSE, stream_id_, DII_CODE_COMMON_INFO) << "Add pcm data to cache, frames: " << frames
                     << "ts: " << ts
-                    << "audio queue size: " << size;;
+                    << "audio cache len: " << cache_time_len_;
 
 }
 
@@ -157,11 +277,13 @@ void DiiRtmpBuffer::ClearCache() {
     // clear audio queue
     {
         dii_rtc::CritScope cs(&a_mtx_);
-        while (!audio_pcm_queue_.empty()) {
-           auto it = audio_pcm_queue_.front();
-           delete it;
-           audio_pcm_queue_.pop();
+        if (pcm_ring_) {
+            WebRtc_InitBuffer(pcm_ring_);
         }
+        pcm_marker_head_ = 0;
+        pcm_marker_count_ = 0;
+        pcm_write_pos_ = 0;
+        pcm_read_pos_ = 0;
     }
     
     // clear video queue
@@ -172,38 +294,118 @@ void DiiRtmpBuffer::ClearCache() {
             h264_frame_queue_.pop();
             delete it;
         }
+        next_video_pts_ = std::numeric_limits<int64_t>::max();
+    }
+}
+
+void DiiRtmpBuffer::GetPacingStatistics(int32_t& p50_ms, int32_t& p90_ms, int32_t& p99_ms) {
+    std::vector<int32_t> samples;
+    {
+        dii_rtc::CritScope cs(&v_mtx_);
+        samples.swap(pacing_samples_);
+        pacing_samples_.reserve(PACING_MAX_SAMPLES);
+    }
+
+    p50_ms = p90_ms = p99_ms = 0;
+    if (samples.empty()) {
+        return;
     }
+    auto percentile = [&samples](int pct) {
+        size_t idx = (samples.size() - 1) * pct / 100;
+        std::nth_element(samples.begin(), samples.begin() + idx, samples.end());
+        return samples[idx];
+    };
+    p50_ms = percentile(50);
+    p90_ms = percentile(90);
+    p99_ms = percentile(99);
 }
 
 void DiiRtmpBuffer::Run() {
     while(processing_) {
-        dii_rtc::Thread::SleepMs(5);
-        DoSyncAudioVideo();
+        int32_t wait_ms = DoSyncAudioVideo();
+        if (wait_ms > 0) {
+            wakeup_event_.Wait(wait_ms);
+        }
     }
 }
 
 // audio and video sync
-void DiiRtmpBuffer::DoSyncAudioVideo()
+int32_t DiiRtmpBuffer::DoSyncAudioVideo()
 {
     if (first_pkt_real_ts_ == 0 || buffer_state_ != BufferReady) {
-		return;
+        if (fast_start_ && !poster_released_) {
+            ReleasePosterFrame();
+        }
+		return SCHEDULER_MAX_WAIT_MS;
     }
     
-    PlyPacket* pkt = NULL;
-    {
-        dii_rtc::CritScope cs(&v_mtx_);
-        if (!h264_frame_queue_.empty()) {
-            pkt = h264_frame_queue_.front();
-            
-            int64_t dt = pkt->_pts - sync_clock_;
-            if(dt <= 0) {
-                callback_.OnNeedDecodeFrame(pkt);
-                h264_frame_queue_.pop();
-            } else if(std::abs(dt) >= 4000) { //防止异常跳变的时间戳, 但对于连续跳变的时间戳，此逻辑无效
-                Thread::SleepMs(66);
-                callback_.OnNeedDecodeFrame(pkt);
-                h264_frame_queue_.pop();
-            }
+    dii_rtc::CritScope cs(&v_mtx_);
+    while (!h264_frame_queue_.empty()) {
+        PlyPacket* pkt = h264_frame_queue_.front();
+        int64_t now = dii_rtc::TimeMillis();
+        int64_t late_ms = 0;
+        int64_t wait_ms = VideoWaitMs(pkt, now, late_ms);
+        if (wait_ms > 0) {
+            return (int32_t)wait_ms;
+        }
+        if (late_ms >= 0 && pacing_samples_.size() < PACING_MAX_SAMPLES) {
+            pacing_samples_.push_back((int32_t)late_ms);
         }
+
+        h264_frame_queue_.pop();
+        next_video_pts_ = h264_frame_queue_.empty() ? std::numeric_limits<int64_t>::max()
+                                                    : (int64_t)h264_frame_queue_.front()->_pts;
+        last_release_ms_ = now;
+        callback_.OnNeedDecodeFrame(pkt);
+    }
+    return SCHEDULER_MAX_WAIT_MS;
+}
+
+int64_t DiiRtmpBuffer::VideoWaitMs(const PlyPacket* pkt, int64_t now, int64_t& late_ms) {
+    late_ms = -1;
+    int64_t dt = pkt->_pts - VideoClock(now);
+    if (dt <= 0) {
+        late_ms = -dt;
+        return 0;
+    }
+    if (dt >= TIMESTAMP_JUMP_LEN) {
+        // guard against a single timestamp jump, a continuous one still stalls here
+        return FFMAX(last_release_ms_ + VIDEO_PACKET_TIME_LEN - now, 0);
+    }
+    // next wakeup normally comes from GetMorePcmData, this is only the fallback
+    return FFMIN(dt, SCHEDULER_MAX_WAIT_MS);
+}
+
+bool DiiRtmpBuffer::VideoDue() {
+    dii_rtc::CritScope cs(&v_mtx_);
+    if (h264_frame_queue_.empty()) {
+        return false;
+    }
+    bool due = false;
+    if (first_pkt_real_ts_ == 0 || buffer_state_ != BufferReady) {
+        due = fast_start_ && !poster_released_;
+    } else {
+        int64_t late_ms = 0;
+        due = VideoWaitMs(h264_frame_queue_.front(), dii_rtc::TimeMillis(), late_ms) == 0;
+    }
+    if (due) {
+        wakeup_event_.Set();
+    }
+    return due;
+}
+
+void DiiRtmpBuffer::ReleasePosterFrame() {
+    dii_rtc::CritScope cs(&v_mtx_);
+    if (h264_frame_queue_.empty()) {
+        return;
     }
+    // the decoder drops everything before the first keyframe, so this is one
+    PlyPacket* pkt = h264_frame_queue_.front();
+    h264_frame_queue_.pop();
+    next_video_pts_ = h264_frame_queue_.empty() ? std::numeric_limits<int64_t>::max()
+                                                : (int64_t)h264_frame_queue_.front()->_pts;
+    poster_released_ = true;
+    last_release_ms_ = dii_rtc::TimeMillis();
+    DII_LOG(LS_INFO, stream_id_, DII_CODE_COMMON_INFO) << "DiiRtmpBuffer: fast start, show the first keyframe, pts: " << pkt->_pts;
+    callback_.OnNeedDecodeFrame(pkt);
 }
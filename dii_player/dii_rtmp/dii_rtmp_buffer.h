@@ -21,24 +21,38 @@
 
 #include "webrtc/video_frame.h"
 #include "webrtc/base/timeutils.h"
-#include "webrtc/modules/audio_coding/acm2/acm_resampler.h"
+#include "webrtc/common_audio/ring_buffer.h"
 #include "webrtc/base/criticalsection.h"
+#include "webrtc/base/event.h"
 #include "webrtc/base/scoped_ptr.h"
 #include "webrtc/base/thread.h"
+#include "dii_rtmp_packet_pool.h"
+#include "dii_rtmp_delay_manager.h"
+#include "dii_rtmp_video_info.h"
 
+#include <atomic>
 #include <list>
 #include <queue>
+#include <vector>
 #include <stdint.h>
 
 
 typedef struct PlyPacket {
 	PlyPacket(bool isvideo) : _data(NULL), _data_len(0),
-							  _b_video(isvideo), _pts(0), _sync_ts(0) {}
+							  _b_video(isvideo),
+							  _pts(0), _cts(0), _sync_ts(0) {}
 
 	virtual ~PlyPacket(void){
-		if (_data)
+		if (_data && !_buffer)
 			delete[] _data;
 	}
+	// reference a pooled payload instead of copying it
+	void SetBuffer(const dii_rtc::scoped_refptr<PlyBuffer>& buffer, uint32_t ts) {
+		_pts = ts;
+		_buffer = buffer;
+		_data = buffer->data();
+		_data_len = buffer->size();
+	}
 	void SetData(const uint8_t*pdata, int len, uint32_t ts) {
 		_pts = ts;
 		if (len > 0 && pdata != NULL) {
@@ -71,8 +85,14 @@ typedef struct PlyPacket {
 	uint8_t*_data;
 	int _data_len;
 	bool _b_video;
+	// video, parsed by the puller
+	PlyVideoInfo _video;
+	// decode time, frames are released by it
 	uint32_t _pts;
+	// composition time offset of video, presentation time is _pts + _cts
+	int32_t _cts;
     uint64_t _sync_ts;
+	dii_rtc::scoped_refptr<PlyBuffer> _buffer;
 } PlyPacket;
 
 enum BufferState {
@@ -91,23 +111,64 @@ class DiiRtmpBuffer : public dii_rtc::Thread {
 public:
 	DiiRtmpBuffer(int32_t stream_id, PlyBufferCallback&callback);
 	virtual ~DiiRtmpBuffer();
+	// 10 ms of pcm, 0 until enough is buffered in exactly the requested format
 	int GetMorePcmData(void *audioSamples, size_t samplesPerSec, size_t nChannels, uint64_t &sync_ts);
     BufferState PlayerStatus(){return buffer_state_;};
 	int32_t GetPlayCacheTime(){return cache_time_len_;};
-    int32_t PlayReadyBufferLen() const { return buffer_ready_len_;};
+    // adaptive: follows the arrival jitter, see DiiRtmpDelayManager
+    int32_t PlayReadyBufferLen() const { return delay_manager_.TargetDelayMs();};
+    // time-stretch rate that moves the cache toward PlayReadyBufferLen
+    float PlaybackRate() const;
+    // fast start: show the first keyframe at once and start audio on a short preroll,
+    // the buffer then grows to its target during playback. applies to buffers created afterwards.
+    static void SetFastStart(bool enable) { fast_start_default_ = enable; }
+    void OnAudioPacketArrived(uint32_t ts) { delay_manager_.Update(ts, dii_rtc::TimeMillis());};
+    void SetPlayoutDelay(int32_t delay_ms) { playout_delay_ms_ = delay_ms; };
+    // frames spend this long in the decoder, they are released that much earlier
+    void SetVideoDecodeDelay(int32_t delay_ms) { decode_delay_ms_ = delay_ms; };
+    // buffered on top of the jitter target so a sync group plays on one timeline
+    void SetGroupDelay(int32_t delay_ms) { group_delay_ms_ = delay_ms; };
+    // where playout was at the last pcm pull: |sync_ts| (0 without metadata sync
+    // timestamps) and |pts| of the audio handed out, |cache_ms| still buffered
+    // behind it and the time of the pull. false before playout starts.
+    bool GetPlayoutPoint(uint64_t& sync_ts, int64_t& pts, int32_t& cache_ms, int64_t& update_ms) const;
 	void CacheH264Frame(PlyPacket* pkt, int type); //dii_media_kit::VideoFrame* frame
-	void CachePcmData(const uint8_t* pdata, int len, int sample_rate, int channel_cnt, uint32_t ts, uint64_t sync_ts);
+	// format of the pcm passed to CachePcmData, a change drops what is buffered
+	void SetPcmFormat(int sample_rate, int channel_cnt);
+	void CachePcmData(const int16_t* pcm, size_t frames, uint32_t ts, uint64_t sync_ts);
     void ClearCache();
+    // how far |pts| is behind the audio clock now, 0 while there is no running clock
+    int64_t VideoLateMs(uint32_t pts);
+    // pts of the audio last handed to the device, 0 before playout starts
+    int64_t AudioClock() const { return sync_clock_; }
+    // lateness of video releases against the audio clock since the last call
+    void GetPacingStatistics(int32_t& p50_ms, int32_t& p90_ms, int32_t& p99_ms);
+    // true while a frame is due for the decoder and not released yet, the scheduler
+    // is woken up for it. DiiRtmpTraceReplay holds its clock until this is false.
+    bool VideoDue();
     
 private:
     //* For Thread
     virtual void Run() override;
     
-	void DoSyncAudioVideo();
-    void InitSoundTouch(uint16_t sample_rate, uint8_t channel_count);
+    // releases due frames, returns ms until the scheduler should look again
+	int32_t DoSyncAudioVideo();
+    // 0 when |pkt| is due at |now|, with how late it is in |late_ms| (-1 past a
+    // timestamp jump), otherwise ms until it should be looked at again. v_mtx_ held
+    int64_t VideoWaitMs(const PlyPacket* pkt, int64_t now, int64_t& late_ms);
+    // fast start, hands the first keyframe to the decoder while still buffering
+    void ReleasePosterFrame();
+    void UpdateAudioCacheTime();
+    // a frame is due when the audio clock minus this reaches its pts
+    int64_t VideoClockOffset() const { return playout_delay_ms_ - decode_delay_ms_; }
+    // the clock video is released against: the audio clock extrapolated to |now|,
+    // but not across an audio stall, minus VideoClockOffset
+    int64_t VideoClock(int64_t now) const;
 private:
     int32_t stream_id_ = 0;
     bool                    processing_ = false;
+    // signaled on new arrivals and when the audio clock reaches the next frame
+    dii_rtc::Event          wakeup_event_;
     
     dii_rtc::CriticalSection a_mtx_;
     dii_rtc::CriticalSection v_mtx_;
@@ -116,29 +177,53 @@ private:
     bool					got_audio_ = false;
     bool                    got_video_ = false;
 	uint64_t			    cache_delta_ = 0;
-	int32_t                	cache_time_len_ = 0;
-	BufferState				buffer_state_ = Buffering;
-	int64_t				    first_pkt_real_ts_ = 0;
+	// written by the audio and the video ingest, read by the audio device
+	std::atomic<int32_t>    cache_time_len_;
+	// written by the audio ingest, read by the scheduler and the audio device
+	std::atomic<BufferState> buffer_state_{Buffering};
+	std::atomic<int64_t>    first_pkt_real_ts_;
 	int64_t				    first_rtmp_pkt_ts_ = 0;
 	int64_t				    rtmp_cache_time_ = 0;
-	int64_t                 sync_clock_ = 0;
+	std::atomic<int64_t>    sync_clock_;
+    std::atomic<int64_t>    sync_clock_update_ms_;
+    // pts of the frame at the head of h264_frame_queue_, INT64_MAX if empty
+    std::atomic<int64_t>    next_video_pts_;
+    int64_t                 last_release_ms_ = 0;
+    std::vector<int32_t>    pacing_samples_;
+    // audio handed to the device is heard this much later, set from the
+    // audio device thread and read by the scheduler
+    std::atomic<int32_t>    playout_delay_ms_{0};
+    std::atomic<int32_t>    decode_delay_ms_{0};
+    std::atomic<int32_t>    group_delay_ms_{0};
+    std::atomic<uint64_t>   played_sync_ts_{0};
+
+    static std::atomic<bool> fast_start_default_;
+    bool                    fast_start_ = false;
+    bool                    poster_released_ = false;
+    // the first BufferReady has been reached
+    bool                    started_ = false;
+    // fast start preroll is still below the target, playback runs slightly slow
+    std::atomic<bool>       growing_{false};
 
-	std::queue<PlyPacket*>	audio_pcm_queue_;
+	// interleaved pcm already in the playout format, one element per frame
+	RingBuffer*             pcm_ring_ = nullptr;
+	int32_t                 pcm_sample_rate_ = 0;
+	int32_t                 pcm_channels_ = 0;
+	// media timestamps of the ring content, by absolute frame position
+	struct PcmMarker {
+		int64_t  pos;
+		uint32_t pts;
+		uint64_t sync_ts;
+	};
+	std::vector<PcmMarker>  pcm_markers_;
+	size_t                  pcm_marker_head_ = 0;
+	size_t                  pcm_marker_count_ = 0;
+	int64_t                 pcm_write_pos_ = 0;
+	int64_t                 pcm_read_pos_ = 0;
 
     std::queue<PlyPacket*>          h264_frame_queue_;
     
-    int32_t buffer_ready_len_ = 300;
-    int32_t caton_cnt_ = 0;
-    
-    
-    int32_t                 pcm_packets_count_ = 0;
-    uint32_t                pre_pkt_ts_ = 0;
-    bool                    cmpt_render_dely_ = true;
-    
-    // resampler
-    dii_media_kit::acm2::ACMResampler audio_resampler_;
-    int32_t src_sample_rate_ = 44100;
-    int32_t src_channel_count_ = 1;
+    DiiRtmpDelayManager     delay_manager_;
 };
 
 #endif	// __PLAYER_BUFER_H__
@@ -0,0 +1,245 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#include "dii_rtmp_connection.h"
+#include "srs_librtmp.h"
+#include "dii_media_utils.h"
+#include "webrtc/base/bind.h"
+#include "webrtc/base/logging.h"
+#include "webrtc/base/socketaddress.h"
+#include "webrtc/base/timeutils.h"
+
+#include <mutex>
+
+#define DII_MSG_CHECK_TIMEOUT       1000
+#define RTMP_READ_TIME_OUT          10000  //ms
+#define RTMP_RECV_BUFFER_SIZE       (64 * 1024)
+// bound the bytes one busy stream reads before the others get a turn
+#define RTMP_MAX_READS_PER_EVENT    4
+
+std::atomic<int32_t> DiiRtmpConnection::open_connections_(0);
+
+// only the io thread reads, one buffer serves every connection
+static char recv_buffer[RTMP_RECV_BUFFER_SIZE];
+
+dii_rtc::Thread* DiiRtmpConnection::IoThread() {
+    static std::mutex mtx;
+    static dii_rtc::Thread* io_thread = nullptr;
+    std::unique_lock<std::mutex> lck(mtx);
+    if (!io_thread) {
+        io_thread = new dii_rtc::Thread();
+        io_thread->SetName("dii_rtmp_io", nullptr);
+        io_thread->Start();
+    }
+    return io_thread;
+}
+
+DiiRtmpConnection::DiiRtmpConnection(int32_t stream_id, DiiTransportCallback& callback)
+    : stream_id_(stream_id)
+    , callback_(callback) {
+    io_thread_ = IoThread();
+}
+
+DiiRtmpConnection::~DiiRtmpConnection() {
+    Close();
+}
+
+int32_t DiiRtmpConnection::Open(const std::string& url) {
+    return io_thread_->Invoke<int32_t>(RTC_FROM_HERE, dii_rtc::Bind(&DiiRtmpConnection::DoOpen, this, url));
+}
+
+void DiiRtmpConnection::Close() {
+    io_thread_->Invoke<void>(RTC_FROM_HERE, dii_rtc::Bind(&DiiRtmpConnection::DoClose, this));
+}
+
+int32_t DiiRtmpConnection::DoOpen(const std::string& url) {
+    DoClose();
+
+    session_ = srs_rtmp_nb_create(url.c_str());
+    char host[128] = {0};
+    int port = 0;
+    if (srs_rtmp_nb_get_server(session_, host, &port) != 0) {
+        DII_LOG(LS_ERROR, stream_id_, 2002003) << "rtmp connection: invalid url: " << url;
+        DoClose();
+        return -1;
+    }
+
+    socket_ = io_thread_->socketserver()->CreateAsyncSocket(AF_INET, SOCK_STREAM);
+    if (!socket_) {
+        DoClose();
+        return -1;
+    }
+    open_connections_++;
+    socket_->SignalConnectEvent.connect(this, &DiiRtmpConnection::OnConnectEvent);
+    socket_->SignalReadEvent.connect(this, &DiiRtmpConnection::OnReadEvent);
+    socket_->SignalWriteEvent.connect(this, &DiiRtmpConnection::OnWriteEvent);
+    socket_->SignalCloseEvent.connect(this, &DiiRtmpConnection::OnCloseEvent);
+    socket_->SetOption(dii_rtc::Socket::OPT_NODELAY, 1);
+
+    // an unresolved host name is resolved asynchronously by the socket
+    if (socket_->Connect(dii_rtc::SocketAddress(host, port)) != 0) {
+        DII_LOG(LS_ERROR, stream_id_, 2002003) << "rtmp connection: connect failed, error: " << socket_->GetError();
+        DoClose();
+        return -1;
+    }
+    last_recv_ms_ = open_ms_ = dii_rtc::TimeMillis();
+    connect_ms_ = setup_ms_ = 0;
+    io_thread_->PostDelayed(RTC_FROM_HERE, 1000, this, DII_MSG_CHECK_TIMEOUT);
+    return 0;
+}
+
+void DiiRtmpConnection::DoClose() {
+    io_thread_->Clear(this);
+    if (socket_) {
+        // no disconnect here, we may be inside one of its events and the signal
+        // holds its (non recursive) lock while emitting. Close() takes the socket
+        // off the socket server so no event follows, deleting it once the event
+        // returns disconnects us.
+        socket_->Close();
+        io_thread_->Dispose(socket_);
+        socket_ = nullptr;
+        open_connections_--;
+    }
+    if (session_) {
+        srs_rtmp_nb_destroy(session_);
+        session_ = nullptr;
+    }
+    started_ = false;
+    got_data_ = false;
+    playing_ = false;
+}
+
+void DiiRtmpConnection::Fail(int32_t eventid, const char* errmsg) {
+    DoClose();
+    callback_.OnTransportFailed(eventid, errmsg);
+}
+
+void DiiRtmpConnection::StartSession() {
+    if (started_) {
+        return;
+    }
+    started_ = true;
+    connected_ms_ = dii_rtc::TimeMillis();
+    connect_ms_ = (int32_t)(connected_ms_ - open_ms_);
+    srs_rtmp_nb_start(session_);
+    Flush();
+}
+
+bool DiiRtmpConnection::Flush() {
+    const char* data = nullptr;
+    int size = 0;
+    srs_rtmp_nb_pending_send(session_, &data, &size);
+    while (size > 0) {
+        int sent = socket_->Send(data, size);
+        if (sent <= 0) {
+            if (socket_->IsBlocking()) {
+                // resumed by SignalWriteEvent
+                return true;
+            }
+            Fail(playing_ ? 2002006 : 2002004, "rtmp connection send failed");
+            return false;
+        }
+        srs_rtmp_nb_consume_send(session_, sent);
+        srs_rtmp_nb_pending_send(session_, &data, &size);
+    }
+    return true;
+}
+
+bool DiiRtmpConnection::ReadPackets() {
+    for (;;) {
+        char type = 0;
+        u_int32_t timestamp = 0;
+        char* data = nullptr;
+        int size = 0;
+        int ret = srs_rtmp_nb_read_packet(session_, &type, &timestamp, &data, &size);
+        if (ret != 0) {
+            Fail(playing_ ? 2002006 : 2002004, playing_ ? "Srs rtmp read packet faild" : "rtmp connect vhost / app faild.");
+            return false;
+        }
+        if (!playing_ && srs_rtmp_nb_is_playing(session_)) {
+            playing_ = true;
+            setup_ms_ = (int32_t)(dii_rtc::TimeMillis() - connected_ms_);
+            callback_.OnTransportPlaying();
+        }
+        if (!data) {
+            return true;
+        }
+        if (!callback_.OnTransportPacket(type, timestamp, data, size)) {
+            DoClose();
+            return false;
+        }
+    }
+}
+
+void DiiRtmpConnection::OnConnectEvent(dii_rtc::AsyncSocket* socket) {
+    StartSession();
+}
+
+void DiiRtmpConnection::OnReadEvent(dii_rtc::AsyncSocket* socket) {
+    for (int i = 0; i < RTMP_MAX_READS_PER_EVENT; i++) {
+        int len = socket_->Recv(recv_buffer, sizeof(recv_buffer), nullptr);
+        if (len <= 0) {
+            // the socket signals close on its own after eof
+            if (!socket_->IsBlocking()) {
+                Fail(playing_ ? 2002006 : 2002003, "rtmp connection read failed");
+            }
+            return;
+        }
+        last_recv_ms_ = dii_rtc::TimeMillis();
+        if (srs_rtmp_nb_on_recv(session_, recv_buffer, len) != 0) {
+            Fail(2002003, "rtmp simple handshake failed");
+            return;
+        }
+        got_data_ = true;
+        if (!ReadPackets() || !Flush()) {
+            return;
+        }
+    }
+}
+
+void DiiRtmpConnection::OnWriteEvent(dii_rtc::AsyncSocket* socket) {
+    // a connect that completes at once reports writable instead of connected
+    if (!started_) {
+        StartSession();
+        return;
+    }
+    Flush();
+}
+
+void DiiRtmpConnection::OnCloseEvent(dii_rtc::AsyncSocket* socket, int err) {
+    DII_LOG(LS_WARNING, stream_id_, DII_CODE_COMMON_WARN) << "rtmp connection closed, error: " << err;
+    Fail(playing_ ? 2002006 : (got_data_ ? 2002004 : 2002003), "rtmp connection closed");
+}
+
+void DiiRtmpConnection::OnMessage(dii_rtc::Message* msg) {
+    switch (msg->message_id) {
+        case DII_MSG_CHECK_TIMEOUT: {
+            if (!socket_) {
+                break;
+            }
+            if (dii_rtc::TimeMillis() - last_recv_ms_ > RTMP_READ_TIME_OUT) {
+                Fail(playing_ ? 2002006 : 2002003, "rtmp read time out");
+                break;
+            }
+            io_thread_->PostDelayed(RTC_FROM_HERE, 1000, this, DII_MSG_CHECK_TIMEOUT);
+            break;
+        }
+        default:
+            break;
+    }
+}
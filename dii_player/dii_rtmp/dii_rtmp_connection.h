@@ -0,0 +1,86 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#ifndef __DII_RTMP_CONNECTION_H__
+#define __DII_RTMP_CONNECTION_H__
+
+#include "dii_rtmp_transport.h"
+#include "webrtc/base/asyncsocket.h"
+#include "webrtc/base/messagehandler.h"
+#include "webrtc/base/sigslot.h"
+#include "webrtc/base/thread.h"
+
+#include <atomic>
+#include <string>
+#include <stdint.h>
+
+// One rtmp play connection without a thread of its own. Every connection lives
+// on a single shared io thread, whose socket server waits on all sockets at once;
+// the handshake, the play commands and the chunk stream advance as bytes arrive.
+class DiiRtmpConnection : public DiiRtmpTransport,
+                          public sigslot::has_slots<>,
+                          public dii_rtc::MessageHandler {
+public:
+    DiiRtmpConnection(int32_t stream_id, DiiTransportCallback& callback);
+    virtual ~DiiRtmpConnection();
+    // both wait for the io thread, no callback runs after Close returns
+    int32_t Open(const std::string& url) override;
+    void Close() override;
+    // connections open on the shared io thread
+    static int32_t OpenConnections() { return open_connections_; }
+    // ms from Open to tcp connected (dns included), and from there to playing
+    void GetTimings(int32_t& connect_ms, int32_t& setup_ms) override { connect_ms = connect_ms_; setup_ms = setup_ms_; }
+    const char* Name() const override { return "rtmp"; }
+    // the thread all shared io sockets live on, http-flv included
+    static dii_rtc::Thread* IoThread();
+
+    //* For MessageHandler
+    virtual void OnMessage(dii_rtc::Message* msg) override;
+
+private:
+    int32_t DoOpen(const std::string& url);
+    void DoClose();
+    void Fail(int32_t eventid, const char* errmsg);
+    void StartSession();
+    bool Flush();
+    bool ReadPackets();
+
+    void OnConnectEvent(dii_rtc::AsyncSocket* socket);
+    void OnReadEvent(dii_rtc::AsyncSocket* socket);
+    void OnWriteEvent(dii_rtc::AsyncSocket* socket);
+    void OnCloseEvent(dii_rtc::AsyncSocket* socket, int err);
+
+private:
+    int32_t stream_id_ = -1;
+    DiiTransportCallback&       callback_;
+    dii_rtc::Thread*            io_thread_ = nullptr;
+    dii_rtc::AsyncSocket*       socket_ = nullptr;
+    void*                       session_ = nullptr;
+    bool                        started_ = false;
+    bool                        got_data_ = false;
+    bool                        playing_ = false;
+    int64_t                     last_recv_ms_ = 0;
+    int64_t                     open_ms_ = 0;
+    int64_t                     connected_ms_ = 0;
+    int32_t                     connect_ms_ = 0;
+    int32_t                     setup_ms_ = 0;
+
+    static std::atomic<int32_t> open_connections_;
+};
+
+#endif	// __DII_RTMP_CONNECTION_H__
@@ -20,110 +20,42 @@
 #include "webrtc/base/logging.h"
 #include "webrtc/media/engine/webrtcvideoframe.h"
 #include "webrtc/common_video/libyuv/include/webrtc_libyuv.h"
+#include "webrtc/common_video/h264/h264_common.h"
+#include "webrtc/common_video/h264/sps_parser.h"
+#include "webrtc/common_video/include/i420_buffer_pool.h"
 #include "dii_media_utils.h"
 
-namespace dii_media_kit {
-#ifndef WEBRTC_WIN
-enum Frametype {
-    FRAME_I  = 15,
-    FRAME_P  = 16,
-    FRAME_B  = 17
-};
-
-typedef struct Tag_bs_t {
-    unsigned char *p_start;                //
-    unsigned char *p;                      //
-    unsigned char *p_end;                  //
-    int     i_left;                        //
-}bs_t;
-
-void bs_init( bs_t *s, void *p_data, int i_data ) {
-    s->p_start = (unsigned char *)p_data;        //
-    s->p       = (unsigned char *)p_data;        //
-    s->p_end   = s->p + i_data;                  //
-    s->i_left  = 8;                              //
-}
-
-int bs_read( bs_t *s, int i_count ) {
-    static uint32_t i_mask[33] ={0x00,
-        0x01,      0x03,      0x07,      0x0f,
-        0x1f,      0x3f,      0x7f,      0xff,
-        0x1ff,     0x3ff,     0x7ff,     0xfff,
-        0x1fff,    0x3fff,    0x7fff,    0xffff,
-        0x1ffff,   0x3ffff,   0x7ffff,   0xfffff,
-        0x1fffff,  0x3fffff,  0x7fffff,  0xffffff,
-        0x1ffffff, 0x3ffffff, 0x7ffffff, 0xfffffff,
-        0x1fffffff,0x3fffffff,0x7fffffff,0xffffffff};
-    int      i_shr;             //
-    int i_result = 0;           //
-    
-    while( i_count > 0 )     //
-    {
-        if( s->p >= s->p_end ) //
-        {                       //
-            break;
-        }
-        
-        if( ( i_shr = s->i_left - i_count ) >= 0 )
-        {
-            i_result |= ( *s->p >> i_shr )&i_mask[i_count];
-     
-            s->i_left -= i_count;
-            if( s->i_left == 0 )
-            {
-                s->p++;
-                s->i_left = 8;
-            }
-            return( i_result );
-        }
-        else
-        {
-            i_result |= (*s->p&i_mask[s->i_left]) << -i_shr;
-            i_count  -= s->i_left;
-            s->p++;  //
-            s->i_left = 8;   //
-        }
-    }
-    
-    return( i_result );
-}
-int bs_read1( bs_t *s ) {
-    if( s->p < s->p_end )
-    {
-        unsigned int i_result;
-        
-        s->i_left--;                           //
-        i_result = ( *s->p >> s->i_left )&0x01;//
-        if( s->i_left == 0 )                   //
-        {
-            s->p++;                             //
-            s->i_left = 8;                     //
-        }
-        return i_result;                       // unsigned int
-    }
-    
-    return 0;                                  //
-}
+#include <algorithm>
+
+// max tempo change per decoded aac frame
+#define AUDIO_SPEED_STEP        0.01f
+// aac frames waiting to be decoded, ~10 s at 48 kHz. the oldest are dropped beyond
+#define AUDIO_MAX_QUEUED_FRAMES 512
+// video this late against the audio clock is not decoded unless it is a reference
+#define VIDEO_DROP_LATE_LEN     300
+// this late, jump to the newest keyframe already released for decoding
+#define VIDEO_CATCHUP_LEN       1000
+
+// presentation times remembered to learn how far b-frames reach back
+#define VIDEO_REORDER_WINDOW    16
+// automatic decode threads: at most this many, fewer below 1080p
+#define VIDEO_MAX_DECODE_THREADS    4
+// frames in flight in the decoder that are tracked for its delay
+#define VIDEO_MAX_DECODE_SUBMITS    64
+#define VIDEO_MAX_DECODE_DELAY      500
 
-int bs_read_ue( bs_t *s ) {
-    int i = 0;
-    
-    while( bs_read1( s ) == 0 && s->p < s->p_end && i < 32 )
-    {
-        i++;
-    }
-    return( ( 1 << i) - 1 + bs_read( s, i ) );
-}
-#endif
+namespace dii_media_kit {
+std::atomic<int32_t> DiiRtmpDecoder::decode_threads_default_(0);
+std::atomic<bool> DiiRtmpDecoder::frame_threads_default_(true);
+std::atomic<int32_t> DiiRtmpDecoder::audio_decoder_default_(DII_AUDIO_DECODER_AUTO);
 
 
 /**
  *  PlyDecoder
  */
 DiiRtmpDecoder::DiiRtmpDecoder(int32_t stream_id, bool report)
-	: running_(false)
-	, h264_decoder_(NULL)
-	, aac_decoder_(NULL)
+	: h264_decoder_(NULL)
+	, running_(false)
 	, a_cache_len_(0)
 	, encoded_audio_ch_nb_(2)
     , cur_audio_speed_(1.0)
@@ -132,6 +64,7 @@ DiiRtmpDecoder::DiiRtmpDecoder(int32_t stream_id, bool report)
     , _report(report)
 {
         this->stream_id_ = stream_id;
+        aac_queue_.resize(AUDIO_MAX_QUEUED_FRAMES);
 }
 
 DiiRtmpDecoder::~DiiRtmpDecoder()
@@ -149,18 +82,19 @@ void DiiRtmpDecoder::Start(bool report) {
     }
     _report = report;
     got_keyframe_ = false;
-    h264_decoder_ = dii_media_kit::H264Decoder::Create();
-    dii_media_kit::VideoCodec codecSetting;
-    codecSetting.codecType = dii_media_kit::kVideoCodecH264;
-    codecSetting.width = 320;
-    codecSetting.height = 240;
-    h264_decoder_->InitDecode(&codecSetting, 1);
-    h264_decoder_->RegisterDecodeCompleteCallback(this);
-    
+    reorder_depth_ = 0;
+    recent_pts_.clear();
+    audio_decoder_type_ = (DiiAudioDecoderType)audio_decoder_default_.load();
+    // video decoder is created on the first sps, when the resolution is known.
     running_ = true;
+    start_ms_ = dii_rtc::TimeMillis();
+    first_video_frame_ms_ = 0;
+    first_audio_ms_ = 0;
     
 //    last_statistic_ts_ = dii_rtc::Time();
     ply_buffer_ = new DiiRtmpBuffer(stream_id_, *this);
+    ply_buffer_->SetPlayoutDelay(playout_delay_ms_);
+    ply_buffer_->SetGroupDelay(group_delay_ms_);
     v_decode_thread_ = new std::thread(&DiiRtmpDecoder::VideoDecodeThread, this);
     a_decode_thread_ = new std::thread(&DiiRtmpDecoder::AudioDecodeThread, this);
     
@@ -187,14 +121,18 @@ void DiiRtmpDecoder::Shutdown() {
     }
 
     if (aac_decoder_) {
-        aac_decoder_close(aac_decoder_);
-        aac_decoder_ = NULL;
+        delete aac_decoder_;
+        aac_decoder_ = nullptr;
     }
+    audio_decoder_name_ = nullptr;
+    // reopened from the current config on the next Start
+    decoder_config_gen_ = 0;
 
     if (h264_decoder_) {
         delete h264_decoder_;
         h264_decoder_ = NULL;
     }
+    decoder_name_ = nullptr;
     
     if (sound_touch_) {
         sound_touch_->clear();
@@ -212,6 +150,22 @@ void DiiRtmpDecoder::SetVideoFrameCallback(VideoFrameCallback callback) {
     video_frame_callback_ = callback;
 }
 
+void DiiRtmpDecoder::SetDecodeThreads(int32_t threads, bool frame_threads) {
+    decode_threads_default_ = threads;
+    frame_threads_default_ = frame_threads;
+}
+
+void DiiRtmpDecoder::SetAudioDecoder(DiiAudioDecoderType type) {
+    audio_decoder_default_ = type;
+}
+
+void DiiRtmpDecoder::SetPlayoutDelay(int32_t delay_ms) {
+    playout_delay_ms_ = delay_ms;
+    if (ply_buffer_) {
+        ply_buffer_->SetPlayoutDelay(delay_ms);
+    }
+}
+
 bool DiiRtmpDecoder::IsPlaying()
 {
     if (!ply_buffer_) {
@@ -223,6 +177,10 @@ bool DiiRtmpDecoder::IsPlaying()
     return true;
 }
 
+int64_t DiiRtmpDecoder::PlayingTs() {
+    return ply_buffer_ ? ply_buffer_->AudioClock() : 0;
+}
+
 int32_t DiiRtmpDecoder::GetCacheTime() {
     // FIX ME:
     int32_t cache_len = 0;
@@ -233,46 +191,32 @@ int32_t DiiRtmpDecoder::GetCacheTime() {
     return cache_len;
 }
 
-void DiiRtmpDecoder::CacheAvcData(const uint8_t* pdata, int len, uint32_t ts)
+void DiiRtmpDecoder::CacheAvcData(const dii_rtc::scoped_refptr<PlyBuffer>& frame, uint32_t ts, int32_t cts,
+                                  const PlyVideoInfo& info)
 {
-    video_bitrate_ += len;
-
-    PlyPacket* pkt = new PlyPacket(true);
-    pkt->SetData(pdata, len, ts);
-
-#ifndef WEBRTC_WIN
-    bs_t s;
-    bs_init(&s, (void *)(pkt->_data + 4 + 1), pkt->_data_len - 4 -1);
-    /* i_first_mb */
-    bs_read_ue( &s );
-    /* picture type */
-    int frame_type =  bs_read_ue( &s );
-    Frametype ft = FRAME_P;
-    switch(frame_type) {
-        case 0: case 5: /* P */
-            ft = FRAME_P;
-            break;
-        case 1: case 6: /* B */
-            ft = FRAME_B;
-            break;
-        case 3: case 8: /* SP */
-            ft = FRAME_P;
-            break;
-        case 2: case 7: /* I */
-            ft = FRAME_I;
-            break;
-        case 4: case 9: /* SI */
-            ft = FRAME_I;
-            break;
-    }
-    if(ft == FRAME_B) {
-        DII_LOG(LS_WARNING, stream_id_, DII_CODE_COMMON_WARN) << "Not support decode P video frame, drop it.";
-        return;
+    video_bitrate_ += frame->size();
+
+    // the composition time tells about b-frames, no need to parse slice headers.
+    // depth is how many earlier frames are presented after this one.
+    if (cts != 0 || reorder_depth_ > 0) {
+        int64_t pts = (int64_t)ts + cts;
+        int32_t later = 0;
+        for (int64_t recent : recent_pts_) {
+            if (recent > pts) {
+                later++;
+            }
+        }
+        if (later > reorder_depth_) {
+            reorder_depth_ = later;
+            DII_LOG(LS_INFO, stream_id_, DII_CODE_COMMON_INFO) << "Video has b-frames, reorder depth: " << later;
+        }
+        recent_pts_.push_back(pts);
+        if (recent_pts_.size() > VIDEO_REORDER_WINDOW) {
+            recent_pts_.pop_front();
+        }
     }
-#endif
-    int type = pkt->_data[4] & 0x1f;
-    
-    if (type == 7) { // keyframe
+
+    if (info.keyframe) {
         got_keyframe_ = true;
     }
     
@@ -282,54 +226,97 @@ void DiiRtmpDecoder::CacheAvcData(const uint8_t* pdata, int len, uint32_t ts)
     }
     
     if(ply_buffer_) {
-        ply_buffer_->CacheH264Frame(pkt, type);
+        PlyPacket* pkt = new PlyPacket(true);
+        pkt->SetBuffer(frame, ts);
+        pkt->_cts = cts;
+        pkt->_video = info;
+        ply_buffer_->CacheH264Frame(pkt, info.nal_type);
     }
 }
 
 void DiiRtmpDecoder::AudioDecodeThread() {
     while (running_) {
-        PlyPacket* pkt = nullptr;
+        AacFrame frame;
+        bool reopen = false;
         {
             std::unique_lock<std::mutex> lck(a_mtx_);
-            if(aac_queue_.empty() || !ply_buffer_) {
+            if(aac_queue_count_ == 0 || !ply_buffer_) {
                 a_cond_.wait_for(lck, std::chrono::milliseconds(10));
                 continue;
             }
-            pkt = aac_queue_.front();
-            aac_queue_.pop();
-            if(!pkt)
-                continue;
+            AacFrame& head = aac_queue_[aac_queue_head_];
+            frame.data.swap(head.data);
+            frame.pts = head.pts;
+            frame.sync_ts = head.sync_ts;
+            aac_queue_head_ = (aac_queue_head_ + 1) % AUDIO_MAX_QUEUED_FRAMES;
+            aac_queue_count_--;
+            if (decoder_config_gen_ != aac_config_gen_) {
+                decoder_config_gen_ = aac_config_gen_;
+                decoder_config_ = aac_config_;
+                reopen = true;
+            }
         }
 
-        // init aac decoder
-        if (aac_decoder_ == NULL) {
-            InitAACDecoder(pkt->_data, pkt->_data_len);
+        if (reopen) {
+            InitAACDecoder();
         }
-        
-        unsigned int decoded_out_len = 0;
-        uint8_t decoded_out[4096] = {0};
-       int ret =  aac_decoder_decode_frame(aac_decoder_, (unsigned char*)pkt->_data, pkt->_data_len, decoded_out, &decoded_out_len);
+        DecodeAacFrame(frame);
+        audio_pending_--;
+    }
+}
 
-        if (decoded_out_len > 0) {
-            DoSoundtouch(decoded_out, decoded_out_len);
-            ChunkAndCacheAudioData(pkt->_pts, pkt->_sync_ts);
-        } else {
-            DII_LOG(LS_ERROR, stream_id_, 2002013) << "rtmp aac decode error with error code:"<<ret;
+void DiiRtmpDecoder::DecodeAacFrame(const AacFrame& frame) {
+    if (!aac_decoder_) {
+        return;
+    }
+
+    const int16_t* pcm = nullptr;
+    int64_t decode_start_us = dii_rtc::TimeMicros();
+    int frames = aac_decoder_->Decode(frame.data->data(), frame.data->size(), &pcm);
+    audio_decode_time_us_ += dii_rtc::TimeMicros() - decode_start_us;
+
+    if (frames > 0) {
+        SetAudioFormat(aac_decoder_->SampleRate(), aac_decoder_->Channels());
+        if (encoded_audio_sample_rate_ == 0) {
+            return;
         }
+        audio_decoded_us_ += (int64_t)frames * 1000000 / encoded_audio_sample_rate_;
+        DoSoundtouch(pcm, frames);
+        ChunkAndCacheAudioData(frame.pts, frame.sync_ts);
+    } else if (frames < 0) {
+        DII_LOG(LS_ERROR, stream_id_, 2002013) << "rtmp aac decode error with error code:" << frames;
     }
 }
 
-void DiiRtmpDecoder::InitAACDecoder(uint8_t*data, int32_t len) {
-    aac_decoder_ = aac_decoder_open((unsigned char*)data,
-                                              len,
-                                              &encoded_audio_ch_nb_,
-                                              &encoded_audio_sample_rate_);
-              
-    DII_LOG(LS_INFO, stream_id_, DII_CODE_COMMON_INFO) << "Open aac codec decoder, aac channels: " << encoded_audio_ch_nb_
-      << ", aac sample rate: " << encoded_audio_sample_rate_;
+void DiiRtmpDecoder::InitAACDecoder() {
+    if (aac_decoder_) {
+        delete aac_decoder_;
+    }
+    aac_decoder_ = DiiRtmpAacDecoder::Create(audio_decoder_type_, decoder_config_.data(), (int)decoder_config_.size());
+    if (!aac_decoder_) {
+        audio_decoder_name_ = nullptr;
+        DII_LOG(LS_ERROR, stream_id_, 2002013) << "Open aac codec decoder failed, config size: " << decoder_config_.size();
+        return;
+    }
+    audio_decoder_name_ = aac_decoder_->ImplementationName();
+    DII_LOG(LS_INFO, stream_id_, DII_CODE_COMMON_INFO) << "Open aac codec decoder " << audio_decoder_name_
+      << ", aac channels: " << aac_decoder_->Channels() << ", aac sample rate: " << aac_decoder_->SampleRate();
+    SetAudioFormat(aac_decoder_->SampleRate(), aac_decoder_->Channels());
+}
 
-    if (encoded_audio_ch_nb_ == 0)
-      encoded_audio_ch_nb_ = 1;
+void DiiRtmpDecoder::SetAudioFormat(int32_t sample_rate, int32_t channels) {
+    if (sample_rate <= 0 || channels <= 0 ||
+        ((uint32_t)sample_rate == encoded_audio_sample_rate_ && channels == encoded_audio_ch_nb_)) {
+        return;
+    }
+    encoded_audio_sample_rate_ = sample_rate;
+    encoded_audio_ch_nb_ = (uint8_t)channels;
+    a_cache_len_ = 0;
+    if (sound_touch_) {
+        sound_touch_->clear();
+        sound_touch_->setSampleRate(sample_rate);
+        sound_touch_->setChannels(channels);
+    }
 }
 
 void DiiRtmpDecoder::InitSoundTouch(uint16_t sample_rate, uint8_t channel_count) {
@@ -340,38 +327,68 @@ void DiiRtmpDecoder::InitSoundTouch(uint16_t sample_rate, uint8_t channel_count)
     sound_touch_->setTempo(1.0);
 }
 
-void DiiRtmpDecoder::DoSoundtouch(uint8_t*data, int32_t len) {
+void DiiRtmpDecoder::DoSoundtouch(const int16_t* pcm, int32_t frames) {
     if(sound_touch_ == nullptr) {
         InitSoundTouch(encoded_audio_sample_rate_, encoded_audio_ch_nb_);
     }
 
-    int32_t cache_time_len_ = GetCacheTime();
-    if(cache_time_len_ < ply_buffer_->PlayReadyBufferLen() && current_audio_play_speed_ != 1) {
-        current_audio_play_speed_ = 1;
-        sound_touch_->setTempo(1.0);
-        DII_LOG(LS_INFO, stream_id_, DII_CODE_COMMON_INFO) << "audio play speed 100%, cache len: " << cache_time_len_ << " ms.";
-    } else if (cache_time_len_ > (ply_buffer_->PlayReadyBufferLen() + 2000) && current_audio_play_speed_ != 2){
-        current_audio_play_speed_ = 2;
-        sound_touch_->setTempo(1.2);
-        DII_LOG(LS_INFO, stream_id_, DII_CODE_COMMON_INFO) << "audio play speed 120%, cache len: " << cache_time_len_ << " ms.";
+    // ease toward the wanted rate, a sudden tempo step is audible
+    float rate = ply_buffer_->PlaybackRate();
+    float speed = cur_audio_speed_;
+    if (rate > speed) {
+        speed = FFMIN(rate, speed + AUDIO_SPEED_STEP);
+    } else if (rate < speed) {
+        speed = FFMAX(rate, speed - AUDIO_SPEED_STEP);
+    }
+    if (speed != cur_audio_speed_) {
+        if ((speed == 1.0f) != (cur_audio_speed_ == 1.0f)) {
+            DII_LOG(LS_INFO, stream_id_, DII_CODE_COMMON_INFO) << "audio play speed " << (int)(rate * 100) << "%, cache len: "
+                            << GetCacheTime() << " ms, target: " << ply_buffer_->PlayReadyBufferLen() << " ms.";
+        }
+        cur_audio_speed_ = speed;
+        sound_touch_->setTempo(speed);
     }
 
     // soundtouch process
-    std::vector<uint8_t> soundtouch_buf;
-    // if need speed cut, soundtouc_buf may > src audio data len.
-    soundtouch_buf.resize(2*len);
+    // if need speed cut, soundtouc_buf may > src audio data len. grows once, then reused.
+    size_t len = (size_t)frames * encoded_audio_ch_nb_ * sizeof(int16_t);
+    if (soundtouch_buf_.size() < 2 * len) {
+        soundtouch_buf_.resize(2 * len);
+    }
     
-    int out_sample_nb = len/encoded_audio_ch_nb_/2;
-    sound_touch_->putSamples((dii_soundtouch::SAMPLETYPE *)data, out_sample_nb);
+    sound_touch_->putSamples((const dii_soundtouch::SAMPLETYPE *)pcm, frames);
 
-    int out_st_sample_cnt = sound_touch_->receiveSamples((dii_soundtouch::SAMPLETYPE *)soundtouch_buf.data(), out_sample_nb);
+    // slowing down yields more samples than went in, bounded by what audio_cache_ can take
+    int max_receive = FFMIN(2 * frames,
+                            (int)(sizeof(audio_cache_) - a_cache_len_) / encoded_audio_ch_nb_ / 2);
+    int out_st_sample_cnt = sound_touch_->receiveSamples((dii_soundtouch::SAMPLETYPE *)soundtouch_buf_.data(), max_receive);
     if(out_st_sample_cnt > 0) {
        int out_len = out_st_sample_cnt*encoded_audio_ch_nb_*sizeof(int16_t);
-       memcpy(audio_cache_ + a_cache_len_, soundtouch_buf.data(), out_len);
+       memcpy(audio_cache_ + a_cache_len_, soundtouch_buf_.data(), out_len);
        a_cache_len_ += out_len;
     }
 }
 
+// interleaved int16, downmix to mono averages, otherwise channels are mapped or repeated
+static void RemixChannels(const int16_t* in, size_t frames, size_t in_channels,
+                          int16_t* out, size_t out_channels) {
+    for (size_t i = 0; i < frames; i++) {
+        const int16_t* src = in + i * in_channels;
+        int16_t* dst = out + i * out_channels;
+        if (out_channels == 1) {
+            int32_t sum = 0;
+            for (size_t c = 0; c < in_channels; c++) {
+                sum += src[c];
+            }
+            dst[0] = (int16_t)(sum / (int32_t)in_channels);
+        } else {
+            for (size_t c = 0; c < out_channels; c++) {
+                dst[c] = src[c < in_channels ? c : in_channels - 1];
+            }
+        }
+    }
+}
+
 void DiiRtmpDecoder::ChunkAndCacheAudioData(uint32_t pts, uint64_t sync_ts) {
     // start chunk cache in 10ms len.
     int alen_10ms = encoded_audio_sample_rate_/100*2*encoded_audio_ch_nb_;
@@ -381,14 +398,32 @@ void DiiRtmpDecoder::ChunkAndCacheAudioData(uint32_t pts, uint64_t sync_ts) {
         return;
     }
                   
+    // convert to the playout format here, the audio callback then only copies
+    int out_rate = out_sample_rate_ > 0 ? out_sample_rate_.load() : (int)encoded_audio_sample_rate_;
+    int out_channels = out_channels_ > 0 ? out_channels_.load() : (int)encoded_audio_ch_nb_;
+    const int max_out_samples = sizeof(resample_buf_) / sizeof(int16_t);
+    if (out_rate / 100 * FFMAX(out_channels, (int)encoded_audio_ch_nb_) > max_out_samples) {
+        DII_LOG(LS_ERROR, stream_id_, DII_CODE_COMMON_INFO) << "unsupported playout format, rate: " << out_rate << ", channels: " << out_channels;
+        return;
+    }
+    ply_buffer_->SetPcmFormat(out_rate, out_channels);
+
     int ct = 0;
-    while (a_cache_len_ > alen_10ms) {
-       ply_buffer_->CachePcmData(audio_cache_ + ct * alen_10ms,
-                                 alen_10ms,
-                                 encoded_audio_sample_rate_,
-                                 encoded_audio_ch_nb_,
-                                 pts,
-                                 sync_ts);
+    while (a_cache_len_ >= alen_10ms) {
+       int frames = audio_resampler_.Resample10Msec((int16_t*)(audio_cache_ + ct * alen_10ms),
+                                                    encoded_audio_sample_rate_,
+                                                    out_rate,
+                                                    encoded_audio_ch_nb_,
+                                                    max_out_samples,
+                                                    resample_buf_);
+       if (frames > 0) {
+           const int16_t* pcm = resample_buf_;
+           if (out_channels != encoded_audio_ch_nb_) {
+               RemixChannels(resample_buf_, frames, encoded_audio_ch_nb_, remix_buf_, out_channels);
+               pcm = remix_buf_;
+           }
+           ply_buffer_->CachePcmData(pcm, frames, pts, sync_ts);
+       }
        a_cache_len_ -= alen_10ms;
        ct++;
     }
@@ -396,20 +431,46 @@ void DiiRtmpDecoder::ChunkAndCacheAudioData(uint32_t pts, uint64_t sync_ts) {
 }
 
 
-void DiiRtmpDecoder::CacheAacData(const uint8_t*pdata, int len, uint32_t ts, uint64_t sync_ts) {
-    audio_bitrate_ += len;
-    // push packet
-    PlyPacket* pkt = new PlyPacket(false);
-    pkt->SetData(pdata, len, ts, sync_ts);
+void DiiRtmpDecoder::CacheAacData(const dii_rtc::scoped_refptr<PlyBuffer>& frame, uint32_t ts, uint64_t sync_ts) {
+    audio_bitrate_ += frame->size();
+    if (ply_buffer_) {
+        ply_buffer_->OnAudioPacketArrived(ts);
+    }
     std::unique_lock<std::mutex> lck(a_mtx_);
-    aac_queue_.push(pkt);
+    if (aac_queue_count_ == AUDIO_MAX_QUEUED_FRAMES) {
+        aac_queue_[aac_queue_head_].data = nullptr;
+        aac_queue_head_ = (aac_queue_head_ + 1) % AUDIO_MAX_QUEUED_FRAMES;
+        aac_queue_count_--;
+        audio_pending_--;
+    }
+    AacFrame& tail = aac_queue_[(aac_queue_head_ + aac_queue_count_) % AUDIO_MAX_QUEUED_FRAMES];
+    tail.data = frame;
+    tail.pts = ts;
+    tail.sync_ts = sync_ts;
+    aac_queue_count_++;
+    audio_pending_++;
     a_cond_.notify_one();
 }
 
+void DiiRtmpDecoder::SetAacConfig(const uint8_t* config, int len) {
+    if (!config || len <= 0) {
+        return;
+    }
+    std::unique_lock<std::mutex> lck(a_mtx_);
+    // sent again on every reconnect, only a different config reopens the decoder
+    if (aac_config_.size() == (size_t)len && memcmp(aac_config_.data(), config, len) == 0) {
+        return;
+    }
+    aac_config_.assign(config, config + len);
+    aac_config_gen_++;
+}
+
 int DiiRtmpDecoder::GetMorePcmData(void *audioSamples,
                                  size_t samplesPerSec,
                                  size_t nChannels,
                                  uint64_t &sync_ts) {
+    out_sample_rate_ = (int32_t)samplesPerSec;
+    out_channels_ = (int32_t)nChannels;
     if (ply_buffer_ && ply_buffer_->PlayerStatus() != BufferReady) {
         return 0;
     }
@@ -437,7 +498,12 @@ int DiiRtmpDecoder::GetMorePcmData(void *audioSamples,
             }
         }
         
-        return ply_buffer_->GetMorePcmData(audioSamples, samplesPerSec, nChannels, sync_ts);
+        int ret = ply_buffer_->GetMorePcmData(audioSamples, samplesPerSec, nChannels, sync_ts);
+        if (ret > 0 && first_audio_ms_ == 0) {
+            first_audio_ms_ = (int32_t)FFMAX(dii_rtc::TimeMillis() - start_ms_, 1);
+            DII_LOG(LS_INFO, stream_id_, DII_CODE_COMMON_INFO) << "first audio played after " << first_audio_ms_ << " ms.";
+        }
+        return ret;
     }
     return -1;
 }
@@ -450,42 +516,65 @@ void DiiRtmpDecoder::ClearCache() {
         while (!h264_queue_.empty()) {
             auto it = h264_queue_.front();
             delete it;
-            h264_queue_.pop();
+            h264_queue_.pop_front();
         }
     }
     
     {
         std::unique_lock<std::mutex> alck(a_mtx_);
-        while (!aac_queue_.empty()) {
-            auto it = aac_queue_.front();
-            delete it;
-            aac_queue_.pop();
+        for (auto& frame : aac_queue_) {
+            frame.data = nullptr;
         }
+        audio_pending_ -= (int32_t)aac_queue_count_;
+        aac_queue_head_ = 0;
+        aac_queue_count_ = 0;
+    }
+
+    {
+        std::unique_lock<std::mutex> rlck(reorder_mtx_);
+        reorder_queue_.clear();
+        decode_submits_.clear();
+        decode_delay_ms_ = 0;
     }
 }
 
 void DiiRtmpDecoder::VideoDecodeThread() {
     while(running_) {
         PlyPacket* pkt = nullptr;
+        // the frame taken last time round is done with
+        video_decoding_ = false;
         {
             std::unique_lock<std::mutex> lck(v_mtx_);
-            if (h264_queue_.empty() || !h264_decoder_) {
+            if (h264_queue_.empty()) {
                 v_cond_.wait_for(lck, std::chrono::milliseconds(10));
                 continue;
             }
             pkt = h264_queue_.front();
-            h264_queue_.pop();
+            h264_queue_.pop_front();
+            video_decoding_ = true;
+            if(!pkt)
+                continue;
+            pkt = SkipLateVideo(pkt);
             if(!pkt)
                 continue;
         }
      
-        int frameType = pkt->_data[4] & 0x1f;
+        if (h264_decoder_ && pkt->_video.keyframe && pkt->_video.codec != decoder_codec_) {
+            DII_LOG(LS_INFO, stream_id_, DII_CODE_COMMON_INFO) << "Video codec changed to " << pkt->_video.codec << ", recreate decoder.";
+            delete h264_decoder_;
+            h264_decoder_ = NULL;
+        }
+        if (!h264_decoder_ && (!pkt->_video.keyframe || !CreateVideoDecoder(pkt->_data, pkt->_data_len, pkt->_video.codec))) {
+            delete pkt;
+            continue;
+        }
         dii_media_kit::EncodedImage encoded_image;
         encoded_image._buffer = (uint8_t*)pkt->_data;
         encoded_image._length = pkt->_data_len;
         encoded_image._size = pkt->_data_len + 8;
-        encoded_image._timeStamp = pkt->_pts;
-        if (frameType == 7) {
+        // released at decode time, shown at presentation time
+        encoded_image._timeStamp = pkt->_pts + pkt->_cts;
+        if (pkt->_video.keyframe) {
             encoded_image._frameType = dii_media_kit::kVideoFrameKey;
         }
         else {
@@ -495,7 +584,16 @@ void DiiRtmpDecoder::VideoDecodeThread() {
         dii_media_kit::RTPFragmentationHeader frag_info;
      
         decode_fps_++;
+        int64_t decode_start_us = dii_rtc::TimeMicros();
+        {
+            std::unique_lock<std::mutex> rlck(reorder_mtx_);
+            decode_submits_.emplace_back(encoded_image._timeStamp, decode_start_us / 1000);
+            if (decode_submits_.size() > VIDEO_MAX_DECODE_SUBMITS) {
+                decode_submits_.pop_front();
+            }
+        }
         int ret = h264_decoder_->Decode(encoded_image, false, &frag_info);
+        decode_time_us_ += dii_rtc::TimeMicros() - decode_start_us;
         if (ret != 0) {
             DII_LOG(LS_INFO, stream_id_, 2002009) << "rtmp h264 decode error.with error code:"<<ret;
         }
@@ -503,15 +601,181 @@ void DiiRtmpDecoder::VideoDecodeThread() {
 	}
 }
 
+bool DiiRtmpDecoder::CreateVideoDecoder(const uint8_t* data, int32_t len, VideoCodecType codec) {
+    int32_t width = 0;
+    int32_t height = 0;
+    if (codec == kVideoCodecH265) {
+        // libavcodec reads the resolution from the stream
+        h264_decoder_ = dii_media_kit::H264Decoder::CreateH265();
+    } else {
+        for (const H264::NaluIndex& index : H264::FindNaluIndices(data, len)) {
+            if (H264::ParseNaluType(data[index.payload_start_offset]) != H264::kSps)
+                continue;
+            dii_rtc::Optional<SpsParser::SpsState> sps =
+                SpsParser::ParseSps(data + index.payload_start_offset + H264::kNaluTypeSize,
+                                    index.payload_size - H264::kNaluTypeSize);
+            if (sps) {
+                width = sps->width;
+                height = sps->height;
+            }
+            break;
+        }
+
+        if (dii_media_kit::H264Decoder::IsSupported()) {
+            h264_decoder_ = dii_media_kit::H264Decoder::Create();
+        }
+    }
+    if (!h264_decoder_) {
+        DII_LOG(LS_ERROR, stream_id_, 2002009) << "No video decoder available, codec: " << codec;
+        return false;
+    }
+    dii_media_kit::VideoCodec codecSetting;
+    codecSetting.codecType = codec;
+    codecSetting.width = width > 0 ? width : 320;
+    codecSetting.height = height > 0 ? height : 240;
+    decode_threads_ = DecodeThreads(width, height);
+    h264_decoder_->SetFrameThreading(frame_threads_default_);
+    h264_decoder_->InitDecode(&codecSetting, decode_threads_);
+    h264_decoder_->RegisterDecodeCompleteCallback(this);
+    decoder_name_ = h264_decoder_->ImplementationName();
+    decoder_codec_ = codec;
+
+    DII_LOG(LS_INFO, stream_id_, DII_CODE_COMMON_INFO) << "Create video decoder: " << decoder_name_
+                                                       << ", sps resolution: " << width << "x" << height
+                                                       << ", threads: " << decode_threads_
+                                                       << ", delay frames: " << h264_decoder_->DecodeDelayFrames();
+    return true;
+}
+
+int32_t DiiRtmpDecoder::DecodeThreads(int32_t width, int32_t height) {
+    int32_t threads = decode_threads_default_;
+    if (threads > 0) {
+        return threads;
+    }
+    // one core keeps up with small streams, h265 does not tell its resolution here
+    int32_t cores = std::max(1, (int32_t)std::thread::hardware_concurrency());
+    int32_t pixels = width * height;
+    if (pixels == 0 || pixels >= 1920 * 1080) {
+        return std::min(cores, VIDEO_MAX_DECODE_THREADS);
+    }
+    if (pixels >= 1280 * 720) {
+        return std::min(cores, 2);
+    }
+    return 1;
+}
+
+void DiiRtmpDecoder::UpdateDecodeDelay(uint32_t timestamp) {
+    int64_t now = dii_rtc::TimeMillis();
+    int32_t delay_ms = -1;
+    {
+        std::unique_lock<std::mutex> rlck(reorder_mtx_);
+        for (auto it = decode_submits_.begin(); it != decode_submits_.end(); ++it) {
+            if (it->first == timestamp) {
+                delay_ms = (int32_t)std::min<int64_t>(now - it->second, VIDEO_MAX_DECODE_DELAY);
+                decode_submits_.erase(it);
+                break;
+            }
+        }
+        if (delay_ms < 0) {
+            return;
+        }
+        // frame threads and reordering hold frames back for a steady number of releases
+        decode_delay_ms_ += (delay_ms - decode_delay_ms_) / 8;
+        delay_ms = decode_delay_ms_;
+    }
+    if (ply_buffer_) {
+        ply_buffer_->SetVideoDecodeDelay(delay_ms);
+    }
+}
+
+PlyPacket* DiiRtmpDecoder::SkipLateVideo(PlyPacket* pkt) {
+    int64_t late_ms = ply_buffer_ ? ply_buffer_->VideoLateMs(pkt->_pts) : 0;
+    if (late_ms < VIDEO_DROP_LATE_LEN || !h264_decoder_) {
+        video_catching_up_ = false;
+        return pkt;
+    }
+    if (!video_catching_up_) {
+        video_catching_up_ = true;
+        video_catchup_events_++;
+        DII_LOG(LS_WARNING, stream_id_, DII_CODE_COMMON_WARN) << "Video decoding " << late_ms
+            << " ms behind audio, catching up, queued frames: " << h264_queue_.size();
+    }
+
+    if (late_ms >= VIDEO_CATCHUP_LEN) {
+        // nothing before the newest keyframe is needed to decode what follows it
+        auto key = std::find_if(h264_queue_.rbegin(), h264_queue_.rend(), [](const PlyPacket* p) {
+            return p->_video.keyframe;
+        });
+        if (key != h264_queue_.rend()) {
+            size_t idx = h264_queue_.rend() - key - 1;
+            delete pkt;
+            for (size_t i = 0; i < idx; i++) {
+                delete h264_queue_[i];
+            }
+            pkt = h264_queue_[idx];
+            h264_queue_.erase(h264_queue_.begin(), h264_queue_.begin() + idx + 1);
+            video_skipped_frames_ += (int32_t)idx + 1;
+            DII_LOG(LS_WARNING, stream_id_, DII_CODE_COMMON_WARN) << "Video skipped " << idx + 1
+                << " frames to keyframe pts: " << pkt->_pts;
+            return pkt;
+        }
+    }
+
+    if (!pkt->_video.reference) {
+        video_skipped_frames_++;
+        delete pkt;
+        return nullptr;
+    }
+    return pkt;
+}
+
 // decode video data
+bool DiiRtmpDecoder::VideoIdle() {
+    std::unique_lock<std::mutex> vlck(v_mtx_);
+    return h264_queue_.empty() && !video_decoding_;
+}
+
 void DiiRtmpDecoder::OnNeedDecodeFrame(PlyPacket* pkt) {
     std::unique_lock<std::mutex> vlck(v_mtx_);
-    h264_queue_.push(pkt);
+    h264_queue_.push_back(pkt);
+    v_cond_.notify_one();
+}
+
+// presentation order, robust to the 32 bit timestamp wrapping
+static bool PresentedLater(const VideoFrame& a, const VideoFrame& b) {
+    return (int32_t)(a.timestamp() - b.timestamp()) > 0;
 }
 
 // Got Decoded Frame Image
 int32_t DiiRtmpDecoder::Decoded(dii_media_kit::VideoFrame& decodedImage) {
+    int32_t depth = reorder_depth_;
+    if (depth == 0 || (h264_decoder_ && h264_decoder_->ReordersOutput())) {
+        return DeliverFrame(decodedImage);
+    }
+    // decode order out of this decoder, hold back enough frames to present them in order.
+    // hardware decoders call back on their own thread.
+    VideoFrame frame;
+    {
+        std::unique_lock<std::mutex> rlck(reorder_mtx_);
+        reorder_queue_.push_back(decodedImage);
+        std::push_heap(reorder_queue_.begin(), reorder_queue_.end(), PresentedLater);
+        if (reorder_queue_.size() <= (size_t)depth) {
+            return 0;
+        }
+        std::pop_heap(reorder_queue_.begin(), reorder_queue_.end(), PresentedLater);
+        frame = reorder_queue_.back();
+        reorder_queue_.pop_back();
+    }
+    return DeliverFrame(frame);
+}
+
+int32_t DiiRtmpDecoder::DeliverFrame(dii_media_kit::VideoFrame& decodedImage) {
     render_fps_++;
+    UpdateDecodeDelay(decodedImage.timestamp());
+    if (first_video_frame_ms_ == 0) {
+        first_video_frame_ms_ = (int32_t)FFMAX(dii_rtc::TimeMillis() - start_ms_, 1);
+        DII_LOG(LS_INFO, stream_id_, DII_CODE_COMMON_INFO) << "first video frame rendered after " << first_video_frame_ms_ << " ms.";
+    }
     frame_width_ = decodedImage.width();
     frame_height_ = decodedImage.height();
     video_frame_callback_(decodedImage);
@@ -571,17 +835,58 @@ void DiiRtmpDecoder::DoStatistics(DiiPlayerStatistics& statistics) {
     statistics.cache_len_               = GetCacheTime();
     statistics.video_decode_framerate   = decode_fps_;
     statistics.video_render_framerate   = render_fps_;
+    statistics.video_decoder_           = decoder_name_;
+    statistics.video_decode_time_us_    = decode_fps_ > 0 ? (int32_t)(decode_time_us_ / decode_fps_) : 0;
     statistics.audio_samplerate_        = encoded_audio_sample_rate_;
     statistics.video_width_             = frame_width_;
     statistics.video_height_            = frame_height_;
 
     statistics.sync_ts_ = cur_sync_ts_;
+    statistics.jitter_delay_ms_         = ply_buffer_ ? ply_buffer_->PlayReadyBufferLen() : 0;
+    statistics.audio_play_speed_        = cur_audio_speed_;
+    statistics.audio_decoder_           = audio_decoder_name_;
+    {
+        int64_t decoded_us = audio_decoded_us_.exchange(0);
+        int64_t decode_time_us = audio_decode_time_us_.exchange(0);
+        statistics.audio_decode_us_per_s_ = decoded_us > 0 ? (int32_t)(decode_time_us * 1000000 / decoded_us) : 0;
+    }
+    statistics.first_video_frame_ms_    = first_video_frame_ms_;
+    statistics.first_audio_ms_          = first_audio_ms_;
+    statistics.video_reorder_depth_     = reorder_depth_;
+    statistics.sync_group_              = sync_group_;
+    statistics.sync_group_skew_ms_      = group_skew_ms_;
+    statistics.sync_group_delay_ms_     = group_delay_ms_;
+    statistics.video_decode_threads_    = decode_threads_;
+    {
+        dii_media_kit::I420BufferPool::Stats pool = dii_media_kit::I420BufferPool::GetGlobalStats();
+        int64_t requests = pool.hits + pool.misses;
+        statistics.video_pool_hit_rate_ = requests > 0 ? (int32_t)(pool.hits * 100 / requests) : 0;
+        statistics.video_pool_kb_       = (int32_t)(pool.allocated_bytes / 1024);
+        statistics.video_pool_idle_kb_  = (int32_t)(pool.pooled_bytes / 1024);
+    }
+    {
+        std::unique_lock<std::mutex> rlck(reorder_mtx_);
+        statistics.video_decode_delay_ms_ = decode_delay_ms_;
+    }
+    {
+        std::unique_lock<std::mutex> vlck(v_mtx_);
+        statistics.video_catchup_events_ = video_catchup_events_;
+        statistics.video_skipped_frames_ = video_skipped_frames_;
+        video_catchup_events_ = 0;
+        video_skipped_frames_ = 0;
+    }
+    if (ply_buffer_) {
+        ply_buffer_->GetPacingStatistics(statistics.video_pacing_p50_ms_,
+                                         statistics.video_pacing_p90_ms_,
+                                         statistics.video_pacing_p99_ms_);
+    }
     
     audio_bitrate_ = 0;
     video_bitrate_ = 0;
     
     render_fps_ = 0;
     decode_fps_ = 0;
+    decode_time_us_ = 0;
 }
 }
 
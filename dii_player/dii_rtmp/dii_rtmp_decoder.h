@@ -19,7 +19,7 @@
 #ifndef __PLAYER_DECODER_H__
 #define __PLAYER_DECODER_H__
 #include "dii_rtmp_buffer.h"
-#include "pluginaac.h"
+#include "dii_rtmp_aac_decoder.h"
 #include "dii_common.h"
 #include "dii_play_base.h"
 #include "webrtc/base/thread.h"
@@ -30,6 +30,7 @@
 #include "webrtc/modules/video_coding/codecs/h264/include/h264.h"
 #include "webrtc/api/mediastreaminterface.h"
 #include "third_party/SoundTouch/SoundTouch/SoundTouch.h"
+#include <deque>
 
 extern "C" {
     #include "libavutil/avstring.h"
@@ -65,17 +66,33 @@ namespace dii_media_kit {
 
     class DiiRtmpDecoder : PlyBufferCallback, public DecodedImageCallback {
          friend class PlySyncMultiStream;
+         friend class DiiRtmpTraceReplay;
     public:
         DiiRtmpDecoder(int32_t stream_id, bool report);
         virtual ~DiiRtmpDecoder();
         void Start(bool report);
         void Shutdown();
         void SetVideoFrameCallback(VideoFrameCallback callback);
+        // ffmpeg decoding threads, 0 picks them by resolution. frame threading is faster
+        // but delays frames, the buffer releases them earlier. applies to decoders created afterwards.
+        static void SetDecodeThreads(int32_t threads, bool frame_threads);
+        // aac backend, applies to decoders started afterwards
+        static void SetAudioDecoder(DiiAudioDecoderType type);
+        void SetPlayoutDelay(int32_t delay_ms);
         bool IsPlaying();
         int32_t  GetCacheTime();
+        // media time being played, 0 until audio plays
+        int64_t PlayingTs();
 
-        void CacheAvcData(const uint8_t*pdata, int len, uint32_t ts);
-        void CacheAacData(const uint8_t*pdata, int len, uint32_t ts, uint64_t sync_ts);
+        // |ts| + |cts| is the presentation time, frames with b-slices are decoded and reordered.
+        // |frame| is h264 or h265 by |info.codec|, despite the name. |info| comes from the puller,
+        // the payload is not parsed again.
+        void CacheAvcData(const dii_rtc::scoped_refptr<PlyBuffer>& frame, uint32_t ts, int32_t cts,
+                          const PlyVideoInfo& info);
+        // |frame| is one raw aac frame, decoded with the config of the last SetAacConfig
+        void CacheAacData(const dii_rtc::scoped_refptr<PlyBuffer>& frame, uint32_t ts, uint64_t sync_ts);
+        // AudioSpecificConfig of the stream, the aac decoder is reopened when it changes
+        void SetAacConfig(const uint8_t* config, int len);
         int GetMorePcmData(void *audioSamples, size_t samplesPerSec, size_t nChannels, uint64_t &sync_ts);
         void ClearCache();
         void DoStatistics(DiiPlayerStatistics& statistics);
@@ -83,11 +100,23 @@ namespace dii_media_kit {
         void OnNeedDecodeFrame(PlyPacket* pkt) override;
         int32_t Decoded(dii_media_kit::VideoFrame& decodedImage) override;
     private:
+        // renders a frame that is next in presentation order
+        int32_t DeliverFrame(dii_media_kit::VideoFrame& decodedImage);
         void VideoDecodeThread();
+        // nothing released to the video decode thread is left undecoded
+        bool VideoIdle();
+        // drops frames that can no longer be shown on time, called with v_mtx_ held
+        PlyPacket* SkipLateVideo(PlyPacket* pkt);
+        bool CreateVideoDecoder(const uint8_t* data, int32_t len, VideoCodecType codec);
+        int32_t DecodeThreads(int32_t width, int32_t height);
+        // time from Decode to render of the frame with |timestamp|, steers the buffer
+        void UpdateDecodeDelay(uint32_t timestamp);
         void AudioDecodeThread();
-        void InitAACDecoder(uint8_t*data, int32_t len);
+        void InitAACDecoder();
+        // decoded pcm format changed, pcm of the old format still waiting is dropped
+        void SetAudioFormat(int32_t sample_rate, int32_t channels);
         void InitSoundTouch(uint16_t sample_rate, uint8_t channel_count);
-        void DoSoundtouch(uint8_t*data, int32_t len);
+        void DoSoundtouch(const int16_t* pcm, int32_t frames);
         void ChunkAndCacheAudioData(uint32_t pts, uint64_t sync_ts );
     private:
         int32_t stream_id_ = -1;
@@ -96,23 +125,78 @@ namespace dii_media_kit {
         std::mutex v_mtx_;
         std::condition_variable         v_cond_;
         
-        std::queue<PlyPacket*>          h264_queue_;
-        dii_media_kit::VideoDecoder*  h264_decoder_;
+        std::deque<PlyPacket*>          h264_queue_;
+        // a frame taken off h264_queue_ is being decoded, set under v_mtx_
+        std::atomic<bool>               video_decoding_{false};
+        dii_media_kit::H264Decoder*   h264_decoder_;
+        const char*                   decoder_name_ = nullptr;
+        // codec h264_decoder_ was created for, it is recreated on a switch
+        VideoCodecType                decoder_codec_ = kVideoCodecH264;
+        static std::atomic<int32_t>   decode_threads_default_;
+        static std::atomic<bool>      frame_threads_default_;
+        int32_t                       decode_threads_ = 0;
+        // timestamp and time each frame went into the decoder, guarded by reorder_mtx_
+        std::deque<std::pair<uint32_t, int64_t>> decode_submits_;
+        int32_t                       decode_delay_ms_ = 0;
+        int64_t                       decode_time_us_ = 0;
+        bool                          video_catching_up_ = false;
+        int32_t                       video_catchup_events_ = 0;
+        int32_t                       video_skipped_frames_ = 0;
+        // b-frames: frames presented after a later decoded one, learned from the composition time
+        std::atomic<int32_t>          reorder_depth_{0};
+        std::deque<int64_t>           recent_pts_;
+        // decoded frames waiting for their turn, a min-heap on the timestamp
+        std::mutex                    reorder_mtx_;
+        std::vector<dii_media_kit::VideoFrame> reorder_queue_;
         
         // audio decode thread
         std::thread* a_decode_thread_ = nullptr;
         std::mutex a_mtx_;
         std::condition_variable     a_cond_;
-        std::queue<PlyPacket*>      aac_queue_;
+        // frames waiting for the audio thread, a fixed ring so queueing allocates nothing
+        struct AacFrame {
+            dii_rtc::scoped_refptr<PlyBuffer> data;
+            uint32_t pts = 0;
+            uint64_t sync_ts = 0;
+        };
+        // one queued frame through aac, soundtouch and into the buffer, audio thread only
+        void DecodeAacFrame(const AacFrame& frame);
+
+        std::vector<AacFrame>       aac_queue_;
+        size_t                      aac_queue_head_ = 0;
+        size_t                      aac_queue_count_ = 0;
+        // frames queued or being decoded, 0 once all audio handed in is in the buffer
+        std::atomic<int32_t>        audio_pending_{0};
+        // AudioSpecificConfig, guarded by a_mtx_. the generation moves on when it changes
+        std::vector<uint8_t>        aac_config_;
+        int32_t                     aac_config_gen_ = 0;
         
         
         bool			        running_;
-        DiiRtmpBuffer*		ply_buffer_;
+        DiiRtmpBuffer*		ply_buffer_ = nullptr;
+        // set from the audio device thread, handed to every new buffer
+        std::atomic<int32_t>    playout_delay_ms_{0};
+        // written by PlySyncMultiStream, the delay survives a restart of the buffer
+        std::atomic<int32_t>    sync_group_{0};
+        std::atomic<int32_t>    group_delay_ms_{0};
+        std::atomic<int32_t>    group_skew_ms_{0};
+        // open speed, ms from Start to the first frame rendered / first audio played
+        int64_t                 start_ms_ = 0;
+        int32_t                 first_video_frame_ms_ = 0;
+        int32_t                 first_audio_ms_ = 0;
         
         int32_t                 video_frame_observer_uid_;
 
         // audio
-        aac_dec_t		aac_decoder_;
+        static std::atomic<int32_t> audio_decoder_default_;
+        DiiAudioDecoderType     audio_decoder_type_ = DII_AUDIO_DECODER_AUTO;
+        DiiRtmpAacDecoder*      aac_decoder_ = nullptr;
+        const char*             audio_decoder_name_ = nullptr;
+        // config the decoder was opened with, audio thread only
+        std::vector<uint8_t>    decoder_config_;
+        int32_t                 decoder_config_gen_ = 0;
+        std::atomic<int64_t>    audio_decode_time_us_{0};
+        std::atomic<int64_t>    audio_decoded_us_{0};
         uint8_t			audio_cache_[8192] = {0};
         int				a_cache_len_ = 0;
         uint32_t		encoded_audio_sample_rate_ = 0;
@@ -129,8 +213,16 @@ namespace dii_media_kit {
         int32_t    decode_fps_ = 0;
         int32_t    render_fps_ = 0;
 
+        // playout format asked for by the audio callback, pcm is converted to it once after decoding
+        std::atomic<int32_t> out_sample_rate_{0};
+        std::atomic<int32_t> out_channels_{0};
+        dii_media_kit::acm2::ACMResampler audio_resampler_;
+        int16_t         resample_buf_[3840];
+        int16_t         remix_buf_[3840];
+        std::vector<uint8_t> soundtouch_buf_;
+
+        // time-stretch tempo currently applied by soundtouch
         float cur_audio_speed_ = 1.0;
-        float pre_audio_speed_ = 1.0;
         int32_t decoder_index_ = 0;
         bool        got_keyframe_ = false;
         VideoFrameCallback video_frame_callback_ = nullptr;
@@ -139,7 +231,6 @@ namespace dii_media_kit {
         
         // soundtouch
         dii_soundtouch::SoundTouch *sound_touch_ = nullptr;
-        int32_t current_audio_play_speed_ = 1;
         dii_radar::DiiRole _role;
         char * _userId;
         bool _report;
@@ -0,0 +1,115 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#include "dii_rtmp_delay_manager.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#define DELAY_WINDOW_MS             10000      // jitter history considered
+#define DELAY_MAX_SAMPLES           1024       // > 10 s of aac frames at 48 kHz
+#define DELAY_PERCENTILE            95
+#define DELAY_MARGIN_MS             100        // headroom above the measured jitter
+#define DELAY_MIN_TARGET_MS         200
+#define DELAY_MAX_TARGET_MS         5000
+#define DELAY_INITIAL_TARGET_MS     300        // same start-up buffer as before
+#define DELAY_DECREASE_STEP_MS      2          // per packet, roughly 100 ms per second
+#define DELAY_RESET_JUMP_MS         10000      // timestamp discontinuity, start over
+
+#define RATE_DEADBAND_MS            60
+#define RATE_MAX_ACCELERATE         1.25f
+#define RATE_MAX_DECELERATE         0.9f
+#define RATE_FULL_SCALE_MS          2000       // error at which the max rate is reached
+
+DiiRtmpDelayManager::DiiRtmpDelayManager()
+    : target_delay_ms_(DELAY_INITIAL_TARGET_MS) {
+    samples_.resize(DELAY_MAX_SAMPLES);
+    scratch_.reserve(DELAY_MAX_SAMPLES);
+}
+
+void DiiRtmpDelayManager::Reset() {
+    head_ = 0;
+    count_ = 0;
+    first_ = true;
+}
+
+void DiiRtmpDelayManager::Update(uint32_t pts, int64_t arrival_ms) {
+    if (first_) {
+        first_ = false;
+        first_arrival_ms_ = arrival_ms;
+        first_pts_ = pts;
+    }
+
+    // how much later than its timestamp says this packet showed up
+    int64_t delay_ms = (arrival_ms - first_arrival_ms_) - (int64_t)(int32_t)(pts - first_pts_);
+    if (std::abs(delay_ms) > DELAY_RESET_JUMP_MS) {
+        Reset();
+        first_ = false;
+        first_arrival_ms_ = arrival_ms;
+        first_pts_ = pts;
+        delay_ms = 0;
+    }
+
+    // drop what fell out of the window, then record
+    while (count_ > 0 && samples_[head_].arrival_ms < arrival_ms - DELAY_WINDOW_MS) {
+        head_ = (head_ + 1) % DELAY_MAX_SAMPLES;
+        count_--;
+    }
+    if (count_ == DELAY_MAX_SAMPLES) {
+        head_ = (head_ + 1) % DELAY_MAX_SAMPLES;
+        count_--;
+    }
+    Sample& sample = samples_[(head_ + count_) % DELAY_MAX_SAMPLES];
+    sample.arrival_ms = arrival_ms;
+    sample.delay_ms = (int32_t)delay_ms;
+    count_++;
+
+    // jitter is the spread above the fastest packet in the window
+    scratch_.clear();
+    int32_t min_delay = sample.delay_ms;
+    for (size_t i = 0; i < count_; i++) {
+        int32_t d = samples_[(head_ + i) % DELAY_MAX_SAMPLES].delay_ms;
+        scratch_.push_back(d);
+        min_delay = std::min(min_delay, d);
+    }
+    size_t idx = (scratch_.size() - 1) * DELAY_PERCENTILE / 100;
+    std::nth_element(scratch_.begin(), scratch_.begin() + idx, scratch_.end());
+    int32_t wanted = scratch_[idx] - min_delay + DELAY_MARGIN_MS;
+    wanted = std::max(DELAY_MIN_TARGET_MS, std::min(DELAY_MAX_TARGET_MS, wanted));
+
+    int32_t target = target_delay_ms_;
+    if (wanted >= target) {
+        target = wanted;
+    } else {
+        target = std::max(wanted, target - DELAY_DECREASE_STEP_MS);
+    }
+    target_delay_ms_ = target;
+}
+
+float DiiRtmpDelayManager::PlaybackRate(int32_t cache_ms, int32_t extra_ms) const {
+    int32_t error = cache_ms - (target_delay_ms_ + extra_ms);
+    if (std::abs(error) <= RATE_DEADBAND_MS) {
+        return 1.0f;
+    }
+    float scale = (float)(std::abs(error) - RATE_DEADBAND_MS) / RATE_FULL_SCALE_MS;
+    scale = std::min(scale, 1.0f);
+    if (error > 0) {
+        return 1.0f + (RATE_MAX_ACCELERATE - 1.0f) * scale;
+    }
+    return 1.0f - (1.0f - RATE_MAX_DECELERATE) * scale;
+}
@@ -0,0 +1,59 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#ifndef __DII_RTMP_DELAY_MANAGER_H__
+#define __DII_RTMP_DELAY_MANAGER_H__
+
+#include <atomic>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+// Picks the playout buffer length from the arrival jitter of the stream, in
+// the spirit of NetEQ's DelayManager. Every packet's delay relative to the
+// fastest packet of the last few seconds is recorded; the target is a high
+// percentile of that plus a small margin. It follows bursts up at once and
+// comes back down slowly once the network calms, so latency recovers.
+class DiiRtmpDelayManager {
+public:
+    DiiRtmpDelayManager();
+
+    // called on the network thread for every audio packet
+    void Update(uint32_t pts, int64_t arrival_ms);
+    void Reset();
+    int32_t TargetDelayMs() const { return target_delay_ms_; }
+    // playback rate that steers |cache_ms| toward the target plus |extra_ms|, 1.0 when close enough
+    float PlaybackRate(int32_t cache_ms, int32_t extra_ms = 0) const;
+
+private:
+    struct Sample {
+        int64_t arrival_ms;
+        int32_t delay_ms;
+    };
+    std::vector<Sample>     samples_;
+    size_t                  head_ = 0;
+    size_t                  count_ = 0;
+    std::vector<int32_t>    scratch_;
+
+    bool                    first_ = true;
+    int64_t                 first_arrival_ms_ = 0;
+    uint32_t                first_pts_ = 0;
+    std::atomic<int32_t>    target_delay_ms_;
+};
+
+#endif	// __DII_RTMP_DELAY_MANAGER_H__
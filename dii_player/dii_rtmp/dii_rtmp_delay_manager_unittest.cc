@@ -0,0 +1,137 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#include "dii_rtmp_delay_manager.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+const int kFrameMs = 20;
+
+// packets at the pace of their timestamps from |pts| up to |end_pts|,
+// arriving |late_ms| after it
+void Steady(DiiRtmpDelayManager& manager, uint32_t& pts, uint32_t end_pts, int64_t late_ms = 0) {
+    for (; pts < end_pts; pts += kFrameMs) {
+        manager.Update(pts, pts + late_ms);
+    }
+}
+
+}  // namespace
+
+TEST(DiiRtmpDelayManagerTest, SteadyStreamDecaysToTheMinimum) {
+    DiiRtmpDelayManager manager;
+    EXPECT_EQ(300, manager.TargetDelayMs());
+    uint32_t pts = 0;
+    // 2 ms per packet
+    Steady(manager, pts, 10 * kFrameMs);
+    EXPECT_EQ(280, manager.TargetDelayMs());
+    Steady(manager, pts, 2000);
+    EXPECT_EQ(200, manager.TargetDelayMs());
+}
+
+TEST(DiiRtmpDelayManagerTest, TargetRisesAtOnceAndDecaysSlowly) {
+    DiiRtmpDelayManager manager;
+    uint32_t pts = 0;
+    Steady(manager, pts, 5000);
+    ASSERT_EQ(200, manager.TargetDelayMs());
+
+    // an 800 ms hole, what is due in it comes in one burst at its end
+    for (; pts < 5800; pts += kFrameMs) {
+        manager.Update(pts, 5800);
+    }
+    int32_t burst_target = manager.TargetDelayMs();
+    EXPECT_GE(burst_target, 500);
+    EXPECT_LE(burst_target, 800 + 100);
+
+    // held while the burst is in the 10 s of history, then 2 ms per packet
+    int32_t last = burst_target;
+    bool decayed = false;
+    for (; pts < 5800 + 10000; pts += kFrameMs) {
+        manager.Update(pts, pts);
+        EXPECT_GE(manager.TargetDelayMs(), last - 2);
+        EXPECT_LE(manager.TargetDelayMs(), burst_target);
+        last = manager.TargetDelayMs();
+    }
+    EXPECT_GT(last, 200);
+    for (; pts < 5800 + 20000; pts += kFrameMs) {
+        manager.Update(pts, pts);
+        EXPECT_GE(manager.TargetDelayMs(), last - 2);
+        decayed |= manager.TargetDelayMs() < last;
+        last = manager.TargetDelayMs();
+    }
+    EXPECT_TRUE(decayed);
+    EXPECT_EQ(200, last);
+}
+
+TEST(DiiRtmpDelayManagerTest, DelayStepIsHeldWhileInTheWindow) {
+    DiiRtmpDelayManager manager;
+    uint32_t pts = 0;
+    Steady(manager, pts, 3000);
+    // every packet 1 s late from here on, the spread stays the same
+    Steady(manager, pts, 6000, 1000);
+    int32_t target = manager.TargetDelayMs();
+    EXPECT_GE(target, 1000);
+    // once the fast packets are out of the window the target comes down
+    Steady(manager, pts, 30000, 1000);
+    EXPECT_EQ(200, manager.TargetDelayMs());
+}
+
+TEST(DiiRtmpDelayManagerTest, TimestampJumpStartsOver) {
+    DiiRtmpDelayManager manager;
+    uint32_t pts = 0;
+    Steady(manager, pts, 3000);
+    ASSERT_EQ(200, manager.TargetDelayMs());
+    // a new stream 60 s further on, arriving right after the last packet
+    int64_t arrival = pts;
+    for (pts += 60000; pts < 63000 + 60000; pts += kFrameMs, arrival += kFrameMs) {
+        manager.Update(pts, arrival);
+        EXPECT_EQ(200, manager.TargetDelayMs());
+    }
+}
+
+TEST(DiiRtmpDelayManagerTest, RateDeadband) {
+    DiiRtmpDelayManager manager;
+    const int32_t target = manager.TargetDelayMs();
+    EXPECT_FLOAT_EQ(1.0f, manager.PlaybackRate(target));
+    EXPECT_FLOAT_EQ(1.0f, manager.PlaybackRate(target + 60));
+    EXPECT_FLOAT_EQ(1.0f, manager.PlaybackRate(target - 60));
+    EXPECT_GT(manager.PlaybackRate(target + 61), 1.0f);
+    EXPECT_LT(manager.PlaybackRate(target - 61), 1.0f);
+
+    // |extra_ms| moves the point steered to
+    EXPECT_FLOAT_EQ(1.0f, manager.PlaybackRate(target + 500, 500));
+    EXPECT_LT(manager.PlaybackRate(target, 500), 1.0f);
+}
+
+TEST(DiiRtmpDelayManagerTest, RateIsProportionalAndBounded) {
+    DiiRtmpDelayManager manager;
+    const int32_t target = manager.TargetDelayMs();
+    // the full rate 2 s outside the deadband
+    EXPECT_FLOAT_EQ(1.125f, manager.PlaybackRate(target + 60 + 1000));
+    EXPECT_FLOAT_EQ(1.25f, manager.PlaybackRate(target + 60 + 2000));
+    EXPECT_FLOAT_EQ(1.25f, manager.PlaybackRate(target + 10000));
+    EXPECT_FLOAT_EQ(0.95f, manager.PlaybackRate(0, 1060 - target));
+    EXPECT_FLOAT_EQ(0.9f, manager.PlaybackRate(0, 5000));
+
+    float last = 0.0f;
+    for (int32_t cache = 0; cache < 5000; cache += 10) {
+        float rate = manager.PlaybackRate(cache);
+        EXPECT_GE(rate, last);
+        last = rate;
+    }
+}
@@ -0,0 +1,98 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#include "dii_rtmp_flv_reader.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define FLV_HEADER_SIZE             9
+#define FLV_TAG_HEADER_SIZE         11
+
+static uint32_t ReadBE24(const char* p) {
+    const uint8_t* u = (const uint8_t*)p;
+    return (u[0] << 16) | (u[1] << 8) | u[2];
+}
+
+static uint32_t ReadBE32(const char* p) {
+    const uint8_t* u = (const uint8_t*)p;
+    return ((uint32_t)u[0] << 24) | (u[1] << 16) | (u[2] << 8) | u[3];
+}
+
+void DiiFlvTagReader::Append(const char* data, int len) {
+    // drop what was read once it is half the buffer, the rest moves once
+    if (pos_ > 0 && pos_ * 2 >= buffer_.size()) {
+        buffer_.erase(buffer_.begin(), buffer_.begin() + pos_);
+        pos_ = 0;
+    }
+    buffer_.insert(buffer_.end(), data, data + len);
+}
+
+int32_t DiiFlvTagReader::ReadTag(char& type, uint32_t& timestamp, char*& data, int& size) {
+    if (!got_header_) {
+        size_t avail = buffer_.size() - pos_;
+        if (avail < FLV_HEADER_SIZE) {
+            return 0;
+        }
+        const char* p = buffer_.data() + pos_;
+        if (memcmp(p, "FLV", 3) != 0) {
+            return -1;
+        }
+        uint32_t offset = ReadBE32(p + 5);
+        if (offset < FLV_HEADER_SIZE || offset > 1024) {
+            return -1;
+        }
+        // the header and PreviousTagSize0
+        if (avail < offset + 4) {
+            return 0;
+        }
+        pos_ += offset + 4;
+        got_header_ = true;
+    }
+    for (;;) {
+        size_t avail = buffer_.size() - pos_;
+        if (avail < FLV_TAG_HEADER_SIZE) {
+            return 0;
+        }
+        const char* p = buffer_.data() + pos_;
+        uint32_t tag_size = ReadBE24(p + 1);
+        // the body and the PreviousTagSize after it, which isn't checked, muxers get it wrong
+        if (avail < FLV_TAG_HEADER_SIZE + tag_size + 4) {
+            return 0;
+        }
+        pos_ += FLV_TAG_HEADER_SIZE + tag_size + 4;
+        char tag_type = p[0] & 0x1f;
+        bool encrypted = (p[0] & 0x20) != 0;
+        if (encrypted || tag_size == 0 ||
+            (tag_type != FLV_TAG_AUDIO && tag_type != FLV_TAG_VIDEO && tag_type != FLV_TAG_SCRIPT)) {
+            continue;
+        }
+        type = tag_type;
+        timestamp = ReadBE24(p + 4) | ((uint32_t)(uint8_t)p[7] << 24);
+        size = (int)tag_size;
+        data = (char*)malloc(tag_size);
+        memcpy(data, p + FLV_TAG_HEADER_SIZE, tag_size);
+        return 1;
+    }
+}
+
+void DiiFlvTagReader::Reset() {
+    buffer_.clear();
+    pos_ = 0;
+    got_header_ = false;
+}
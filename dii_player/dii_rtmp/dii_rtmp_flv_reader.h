@@ -0,0 +1,46 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#ifndef __DII_RTMP_FLV_READER_H__
+#define __DII_RTMP_FLV_READER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#define FLV_TAG_AUDIO               8
+#define FLV_TAG_VIDEO               9
+#define FLV_TAG_SCRIPT              18
+
+// Splits an flv byte stream into tags as bytes come in, from any offset.
+class DiiFlvTagReader {
+public:
+    void Append(const char* data, int len);
+    // 1 with the next audio, video or script tag body in malloc'd |data| the caller
+    // frees, 0 until more bytes come in, < 0 when the stream isn't flv
+    int32_t ReadTag(char& type, uint32_t& timestamp, char*& data, int& size);
+    bool GotHeader() const { return got_header_; }
+    void Reset();
+
+private:
+    std::vector<char>   buffer_;
+    size_t              pos_ = 0;
+    bool                got_header_ = false;
+};
+
+#endif	// __DII_RTMP_FLV_READER_H__
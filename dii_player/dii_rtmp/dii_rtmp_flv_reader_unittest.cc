@@ -0,0 +1,212 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#include "dii_rtmp_flv_reader.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+#include <stdlib.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Tag {
+    char        type;
+    uint32_t    timestamp;
+    std::string data;
+};
+
+std::string FlvHeader(uint32_t offset = 9) {
+    std::string header("FLV\x01\x05", 5);
+    header += (char)(offset >> 24);
+    header += (char)(offset >> 16);
+    header += (char)(offset >> 8);
+    header += (char)offset;
+    header.append(offset - 9, '\0');
+    // PreviousTagSize0
+    header.append(4, '\0');
+    return header;
+}
+
+std::string FlvTag(uint8_t type, uint32_t timestamp, const std::string& body) {
+    std::string tag;
+    tag += (char)type;
+    tag += (char)(body.size() >> 16);
+    tag += (char)(body.size() >> 8);
+    tag += (char)body.size();
+    tag += (char)(timestamp >> 16);
+    tag += (char)(timestamp >> 8);
+    tag += (char)timestamp;
+    tag += (char)(timestamp >> 24);
+    tag.append(3, '\0');
+    tag += body;
+    uint32_t previous = (uint32_t)(11 + body.size());
+    tag += (char)(previous >> 24);
+    tag += (char)(previous >> 16);
+    tag += (char)(previous >> 8);
+    tag += (char)previous;
+    return tag;
+}
+
+// reads until the reader wants more bytes, the result of the last call
+int32_t ReadTags(DiiFlvTagReader& reader, std::vector<Tag>& tags) {
+    for (;;) {
+        char type = 0;
+        uint32_t timestamp = 0;
+        char* data = nullptr;
+        int size = 0;
+        int32_t ret = reader.ReadTag(type, timestamp, data, size);
+        if (ret <= 0) {
+            return ret;
+        }
+        Tag tag = {type, timestamp, std::string(data, size)};
+        tags.push_back(tag);
+        free(data);
+    }
+}
+
+}  // namespace
+
+TEST(DiiFlvTagReaderTest, ReadsTagsSplitAnywhere) {
+    const std::string body(300, 'v');
+    std::string flv = FlvHeader();
+    flv += FlvTag(FLV_TAG_SCRIPT, 0, "onMetaData");
+    flv += FlvTag(FLV_TAG_AUDIO, 23, "\xaf\x01" "aac");
+    // the extended byte is the high 8 bits
+    flv += FlvTag(FLV_TAG_VIDEO, 0x12345678, body);
+
+    for (size_t step : {(size_t)1, (size_t)2, (size_t)7, (size_t)11, (size_t)64, flv.size()}) {
+        DiiFlvTagReader reader;
+        std::vector<Tag> tags;
+        for (size_t pos = 0; pos < flv.size(); pos += step) {
+            EXPECT_EQ(0, ReadTags(reader, tags));
+            reader.Append(flv.data() + pos, (int)std::min(step, flv.size() - pos));
+        }
+        EXPECT_EQ(0, ReadTags(reader, tags));
+        EXPECT_TRUE(reader.GotHeader());
+        ASSERT_EQ(3u, tags.size()) << "step " << step;
+        EXPECT_EQ(FLV_TAG_SCRIPT, tags[0].type);
+        EXPECT_EQ("onMetaData", tags[0].data);
+        EXPECT_EQ(FLV_TAG_AUDIO, tags[1].type);
+        EXPECT_EQ(23u, tags[1].timestamp);
+        EXPECT_EQ(std::string("\xaf\x01" "aac"), tags[1].data);
+        EXPECT_EQ(FLV_TAG_VIDEO, tags[2].type);
+        EXPECT_EQ(0x12345678u, tags[2].timestamp);
+        EXPECT_EQ(body, tags[2].data);
+    }
+}
+
+TEST(DiiFlvTagReaderTest, SkipsTagsItDoesNotPlay) {
+    std::string flv = FlvHeader();
+    flv += FlvTag(15, 0, "unknown");
+    // the filter bit
+    flv += FlvTag(0x20 | FLV_TAG_VIDEO, 40, "encrypted");
+    flv += FlvTag(FLV_TAG_AUDIO, 40, "");
+    flv += FlvTag(FLV_TAG_AUDIO, 46, "played");
+
+    DiiFlvTagReader reader;
+    reader.Append(flv.data(), (int)flv.size());
+    std::vector<Tag> tags;
+    EXPECT_EQ(0, ReadTags(reader, tags));
+    ASSERT_EQ(1u, tags.size());
+    EXPECT_EQ(46u, tags[0].timestamp);
+    EXPECT_EQ("played", tags[0].data);
+}
+
+TEST(DiiFlvTagReaderTest, WaitsForTheWholeHeader) {
+    std::string flv = FlvHeader(13);
+    flv += FlvTag(FLV_TAG_AUDIO, 0, "a");
+    DiiFlvTagReader reader;
+    std::vector<Tag> tags;
+    // the 9 bytes, then the 4 extra header bytes and PreviousTagSize0
+    reader.Append(flv.data(), 9);
+    EXPECT_EQ(0, ReadTags(reader, tags));
+    EXPECT_FALSE(reader.GotHeader());
+    reader.Append(flv.data() + 9, 7);
+    EXPECT_EQ(0, ReadTags(reader, tags));
+    EXPECT_FALSE(reader.GotHeader());
+    reader.Append(flv.data() + 16, (int)flv.size() - 16);
+    EXPECT_EQ(0, ReadTags(reader, tags));
+    EXPECT_TRUE(reader.GotHeader());
+    ASSERT_EQ(1u, tags.size());
+    EXPECT_EQ("a", tags[0].data);
+}
+
+TEST(DiiFlvTagReaderTest, RejectsBadHeaders) {
+    std::vector<std::string> bad;
+    bad.push_back("FLX\x01\x05\0\0\0\x09\0\0\0\0");
+    bad.back().resize(13);
+    // a data offset inside the header
+    bad.push_back(FlvHeader());
+    bad.back()[8] = 8;
+    // and one past anything sane
+    bad.push_back(FlvHeader());
+    bad.back()[7] = 0x04;
+    bad.back()[8] = 0x01;
+    // an rtmp handshake, not flv
+    bad.push_back(std::string("\x03\0\0\0\0\0\0\0\0\0\0\0\0", 13));
+
+    for (const std::string& data : bad) {
+        DiiFlvTagReader reader;
+        reader.Append(data.data(), (int)data.size());
+        std::vector<Tag> tags;
+        EXPECT_GT(0, ReadTags(reader, tags));
+        EXPECT_FALSE(reader.GotHeader());
+        EXPECT_TRUE(tags.empty());
+    }
+}
+
+TEST(DiiFlvTagReaderTest, ResetWantsANewHeader) {
+    std::string flv = FlvHeader() + FlvTag(FLV_TAG_AUDIO, 0, "a");
+    DiiFlvTagReader reader;
+    reader.Append(flv.data(), (int)flv.size());
+    std::vector<Tag> tags;
+    EXPECT_EQ(0, ReadTags(reader, tags));
+    ASSERT_TRUE(reader.GotHeader());
+
+    reader.Reset();
+    EXPECT_FALSE(reader.GotHeader());
+    std::string tag = FlvTag(FLV_TAG_AUDIO, 23, "b");
+    reader.Append(tag.data(), (int)tag.size());
+    EXPECT_GT(0, ReadTags(reader, tags));
+
+    reader.Reset();
+    reader.Append(flv.data(), (int)flv.size());
+    EXPECT_EQ(0, ReadTags(reader, tags));
+    EXPECT_EQ(2u, tags.size());
+}
+
+TEST(DiiFlvTagReaderTest, LongStreamReadAsItComes) {
+    std::string header = FlvHeader();
+    DiiFlvTagReader reader;
+    reader.Append(header.data(), (int)header.size());
+    std::vector<Tag> tags;
+    // bodies of 1 to 500 bytes, every tag appended in two halves
+    for (uint32_t i = 0; i < 2000; i++) {
+        std::string tag = FlvTag(FLV_TAG_VIDEO, i * 40, std::string(i % 500 + 1, (char)i));
+        size_t half = tag.size() / 2;
+        reader.Append(tag.data(), (int)half);
+        ASSERT_EQ(0, ReadTags(reader, tags));
+        reader.Append(tag.data() + half, (int)(tag.size() - half));
+        ASSERT_EQ(0, ReadTags(reader, tags));
+        ASSERT_EQ(i + 1, tags.size());
+        EXPECT_EQ(i * 40, tags.back().timestamp);
+        EXPECT_EQ(std::string(i % 500 + 1, (char)i), tags.back().data);
+    }
+}
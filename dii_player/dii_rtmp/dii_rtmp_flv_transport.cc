@@ -0,0 +1,524 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#include "dii_rtmp_flv_transport.h"
+#include "dii_rtmp_connection.h"
+#include "dii_media_utils.h"
+#include "webrtc/base/bind.h"
+#include "webrtc/base/logging.h"
+#include "webrtc/base/socketaddress.h"
+#include "webrtc/base/timeutils.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#define DII_MSG_CHECK_TIMEOUT       1000
+#define HTTP_READ_TIME_OUT          10000  //ms
+#define HTTP_RECV_BUFFER_SIZE       (64 * 1024)
+#define HTTP_MAX_READS_PER_EVENT    4
+#define HTTP_MAX_HEADER_SIZE        (16 * 1024)
+#define HTTP_MAX_REDIRECTS          5
+
+#define FLV_FILE_READ_SIZE          (64 * 1024)
+// a gap longer than this in a file's timestamps is skipped instead of waited out
+#define FLV_FILE_MAX_WAIT           3000    // ms
+// between the last tag of a pass and the first of the next one
+#define FLV_FILE_LOOP_GAP           40      // ms
+
+// only the io thread reads, one buffer serves every http-flv connection
+static char recv_buffer[HTTP_RECV_BUFFER_SIZE];
+
+DiiHttpFlvConnection::DiiHttpFlvConnection(int32_t stream_id, DiiTransportCallback& callback)
+    : stream_id_(stream_id)
+    , callback_(callback) {
+    io_thread_ = DiiRtmpConnection::IoThread();
+}
+
+DiiHttpFlvConnection::~DiiHttpFlvConnection() {
+    Close();
+}
+
+int32_t DiiHttpFlvConnection::Open(const std::string& url) {
+    return io_thread_->Invoke<int32_t>(RTC_FROM_HERE, dii_rtc::Bind(&DiiHttpFlvConnection::DoOpen, this, url));
+}
+
+void DiiHttpFlvConnection::Close() {
+    io_thread_->Invoke<void>(RTC_FROM_HERE, dii_rtc::Bind(&DiiHttpFlvConnection::DoClose, this));
+}
+
+int32_t DiiHttpFlvConnection::DoOpen(const std::string& url) {
+    DoClose();
+    redirects_ = 0;
+    open_ms_ = dii_rtc::TimeMillis();
+    connect_ms_ = setup_ms_ = 0;
+    return Connect(url);
+}
+
+int32_t DiiHttpFlvConnection::Connect(const std::string& url) {
+    // http://host[:port][/path[?query]]
+    const std::string scheme = "http://";
+    if (url.compare(0, scheme.size(), scheme) != 0) {
+        DII_LOG(LS_ERROR, stream_id_, 2002003) << "http-flv connection: only http is supported, url: " << url;
+        return -1;
+    }
+    size_t host_end = url.find_first_of("/?", scheme.size());
+    std::string authority = url.substr(scheme.size(), host_end == std::string::npos ? std::string::npos
+                                                                                     : host_end - scheme.size());
+    std::string path = host_end == std::string::npos ? "/" : url.substr(host_end);
+    if (path[0] == '?') {
+        path = "/" + path;
+    }
+    int port = 80;
+    std::string host = authority;
+    size_t colon = authority.rfind(':');
+    if (colon != std::string::npos && authority.find(']', colon) == std::string::npos) {
+        host = authority.substr(0, colon);
+        port = atoi(authority.c_str() + colon + 1);
+    }
+    if (host.empty() || port <= 0 || port > 65535) {
+        DII_LOG(LS_ERROR, stream_id_, 2002003) << "http-flv connection: invalid url: " << url;
+        return -1;
+    }
+    host_ = authority;
+
+    socket_ = io_thread_->socketserver()->CreateAsyncSocket(AF_INET, SOCK_STREAM);
+    if (!socket_) {
+        return -1;
+    }
+    socket_->SignalConnectEvent.connect(this, &DiiHttpFlvConnection::OnConnectEvent);
+    socket_->SignalReadEvent.connect(this, &DiiHttpFlvConnection::OnReadEvent);
+    socket_->SignalWriteEvent.connect(this, &DiiHttpFlvConnection::OnWriteEvent);
+    socket_->SignalCloseEvent.connect(this, &DiiHttpFlvConnection::OnCloseEvent);
+    socket_->SetOption(dii_rtc::Socket::OPT_NODELAY, 1);
+
+    // an unresolved host name is resolved asynchronously by the socket
+    if (socket_->Connect(dii_rtc::SocketAddress(host, port)) != 0) {
+        DII_LOG(LS_ERROR, stream_id_, 2002003) << "http-flv connection: connect failed, error: " << socket_->GetError();
+        CloseSocket();
+        return -1;
+    }
+    request_ = "GET " + path + " HTTP/1.1\r\n"
+               "Host: " + host_ + "\r\n"
+               "User-Agent: DiiPlayer\r\n"
+               "Accept: */*\r\n"
+               "Connection: close\r\n"
+               "\r\n";
+    request_sent_ = 0;
+    last_recv_ms_ = dii_rtc::TimeMillis();
+    io_thread_->Clear(this, DII_MSG_CHECK_TIMEOUT);
+    io_thread_->PostDelayed(RTC_FROM_HERE, 1000, this, DII_MSG_CHECK_TIMEOUT);
+    return 0;
+}
+
+void DiiHttpFlvConnection::CloseSocket() {
+    if (socket_) {
+        socket_->SignalConnectEvent.disconnect(this);
+        socket_->SignalReadEvent.disconnect(this);
+        socket_->SignalWriteEvent.disconnect(this);
+        socket_->SignalCloseEvent.disconnect(this);
+        socket_->Close();
+        // we may be inside one of its events, delete it once that returns
+        io_thread_->Dispose(socket_);
+        socket_ = nullptr;
+    }
+    connected_ = false;
+    header_.clear();
+    got_header_ = false;
+    chunked_ = false;
+    chunk_state_ = CHUNK_SIZE;
+    chunk_line_.clear();
+    chunk_left_ = 0;
+    reader_.Reset();
+}
+
+void DiiHttpFlvConnection::DoClose() {
+    io_thread_->Clear(this);
+    CloseSocket();
+    playing_ = false;
+}
+
+void DiiHttpFlvConnection::Fail(int32_t eventid, const char* errmsg) {
+    DoClose();
+    callback_.OnTransportFailed(eventid, errmsg);
+}
+
+bool DiiHttpFlvConnection::Flush() {
+    while (request_sent_ < request_.size()) {
+        int sent = socket_->Send(request_.data() + request_sent_, request_.size() - request_sent_);
+        if (sent <= 0) {
+            if (socket_->IsBlocking()) {
+                // resumed by SignalWriteEvent
+                return true;
+            }
+            Fail(2002003, "http-flv connection send failed");
+            return false;
+        }
+        request_sent_ += sent;
+    }
+    return true;
+}
+
+bool DiiHttpFlvConnection::HandleData(const char* data, int len) {
+    if (got_header_) {
+        return chunked_ ? HandleChunked(data, len) : HandleBody(data, len);
+    }
+    size_t scanned = header_.size() >= 3 ? header_.size() - 3 : 0;
+    header_.append(data, len);
+    size_t end = header_.find("\r\n\r\n", scanned);
+    if (end == std::string::npos) {
+        if (header_.size() > HTTP_MAX_HEADER_SIZE) {
+            Fail(2002005, "http-flv response header too large");
+            return false;
+        }
+        return true;
+    }
+    // whatever follows the header is the start of the body
+    std::string body = header_.substr(end + 4);
+    header_.resize(end + 2);
+    int32_t ret = ParseHeader();
+    if (ret != 0) {
+        return false;
+    }
+    got_header_ = true;
+    if (body.empty()) {
+        return true;
+    }
+    return chunked_ ? HandleChunked(body.data(), (int)body.size()) : HandleBody(body.data(), (int)body.size());
+}
+
+int32_t DiiHttpFlvConnection::ParseHeader() {
+    // HTTP/1.1 200 OK\r\n then name: value\r\n lines
+    int status = 0;
+    if (sscanf(header_.c_str(), "HTTP/%*d.%*d %d", &status) != 1) {
+        Fail(2002005, "http-flv response is not http");
+        return -1;
+    }
+    std::string location;
+    size_t pos = header_.find("\r\n") + 2;
+    while (pos < header_.size()) {
+        size_t eol = header_.find("\r\n", pos);
+        std::string line = header_.substr(pos, eol - pos);
+        pos = eol + 2;
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) {
+            continue;
+        }
+        std::string name = line.substr(0, colon);
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        size_t value_start = line.find_first_not_of(" \t", colon + 1);
+        std::string value = value_start == std::string::npos ? "" : line.substr(value_start);
+        if (name == "transfer-encoding") {
+            std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+            chunked_ = value.find("chunked") != std::string::npos;
+        } else if (name == "location") {
+            location = value;
+        }
+    }
+
+    if (status >= 300 && status < 400 && !location.empty()) {
+        if (++redirects_ > HTTP_MAX_REDIRECTS) {
+            Fail(2002005, "http-flv too many redirects");
+            return -1;
+        }
+        if (location[0] == '/') {
+            location = "http://" + host_ + location;
+        }
+        DII_LOG(LS_INFO, stream_id_, DII_CODE_COMMON_INFO) << "http-flv connection: " << status
+            << " redirect to " << location;
+        CloseSocket();
+        if (Connect(location) != 0) {
+            Fail(2002003, "http-flv redirect failed");
+        }
+        return 1;
+    }
+    if (status != 200) {
+        DII_LOG(LS_ERROR, stream_id_, 2002005) << "http-flv connection: http status " << status;
+        Fail(2002005, "http-flv request failed");
+        return -1;
+    }
+    return 0;
+}
+
+bool DiiHttpFlvConnection::HandleChunked(const char* data, int len) {
+    const char* end = data + len;
+    while (data < end) {
+        switch (chunk_state_) {
+            case CHUNK_SIZE: {
+                // hex size, maybe ;extensions, then crlf
+                const char* eol = (const char*)memchr(data, '\n', end - data);
+                chunk_line_.append(data, eol ? eol - data : end - data);
+                if (chunk_line_.size() > 64) {
+                    Fail(2002006, "http-flv bad chunk");
+                    return false;
+                }
+                if (!eol) {
+                    return true;
+                }
+                data = eol + 1;
+                char* parsed = nullptr;
+                chunk_left_ = strtoul(chunk_line_.c_str(), &parsed, 16);
+                if (parsed == chunk_line_.c_str()) {
+                    Fail(2002006, "http-flv bad chunk");
+                    return false;
+                }
+                chunk_line_.clear();
+                if (chunk_left_ == 0) {
+                    // the last chunk, a live stream ended
+                    Fail(2002006, "http-flv stream ended");
+                    return false;
+                }
+                chunk_state_ = CHUNK_DATA;
+                break;
+            }
+            case CHUNK_DATA: {
+                size_t n = std::min(chunk_left_, (size_t)(end - data));
+                if (!HandleBody(data, (int)n)) {
+                    return false;
+                }
+                data += n;
+                chunk_left_ -= n;
+                if (chunk_left_ == 0) {
+                    chunk_state_ = CHUNK_DATA_END;
+                }
+                break;
+            }
+            case CHUNK_DATA_END: {
+                // the crlf after the data
+                const char* eol = (const char*)memchr(data, '\n', end - data);
+                if (!eol) {
+                    return true;
+                }
+                data = eol + 1;
+                chunk_state_ = CHUNK_SIZE;
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+bool DiiHttpFlvConnection::HandleBody(const char* data, int len) {
+    reader_.Append(data, len);
+    for (;;) {
+        char type = 0;
+        uint32_t timestamp = 0;
+        char* tag = nullptr;
+        int size = 0;
+        int32_t ret = reader_.ReadTag(type, timestamp, tag, size);
+        if (ret < 0) {
+            Fail(2002005, "http-flv response is not flv");
+            return false;
+        }
+        if (!playing_ && reader_.GotHeader()) {
+            playing_ = true;
+            setup_ms_ = (int32_t)(dii_rtc::TimeMillis() - connected_ms_);
+            callback_.OnTransportPlaying();
+        }
+        if (ret == 0) {
+            return true;
+        }
+        if (!callback_.OnTransportPacket(type, timestamp, tag, size)) {
+            DoClose();
+            return false;
+        }
+    }
+}
+
+void DiiHttpFlvConnection::OnConnectEvent(dii_rtc::AsyncSocket* socket) {
+    if (connected_) {
+        return;
+    }
+    connected_ = true;
+    // a redirect keeps the time of the first connect
+    if (connect_ms_ == 0) {
+        connected_ms_ = dii_rtc::TimeMillis();
+        connect_ms_ = (int32_t)(connected_ms_ - open_ms_);
+    }
+    Flush();
+}
+
+void DiiHttpFlvConnection::OnReadEvent(dii_rtc::AsyncSocket* socket) {
+    for (int i = 0; i < HTTP_MAX_READS_PER_EVENT; i++) {
+        int len = socket_->Recv(recv_buffer, sizeof(recv_buffer), nullptr);
+        if (len <= 0) {
+            // the socket signals close on its own after eof
+            if (!socket_->IsBlocking()) {
+                Fail(playing_ ? 2002006 : 2002003, "http-flv connection read failed");
+            }
+            return;
+        }
+        last_recv_ms_ = dii_rtc::TimeMillis();
+        dii_rtc::AsyncSocket* current = socket_;
+        if (!HandleData(recv_buffer, len) || socket_ != current) {
+            // failed, closed or redirected to a new socket
+            return;
+        }
+    }
+}
+
+void DiiHttpFlvConnection::OnWriteEvent(dii_rtc::AsyncSocket* socket) {
+    // a connect that completes at once reports writable instead of connected
+    if (!connected_) {
+        OnConnectEvent(socket);
+        return;
+    }
+    Flush();
+}
+
+void DiiHttpFlvConnection::OnCloseEvent(dii_rtc::AsyncSocket* socket, int err) {
+    DII_LOG(LS_WARNING, stream_id_, DII_CODE_COMMON_WARN) << "http-flv connection closed, error: " << err;
+    Fail(playing_ ? 2002006 : (got_header_ ? 2002005 : 2002003), "http-flv connection closed");
+}
+
+void DiiHttpFlvConnection::OnMessage(dii_rtc::Message* msg) {
+    switch (msg->message_id) {
+        case DII_MSG_CHECK_TIMEOUT: {
+            if (!socket_) {
+                break;
+            }
+            if (dii_rtc::TimeMillis() - last_recv_ms_ > HTTP_READ_TIME_OUT) {
+                Fail(playing_ ? 2002006 : 2002003, "http-flv read time out");
+                break;
+            }
+            io_thread_->PostDelayed(RTC_FROM_HERE, 1000, this, DII_MSG_CHECK_TIMEOUT);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+DiiFlvFileTransport::DiiFlvFileTransport(int32_t stream_id, DiiTransportCallback& callback)
+    : stream_id_(stream_id)
+    , callback_(callback)
+    , wakeup_event_(false, false) {
+}
+
+DiiFlvFileTransport::~DiiFlvFileTransport() {
+    Close();
+}
+
+int32_t DiiFlvFileTransport::Open(const std::string& url) {
+    Close();
+    const std::string scheme = DII_FLV_FILE_SCHEME;
+    path_ = url.compare(0, scheme.size(), scheme) == 0 ? url.substr(scheme.size()) : url;
+    file_ = fopen(path_.c_str(), "rb");
+    if (!file_) {
+        DII_LOG(LS_ERROR, stream_id_, 2002003) << "flv file transport: can't open " << path_;
+        return -1;
+    }
+    reader_.Reset();
+    open_ms_ = dii_rtc::TimeMillis();
+    setup_ms_ = 0;
+    anchor_ms_ = -1;
+    ts_offset_ = 0;
+    last_ts_ = 0;
+    processing_ = true;
+    dii_rtc::Thread::Start();
+    return 0;
+}
+
+void DiiFlvFileTransport::Close() {
+    if (processing_) {
+        processing_ = false;
+        wakeup_event_.Set();
+        dii_rtc::Thread::Stop();
+    }
+    if (file_) {
+        fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+bool DiiFlvFileTransport::WaitUntilDue(uint32_t timestamp) {
+    int64_t now = dii_rtc::TimeMillis();
+    int64_t wait = anchor_ms_ < 0 ? 0 : anchor_ms_ + (int32_t)(timestamp - anchor_ts_) - now;
+    if (anchor_ms_ < 0 || wait > FLV_FILE_MAX_WAIT || wait < -FLV_FILE_MAX_WAIT) {
+        // the first tag, or a jump in the file's timestamps: pace from here
+        anchor_ts_ = timestamp;
+        anchor_ms_ = now;
+        return processing_;
+    }
+    while (processing_ && wait > 0) {
+        wakeup_event_.Wait((int)wait);
+        wait = anchor_ms_ + (int32_t)(timestamp - anchor_ts_) - dii_rtc::TimeMillis();
+    }
+    return processing_;
+}
+
+void DiiFlvFileTransport::Run() {
+    std::vector<char> chunk(FLV_FILE_READ_SIZE);
+    bool pass_start = true;
+    bool playing = false;
+    while (processing_) {
+        size_t len = fread(chunk.data(), 1, chunk.size(), file_);
+        if (len == 0) {
+            if (ferror(file_)) {
+                callback_.OnTransportFailed(2002006, "flv file read failed");
+                return;
+            }
+            if (pass_start) {
+                // a pass without a single tag would spin
+                callback_.OnTransportFailed(2002006, "flv file has no media");
+                return;
+            }
+            // end of the file, start over with the timestamps running on
+            DII_LOG(LS_INFO, stream_id_, DII_CODE_COMMON_INFO) << "flv file transport: looping " << path_;
+            rewind(file_);
+            reader_.Reset();
+            pass_start = true;
+            continue;
+        }
+        reader_.Append(chunk.data(), (int)len);
+        for (;;) {
+            char type = 0;
+            uint32_t timestamp = 0;
+            char* data = nullptr;
+            int size = 0;
+            int32_t ret = reader_.ReadTag(type, timestamp, data, size);
+            if (ret < 0) {
+                callback_.OnTransportFailed(2002006, "flv file is not flv");
+                return;
+            }
+            if (!playing && reader_.GotHeader()) {
+                playing = true;
+                setup_ms_ = (int32_t)(dii_rtc::TimeMillis() - open_ms_);
+                callback_.OnTransportPlaying();
+            }
+            if (ret == 0) {
+                break;
+            }
+            if (pass_start) {
+                pass_start = false;
+                if (last_ts_ > 0) {
+                    ts_offset_ = last_ts_ + FLV_FILE_LOOP_GAP - timestamp;
+                }
+            }
+            timestamp += ts_offset_;
+            last_ts_ = std::max(last_ts_, timestamp);
+            if (!WaitUntilDue(timestamp)) {
+                free(data);
+                return;
+            }
+            if (!callback_.OnTransportPacket(type, timestamp, data, size)) {
+                return;
+            }
+        }
+    }
+}
@@ -0,0 +1,146 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#ifndef __DII_RTMP_FLV_TRANSPORT_H__
+#define __DII_RTMP_FLV_TRANSPORT_H__
+
+#include "dii_rtmp_flv_reader.h"
+#include "dii_rtmp_transport.h"
+#include "webrtc/base/asyncsocket.h"
+#include "webrtc/base/event.h"
+#include "webrtc/base/messagehandler.h"
+#include "webrtc/base/sigslot.h"
+#include "webrtc/base/thread.h"
+
+#include <atomic>
+#include <stdio.h>
+#include <string>
+
+// a local flv file played out as a live stream, e.g. flvfile:///data/test.flv
+#define DII_FLV_FILE_SCHEME     "flvfile://"
+
+// http-flv: a GET whose response body, plain or chunked, is the flv stream.
+// Lives on the shared rtmp io thread like DiiRtmpConnection, follows
+// redirects to other http urls. No https, such urls stay with ffplay.
+class DiiHttpFlvConnection : public DiiRtmpTransport,
+                             public sigslot::has_slots<>,
+                             public dii_rtc::MessageHandler {
+public:
+    DiiHttpFlvConnection(int32_t stream_id, DiiTransportCallback& callback);
+    virtual ~DiiHttpFlvConnection();
+    int32_t Open(const std::string& url) override;
+    void Close() override;
+    void GetTimings(int32_t& connect_ms, int32_t& setup_ms) override { connect_ms = connect_ms_; setup_ms = setup_ms_; }
+    const char* Name() const override { return "http-flv"; }
+
+    //* For MessageHandler
+    virtual void OnMessage(dii_rtc::Message* msg) override;
+
+private:
+    int32_t DoOpen(const std::string& url);
+    void DoClose();
+    // opens the socket and queues the request, also for a redirect
+    int32_t Connect(const std::string& url);
+    void CloseSocket();
+    void Fail(int32_t eventid, const char* errmsg);
+    bool Flush();
+    // response bytes in order: header, then the (chunked) body
+    bool HandleData(const char* data, int len);
+    // < 0 failed, 0 body follows, 1 redirected
+    int32_t ParseHeader();
+    bool HandleChunked(const char* data, int len);
+    bool HandleBody(const char* data, int len);
+
+    void OnConnectEvent(dii_rtc::AsyncSocket* socket);
+    void OnReadEvent(dii_rtc::AsyncSocket* socket);
+    void OnWriteEvent(dii_rtc::AsyncSocket* socket);
+    void OnCloseEvent(dii_rtc::AsyncSocket* socket, int err);
+
+private:
+    enum ChunkState {
+        CHUNK_SIZE,
+        CHUNK_DATA,
+        CHUNK_DATA_END,
+    };
+
+    int32_t stream_id_ = -1;
+    DiiTransportCallback&       callback_;
+    dii_rtc::Thread*            io_thread_ = nullptr;
+    dii_rtc::AsyncSocket*       socket_ = nullptr;
+    std::string                 host_;
+    std::string                 request_;
+    size_t                      request_sent_ = 0;
+    int32_t                     redirects_ = 0;
+    bool                        connected_ = false;
+    // response
+    std::string                 header_;
+    bool                        got_header_ = false;
+    bool                        chunked_ = false;
+    ChunkState                  chunk_state_ = CHUNK_SIZE;
+    std::string                 chunk_line_;
+    size_t                      chunk_left_ = 0;
+    DiiFlvTagReader             reader_;
+    bool                        playing_ = false;
+    int64_t                     last_recv_ms_ = 0;
+    int64_t                     open_ms_ = 0;
+    int64_t                     connected_ms_ = 0;
+    int32_t                     connect_ms_ = 0;
+    int32_t                     setup_ms_ = 0;
+};
+
+// Plays a local flv file out at the pace of its timestamps and starts over at
+// the end with timestamps running on, so the pipeline sees an endless live
+// stream. For trying out the buffering and catch-up offline.
+class DiiFlvFileTransport : public DiiRtmpTransport,
+                            public dii_rtc::Thread {
+public:
+    DiiFlvFileTransport(int32_t stream_id, DiiTransportCallback& callback);
+    virtual ~DiiFlvFileTransport();
+    // |url| is DII_FLV_FILE_SCHEME followed by the path
+    int32_t Open(const std::string& url) override;
+    void Close() override;
+    void GetTimings(int32_t& connect_ms, int32_t& setup_ms) override { connect_ms = 0; setup_ms = setup_ms_; }
+    const char* Name() const override { return "flv-file"; }
+
+protected:
+    //* For Thread
+    virtual void Run() override;
+
+private:
+    // false when closed before the tag is due
+    bool WaitUntilDue(uint32_t timestamp);
+
+private:
+    int32_t stream_id_ = -1;
+    DiiTransportCallback&       callback_;
+    std::string                 path_;
+    FILE*                       file_ = nullptr;
+    std::atomic<bool>           processing_{false};
+    dii_rtc::Event              wakeup_event_;
+    DiiFlvTagReader             reader_;
+    int64_t                     open_ms_ = 0;
+    int32_t                     setup_ms_ = 0;
+    // pacing, tag timestamps as sent
+    uint32_t                    anchor_ts_ = 0;
+    int64_t                     anchor_ms_ = -1;
+    // added to the file's timestamps, grows with every pass
+    uint32_t                    ts_offset_ = 0;
+    uint32_t                    last_ts_ = 0;
+};
+
+#endif	// __DII_RTMP_FLV_TRANSPORT_H__
@@ -0,0 +1,153 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#include "dii_rtmp_packet_pool.h"
+#include "webrtc/base/atomicops.h"
+#include "webrtc/base/refcountedobject.h"
+
+#include <string.h>
+
+#define POOL_MIN_BUCKET_SHIFT       12                  // 4KB, small audio / P frames
+#define POOL_MAX_BUCKET_SHIFT       25                  // 32MB, same cap as DEMUX_DATA_MAX_SIZE
+#define POOL_BUCKET_FREE_BYTES      (4 * 1024 * 1024)   // idle memory kept per bucket
+#define POOL_BUCKET_MIN_FREE        4
+// H264 decoders read up to EncodedImage::kBufferPaddingBytesH264 past the end
+#define POOL_BUFFER_PADDING         8
+
+PlyBuffer::PlyBuffer(int capacity, int bucket)
+    : capacity_(capacity)
+    , bucket_(bucket) {
+    data_ = new uint8_t[capacity + POOL_BUFFER_PADDING];
+}
+
+PlyBuffer::~PlyBuffer() {
+    delete[] data_;
+}
+
+int PlyBuffer::AddRef() const {
+    return dii_rtc::AtomicOps::Increment(&ref_count_);
+}
+
+int PlyBuffer::Release() const {
+    int count = dii_rtc::AtomicOps::Decrement(&ref_count_);
+    if (!count) {
+        PlyPacketPool* pool = pool_;
+        pool_ = nullptr;
+        if (pool) {
+            pool->Recycle(const_cast<PlyBuffer*>(this));
+            pool->Release();
+        } else {
+            delete this;
+        }
+    }
+    return count;
+}
+
+int PlyBuffer::append(const void* pdata, int len) {
+    if (len <= 0 || size_ + len > capacity_)
+        return 0;
+    memcpy(data_ + size_, pdata, len);
+    size_ += len;
+    if (pool_) {
+        pool_->bytes_copied_ += len;
+    }
+    return len;
+}
+
+std::atomic<bool> PlyPacketPool::recycle_(true);
+
+void PlyPacketPool::SetRecycle(bool recycle) {
+    recycle_ = recycle;
+}
+
+dii_rtc::scoped_refptr<PlyPacketPool> PlyPacketPool::Create() {
+    return new dii_rtc::RefCountedObject<PlyPacketPool>();
+}
+
+PlyPacketPool::PlyPacketPool()
+    : free_buffers_(POOL_MAX_BUCKET_SHIFT - POOL_MIN_BUCKET_SHIFT + 1)
+    , bytes_copied_(0)
+    , allocations_(0)
+    , packets_(0) {
+}
+
+PlyPacketPool::~PlyPacketPool() {
+    for (auto& bucket : free_buffers_) {
+        for (auto buffer : bucket) {
+            delete buffer;
+        }
+    }
+}
+
+dii_rtc::scoped_refptr<PlyBuffer> PlyPacketPool::Get(int size) {
+    packets_++;
+
+    int bucket = 0;
+    while (bucket + POOL_MIN_BUCKET_SHIFT <= POOL_MAX_BUCKET_SHIFT &&
+           (1 << (bucket + POOL_MIN_BUCKET_SHIFT)) < size + POOL_BUFFER_PADDING) {
+        bucket++;
+    }
+
+    PlyBuffer* buffer = nullptr;
+    if (bucket + POOL_MIN_BUCKET_SHIFT > POOL_MAX_BUCKET_SHIFT) {
+        // too large to keep around, freed on release
+        allocations_++;
+        buffer = new PlyBuffer(size, -1);
+        return buffer;
+    }
+
+    if (recycle_) {
+        dii_rtc::CritScope cs(&crit_);
+        if (!free_buffers_[bucket].empty()) {
+            buffer = free_buffers_[bucket].back();
+            free_buffers_[bucket].pop_back();
+        }
+    }
+    if (!buffer) {
+        allocations_++;
+        buffer = new PlyBuffer((1 << (bucket + POOL_MIN_BUCKET_SHIFT)) - POOL_BUFFER_PADDING, bucket);
+    }
+
+    // each outstanding buffer keeps the pool alive
+    AddRef();
+    buffer->pool_ = this;
+    buffer->reset();
+    return buffer;
+}
+
+void PlyPacketPool::Recycle(PlyBuffer* buffer) {
+    if (buffer->bucket_ >= 0 && recycle_) {
+        int32_t max_free = POOL_BUCKET_FREE_BYTES >> (buffer->bucket_ + POOL_MIN_BUCKET_SHIFT);
+        if (max_free < POOL_BUCKET_MIN_FREE)
+            max_free = POOL_BUCKET_MIN_FREE;
+
+        dii_rtc::CritScope cs(&crit_);
+        std::vector<PlyBuffer*>& bucket = free_buffers_[buffer->bucket_];
+        if ((int32_t)bucket.size() < max_free) {
+            bucket.push_back(buffer);
+            return;
+        }
+    }
+    delete buffer;
+}
+
+void PlyPacketPool::GetStatistics(int64_t& bytes_copied, int32_t& allocations, int32_t& packets) {
+    bytes_copied = bytes_copied_.exchange(0);
+    allocations = allocations_.exchange(0);
+    packets = packets_.exchange(0);
+}
@@ -0,0 +1,95 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#ifndef __DII_RTMP_PACKET_POOL_H__
+#define __DII_RTMP_PACKET_POOL_H__
+
+#include "webrtc/base/criticalsection.h"
+#include "webrtc/base/refcount.h"
+#include "webrtc/base/scoped_ref_ptr.h"
+
+#include <atomic>
+#include <vector>
+#include <stdint.h>
+
+class PlyPacketPool;
+
+// Ref-counted packet payload. The demuxer writes into it once and every later
+// stage (decoder cache, sync buffer, decoder input) only holds a reference.
+// On the last Release the buffer goes back to the pool it came from.
+class PlyBuffer {
+public:
+    int AddRef() const;
+    int Release() const;
+
+    uint8_t* data() const { return data_; }
+    int size() const { return size_; }
+    // usable bytes, the decoder padding lives behind this
+    int capacity() const { return capacity_; }
+    int append(const void* pdata, int len);
+    void reset() { size_ = 0; }
+
+private:
+    friend class PlyPacketPool;
+    PlyBuffer(int capacity, int bucket);
+    ~PlyBuffer();
+
+    uint8_t*                data_ = nullptr;
+    int                     size_ = 0;
+    int                     capacity_ = 0;
+    int                     bucket_ = 0;
+    mutable volatile int    ref_count_ = 0;
+    mutable PlyPacketPool*  pool_ = nullptr;
+};
+
+// Power-of-two buckets of PlyBuffer, a steady stream allocates nothing once
+// the buckets it needs are warm.
+class PlyPacketPool : public dii_rtc::RefCountInterface {
+public:
+    static dii_rtc::scoped_refptr<PlyPacketPool> Create();
+    // off: every Get allocates and every release frees, the way packets were
+    // handled before the pool. For benchmarks, on by default
+    static void SetRecycle(bool recycle);
+
+    // buffer with at least |size| usable bytes, empty
+    dii_rtc::scoped_refptr<PlyBuffer> Get(int size);
+    // counters since the previous call
+    void GetStatistics(int64_t& bytes_copied, int32_t& allocations, int32_t& packets);
+    // for copies and allocations made outside the pool, e.g. by srs_librtmp
+    void CountAllocation() { allocations_++; }
+    void CountCopy(int bytes) { bytes_copied_ += bytes; }
+
+protected:
+    PlyPacketPool();
+    ~PlyPacketPool() override;
+
+private:
+    friend class PlyBuffer;
+    void Recycle(PlyBuffer* buffer);
+
+    static std::atomic<bool>            recycle_;
+
+    dii_rtc::CriticalSection            crit_;
+    std::vector<std::vector<PlyBuffer*>> free_buffers_;
+
+    std::atomic<int64_t>    bytes_copied_;
+    std::atomic<int32_t>    allocations_;
+    std::atomic<int32_t>    packets_;
+};
+
+#endif	// __DII_RTMP_PACKET_POOL_H__
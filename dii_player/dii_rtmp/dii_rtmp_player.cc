@@ -18,13 +18,10 @@
 */
 #include "dii_rtmp_player.h"
 #include "dii_audio_manager.h"
-#include "srs_librtmp.h"
 #include "dii_media_utils.h"
 #include "webrtc/base/logging.h"
 #include "webrtc/media/base/videoframe.h"
 
-#define DII_MSG_REPULL      1000
-
 namespace dii_media_kit {
 DiiRtmplayer::DiiRtmplayer(int32_t stream_id) {
     this->stream_id_ = stream_id;
@@ -32,24 +29,11 @@ DiiRtmplayer::DiiRtmplayer(int32_t stream_id) {
     _role = dii_radar::_Role_Unknown;
     _userid = NULL;
     _report = true;
-    
-    av_decoder_ = new DiiRtmpDecoder(stream_id, _report);
-    rtmp_puller_ = new DiiRtmpPuller(stream_id, *this, _report);
-    dii_rtc::Thread::Start();
 }
 
 DiiRtmplayer::~DiiRtmplayer(void)
 {
-    dii_rtc::Thread::Clear(this, DII_MSG_REPULL);
-    dii_rtc::Thread::Stop();
-    if (rtmp_puller_) {
-        delete rtmp_puller_;
-        rtmp_puller_ = NULL;
-    }
-    if (av_decoder_) {
-        delete av_decoder_;
-        av_decoder_ = NULL;
-    }
+    StopPlay();
     
     if(_userid){
         free(_userid);
@@ -57,21 +41,6 @@ DiiRtmplayer::~DiiRtmplayer(void)
     }
 }
 
-void DiiRtmplayer::OnMessage(dii_rtc::Message* msg) {
-    switch (msg->message_id) {
-        case DII_MSG_REPULL: {
-            std::unique_lock<std::mutex> lck(mtx_);
-            if (running_ && rtmp_puller_) {
-                rtmp_puller_->Shutdown();
-                rtmp_puller_->StartPull(url_, _report);
-            }
-            break;
-        } default: {
-            break;
-        }
-    }
-}
-
 int32_t DiiRtmplayer::Start(const char* url, int64_t pos, bool pause) {
     std::unique_lock<std::mutex> lck(mtx_);
     DII_LOG(LS_INFO, stream_id_, 2002001) << "DiiRtmplayer Start play rtmp url: " << url << ", stream id:" << stream_id_;
@@ -79,9 +48,9 @@ int32_t DiiRtmplayer::Start(const char* url, int64_t pos, bool pause) {
         return 0;
     running_ = true;
     url_ = url;
+    previous_sync_ts_ = 0;
 
-    this->av_decoder_->Start(_report);
-    this->rtmp_puller_->StartPull(url_, _report);
+    std::atomic_store(&source_, DiiRtmpSource::Attach(url_, stream_id_, this));
     return 0;
 }
 int32_t DiiRtmplayer::StopPlay() {
@@ -91,80 +60,105 @@ int32_t DiiRtmplayer::StopPlay() {
     DII_LOG(LS_INFO, stream_id_, 2002002) << "DiiRtmplayer Stop play rtmp, stream id: " << stream_id_;
     
     running_ = false;
-    if (rtmp_puller_) {
-        rtmp_puller_->Shutdown();
-    }
+    std::shared_ptr<DiiRtmpSource> source = std::atomic_exchange(&source_, std::shared_ptr<DiiRtmpSource>());
+    // the group goes with the player, a source other players keep plays on free running
+    source->SetSyncGroup(this, 0);
+    DiiRtmpSource::Detach(source, this);
 
-    if (av_decoder_) {
-        av_decoder_->Shutdown();
+    if (callback_.state_callback_) {
+        callback_.state_callback_(DII_STATE_STOPPED, 0, "stop");
     }
-    callback_.state_callback_(DII_STATE_STOPPED, 0, "stop");
     return 0;
 }
 
 int32_t DiiRtmplayer::GetMoreAudioData(void *stream, size_t sample_rate, size_t channel) {
-    if (av_decoder_) {
+    std::shared_ptr<DiiRtmpSource> source = std::atomic_load(&source_);
+    if (source) {
         uint64_t sync_ts = 0;
-        int ret = av_decoder_->GetMorePcmData(stream, sample_rate, channel, sync_ts);
+        int ret = source->GetMorePcmData(this, stream, sample_rate, channel, sync_ts);
         if( sync_ts > 0) {
             if(sync_ts != previous_sync_ts_) {
                 previous_sync_ts_ = sync_ts;
                 callback_.rtmp_sync_time_callback_(sync_ts);
             }
         }
-        
-        if(ret > 0) {
-              if(need_callback_) {
-                  callback_.state_callback_(DII_STATE_PLAYING, 0, "playing");
-                  need_callback_ = false;
-              }
-        }
-        
         return ret;
     }
     return 0;
 }
 
-int32_t DiiRtmplayer::SetCallback(DiiMediaBaseCallback callback) {
-    callback_ = callback;
-    av_decoder_->SetVideoFrameCallback(callback_.video_frame_callback_);
-    return 0;
+void DiiRtmplayer::SetPlayoutDelay(int32_t delay_ms) {
+    std::shared_ptr<DiiRtmpSource> source = std::atomic_load(&source_);
+    if (source) {
+        source->SetPlayoutDelay(this, delay_ms);
+    }
+}
+
+int32_t DiiRtmplayer::Pause() {
+    std::shared_ptr<DiiRtmpSource> source = std::atomic_load(&source_);
+    return source ? source->Pause() : DII_ERROR;
+}
+
+int32_t DiiRtmplayer::Resume() {
+    std::shared_ptr<DiiRtmpSource> source = std::atomic_load(&source_);
+    return source ? source->Resume() : DII_ERROR;
+}
+
+int32_t DiiRtmplayer::Seek(int64_t pos) {
+    std::shared_ptr<DiiRtmpSource> source = std::atomic_load(&source_);
+    return source ? source->Seek(pos) : DII_ERROR;
+}
+
+int64_t DiiRtmplayer::Position() {
+    std::shared_ptr<DiiRtmpSource> source = std::atomic_load(&source_);
+    return source ? source->Position() : 0;
+}
+
+int64_t DiiRtmplayer::Duration() {
+    std::shared_ptr<DiiRtmpSource> source = std::atomic_load(&source_);
+    return source ? source->Duration() : 0;
+}
+
+int32_t DiiRtmplayer::StartRecord(const char* path, DiiRecordFormat format) {
+    std::shared_ptr<DiiRtmpSource> source = std::atomic_load(&source_);
+    return source ? source->StartRecord(this, path, format) : DII_ERROR;
 }
 
-void DiiRtmplayer::OnPullVideoData(const uint8_t*pdata, int len, uint32_t ts) {
-	if (av_decoder_) {
-        av_decoder_->CacheAvcData(pdata, len, ts);
-	}
+int32_t DiiRtmplayer::StopRecord() {
+    std::shared_ptr<DiiRtmpSource> source = std::atomic_load(&source_);
+    return source ? source->StopRecord(this) : DII_ERROR;
 }
 
-void DiiRtmplayer::OnPullAudioData(const uint8_t*pdata, int len, uint32_t ts, uint64_t sync_ts) {
-	if (av_decoder_) {
-        av_decoder_->CacheAacData(pdata, len, ts, sync_ts);
-	}
+int32_t DiiRtmplayer::SetSyncGroup(int32_t group_id) {
+    std::shared_ptr<DiiRtmpSource> source = std::atomic_load(&source_);
+    if (!source) {
+        return DII_ERROR;
+    }
+    source->SetSyncGroup(this, group_id);
+    return DII_DONE;
+}
+
+int32_t DiiRtmplayer::SetCallback(DiiMediaBaseCallback callback) {
+    callback_ = callback;
+    return 0;
 }
     
 void DiiRtmplayer::DoStatistics(DiiPlayerStatistics& statistics) {
-    if (av_decoder_) {
-        av_decoder_->DoStatistics(statistics);
+    std::shared_ptr<DiiRtmpSource> source = std::atomic_load(&source_);
+    if (source) {
+        source->DoStatistics(this, statistics);
     }
 }
 
-void DiiRtmplayer::OnServerConnected() {
-   // DII_LOG(LS_INFO, stream_id_, 2002000) << "rtmp server connected ok, url: " << url_;
-    //callback_.state_callback_(DII_STATE_PLAYING, 0, "playing");
+void DiiRtmplayer::OnSourceState(int state, int code, const char* msg) {
+    if (callback_.state_callback_) {
+        callback_.state_callback_(state, code, msg);
+    }
 }
 
-void DiiRtmplayer::OnPullFailed(int32_t errCode,int32_t eventid,const char * errmsg) {
-    if(running_) {
-        need_callback_ = true;
-
-        dii_rtc::Thread::PostDelayed(RTC_FROM_HERE, 1000, this, DII_MSG_REPULL);
-        retry_cnt_++;  
-		DII_LOG(LS_ERROR, stream_id_, eventid) << "rtmp repull url:" << url_ << errmsg << " ,err code:" << errCode;
-        if(retry_cnt_%3 != 0) {
-            return;
-        }
-        callback_.state_callback_(DII_STATE_ERROR, errCode, "rtmp pull failed");//error
+void DiiRtmplayer::OnSourceVideoFrame(dii_media_kit::VideoFrame& frame) {
+    if (callback_.video_frame_callback_) {
+        callback_.video_frame_callback_(frame);
     }
 }
 } // namespace dii_media_kit
@@ -22,55 +22,53 @@
 #include "dii_play_base.h"
 #include "dii_common.h"
 #include "dii_media_utils.h"
-#include "dii_rtmp_puller.h"
-#include "dii_rtmp_decoder.h"
+#include "dii_rtmp_source.h"
 
-#include "webrtc/base/messagehandler.h"
 #include "webrtc/api/mediastreaminterface.h"
 
+#include <memory>
+
 namespace dii_media_kit {
 class DiiRtmplayer :  public DiiPlayBase,
-                        public DiiPullerCallback,
-                        public dii_rtc::Thread,
-                        public dii_rtc::MessageHandler {
+                        public DiiRtmpSourceSink {
 public:
 	DiiRtmplayer(int32_t stream_id);
 	~DiiRtmplayer(void);
 	int32_t Start(const char* url, int64_t pos = 0, bool pause = false) override;
     int32_t StopPlay() override;
     int32_t SetLoop(bool loop) override {return 0;};
+    int32_t SetLoopCacheSize(int64_t max_bytes) override {return 0;};
     int32_t GetMoreAudioData(void *stream, size_t sample_rate, size_t channel) override;
+    void SetPlayoutDelay(int32_t delay_ms) override;
     int32_t SetCallback(DiiMediaBaseCallback callback) override;
     void DoStatistics(DiiPlayerStatistics& statistics) override;
     
-    int32_t Pause() override {return 0;};
-    int32_t Resume() override {return 0;};
-    int32_t Seek(int64_t pos) override {return 0;};
-    int64_t Position() override {return 0;};
-    int64_t Duration() override {return 0;};
+    // pause and seek inside the timeshift window, DII_ERROR without timeshift
+    int32_t Pause() override;
+    int32_t Resume() override;
+    int32_t Seek(int64_t pos) override;
+    int64_t Position() override;
+    int64_t Duration() override;
+
+    // remuxes the pulled packets, also while paused in the timeshift window
+    int32_t StartRecord(const char* path, DiiRecordFormat format) override;
+    int32_t StopRecord() override;
+    int32_t SetSyncGroup(int32_t group_id) override;
                         
 protected:
-	void OnServerConnected() override;
-    void OnPullFailed(int32_t errCode, int32_t eventid, const char * errmsg) override;
-	void OnPullVideoData(const uint8_t*pdata, int len, uint32_t ts) override;
-	void OnPullAudioData(const uint8_t*pdata, int len, uint32_t ts, uint64_t sync_ts) override;
-private:
-    //* For MessageHandler
-    virtual void OnMessage(dii_rtc::Message* msg) override;
+    void OnSourceState(int state, int code, const char* msg) override;
+    void OnSourceVideoFrame(dii_media_kit::VideoFrame& frame) override;
 private:
     std::mutex mtx_;
     bool running_ = false;
     int32_t stream_id_  = -1;
     
     DiiMediaBaseCallback      callback_;
-	DiiRtmpPuller*            rtmp_puller_ = nullptr;
-	DiiRtmpDecoder*           av_decoder_ = nullptr;
+    // pull + decode, shared with other players on the same url
+    std::shared_ptr<DiiRtmpSource> source_;
                             
 	std::string			url_;
     uint64_t            previous_sync_ts_ = 0;
-    int32_t             retry_cnt_ = 0;
-                            
-    bool need_callback_ = true;
                             
     dii_radar::DiiRole _role;
     char * _userid;
@@ -17,10 +17,13 @@
 * See the GNU LICENSE file for more info.
 */
 #include "dii_rtmp_puller.h"
+#include "dii_rtmp_connection.h"
+#include "dii_rtmp_flv_transport.h"
 #include "srs_librtmp.h"
 #include "dii_media_utils.h"
 #include "webrtc/base/logging.h"
 #include "webrtc/base/thread.h"
+#include "webrtc/common_video/h264/h264_common.h"
 
 #ifndef _WIN32
 #define ERROR_SUCCESS   0
@@ -36,6 +39,15 @@
 #define ERR_CODE_PLAY_STREAM                102
 #define ERR_CODE_READ_TIME_OUT              103
 
+std::atomic<bool> DiiRtmpPuller::shared_io_(false);
+std::mutex DiiRtmpPuller::trace_dir_mtx_;
+std::string DiiRtmpPuller::trace_dir_;
+
+void DiiRtmpPuller::SetTraceDir(const std::string& dir) {
+    std::unique_lock<std::mutex> lck(trace_dir_mtx_);
+    trace_dir_ = dir;
+}
+
 static u_int8_t fresh_nalu_header[] = { 0x00, 0x00, 0x00, 0x01 };
 static u_int8_t cont_nalu_header[] = { 0x00, 0x00, 0x01 };
 
@@ -45,17 +57,16 @@ DiiRtmpPuller::DiiRtmpPuller(int32_t stream_id, DiiPullerCallback&callback, bool
 	, running_(false)
 	, rtmp_status_(RS_PLY_Init)
 	, rtmp_(NULL)
-	, audio_payload_(NULL)
-	, video_payload_(NULL)
     , _role(dii_radar::_Role_Unknown)
     , _userId(NULL)
     , _report(report)
+    , trace_(stream_id)
 {
     this->stream_id_ = stream_id;
 	
     srs_codec_ = new SrsAvcAacCodec();
-	audio_payload_ = new DemuxData(1024);
-	video_payload_ = new DemuxData(384 * 1024);
+	video_pool_ = PlyPacketPool::Create();
+	audio_pool_ = PlyPacketPool::Create();
 }
 
 DiiRtmpPuller::~DiiRtmpPuller(void)
@@ -65,14 +76,6 @@ DiiRtmpPuller::~DiiRtmpPuller(void)
 		delete srs_codec_;
 		srs_codec_ = NULL;
 	}
-	if (audio_payload_) {
-		delete audio_payload_;
-		audio_payload_ = NULL;
-	}
-	if (video_payload_) {
-		delete video_payload_;
-		video_payload_ = NULL;
-	}
     if(_userId){
         free(_userId);
         _userId = NULL;
@@ -88,6 +91,22 @@ void DiiRtmpPuller::StartPull(const std::string& url, bool report) {
     str_url_ = url;
     running_ = true;
     rtmp_status_ = RS_PLY_Init;
+    connect_timings_ = ConnectTimings();
+    if (!trace_.IsOpen()) {
+        std::unique_lock<std::mutex> lck(trace_dir_mtx_);
+        if (!trace_dir_.empty()) {
+            trace_.Open(trace_dir_ + "/dii_trace_" + std::to_string(stream_id_) + "_"
+                        + std::to_string(dii_media_kit::DiiUnixTimestampMs()) + ".trace", str_url_);
+        }
+    }
+    transport_ = CreateTransport(str_url_);
+    if (transport_) {
+        if (transport_->Open(str_url_) != 0) {
+            rtmp_status_ = RS_PLY_Closed;
+            callback_.OnPullFailed(-1, 2002003, "ingest transport open failed");
+        }
+        return;
+    }
     rtmp_ = srs_rtmp_create(str_url_.c_str());
     srs_rtmp_set_timeout(rtmp_, RTMP_READ_TIME_OUT, RTMP_WRITE_TIME_OUT);
      dii_rtc::Thread::Start();
@@ -100,6 +119,13 @@ void DiiRtmpPuller::Shutdown() {
 
     running_ = false;
     rtmp_status_ = RS_PLY_Closed;
+    if (transport_) {
+        transport_->Close();
+        delete transport_;
+        transport_ = nullptr;
+        DII_LOG(LS_INFO, stream_id_, DII_CODE_COMMON_INFO) << "rtmp puller, stop pull: " << str_url_;
+        return;
+    }
     
     // 防止socket read 函数长时间读不退出，主动 disconnect
     srs_rtmp_disconnect_server(rtmp_);
@@ -113,9 +139,7 @@ void DiiRtmpPuller::Shutdown() {
 //* For Thread
 void DiiRtmpPuller::Run()
 {
-	bool connect_ok = false;
 	unsigned long long connect_error_count = 0;
-	unsigned long long timestamp_delay_log = 0;
 	unsigned int error_code = 0;
 	char * error_info = NULL;
 
@@ -125,10 +149,9 @@ void DiiRtmpPuller::Run()
         int ret = 0;
 		error_code = 0;
 		error_info = NULL;
-		bool need_reconnect = false;
         if (rtmp_ != NULL) {
 			if (RS_PLY_Init == rtmp_status_) {
-			    ret = srs_rtmp_handshake(rtmp_);
+			    ret = DoHandshake();
 				if (ret == 0) {
 					error_code = 0;
 					error_info = (char *)"rtmp simple handshake ok.";
@@ -143,11 +166,12 @@ void DiiRtmpPuller::Run()
                     //DII_LOG(LS_ERROR, stream_id_, error_code) << error_info;
 					//callback_.OnPullFailed(ret, error_code, error_info);
                     rtmp_status_ = RS_PLY_Closed;
-					need_sleep = true;
-					sleeptimestamp_ms = 200;
+					need_sleep = false;
                 }
 			}else if(RS_PLY_Handshaked == rtmp_status_){
+                int64_t start = dii_rtc::TimeMillis();
                 ret = srs_rtmp_connect_app(rtmp_);
+                connect_timings_.connect_app_ms = (int32_t)(dii_rtc::TimeMillis() - start);
 				if (ret == 0) {
 					error_code = 0;
 					error_info = (char *)"rtmp connect vhost/app ok.";
@@ -162,11 +186,12 @@ void DiiRtmpPuller::Run()
                    //DII_LOG(LS_ERROR, stream_id_, error_code) << error_info;
 					//callback_.OnPullFailed(ret, error_code, error_info);
                     rtmp_status_ = RS_PLY_Closed;
-					need_sleep = true;
-					sleeptimestamp_ms = 200;
+					need_sleep = false;
                 }
 			}else if(RS_PLY_Connected == rtmp_status_){
+                int64_t start = dii_rtc::TimeMillis();
                 ret = srs_rtmp_play_stream(rtmp_);
+                connect_timings_.play_ms = (int32_t)(dii_rtc::TimeMillis() - start);
 				if (ret == 0) {
 					error_code = 0;
 					error_info = (char *)"rtmp play stream command ok.";
@@ -184,8 +209,7 @@ void DiiRtmpPuller::Run()
                    // DII_LOG(LS_INFO, stream_id_, error_code) << error_info;
 					//callback_.OnPullFailed(ret, error_code, error_info);
                     rtmp_status_ = RS_PLY_Closed;
-					need_sleep = true;
-					sleeptimestamp_ms = 200;
+					need_sleep = false;
                 }
 			}else if(RS_PLY_Played == rtmp_status_){
                 ret = DoReadData();
@@ -219,6 +243,27 @@ void DiiRtmpPuller::Run()
 	}
 }
 
+int32_t DiiRtmpPuller::DoHandshake()
+{
+    // srs_rtmp_handshake step by step, to time each phase
+    int64_t start = dii_rtc::TimeMillis();
+    int ret = srs_rtmp_dns_resolve(rtmp_);
+    int64_t resolved = dii_rtc::TimeMillis();
+    connect_timings_.dns_ms = (int32_t)(resolved - start);
+    if (ret != 0) {
+        return ret;
+    }
+    ret = srs_rtmp_connect_server(rtmp_);
+    int64_t connected = dii_rtc::TimeMillis();
+    connect_timings_.tcp_connect_ms = (int32_t)(connected - resolved);
+    if (ret != 0) {
+        return ret;
+    }
+    ret = srs_rtmp_do_simple_handshake(rtmp_);
+    connect_timings_.handshake_ms = (int32_t)(dii_rtc::TimeMillis() - connected);
+    return ret;
+}
+
 int32_t DiiRtmpPuller::DoReadData()
 {
 	int size;
@@ -236,7 +281,13 @@ int32_t DiiRtmpPuller::DoReadData()
         free(data);
         return ret;
     }
-    
+    return HandlePacket(pkt_type, timestamp, data, size);
+}
+
+int32_t DiiRtmpPuller::HandlePacket(char pkt_type, uint32_t timestamp, char* data, int size)
+{
+    int ret = 0;
+    trace_.Write(pkt_type, timestamp, data, size);
     // check if timestamp jump, try to fix it.
     if(timestamp != 0) {
         int32_t dt = timestamp - pre_pkt_ts_;
@@ -257,10 +308,16 @@ int32_t DiiRtmpPuller::DoReadData()
                  << " timestamp: " << timestamp << " this:" << this;
 
     if (pkt_type == SRS_RTMP_TYPE_VIDEO) {
+		// srs_librtmp hands out its own malloc'd copy of every message
+		video_pool_->CountAllocation();
+		video_pool_->CountCopy(size);
 		SrsCodecSample sample;
 		if (srs_codec_->video_avc_demux(data, size, &sample) == ERROR_SUCCESS) {
-			if (srs_codec_->video_codec_id == SrsCodecVideoAVC) {	// Jus support H264
+			if (srs_codec_->video_codec_id == SrsCodecVideoAVC) {
                 GotVideoSample(timestamp, &sample);
+			}
+			else if (srs_codec_->video_codec_id == SrsCodecVideoHEVC) {
+                GotHevcSample(timestamp, &sample);
 			}
 			else {
                 DII_LOG(LS_ERROR, stream_id_, 2002007) << "Don't support video format, video codec id: " << srs_codec_->video_codec_id;
@@ -294,8 +351,12 @@ int32_t DiiRtmpPuller::DoReadData()
 		// for aac: ignore sequence header
 		if (acodec == SrsCodecAudioAAC && sample.aac_packet_type == SrsCodecAudioTypeSequenceHeader) {
             DII_LOG(LS_VERBOSE, stream_id_, DII_CODE_COMMON_INFO) << "receive AAC sequence header, timestamp: " << timestamp;
+            if (srs_codec_->aac_extra_size > 0) {
+                callback_.OnPullAudioConfig((const uint8_t*)srs_codec_->aac_extra_data, srs_codec_->aac_extra_size);
+            }
         } else if (srs_codec_->aac_object == SrsAacObjectTypeReserved) {
             DII_LOG(LS_WARNING, stream_id_, DII_CODE_COMMON_WARN) << "receive AAC sequence header error, aac_object: SrsAacObjectTypeReserved.";
+            free(data);
             ret = -1;
             return ret;
         }
@@ -342,6 +403,37 @@ int32_t DiiRtmpPuller::DoReadData()
     return 0;
 }
 
+DiiRtmpTransport* DiiRtmpPuller::CreateTransport(const std::string& url) {
+    if (url.compare(0, 7, "http://") == 0) {
+        return new DiiHttpFlvConnection(stream_id_, *this);
+    }
+    if (url.compare(0, strlen(DII_FLV_FILE_SCHEME), DII_FLV_FILE_SCHEME) == 0) {
+        return new DiiFlvFileTransport(stream_id_, *this);
+    }
+    if (shared_io_) {
+        return new DiiRtmpConnection(stream_id_, *this);
+    }
+    return nullptr;
+}
+
+void DiiRtmpPuller::OnTransportPlaying() {
+    DII_LOG(LS_INFO, stream_id_, DII_CODE_COMMON_INFO) << transport_->Name() << " stream playing.";
+    rtmp_status_ = RS_PLY_Played;
+    callback_.OnServerConnected();
+}
+
+bool DiiRtmpPuller::OnTransportPacket(char type, uint32_t timestamp, char* data, int size) {
+    HandlePacket(type, timestamp, data, size);
+    return rtmp_status_ != RS_PLY_Closed;
+}
+
+void DiiRtmpPuller::OnTransportFailed(int32_t eventid, const char* errmsg) {
+    rtmp_status_ = RS_PLY_Closed;
+    if (running_) {
+        callback_.OnPullFailed(-1, eventid, errmsg);
+    }
+}
+
 int DiiRtmpPuller::GotVideoSample(uint32_t timestamp, SrsCodecSample *sample)
 {
 	int ret = ERROR_SUCCESS;
@@ -357,19 +449,29 @@ int DiiRtmpPuller::GotVideoSample(uint32_t timestamp, SrsCodecSample *sample)
 		return ret;
 	}
 
+	int frame_size = VideoSampleSize(sample);
+	if (frame_size < 0) {
+		return -1;
+	}
+	// the decoder consumes this buffer as is, no further copy
+	dii_rtc::scoped_refptr<PlyBuffer> video_payload = video_pool_->Get(frame_size);
+	PlyVideoInfo info;
+
 	// when ts message(samples) contains IDR, insert sps+pps.
 	if (sample->has_idr) {
 		// fresh nalu header before sps.
 		if (srs_codec_->sequenceParameterSetLength > 0) {
-			video_payload_->append((const char*)fresh_nalu_header, 4);
+			video_payload->append((const char*)fresh_nalu_header, 4);
 			// sps
-			video_payload_->append(srs_codec_->sequenceParameterSetNALUnit, srs_codec_->sequenceParameterSetLength);
+			video_payload->append(srs_codec_->sequenceParameterSetNALUnit, srs_codec_->sequenceParameterSetLength);
+			info.AddNalu((const uint8_t*)srs_codec_->sequenceParameterSetNALUnit, srs_codec_->sequenceParameterSetLength);
 		}
 		// cont nalu header before pps.
 		if (srs_codec_->pictureParameterSetLength > 0) {
-			video_payload_->append((const char*)fresh_nalu_header, 4);
+			video_payload->append((const char*)fresh_nalu_header, 4);
 			// pps
-			video_payload_->append(srs_codec_->pictureParameterSetNALUnit, srs_codec_->pictureParameterSetLength);
+			video_payload->append(srs_codec_->pictureParameterSetNALUnit, srs_codec_->pictureParameterSetLength);
+			info.AddNalu((const uint8_t*)srs_codec_->pictureParameterSetNALUnit, srs_codec_->pictureParameterSetLength);
 		}
 	}
 
@@ -397,7 +499,7 @@ int DiiRtmpPuller::GotVideoSample(uint32_t timestamp, SrsCodecSample *sample)
 			continue;
 		default: {
             if (nal_unit_type == SrsAvcNaluTypeReserved) {
-                RescanVideoframe(sample_unit->bytes, sample_unit->size, timestamp);
+                RescanVideoframe(sample_unit->bytes, sample_unit->size, timestamp, sample->cts);
                 continue;
             }
         }
@@ -408,26 +510,103 @@ int DiiRtmpPuller::GotVideoSample(uint32_t timestamp, SrsCodecSample *sample)
             // DII_LOG(LS_INFO, stream_id_) << "Got H264 IDR Frame.";
 			// insert cont nalu header before frame.
 #ifdef WEBRTC_IOS
-            video_payload_->append((const char*)fresh_nalu_header, 4);
+            video_payload->append((const char*)fresh_nalu_header, 4);
 #else
-			video_payload_->append((const char*)cont_nalu_header, 3);
+			video_payload->append((const char*)cont_nalu_header, 3);
 #endif
 		}
 		else {
-			video_payload_->append((const char*)fresh_nalu_header, 4);
+			video_payload->append((const char*)fresh_nalu_header, 4);
 		}
 		// sample data
         // DII_LOG(LS_VERBOSE, stream_id_) << "Got H264 Sample Frame Data.";
-		video_payload_->append(sample_unit->bytes, sample_unit->size);
+		video_payload->append(sample_unit->bytes, sample_unit->size);
+		info.AddNalu((const uint8_t*)sample_unit->bytes, sample_unit->size);
 	}
 	//* Fix for mutil nalu.
-	if (video_payload_->_data_len != 0) {
-        callback_.OnPullVideoData((uint8_t *) video_payload_->_data, video_payload_->_data_len, timestamp);
+	if (video_payload->size() != 0) {
+        callback_.OnPullVideoData(video_payload, timestamp, sample->cts, info);
 	}
-	video_payload_->reset();
 
 	return ret;
 }
+
+int DiiRtmpPuller::GotHevcSample(uint32_t timestamp, SrsCodecSample *sample)
+{
+	// only NALUs, the sequence header is kept by srs_codec_
+	if (sample->avc_packet_type != SrsCodecVideoAVCTypeNALU || sample->nb_sample_units == 0) {
+		return ERROR_SUCCESS;
+	}
+
+	int frame_size = VideoSampleSize(sample);
+	if (frame_size < 0) {
+		return -1;
+	}
+	dii_rtc::scoped_refptr<PlyBuffer> video_payload = video_pool_->Get(frame_size);
+	PlyVideoInfo info;
+	info.codec = dii_media_kit::kVideoCodecH265;
+
+	// IRAP pictures carry vps+sps+pps, the decoder starts at them.
+	if (sample->has_idr) {
+		const char* param_sets[] = { srs_codec_->videoParameterSetNALUnit,
+		                             srs_codec_->sequenceParameterSetNALUnit,
+		                             srs_codec_->pictureParameterSetNALUnit };
+		const int param_set_lens[] = { srs_codec_->videoParameterSetLength,
+		                               srs_codec_->sequenceParameterSetLength,
+		                               srs_codec_->pictureParameterSetLength };
+		for (int i = 0; i < 3; i++) {
+			if (param_set_lens[i] > 0) {
+				video_payload->append((const char*)fresh_nalu_header, 4);
+				video_payload->append(param_sets[i], param_set_lens[i]);
+				info.AddNalu((const uint8_t*)param_sets[i], param_set_lens[i]);
+			}
+		}
+	}
+
+	for (int i = 0; i < sample->nb_sample_units; i++) {
+		SrsCodecSampleUnit* sample_unit = &sample->sample_units[i];
+		switch (SRS_HEVC_NALU_TYPE(sample_unit->bytes[0])) {
+		case SrsHevcNaluTypeVPS:
+		case SrsHevcNaluTypeSPS:
+		case SrsHevcNaluTypePPS:
+		case SrsHevcNaluTypeAUD:
+		case SrsHevcNaluTypePrefixSEI:
+		case SrsHevcNaluTypeSuffixSEI:
+			continue;
+		default:
+			break;
+		}
+		video_payload->append((const char*)fresh_nalu_header, 4);
+		video_payload->append(sample_unit->bytes, sample_unit->size);
+		info.AddNalu((const uint8_t*)sample_unit->bytes, sample_unit->size);
+	}
+	if (video_payload->size() != 0) {
+		callback_.OnPullVideoData(video_payload, timestamp, sample->cts, info);
+	}
+	return ERROR_SUCCESS;
+}
+// upper bound of the annex-b frame GotVideoSample assembles, -1 if the sample is broken
+int DiiRtmpPuller::VideoSampleSize(SrsCodecSample *sample)
+{
+	int size = 0;
+	if (sample->has_idr) {
+		if (srs_codec_->sequenceParameterSetLength > 0)
+			size += 4 + srs_codec_->sequenceParameterSetLength;
+		if (srs_codec_->pictureParameterSetLength > 0)
+			size += 4 + srs_codec_->pictureParameterSetLength;
+		if (sample->vcodec == SrsCodecVideoHEVC && srs_codec_->videoParameterSetLength > 0)
+			size += 4 + srs_codec_->videoParameterSetLength;
+	}
+	for (int i = 0; i < sample->nb_sample_units; i++) {
+		SrsCodecSampleUnit* sample_unit = &sample->sample_units[i];
+		if (!sample_unit->bytes || sample_unit->size <= 0) {
+			return -1;
+		}
+		size += 4 + sample_unit->size;
+	}
+	return size;
+}
+
 int DiiRtmpPuller::GotAudioSample(uint32_t timestamp, SrsCodecSample *sample, uint64_t sync_ts)
 {
     int ret = ERROR_SUCCESS;
@@ -440,127 +619,32 @@ int DiiRtmpPuller::GotAudioSample(uint32_t timestamp, SrsCodecSample *sample, ui
 			return ret;
 		}
 
-		// the frame length is the AAC raw data plus the adts header size.
-		int32_t frame_length = size + 7;
-
-		// AAC-ADTS
-		// 6.2 Audio Data Transport Stream, ADTS
-		// in aac-iso-13818-7.pdf, page 26.
-		// fixed 7bytes header
-		u_int8_t adts_header[7] = { 0xff, 0xf9, 0x00, 0x00, 0x00, 0x0f, 0xfc };
-		/*
-		// adts_fixed_header
-		// 2B, 16bits
-		int16_t syncword; //12bits, '1111 1111 1111'
-		int8_t ID; //1bit, '1'
-		int8_t layer; //2bits, '00'
-		int8_t protection_absent; //1bit, can be '1'
-		// 12bits
-		int8_t profile; //2bit, 7.1 Profiles, page 40
-		TSAacSampleFrequency sampling_frequency_index; //4bits, Table 35, page 46
-		int8_t private_bit; //1bit, can be '0'
-		int8_t channel_configuration; //3bits, Table 8
-		int8_t original_or_copy; //1bit, can be '0'
-		int8_t home; //1bit, can be '0'
-
-		// adts_variable_header
-		// 28bits
-		int8_t copyright_identification_bit; //1bit, can be '0'
-		int8_t copyright_identification_start; //1bit, can be '0'
-		int16_t frame_length; //13bits
-		int16_t adts_buffer_fullness; //11bits, 7FF signals that the bitstream is a variable rate bitstream.
-		int8_t number_of_raw_data_blocks_in_frame; //2bits, 0 indicating 1 raw_data_block()
-		*/
-		// profile, 2bits
-		SrsAacProfile aac_profile = srs_codec_aac_rtmp2ts(srs_codec_->aac_object);
-		adts_header[2] = (aac_profile << 6) & 0xc0;
-		// sampling_frequency_index 4bits
-		adts_header[2] |= (srs_codec_->aac_sample_rate << 2) & 0x3c;
-		// channel_configuration 3bits
-		adts_header[2] |= (srs_codec_->aac_channels >> 2) & 0x01;
-		adts_header[3] = (srs_codec_->aac_channels << 6) & 0xc0;
-		// frame_length 13bits
-		adts_header[3] |= (frame_length >> 11) & 0x03;
-		adts_header[4] = (frame_length >> 3) & 0xff;
-		adts_header[5] = ((frame_length << 5) & 0xe0);
-		// adts_buffer_fullness; //11bits
-		adts_header[5] |= 0x1f;
-
-		// copy to audio buffer
-		audio_payload_->append((const char*)adts_header, sizeof(adts_header));
-		audio_payload_->append(sample_unit->bytes, sample_unit->size);
-
-        callback_.OnPullAudioData((uint8_t *) audio_payload_->_data, audio_payload_->_data_len, timestamp, sync_ts);
-		audio_payload_->reset();
+		// raw aac, the decoder is set up from the sequence header
+		dii_rtc::scoped_refptr<PlyBuffer> audio_payload = audio_pool_->Get(size);
+		audio_payload->append(sample_unit->bytes, size);
+        callback_.OnPullAudioData(audio_payload, timestamp, sync_ts);
 	}
 
 	return ret;
 }
 
-void DiiRtmpPuller::RescanVideoframe(const char*pdata, int len, uint32_t timestamp)
+void DiiRtmpPuller::RescanVideoframe(const char*pdata, int len, uint32_t timestamp, int32_t cts)
 {
-    int nal_type = pdata[4] & 0x1f;
-    const char *p = pdata;
-    if (nal_type == 7)
-    {// keyframe
-        int find7 = 0;
-        const char* ptr7 = NULL;
-        int size7 = 0;
-        int find8 = 0;
-        const char* ptr8 = NULL;
-        int size8 = 0;
-        const char* ptr5 = NULL;
-        int size5 = 0;
-        int head01 = 4;
-        for (int i = 4; i < len - 4; i++)
-        {
-            if ((p[i] == 0x0 && p[i + 1] == 0x0 && p[i + 2] == 0x0 && p[i + 3] == 0x1) || (p[i] == 0x0 && p[i + 1] == 0x0 && p[i + 2] == 0x1))
-            {
-                if (p[i + 2] == 0x01)
-                    head01 = 3;
-                else
-                    head01 = 4;
-                if (find7 == 0)
-                {
-                    find7 = i;
-                    ptr7 = p;
-                    size7 = find7;
-                    i++;
-                }
-                else if (find8 == 0)
-                {
-                    find8 = i;
-                    ptr8 = p + find7 ;
-                    size8 = find8 - find7;
-                    const char* ptr = p + i;
-                    if ((ptr[head01] & 0x1f) == 5)
-                    {
-                        ptr5 = p + find8 + head01;
-                        size5 = len - find8 - head01;
-                        break;
-                    }
-                }
-                else
-                {
-                    ptr5 = p + i + head01;
-                    size5 = len - i - head01;
-                    break;
-                }
-            }
-        }
-        video_payload_->append(ptr7, size7);
-        video_payload_->append(ptr8, size8);
-        video_payload_->append((const char*)fresh_nalu_header, 4);
-        video_payload_->append(ptr5, size5);
-        callback_.OnPullVideoData((uint8_t *) video_payload_->_data, video_payload_->_data_len, timestamp);
-        video_payload_->reset();
+    const uint8_t* data = (const uint8_t*)pdata;
+    std::vector<dii_media_kit::H264::NaluIndex> nalus = dii_media_kit::H264::FindNaluIndices(data, len);
+    if (nalus.empty()) {
+        return;
     }
-    else 
-    {
-        video_payload_->append(pdata, len);
-        callback_.OnPullVideoData((uint8_t *) video_payload_->_data, video_payload_->_data_len, timestamp);
-        video_payload_->reset();
+    // every nalu gets a 4 byte start code, short ones grow by a byte each
+    dii_rtc::scoped_refptr<PlyBuffer> video_payload = video_pool_->Get(len + 4 + (int)nalus.size());
+    PlyVideoInfo info;
+    for (const dii_media_kit::H264::NaluIndex& index : nalus) {
+        const uint8_t* nalu = data + index.payload_start_offset;
+        video_payload->append((const char*)fresh_nalu_header, 4);
+        video_payload->append((const char*)nalu, index.payload_size);
+        info.AddNalu(nalu, index.payload_size);
     }
+    callback_.OnPullVideoData(video_payload, timestamp, cts, info);
 }
 
 
@@ -568,3 +652,26 @@ void DiiRtmpPuller::CallConnect()
 {
     callback_.OnServerConnected();
 }
+
+void DiiRtmpPuller::DoStatistics(dii_media_kit::DiiPlayerStatistics& statistics) {
+    int64_t now = dii_rtc::TimeMillis();
+    int64_t bytes_copied = 0;
+    int32_t allocations = 0;
+    int32_t packets = 0;
+    video_pool_->GetStatistics(bytes_copied, allocations, packets);
+    if (last_statistic_ts_ > 0 && now > last_statistic_ts_) {
+        statistics.video_copy_bytes_ = (int32_t)(bytes_copied * 1000 / (now - last_statistic_ts_));
+    }
+    statistics.video_allocs_per_packet_ = packets > 0 ? (float)allocations / packets : 0;
+    statistics.ingest_transport_ = transport_ ? transport_->Name() : "rtmp";
+    if (transport_) {
+        statistics.shared_io_streams_ = shared_io_ ? DiiRtmpConnection::OpenConnections() : 0;
+        transport_->GetTimings(connect_timings_.tcp_connect_ms, connect_timings_.play_ms);
+    }
+    statistics.rtmp_dns_ms_ = connect_timings_.dns_ms;
+    statistics.rtmp_tcp_connect_ms_ = connect_timings_.tcp_connect_ms;
+    statistics.rtmp_handshake_ms_ = connect_timings_.handshake_ms;
+    statistics.rtmp_connect_app_ms_ = connect_timings_.connect_app_ms;
+    statistics.rtmp_play_ms_ = connect_timings_.play_ms;
+    last_statistic_ts_ = now;
+}
@@ -20,11 +20,19 @@
 #define __APOLLO_RTMP_PULL_H__
 
 #include "dii_common.h"
+#include "dii_rtmp_packet_pool.h"
+#include "dii_rtmp_trace.h"
+#include "dii_rtmp_transport.h"
+#include "dii_rtmp_video_info.h"
 #include "webrtc/base/criticalsection.h"
 #include "webrtc/base/scoped_ptr.h"
 #include "webrtc/base/thread.h"
+#include "webrtc/common_types.h"
 #include "srs_kernel_codec.h"
 
+#include <atomic>
+#include <mutex>
+
 enum RTMPLAYER_STATUS
 {
 	RS_PLY_Init,		
@@ -34,6 +42,9 @@ enum RTMPLAYER_STATUS
 	RS_PLY_Closed		
 };
 
+// an 8K IDR frame at high quality stays well below this
+#define DEMUX_DATA_MAX_SIZE (32 * 1024 * 1024)
+
 typedef struct DemuxData
 {
 	DemuxData(int size) : _data(NULL), _data_len(0), _data_size(size){
@@ -44,12 +55,26 @@ typedef struct DemuxData
 		_data_len = 0;
 	}
 	int append(const char* pData, int len){
-		if (_data_len + len > _data_size)
+		if (_data_len + len > _data_size && !grow(_data_len + len))
 			return 0;
 		memcpy(_data + _data_len, pData, len);
 		_data_len += len;
 		return len;
 	}
+	// double the buffer until |size| fits, keeps the data already appended
+	bool grow(int size) {
+		if (size > DEMUX_DATA_MAX_SIZE)
+			return false;
+		int new_size = _data_size;
+		while (new_size < size)
+			new_size = new_size * 2 < DEMUX_DATA_MAX_SIZE ? new_size * 2 : DEMUX_DATA_MAX_SIZE;
+		char* data = new char[new_size];
+		memcpy(data, _data, _data_len);
+		delete[] _data;
+		_data = data;
+		_data_size = new_size;
+		return true;
+	}
 
 	char*_data;
 	int _data_len;
@@ -64,27 +89,62 @@ public:
 
 	virtual void OnServerConnected() = 0;
 	virtual void OnPullFailed(int32_t errCode, int32_t eventid, const char * errmsg) = 0;
-	virtual void OnPullVideoData(const uint8_t*pdata, int len, uint32_t ts) = 0;
-	virtual void OnPullAudioData(const uint8_t*pdata, int len, uint32_t ts, uint64_t sync_ts) = 0;
+	// |frame| is annex-b h264 or h265 by |info.codec|, keep a reference instead of copying it.
+	// |ts| is the decode time, |ts| + |cts| the presentation time, |info| is from its nal headers
+	virtual void OnPullVideoData(const dii_rtc::scoped_refptr<PlyBuffer>& frame, uint32_t ts, int32_t cts,
+	                             const PlyVideoInfo& info) = 0;
+	// |frame| is one raw aac frame, keep a reference instead of copying it
+	virtual void OnPullAudioData(const dii_rtc::scoped_refptr<PlyBuffer>& frame, uint32_t ts, uint64_t sync_ts) = 0;
+	// AudioSpecificConfig of the aac sequence header, comes before the frames it applies to
+	virtual void OnPullAudioConfig(const uint8_t* config, int len) = 0;
 };
 
-class DiiRtmpPuller : public dii_rtc::Thread {
+namespace dii_media_kit {
+class DiiRtmpTraceReplay;
+}
+
+class DiiRtmpPuller : public dii_rtc::Thread, public DiiTransportCallback {
+    // dii_bench feeds traced packets through HandlePacket without a connection
+    friend class dii_media_kit::DiiRtmpTraceReplay;
 public:
 	DiiRtmpPuller(int32_t stream_id, DiiPullerCallback&callback, bool report);
 	virtual ~DiiRtmpPuller(void);
     void StartPull(const std::string& url, bool report);
     void Shutdown();
+    void DoStatistics(dii_media_kit::DiiPlayerStatistics& statistics);
+    // pull on the shared io thread instead of a thread per puller, takes effect on next StartPull
+    static void SetSharedIo(bool enable) { shared_io_ = enable; }
+    // every pulled packet is written with its arrival time to a trace file in |dir|,
+    // empty turns it off. applies to pullers started afterwards.
+    static void SetTraceDir(const std::string& dir);
 protected:
     //* For Thread
     virtual void Run() override;
 
+	// srs_rtmp_handshake split up, timing dns / connect / handshake
+	int32_t DoHandshake();
 	int32_t DoReadData();
+	// consumes one packet from srs_librtmp, frees |data|
+	int32_t HandlePacket(char pkt_type, uint32_t timestamp, char* data, int size);
 	int GotVideoSample(uint32_t timestamp, SrsCodecSample *sample);
+	// hevc from codec id 12 or enhanced rtmp, parameter sets are inserted before IRAP pictures
+	int GotHevcSample(uint32_t timestamp, SrsCodecSample *sample);
+	int VideoSampleSize(SrsCodecSample *sample);
 	int GotAudioSample(uint32_t timestamp, SrsCodecSample *sample, uint64_t sync_ts);
-    void RescanVideoframe(const char*pdata, int len, uint32_t timestamp);
+    // a unit holding annex-b nalus instead of one avcc nalu, splits it on the start codes
+    void RescanVideoframe(const char*pdata, int len, uint32_t timestamp, int32_t cts);
 
 	void CallConnect();
 
+    // http-flv and flv files by url, rtmp on the shared io thread when it is on,
+    // nullptr for rtmp through srs_librtmp on a thread of this puller
+    DiiRtmpTransport* CreateTransport(const std::string& url);
+
+    //* For DiiTransportCallback
+    virtual void OnTransportPlaying() override;
+    virtual bool OnTransportPacket(char type, uint32_t timestamp, char* data, int size) override;
+    virtual void OnTransportFailed(int32_t eventid, const char* errmsg) override;
+
 private:
     int32_t stream_id_ = -1;
     
@@ -95,8 +155,9 @@ private:
     
 	RTMPLAYER_STATUS	rtmp_status_;
 	void*				rtmp_;
-	DemuxData*			audio_payload_;
-	DemuxData*			video_payload_;
+	DiiRtmpTransport*	transport_ = nullptr;
+	dii_rtc::scoped_refptr<PlyPacketPool> video_pool_;
+	dii_rtc::scoped_refptr<PlyPacketPool> audio_pool_;
     uint64_t            metadata_sync_ts_ = 0;
     uint64_t            rtmp_metadata_packet_ts_ = 0;
     uint64_t            lastest_audio_ts_ = 0;
@@ -105,8 +166,24 @@ private:
     
     uint32_t   audio_bitrate_ = 0;
     uint32_t   video_bitrate_ = 0;
+    int64_t    last_statistic_ts_ = 0;
+    // duration of each phase of the last connect, ms
+    struct ConnectTimings {
+        int32_t dns_ms = 0;
+        int32_t tcp_connect_ms = 0;
+        int32_t handshake_ms = 0;
+        int32_t connect_app_ms = 0;
+        int32_t play_ms = 0;
+    };
+    ConnectTimings     connect_timings_;
     dii_radar::DiiRole _role;
     char * _userId;
     bool _report;
+    // opened on the first StartPull, reconnects go on in the same file
+    DiiRtmpTraceWriter  trace_;
+
+    static std::atomic<bool> shared_io_;
+    static std::mutex        trace_dir_mtx_;
+    static std::string       trace_dir_;
 };
 #endif	// __APOLLO_RTMP_PULL_H__
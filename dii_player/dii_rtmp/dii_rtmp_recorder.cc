@@ -0,0 +1,557 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#include "dii_com_def.h"
+#include "dii_rtmp_recorder.h"
+#include "webrtc/base/logging.h"
+#include "webrtc/base/timeutils.h"
+#include "webrtc/common_video/h264/h264_common.h"
+#include "webrtc/common_video/h264/sps_parser.h"
+
+#ifndef DII_WITHOUT_FFMPEG
+extern "C" {
+    #include "libavformat/avformat.h"
+    #include "libavutil/mem.h"
+}
+#endif
+
+#include <algorithm>
+#include <cstdlib>
+#include <string.h>
+
+#define RECORD_QUEUE_MAX_BYTES      (16 << 20)  // writer this far behind drops to the next keyframe
+#define RECORD_BATCH_INTERVAL       100         // ms between writer wakeups
+#define RECORD_WRITE_CHUNK          (256 << 10) // file writes are this size, at multiples of it
+#define RECORD_IO_BUFFER_SIZE       (64 << 10)
+#define RECORD_FLUSH_INTERVAL       1000        // pending data reaches the file at least this often
+#define RECORD_AUDIO_ONLY_WAIT      3000        // audio without any video before the file is audio only
+#define RECORD_TS_JUMP_LEN          10000       // timestamp discontinuity, the file's timeline goes on
+#define RECORD_AUDIO_FRAME_LEN      23          // ms of an aac frame at 44.1 kHz, bridges a discontinuity
+#define RECORD_MP4_FRAGMENT_US      2000000     // caps fragments of long gops
+
+#define HEVC_NALU_TYPE(b)           (((b) >> 1) & 0x3f)
+#define HEVC_NALU_VPS               32
+#define HEVC_NALU_PPS               34
+
+#ifndef DII_WITHOUT_FFMPEG
+
+namespace {
+
+const AVRational kMsTimeBase = {1, 1000};
+
+// sample rate and channels of an AudioSpecificConfig, ISO 14496-3 1.6.2.1
+bool ParseAudioConfig(const std::vector<uint8_t>& config, int* sample_rate, int* channels) {
+    static const int kSampleRates[] = {96000, 88200, 64000, 48000, 44100, 32000, 24000,
+                                       22050, 16000, 12000, 11025, 8000, 7350};
+    size_t pos = 0;
+    auto bits = [&](int n) {
+        uint32_t v = 0;
+        for (int i = 0; i < n; i++, pos++) {
+            if (pos / 8 >= config.size())
+                return -1;
+            v = (v << 1) | ((config[pos / 8] >> (7 - pos % 8)) & 1);
+        }
+        return (int)v;
+    };
+    int object_type = bits(5);
+    if (object_type == 31) {
+        object_type = bits(6);
+    }
+    int index = bits(4);
+    int rate = index == 15 ? bits(24) : (index >= 0 && index < 13 ? kSampleRates[index] : -1);
+    int channel_config = bits(4);
+    if (object_type < 0 || rate <= 0 || channel_config < 0) {
+        return false;
+    }
+    *sample_rate = rate;
+    // 7 is 7.1, 0 is defined in the program config element, stereo is the usual case
+    *channels = channel_config == 7 ? 8 : (channel_config == 0 ? 2 : channel_config);
+    return true;
+}
+
+// the parameter sets in front of the first picture, annex-b as libavformat takes them
+std::vector<uint8_t> ParameterSets(const PlyBuffer& frame, dii_media_kit::VideoCodecType codec,
+                                   int* width, int* height) {
+    static const uint8_t kStartCode[] = {0, 0, 0, 1};
+    std::vector<uint8_t> sets;
+    const uint8_t* data = frame.data();
+    for (const dii_media_kit::H264::NaluIndex& index :
+         dii_media_kit::H264::FindNaluIndices(data, frame.size())) {
+        const uint8_t* nalu = data + index.payload_start_offset;
+        if (index.payload_size == 0)
+            continue;
+        bool parameter_set = false;
+        if (codec == dii_media_kit::kVideoCodecH265) {
+            int type = HEVC_NALU_TYPE(nalu[0]);
+            if (type < HEVC_NALU_VPS)
+                break;
+            parameter_set = type <= HEVC_NALU_PPS;
+        } else {
+            dii_media_kit::H264::NaluType type = dii_media_kit::H264::ParseNaluType(nalu[0]);
+            if (type == dii_media_kit::H264::kSlice || type == dii_media_kit::H264::kIdr)
+                break;
+            parameter_set = type == dii_media_kit::H264::kSps || type == dii_media_kit::H264::kPps;
+            if (type == dii_media_kit::H264::kSps && *width == 0) {
+                dii_rtc::Optional<dii_media_kit::SpsParser::SpsState> sps =
+                    dii_media_kit::SpsParser::ParseSps(nalu + dii_media_kit::H264::kNaluTypeSize,
+                                                       index.payload_size - dii_media_kit::H264::kNaluTypeSize);
+                if (sps) {
+                    *width = sps->width;
+                    *height = sps->height;
+                }
+            }
+        }
+        if (parameter_set) {
+            sets.insert(sets.end(), kStartCode, kStartCode + sizeof(kStartCode));
+            sets.insert(sets.end(), nalu, nalu + index.payload_size);
+        }
+    }
+    return sets;
+}
+
+bool SetExtradata(AVCodecParameters* par, const uint8_t* data, size_t size) {
+    par->extradata = (uint8_t*)av_mallocz(size + AV_INPUT_BUFFER_PADDING_SIZE);
+    if (!par->extradata)
+        return false;
+    memcpy(par->extradata, data, size);
+    par->extradata_size = (int)size;
+    return true;
+}
+
+}  // namespace
+
+DiiRtmpRecorder::DiiRtmpRecorder(int32_t stream_id, const std::string& path,
+                                 dii_media_kit::DiiRecordFormat format)
+    : stream_id_(stream_id)
+    , path_(path)
+    , format_(format)
+    , wakeup_event_(false, false) {
+}
+
+DiiRtmpRecorder::~DiiRtmpRecorder() {
+    if (processing_) {
+        processing_ = false;
+        wakeup_event_.Set();
+        dii_rtc::Thread::Stop();
+    }
+    if (stage_) {
+        av_free(stage_);
+        stage_ = nullptr;
+    }
+}
+
+bool DiiRtmpRecorder::Start() {
+    file_ = fopen(path_.c_str(), "wb");
+    if (!file_) {
+        DII_LOG(LS_ERROR, stream_id_, DII_CODE_COMMON_ERROR) << "Record can't create " << path_;
+        return false;
+    }
+    // every write is a whole chunk already, stdio buffering would only copy it again
+    setvbuf(file_, nullptr, _IONBF, 0);
+    stage_ = (uint8_t*)av_malloc(RECORD_WRITE_CHUNK);
+    last_flush_ms_ = dii_rtc::TimeMillis();
+    DII_LOG(LS_INFO, stream_id_, DII_CODE_COMMON_INFO) << "Record to " << path_ << ", format: "
+        << (format_ == dii_media_kit::DII_RECORD_FORMAT_MP4 ? "fragmented mp4" : "flv");
+    processing_ = true;
+    dii_rtc::Thread::Start();
+    return true;
+}
+
+void DiiRtmpRecorder::AddVideo(const dii_rtc::scoped_refptr<PlyBuffer>& frame, uint32_t ts, int32_t cts,
+                               const PlyVideoInfo& info) {
+    Packet pkt;
+    pkt.type = Packet::kVideo;
+    pkt.ts = ts;
+    pkt.cts = cts;
+    pkt.info = info;
+    pkt.data = frame;
+    Enqueue(pkt, frame->size());
+}
+
+void DiiRtmpRecorder::AddAudio(const dii_rtc::scoped_refptr<PlyBuffer>& frame, uint32_t ts) {
+    Packet pkt;
+    pkt.type = Packet::kAudio;
+    pkt.ts = ts;
+    pkt.data = frame;
+    Enqueue(pkt, frame->size());
+}
+
+void DiiRtmpRecorder::SetAudioConfig(const uint8_t* config, int len) {
+    if (!config || len <= 0) {
+        return;
+    }
+    Packet pkt;
+    pkt.type = Packet::kAudioConfig;
+    pkt.config.assign(config, config + len);
+    Enqueue(pkt, 0);
+}
+
+void DiiRtmpRecorder::Enqueue(Packet& pkt, int size) {
+    dii_rtc::CritScope cs(&crit_);
+    if (pkt.type == Packet::kVideo) {
+        ingest_video_ = true;
+    }
+    if (pkt.type != Packet::kAudioConfig) {
+        if (queued_bytes_ > RECORD_QUEUE_MAX_BYTES && !drop_to_keyframe_) {
+            drop_to_keyframe_ = true;
+            DII_LOG(LS_WARNING, stream_id_, DII_CODE_COMMON_WARN) << "Record writer is "
+                << queued_bytes_ / 1024 << " KB behind, dropping to the next keyframe.";
+        }
+        if (drop_to_keyframe_) {
+            // resume on a keyframe once half the backlog is written, audio only streams on any frame
+            bool resume = queued_bytes_ <= RECORD_QUEUE_MAX_BYTES / 2 &&
+                          (pkt.type == Packet::kVideo ? pkt.info.keyframe : !ingest_video_);
+            if (!resume) {
+                dropped_packets_++;
+                return;
+            }
+            drop_to_keyframe_ = false;
+        }
+    }
+    queued_bytes_ += size;
+    queue_.push_back(std::move(pkt));
+    if (queued_bytes_ > RECORD_QUEUE_MAX_BYTES / 4) {
+        wakeup_event_.Set();
+    }
+}
+
+void DiiRtmpRecorder::Run() {
+    std::deque<Packet> batch;
+    while (true) {
+        // read before taking the queue, what came before Stop still gets written
+        bool last = !processing_;
+        {
+            dii_rtc::CritScope cs(&crit_);
+            batch.swap(queue_);
+            queued_bytes_ = 0;
+        }
+        for (Packet& pkt : batch) {
+            WritePacket(pkt);
+        }
+        batch.clear();
+
+        int64_t now = dii_rtc::TimeMillis();
+        if (now - last_flush_ms_ >= RECORD_FLUSH_INTERVAL) {
+            last_flush_ms_ = now;
+            if (io_ctx_) {
+                avio_flush(io_ctx_);
+            }
+            WriteStaged(true);
+        }
+        if (last) {
+            break;
+        }
+        wakeup_event_.Wait(RECORD_BATCH_INTERVAL);
+    }
+    CloseMuxer();
+}
+
+void DiiRtmpRecorder::WritePacket(Packet& pkt) {
+    if (failed_) {
+        if (pkt.type != Packet::kAudioConfig) {
+            dropped_packets_++;
+        }
+        return;
+    }
+    if (pkt.type == Packet::kAudioConfig) {
+        if (fmt_ctx_ && audio_index_ >= 0 && pkt.config != audio_config_ && !audio_config_changed_) {
+            // a stream's codec parameters are fixed once the header is out
+            audio_config_changed_ = true;
+            DII_LOG(LS_WARNING, stream_id_, DII_CODE_COMMON_WARN) << "Record audio config changed, "
+                "audio is left out of the rest of the file.";
+        } else if (!fmt_ctx_) {
+            audio_config_ = pkt.config;
+        }
+        return;
+    }
+
+    if (!fmt_ctx_) {
+        if (pkt.type == Packet::kVideo) {
+            saw_video_ = true;
+            if (!pkt.info.keyframe || !OpenMuxer(&pkt)) {
+                return;
+            }
+            ts_base_ = pkt.ts;
+            // audio that came in ahead of the keyframe goes in behind it
+            for (const Packet& audio : pending_audio_) {
+                if ((int32_t)(audio.ts - ts_base_) >= 0) {
+                    WriteFrame(audio);
+                }
+            }
+            pending_audio_.clear();
+        } else {
+            if (audio_config_.empty()) {
+                return;
+            }
+            pending_audio_.push_back(std::move(pkt));
+            if ((int32_t)(pending_audio_.back().ts - pending_audio_.front().ts) < RECORD_AUDIO_ONLY_WAIT) {
+                return;
+            }
+            if (saw_video_) {
+                // video is there, keep waiting for its keyframe
+                pending_audio_.pop_front();
+                return;
+            }
+            if (!OpenMuxer(nullptr)) {
+                return;
+            }
+            ts_base_ = pending_audio_.front().ts;
+            for (const Packet& audio : pending_audio_) {
+                WriteFrame(audio);
+            }
+            pending_audio_.clear();
+            return;
+        }
+    }
+    WriteFrame(pkt);
+}
+
+void DiiRtmpRecorder::WriteFrame(const Packet& pkt) {
+    bool video = pkt.type == Packet::kVideo;
+    int index = video ? video_index_ : audio_index_;
+    if (index < 0 || (!video && audio_config_changed_)) {
+        return;
+    }
+    int64_t ts = FileTs(pkt.ts);
+    if (video) {
+        // after a jump or drops the references of the next frames may be gone
+        if (need_keyframe_ && !pkt.info.keyframe) {
+            return;
+        }
+        need_keyframe_ = false;
+    }
+
+    // the muxers want strictly increasing dts per stream
+    int64_t dts = std::max(ts, last_dts_[video ? 0 : 1] + 1);
+    last_dts_[video ? 0 : 1] = dts;
+
+    AVPacket avpkt;
+    av_init_packet(&avpkt);
+    avpkt.data = pkt.data->data();
+    avpkt.size = pkt.data->size();
+    avpkt.stream_index = index;
+    avpkt.dts = dts;
+    avpkt.pts = video ? std::max(dts + pkt.cts, dts) : dts;
+    if (!video || pkt.info.keyframe || pkt.info.idr) {
+        avpkt.flags |= AV_PKT_FLAG_KEY;
+    }
+    av_packet_rescale_ts(&avpkt, kMsTimeBase, fmt_ctx_->streams[index]->time_base);
+    int ret = av_write_frame(fmt_ctx_, &avpkt);
+    if (ret < 0) {
+        char err[AV_ERROR_MAX_STRING_SIZE] = {0};
+        av_strerror(ret, err, sizeof(err));
+        DII_LOG(LS_WARNING, stream_id_, DII_CODE_COMMON_WARN) << "Record drops a "
+            << (video ? "video" : "audio") << " packet at " << pkt.ts << ": " << err;
+        dropped_packets_++;
+    }
+}
+
+int64_t DiiRtmpRecorder::FileTs(uint32_t ts) {
+    int64_t file_ts = (int64_t)(int32_t)(ts - ts_base_) + ts_offset_;
+    if (last_file_ts_ >= 0 && std::abs(file_ts - last_file_ts_) > RECORD_TS_JUMP_LEN) {
+        // a reconnect restarted the timestamps, carry on right after the last packet
+        DII_LOG(LS_INFO, stream_id_, DII_CODE_COMMON_INFO) << "Record timestamp jumps from "
+            << last_file_ts_ << " to " << file_ts << " ms, continuing the file.";
+        ts_offset_ += last_file_ts_ + RECORD_AUDIO_FRAME_LEN - file_ts;
+        file_ts = last_file_ts_ + RECORD_AUDIO_FRAME_LEN;
+        need_keyframe_ = true;
+    }
+    last_file_ts_ = std::max(last_file_ts_, file_ts);
+    return file_ts;
+}
+
+bool DiiRtmpRecorder::OpenMuxer(const Packet* keyframe) {
+    bool mp4 = format_ == dii_media_kit::DII_RECORD_FORMAT_MP4;
+    if (keyframe && keyframe->info.codec == dii_media_kit::kVideoCodecH265 && !mp4) {
+        // libavformat's flv muxer predates enhanced rtmp
+        DII_LOG(LS_ERROR, stream_id_, DII_CODE_COMMON_ERROR) << "Record can't put h265 into flv, "
+            "record to mp4 instead.";
+        failed_ = true;
+        return false;
+    }
+    if (avformat_alloc_output_context2(&fmt_ctx_, nullptr, mp4 ? "mp4" : "flv", nullptr) < 0 || !fmt_ctx_) {
+        DII_LOG(LS_ERROR, stream_id_, DII_CODE_COMMON_ERROR) << "Record muxer unavailable.";
+        failed_ = true;
+        return false;
+    }
+
+    bool ok = true;
+    if (keyframe) {
+        int width = 0;
+        int height = 0;
+        std::vector<uint8_t> sets = ParameterSets(*keyframe->data, keyframe->info.codec, &width, &height);
+        AVStream* st = avformat_new_stream(fmt_ctx_, nullptr);
+        ok = st && !sets.empty() && SetExtradata(st->codecpar, sets.data(), sets.size());
+        if (ok) {
+            st->time_base = kMsTimeBase;
+            st->codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
+            st->codecpar->codec_id = keyframe->info.codec == dii_media_kit::kVideoCodecH265 ?
+                AV_CODEC_ID_HEVC : AV_CODEC_ID_H264;
+            st->codecpar->width = width;
+            st->codecpar->height = height;
+            video_index_ = st->index;
+        }
+    }
+    int sample_rate = 0;
+    int channels = 0;
+    if (ok && !audio_config_.empty() && ParseAudioConfig(audio_config_, &sample_rate, &channels)) {
+        AVStream* st = avformat_new_stream(fmt_ctx_, nullptr);
+        ok = st && SetExtradata(st->codecpar, audio_config_.data(), audio_config_.size());
+        if (ok) {
+            st->time_base = kMsTimeBase;
+            st->codecpar->codec_type = AVMEDIA_TYPE_AUDIO;
+            st->codecpar->codec_id = AV_CODEC_ID_AAC;
+            st->codecpar->sample_rate = sample_rate;
+            st->codecpar->channels = channels;
+            st->codecpar->frame_size = 1024;
+            audio_index_ = st->index;
+        }
+    }
+
+    uint8_t* io_buffer = ok ? (uint8_t*)av_malloc(RECORD_IO_BUFFER_SIZE) : nullptr;
+    if (io_buffer) {
+        io_ctx_ = avio_alloc_context(io_buffer, RECORD_IO_BUFFER_SIZE, 1, this, nullptr,
+                                     &DiiRtmpRecorder::OnMuxerWrite, nullptr);
+        if (!io_ctx_) {
+            av_free(io_buffer);
+        }
+    }
+    int ret = AVERROR(ENOMEM);
+    if (io_ctx_) {
+        // written front to back only, the muxers then skip their seek-back updates
+        io_ctx_->seekable = 0;
+        fmt_ctx_->pb = io_ctx_;
+        fmt_ctx_->flags |= AVFMT_FLAG_CUSTOM_IO;
+        AVDictionary* opts = nullptr;
+        if (mp4) {
+            av_dict_set(&opts, "movflags", "frag_keyframe+empty_moov+default_base_moof", 0);
+            av_dict_set_int(&opts, "frag_duration", RECORD_MP4_FRAGMENT_US, 0);
+        }
+        ret = avformat_write_header(fmt_ctx_, &opts);
+        av_dict_free(&opts);
+    }
+    if (ret < 0) {
+        char err[AV_ERROR_MAX_STRING_SIZE] = {0};
+        av_strerror(ret, err, sizeof(err));
+        DII_LOG(LS_ERROR, stream_id_, DII_CODE_COMMON_ERROR) << "Record can't start the file: " << err;
+        // no header, so no trailer either
+        failed_ = true;
+        CloseMuxer();
+        return false;
+    }
+    DII_LOG(LS_INFO, stream_id_, DII_CODE_COMMON_INFO) << "Record started"
+        << (video_index_ >= 0 ? ", video" : "") << (audio_index_ >= 0 ? ", audio " : "")
+        << (audio_index_ >= 0 ? std::to_string(sample_rate) + " Hz" : "");
+    return true;
+}
+
+void DiiRtmpRecorder::CloseMuxer() {
+    if (fmt_ctx_) {
+        if (io_ctx_ && !failed_) {
+            av_write_trailer(fmt_ctx_);
+            avio_flush(io_ctx_);
+        }
+        if (io_ctx_) {
+            av_freep(&io_ctx_->buffer);
+            avio_context_free(&io_ctx_);
+        }
+        avformat_free_context(fmt_ctx_);
+        fmt_ctx_ = nullptr;
+    }
+    if (file_) {
+        WriteStaged(true);
+        fclose(file_);
+        file_ = nullptr;
+        DII_LOG(LS_INFO, stream_id_, DII_CODE_COMMON_INFO) << "Record closed " << path_ << ", "
+            << bytes_written_ / 1024 << " KB, dropped packets: " << dropped_packets_;
+    }
+}
+
+int DiiRtmpRecorder::OnMuxerWrite(void* opaque, uint8_t* buf, int size) {
+    DiiRtmpRecorder* recorder = static_cast<DiiRtmpRecorder*>(opaque);
+    recorder->Stage(buf, size);
+    return recorder->failed_ ? AVERROR(EIO) : size;
+}
+
+void DiiRtmpRecorder::Stage(const uint8_t* data, int size) {
+    while (size > 0 && !failed_) {
+        // a chunk ends on the next multiple of the chunk size in the file
+        int chunk = RECORD_WRITE_CHUNK - (int)(file_pos_ % RECORD_WRITE_CHUNK);
+        int n = std::min(size, chunk - staged_);
+        memcpy(stage_ + staged_, data, n);
+        staged_ += n;
+        data += n;
+        size -= n;
+        if (staged_ == chunk) {
+            WriteStaged(false);
+        }
+    }
+}
+
+void DiiRtmpRecorder::WriteStaged(bool partial) {
+    if (!file_ || staged_ == 0 || failed_) {
+        return;
+    }
+    if (fwrite(stage_, 1, staged_, file_) != (size_t)staged_) {
+        DII_LOG(LS_ERROR, stream_id_, DII_CODE_COMMON_ERROR) << "Record write to " << path_
+            << " failed, recording stops.";
+        failed_ = true;
+        return;
+    }
+    file_pos_ += staged_;
+    bytes_written_ += staged_;
+    staged_ = 0;
+    if (partial) {
+        fflush(file_);
+    }
+}
+
+#else  // DII_WITHOUT_FFMPEG
+
+// the remuxing needs libavformat, a build without ffmpeg can't record
+DiiRtmpRecorder::DiiRtmpRecorder(int32_t stream_id, const std::string& path,
+                                 dii_media_kit::DiiRecordFormat format)
+    : stream_id_(stream_id)
+    , path_(path)
+    , format_(format)
+    , wakeup_event_(false, false) {
+}
+
+DiiRtmpRecorder::~DiiRtmpRecorder() {
+}
+
+bool DiiRtmpRecorder::Start() {
+    DII_LOG(LS_ERROR, stream_id_, DII_CODE_COMMON_ERROR) << "Record to " << path_
+        << " failed, built without ffmpeg.";
+    return false;
+}
+
+void DiiRtmpRecorder::AddVideo(const dii_rtc::scoped_refptr<PlyBuffer>& frame, uint32_t ts, int32_t cts,
+                               const PlyVideoInfo& info) {
+}
+
+void DiiRtmpRecorder::AddAudio(const dii_rtc::scoped_refptr<PlyBuffer>& frame, uint32_t ts) {
+}
+
+void DiiRtmpRecorder::SetAudioConfig(const uint8_t* config, int len) {
+}
+
+void DiiRtmpRecorder::Run() {
+}
+
+#endif  // DII_WITHOUT_FFMPEG
@@ -0,0 +1,132 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#ifndef __DII_RTMP_RECORDER_H__
+#define __DII_RTMP_RECORDER_H__
+
+#include "dii_common.h"
+#include "dii_rtmp_packet_pool.h"
+#include "dii_rtmp_video_info.h"
+#include "webrtc/base/criticalsection.h"
+#include "webrtc/base/event.h"
+#include "webrtc/base/thread.h"
+
+#include <atomic>
+#include <deque>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+struct AVFormatContext;
+struct AVIOContext;
+
+// Saves the stream being played to a file without transcoding. Ingest only
+// queues references to the demuxed packets; remuxing with libavformat and the
+// file writes run on the recorder thread, in batches and in chunk aligned
+// writes. flv is written as a live stream, mp4 fragmented at keyframes, so a
+// file cut short by a crash plays up to its last fragment.
+// The file starts at the first keyframe, audio only when no video comes.
+class DiiRtmpRecorder : public dii_rtc::Thread {
+public:
+    DiiRtmpRecorder(int32_t stream_id, const std::string& path, dii_media_kit::DiiRecordFormat format);
+    // writes what is queued and closes the file
+    ~DiiRtmpRecorder();
+
+    // creates the file and starts writing, false when it can't be created
+    bool Start();
+
+    // never block: when the writer falls behind by the queue budget, packets
+    // are dropped up to the next keyframe
+    void AddVideo(const dii_rtc::scoped_refptr<PlyBuffer>& frame, uint32_t ts, int32_t cts,
+                  const PlyVideoInfo& info);
+    void AddAudio(const dii_rtc::scoped_refptr<PlyBuffer>& frame, uint32_t ts);
+    void SetAudioConfig(const uint8_t* config, int len);
+
+    int64_t BytesWritten() const { return bytes_written_; }
+    int32_t DroppedPackets() const { return dropped_packets_; }
+
+protected:
+    //* For Thread
+    void Run() override;
+
+private:
+    struct Packet {
+        enum Type { kVideo, kAudio, kAudioConfig };
+        Type        type = kVideo;
+        uint32_t    ts = 0;
+        int32_t     cts = 0;
+        PlyVideoInfo info;
+        dii_rtc::scoped_refptr<PlyBuffer> data;
+        std::vector<uint8_t> config;
+    };
+
+    void Enqueue(Packet& pkt, int size);
+    // writer thread from here on
+    void WritePacket(Packet& pkt);
+    void WriteFrame(const Packet& pkt);
+    // |keyframe| null for an audio only file
+    bool OpenMuxer(const Packet* keyframe);
+    void CloseMuxer();
+    // ms on the file's timeline, continues across timestamp jumps
+    int64_t FileTs(uint32_t ts);
+    static int OnMuxerWrite(void* opaque, uint8_t* buf, int size);
+    void Stage(const uint8_t* data, int size);
+    // |partial| also writes a chunk that isn't full, the next one realigns
+    void WriteStaged(bool partial);
+
+private:
+    int32_t                             stream_id_ = 0;
+    std::string                         path_;
+    dii_media_kit::DiiRecordFormat      format_;
+
+    // ingest side
+    dii_rtc::CriticalSection            crit_;
+    std::deque<Packet>                  queue_;
+    int64_t                             queued_bytes_ = 0;
+    bool                                drop_to_keyframe_ = false;
+    bool                                ingest_video_ = false;
+    std::atomic<bool>                   processing_{false};
+    dii_rtc::Event                      wakeup_event_;
+    std::atomic<int64_t>                bytes_written_{0};
+    std::atomic<int32_t>                dropped_packets_{0};
+
+    // writer side
+    FILE*                               file_ = nullptr;
+    bool                                failed_ = false;
+    AVFormatContext*                    fmt_ctx_ = nullptr;
+    AVIOContext*                        io_ctx_ = nullptr;
+    int                                 video_index_ = -1;
+    int                                 audio_index_ = -1;
+    std::vector<uint8_t>                audio_config_;
+    bool                                audio_config_changed_ = false;
+    bool                                saw_video_ = false;
+    // audio held until the first keyframe opens the file
+    std::deque<Packet>                  pending_audio_;
+    bool                                need_keyframe_ = true;
+    uint32_t                            ts_base_ = 0;
+    int64_t                             ts_offset_ = 0;
+    int64_t                             last_file_ts_ = -1;
+    int64_t                             last_dts_[2] = {-1, -1};
+    // chunk staged for the next file write
+    uint8_t*                            stage_ = nullptr;
+    int                                 staged_ = 0;
+    int64_t                             file_pos_ = 0;
+    int64_t                             last_flush_ms_ = 0;
+};
+
+#endif	// __DII_RTMP_RECORDER_H__
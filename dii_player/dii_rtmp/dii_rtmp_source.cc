@@ -0,0 +1,724 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#include "dii_com_def.h"
+#include "dii_rtmp_source.h"
+#include "dii_rtmp_sync_multi_stream.h"
+#include "webrtc/base/logging.h"
+#include "webrtc/media/base/videoframe.h"
+
+#include <algorithm>
+
+#define DII_MSG_REPULL              1000
+#define DII_MSG_TIMESHIFT_FEED      1001
+#define DII_MSG_SINK_PLAYING        1002
+
+#define TIMESHIFT_FEED_INTERVAL     20      // ms between replay feeds
+#define TIMESHIFT_FEED_LEAD         500     // replayed packets reach the decoder this much early
+#define TIMESHIFT_LIVE_EDGE         1000    // a seek this close to the end goes back to live
+#define RECONNECT_STEADY_MS         5000    // media flowing this long after a reconnect resets the backoff
+#define PRIMARY_IDLE_MS             200     // a primary that hasn't pulled audio this long hands over
+
+namespace dii_media_kit {
+std::mutex DiiRtmpSource::sources_mtx_;
+std::map<std::string, std::weak_ptr<DiiRtmpSource>> DiiRtmpSource::sources_;
+std::atomic<int32_t> DiiRtmpSource::backoff_initial_ms_(500);
+std::atomic<int32_t> DiiRtmpSource::backoff_max_ms_(8000);
+std::atomic<int32_t> DiiRtmpSource::timeshift_window_ms_(0);
+std::atomic<int64_t> DiiRtmpSource::timeshift_memory_bytes_(32 << 20);
+std::mutex DiiRtmpSource::timeshift_dir_mtx_;
+std::string DiiRtmpSource::timeshift_dir_;
+
+void DiiRtmpSource::SetReconnectBackoff(int32_t initial_ms, int32_t max_ms) {
+    backoff_initial_ms_ = std::max(initial_ms, 0);
+    backoff_max_ms_ = std::max(max_ms, backoff_initial_ms_.load());
+}
+
+void DiiRtmpSource::SetTimeshift(int32_t window_ms, int64_t memory_bytes, const std::string& spill_dir) {
+    std::unique_lock<std::mutex> lck(timeshift_dir_mtx_);
+    timeshift_window_ms_ = std::max(window_ms, 0);
+    timeshift_memory_bytes_ = std::max<int64_t>(memory_bytes, 0);
+    timeshift_dir_ = spill_dir;
+}
+
+std::shared_ptr<DiiRtmpSource> DiiRtmpSource::Attach(const std::string& url,
+                                                     int32_t stream_id,
+                                                     DiiRtmpSourceSink* sink) {
+    std::string key = url;
+    // a paused or shifted player has a timeline of its own
+    if (TimeshiftEnabled()) {
+        key += "#timeshift" + std::to_string(stream_id);
+    }
+
+    std::unique_lock<std::mutex> lck(sources_mtx_);
+    std::shared_ptr<DiiRtmpSource> source;
+    auto it = sources_.find(key);
+    if (it != sources_.end()) {
+        source = it->second.lock();
+    }
+
+    if (source) {
+        DII_LOG(LS_INFO, stream_id, 2002001) << "DiiRtmpSource attach to shared rtmp url: " << url
+                                             << ", stream id:" << stream_id
+                                             << ", players: " << source->SinkCount() + 1;
+        source->AddSink(sink);
+    } else {
+        source = std::make_shared<DiiRtmpSource>(key, url, stream_id);
+        sources_[key] = source;
+        source->AddSink(sink);
+        source->StartPull();
+    }
+    return source;
+}
+
+void DiiRtmpSource::Detach(const std::shared_ptr<DiiRtmpSource>& source, DiiRtmpSourceSink* sink) {
+    if (!source) {
+        return;
+    }
+
+    source->StopRecord(sink);
+    bool handover = false;
+    bool remain = false;
+    {
+        std::unique_lock<std::mutex> lck(sources_mtx_);
+        remain = source->RemoveSink(sink, &handover);
+        if (!remain) {
+            // last player gone, a later Attach on the same url starts a fresh pull
+            auto it = sources_.find(source->key_);
+            if (it != sources_.end() && it->second.lock() == source) {
+                sources_.erase(it);
+            }
+        }
+    }
+    // a frame or state callback on another thread may still be in the sink
+    source->WaitSinkCalls(sink);
+    if (!remain) {
+        source->StopPull();
+    } else if (handover) {
+        source->ApplyPrimarySettings();
+    }
+}
+
+DiiRtmpSource::DiiRtmpSource(const std::string& key, const std::string& url, int32_t stream_id)
+    : stream_id_(stream_id)
+    , key_(key)
+    , url_(url) {
+    av_decoder_ = new DiiRtmpDecoder(stream_id, true);
+    av_decoder_->SetVideoFrameCallback(std::bind(&DiiRtmpSource::OnVideoFrame, this, std::placeholders::_1));
+    rtmp_puller_ = new DiiRtmpPuller(stream_id, *this, true);
+    if (timeshift_window_ms_ > 0) {
+        std::unique_lock<std::mutex> lck(timeshift_dir_mtx_);
+        timeshift_.reset(new DiiRtmpTimeshift(stream_id, timeshift_window_ms_, timeshift_memory_bytes_,
+                                              timeshift_dir_));
+    }
+    dii_rtc::Thread::Start();
+}
+
+DiiRtmpSource::~DiiRtmpSource() {
+    dii_rtc::Thread::Clear(this, DII_MSG_REPULL);
+    dii_rtc::Thread::Clear(this, DII_MSG_TIMESHIFT_FEED);
+    dii_rtc::Thread::Clear(this, DII_MSG_SINK_PLAYING);
+    dii_rtc::Thread::Stop();
+    if (rtmp_puller_) {
+        delete rtmp_puller_;
+        rtmp_puller_ = NULL;
+    }
+    if (av_decoder_) {
+        delete av_decoder_;
+        av_decoder_ = NULL;
+    }
+}
+
+void DiiRtmpSource::OnMessage(dii_rtc::Message* msg) {
+    switch (msg->message_id) {
+        case DII_MSG_REPULL: {
+            std::unique_lock<std::mutex> lck(mtx_);
+            if (running_ && rtmp_puller_) {
+                rtmp_puller_->Shutdown();
+                rtmp_puller_->StartPull(url_, true);
+            }
+            break;
+        } case DII_MSG_TIMESHIFT_FEED: {
+            FeedTimeshift();
+            break;
+        } case DII_MSG_SINK_PLAYING: {
+            dii_rtc::TypedMessageData<DiiRtmpSourceSink*>* data =
+                static_cast<dii_rtc::TypedMessageData<DiiRtmpSourceSink*>*>(msg->pdata);
+            if (playing_) {
+                CallSinks([](DiiRtmpSourceSink* sink) {
+                    sink->OnSourceState(DII_STATE_PLAYING, 0, "playing");
+                }, data->data());
+            }
+            delete data;
+            break;
+        } default: {
+            break;
+        }
+    }
+}
+
+void DiiRtmpSource::StartPull() {
+    std::unique_lock<std::mutex> lck(mtx_);
+    DII_LOG(LS_INFO, stream_id_, 2002001) << "DiiRtmpSource start pull rtmp url: " << url_ << ", stream id:" << stream_id_;
+    if (running_)
+        return;
+    running_ = true;
+    playing_ = false;
+    reconnect_attempt_ = 0;
+    flow_since_ms_ = 0;
+    {
+        std::unique_lock<std::mutex> slck(shift_mtx_);
+        shift_live_ = true;
+        shift_paused_ = false;
+    }
+
+    av_decoder_->Start(true);
+    PlySyncMultiStream::Join(sync_group_, av_decoder_);
+    rtmp_puller_->StartPull(url_, true);
+}
+
+void DiiRtmpSource::StopPull() {
+    std::unique_lock<std::mutex> lck(mtx_);
+    if (!running_)
+        return;
+    DII_LOG(LS_INFO, stream_id_, 2002002) << "DiiRtmpSource stop pull rtmp url: " << url_ << ", stream id: " << stream_id_;
+
+    running_ = false;
+    dii_rtc::Thread::Clear(this, DII_MSG_REPULL);
+    dii_rtc::Thread::Clear(this, DII_MSG_TIMESHIFT_FEED);
+    rtmp_puller_->Shutdown();
+    PlySyncMultiStream::Leave(sync_group_, av_decoder_);
+    av_decoder_->Shutdown();
+}
+
+void DiiRtmpSource::AddSink(DiiRtmpSourceSink* sink) {
+    {
+        std::unique_lock<std::mutex> lck(sinks_mtx_);
+        SinkEntry entry;
+        entry.sink = sink;
+        sinks_.push_back(entry);
+        if (!primary_) {
+            primary_ = sink;
+            primary_pull_ms_ = dii_rtc::TimeMillis();
+        }
+    }
+    // a late joiner won't see the transition, tell it we're already up. not from here,
+    // the player attaching holds its own lock
+    if (playing_) {
+        dii_rtc::Thread::Post(RTC_FROM_HERE, this, DII_MSG_SINK_PLAYING,
+                              new dii_rtc::TypedMessageData<DiiRtmpSourceSink*>(sink));
+    }
+}
+
+bool DiiRtmpSource::RemoveSink(DiiRtmpSourceSink* sink, bool* handover) {
+    std::unique_lock<std::mutex> lck(sinks_mtx_);
+    auto it = FindSink(sink);
+    if (it != sinks_.end()) {
+        sinks_.erase(it);
+    }
+    if (primary_ == sink) {
+        primary_ = sinks_.empty() ? nullptr : sinks_.front().sink;
+        primary_pull_ms_ = dii_rtc::TimeMillis();
+        *handover = primary_ != nullptr;
+    }
+    return !sinks_.empty();
+}
+
+void DiiRtmpSource::WaitSinkCalls(DiiRtmpSourceSink* sink) {
+    // a call further up this thread's stack is the one detaching, it can't be waited for
+    std::thread::id self = std::this_thread::get_id();
+    std::unique_lock<std::mutex> lck(sinks_mtx_);
+    calling_cond_.wait(lck, [&] {
+        return std::none_of(calling_.begin(), calling_.end(),
+                            [&](const std::pair<DiiRtmpSourceSink*, std::thread::id>& call) {
+                                return call.first == sink && call.second != self;
+                            });
+    });
+}
+
+void DiiRtmpSource::CallSinks(const std::function<void (DiiRtmpSourceSink* sink)>& call, DiiRtmpSourceSink* only) {
+    std::vector<DiiRtmpSourceSink*> sinks;
+    {
+        std::unique_lock<std::mutex> lck(sinks_mtx_);
+        sinks.reserve(sinks_.size());
+        for (auto& entry : sinks_) {
+            if (!only || entry.sink == only) {
+                sinks.push_back(entry.sink);
+            }
+        }
+    }
+    std::pair<DiiRtmpSourceSink*, std::thread::id> current(nullptr, std::this_thread::get_id());
+    for (auto sink : sinks) {
+        current.first = sink;
+        {
+            std::unique_lock<std::mutex> lck(sinks_mtx_);
+            // detached meanwhile, maybe by a callback earlier in this loop
+            if (FindSink(sink) == sinks_.end()) {
+                continue;
+            }
+            calling_.push_back(current);
+        }
+        call(sink);
+        {
+            std::unique_lock<std::mutex> lck(sinks_mtx_);
+            calling_.erase(std::find(calling_.begin(), calling_.end(), current));
+        }
+        calling_cond_.notify_all();
+    }
+}
+
+std::vector<DiiRtmpSource::SinkEntry>::iterator DiiRtmpSource::FindSink(DiiRtmpSourceSink* sink) {
+    return std::find_if(sinks_.begin(), sinks_.end(), [sink](const SinkEntry& entry) {
+        return entry.sink == sink;
+    });
+}
+
+int32_t DiiRtmpSource::SinkCount() {
+    std::unique_lock<std::mutex> lck(sinks_mtx_);
+    return (int32_t)sinks_.size();
+}
+
+bool DiiRtmpSource::IsPrimary(DiiRtmpSourceSink* sink) {
+    std::unique_lock<std::mutex> lck(sinks_mtx_);
+    return primary_ == sink;
+}
+
+void DiiRtmpSource::OnVideoFrame(dii_media_kit::VideoFrame& frame) {
+    // the frame only holds a reference to the decoded buffer, no pixel copy per player
+    CallSinks([&frame](DiiRtmpSourceSink* sink) {
+        sink->OnSourceVideoFrame(frame);
+    });
+}
+
+void DiiRtmpSource::NotifyState(int state, int code, const char* msg) {
+    CallSinks([state, code, msg](DiiRtmpSourceSink* sink) {
+        sink->OnSourceState(state, code, msg);
+    });
+}
+
+void DiiRtmpSource::ApplyPrimarySettings() {
+    std::unique_lock<std::mutex> lck(mtx_);
+    int32_t delay_ms = -1;
+    int32_t group_id = 0;
+    {
+        std::unique_lock<std::mutex> slck(sinks_mtx_);
+        auto it = FindSink(primary_);
+        if (it == sinks_.end()) {
+            return;
+        }
+        delay_ms = it->playout_delay_ms;
+        group_id = it->sync_group;
+    }
+    if (delay_ms >= 0) {
+        av_decoder_->SetPlayoutDelay(delay_ms);
+    }
+    if (group_id == sync_group_) {
+        return;
+    }
+    if (running_) {
+        PlySyncMultiStream::Leave(sync_group_, av_decoder_);
+        PlySyncMultiStream::Join(group_id, av_decoder_);
+    }
+    sync_group_ = group_id;
+}
+
+int DiiRtmpSource::GetMorePcmData(DiiRtmpSourceSink* sink, void *audioSamples, size_t samplesPerSec,
+                                  size_t nChannels, uint64_t &sync_ts) {
+    // the primary's playout drives the sync clock, the others follow its video
+    bool handover = false;
+    {
+        std::unique_lock<std::mutex> lck(sinks_mtx_);
+        int64_t now = dii_rtc::TimeMillis();
+        if (primary_ != sink) {
+            if (now - primary_pull_ms_ < PRIMARY_IDLE_MS || FindSink(sink) == sinks_.end()) {
+                sync_ts = sync_ts_;
+                return 0;
+            }
+            // the primary is paused or stopped its audio playout, keep audio and the clock going
+            primary_ = sink;
+            handover = true;
+        }
+        primary_pull_ms_ = now;
+    }
+    if (handover) {
+        DII_LOG(LS_INFO, stream_id_, DII_CODE_COMMON_INFO) << "DiiRtmpSource primary player handed over, url: " << url_;
+        ApplyPrimarySettings();
+    }
+
+    int ret = av_decoder_->GetMorePcmData(audioSamples, samplesPerSec, nChannels, sync_ts);
+    if (sync_ts > 0) {
+        sync_ts_ = sync_ts;
+    }
+    if (ret > 0 && !playing_) {
+        playing_ = true;
+        NotifyState(DII_STATE_PLAYING, 0, "playing");
+    }
+    return ret;
+}
+
+void DiiRtmpSource::SetPlayoutDelay(DiiRtmpSourceSink* sink, int32_t delay_ms) {
+    {
+        std::unique_lock<std::mutex> lck(sinks_mtx_);
+        auto it = FindSink(sink);
+        if (it == sinks_.end()) {
+            return;
+        }
+        it->playout_delay_ms = delay_ms;
+        if (primary_ != sink) {
+            DII_LOG(LS_INFO, stream_id_, DII_CODE_COMMON_INFO) << "DiiRtmpSource playout delay " << delay_ms
+                << " ms kept for when the player drives the shared audio.";
+            return;
+        }
+    }
+    av_decoder_->SetPlayoutDelay(delay_ms);
+}
+
+void DiiRtmpSource::SetSyncGroup(DiiRtmpSourceSink* sink, int32_t group_id) {
+    {
+        std::unique_lock<std::mutex> lck(sinks_mtx_);
+        auto it = FindSink(sink);
+        if (it == sinks_.end()) {
+            return;
+        }
+        it->sync_group = group_id;
+        if (primary_ != sink) {
+            DII_LOG(LS_INFO, stream_id_, DII_CODE_COMMON_INFO) << "DiiRtmpSource sync group " << group_id
+                << " kept for when the player drives the shared audio.";
+            return;
+        }
+    }
+    ApplyPrimarySettings();
+}
+
+void DiiRtmpSource::DoStatistics(DiiRtmpSourceSink* sink, DiiPlayerStatistics& statistics) {
+    int32_t stream_id = statistics.stream_id;
+    {
+        std::unique_lock<std::mutex> lck(mtx_);
+        if (IsPrimary(sink)) {
+            av_decoder_->DoStatistics(last_statistics_);
+            rtmp_puller_->DoStatistics(last_statistics_);
+        }
+        statistics = last_statistics_;
+        if (timeshift_) {
+            int64_t playing = av_decoder_->PlayingTs();
+            std::unique_lock<std::mutex> slck(shift_mtx_);
+            statistics.timeshift_window_ms_ = (int32_t)WindowMs();
+            statistics.timeshift_behind_live_ms_ = playing > 0 ? (int32_t)(timeshift_->LastTs() - (uint32_t)playing) : 0;
+            statistics.timeshift_memory_kb_ = (int32_t)(timeshift_->MemoryBytes() / 1024);
+            statistics.timeshift_disk_kb_ = (int32_t)(timeshift_->DiskBytes() / 1024);
+        }
+    }
+    {
+        std::unique_lock<std::mutex> lck(record_mtx_);
+        auto it = recorders_.find(sink);
+        statistics.record_kb_ = it != recorders_.end() ? (int32_t)(it->second->BytesWritten() / 1024) : 0;
+        statistics.record_dropped_packets_ = it != recorders_.end() ? it->second->DroppedPackets() : 0;
+    }
+    statistics.stream_id = stream_id;
+    statistics.shared_players_ = SinkCount();
+    statistics.rtmp_reconnects_ = retry_cnt_;
+}
+
+void DiiRtmpSource::OnPullVideoData(const dii_rtc::scoped_refptr<PlyBuffer>& frame, uint32_t ts, int32_t cts,
+                                    const PlyVideoInfo& info) {
+    NoteMediaFlow();
+    if (recorder_count_ > 0) {
+        RecordVideo(frame, ts, cts, info);
+    }
+    if (!timeshift_) {
+        av_decoder_->CacheAvcData(frame, ts, cts, info);
+        return;
+    }
+    std::unique_lock<std::mutex> lck(shift_mtx_);
+    timeshift_->AppendVideo(*frame, ts, cts, info);
+    if (shift_live_) {
+        av_decoder_->CacheAvcData(frame, ts, cts, info);
+    }
+}
+
+void DiiRtmpSource::OnPullAudioData(const dii_rtc::scoped_refptr<PlyBuffer>& frame, uint32_t ts, uint64_t sync_ts) {
+    NoteMediaFlow();
+    if (recorder_count_ > 0) {
+        RecordAudio(frame, ts);
+    }
+    if (!timeshift_) {
+        av_decoder_->CacheAacData(frame, ts, sync_ts);
+        return;
+    }
+    std::unique_lock<std::mutex> lck(shift_mtx_);
+    timeshift_->AppendAudio(*frame, ts, sync_ts);
+    if (shift_live_) {
+        av_decoder_->CacheAacData(frame, ts, sync_ts);
+    }
+}
+
+void DiiRtmpSource::OnPullAudioConfig(const uint8_t* config, int len) {
+    av_decoder_->SetAacConfig(config, len);
+    std::unique_lock<std::mutex> lck(record_mtx_);
+    aac_config_.assign(config, config + std::max(len, 0));
+    for (auto& it : recorders_) {
+        it.second->SetAudioConfig(config, len);
+    }
+}
+
+void DiiRtmpSource::RecordVideo(const dii_rtc::scoped_refptr<PlyBuffer>& frame, uint32_t ts, int32_t cts,
+                                const PlyVideoInfo& info) {
+    std::unique_lock<std::mutex> lck(record_mtx_);
+    for (auto& it : recorders_) {
+        it.second->AddVideo(frame, ts, cts, info);
+    }
+}
+
+void DiiRtmpSource::RecordAudio(const dii_rtc::scoped_refptr<PlyBuffer>& frame, uint32_t ts) {
+    std::unique_lock<std::mutex> lck(record_mtx_);
+    for (auto& it : recorders_) {
+        it.second->AddAudio(frame, ts);
+    }
+}
+
+int32_t DiiRtmpSource::StartRecord(DiiRtmpSourceSink* sink, const std::string& path, DiiRecordFormat format) {
+    StopRecord(sink);
+    std::unique_ptr<DiiRtmpRecorder> recorder(new DiiRtmpRecorder(stream_id_, path, format));
+    if (!recorder->Start()) {
+        return DII_ERROR;
+    }
+    std::unique_lock<std::mutex> lck(record_mtx_);
+    if (!aac_config_.empty()) {
+        recorder->SetAudioConfig(aac_config_.data(), (int)aac_config_.size());
+    }
+    recorders_[sink] = std::move(recorder);
+    recorder_count_ = (int32_t)recorders_.size();
+    return DII_DONE;
+}
+
+int32_t DiiRtmpSource::StopRecord(DiiRtmpSourceSink* sink) {
+    std::unique_ptr<DiiRtmpRecorder> recorder;
+    {
+        std::unique_lock<std::mutex> lck(record_mtx_);
+        auto it = recorders_.find(sink);
+        if (it == recorders_.end()) {
+            return DII_ERROR;
+        }
+        recorder = std::move(it->second);
+        recorders_.erase(it);
+        recorder_count_ = (int32_t)recorders_.size();
+    }
+    // finishing the file waits for the writer, keep ingest out of it
+    recorder.reset();
+    return DII_DONE;
+}
+
+void DiiRtmpSource::OnServerConnected() {
+}
+
+void DiiRtmpSource::OnPullFailed(int32_t errCode,int32_t eventid,const char * errmsg) {
+    if (running_) {
+        playing_ = false;
+        flow_since_ms_ = 0;
+
+        int32_t delay_ms = NextReconnectDelay();
+        dii_rtc::Thread::PostDelayed(RTC_FROM_HERE, delay_ms, this, DII_MSG_REPULL);
+        retry_cnt_++;
+        DII_LOG(LS_ERROR, stream_id_, eventid) << "rtmp repull url:" << url_ << errmsg << " ,err code:" << errCode
+                                               << ", retry in " << delay_ms << " ms";
+        if (retry_cnt_%3 != 0) {
+            return;
+        }
+        NotifyState(DII_STATE_ERROR, errCode, "rtmp pull failed");//error
+    }
+}
+
+void DiiRtmpSource::NoteMediaFlow() {
+    if (reconnect_attempt_ == 0) {
+        return;
+    }
+    // a server that takes the connection and drops it after a packet keeps backing off
+    int64_t now = dii_rtc::TimeMillis();
+    int64_t since = flow_since_ms_;
+    if (since == 0) {
+        flow_since_ms_ = now;
+    } else if (now - since >= RECONNECT_STEADY_MS) {
+        reconnect_attempt_ = 0;
+    }
+}
+
+int32_t DiiRtmpSource::NextReconnectDelay() {
+    int32_t attempt = reconnect_attempt_++;
+    if (attempt == 0) {
+        // most drops are transient, the cached address usually answers at once
+        return 0;
+    }
+    int32_t max_ms = backoff_max_ms_;
+    int64_t delay = backoff_initial_ms_;
+    for (int32_t i = 1; i < attempt && delay < max_ms; i++) {
+        delay *= 2;
+    }
+    delay = std::min<int64_t>(delay, max_ms);
+    std::uniform_int_distribution<int64_t> jitter(delay * 3 / 4, delay * 5 / 4);
+    return (int32_t)jitter(jitter_rng_);
+}
+
+int32_t DiiRtmpSource::Pause() {
+    if (!timeshift_) {
+        return DII_ERROR;
+    }
+    std::unique_lock<std::mutex> lck(shift_mtx_);
+    if (shift_paused_) {
+        return DII_DONE;
+    }
+    shift_paused_ = true;
+    // what the decoder already has plays on resume, the rest comes from the ring
+    if (shift_live_) {
+        shift_live_ = false;
+        replay_pos_ = timeshift_->End();
+    }
+    DII_LOG(LS_INFO, stream_id_, DII_CODE_COMMON_INFO) << "Timeshift pause, window: " << WindowMs() << " ms";
+    return DII_DONE;
+}
+
+int32_t DiiRtmpSource::Resume() {
+    if (!timeshift_) {
+        return DII_ERROR;
+    }
+    std::unique_lock<std::mutex> lck(shift_mtx_);
+    if (!shift_paused_) {
+        return DII_DONE;
+    }
+    shift_paused_ = false;
+    if (!shift_live_) {
+        StartReplay();
+    }
+    return DII_DONE;
+}
+
+int32_t DiiRtmpSource::Seek(int64_t pos) {
+    if (!timeshift_) {
+        return DII_ERROR;
+    }
+    std::unique_lock<std::mutex> lck(mtx_);
+    std::unique_lock<std::mutex> slck(shift_mtx_);
+    if (!running_ || timeshift_->Empty()) {
+        return DII_ERROR;
+    }
+    uint32_t first = timeshift_->FirstTs();
+    bool live = pos >= WindowMs() - TIMESHIFT_LIVE_EDGE;
+    uint32_t target = live ? timeshift_->LastTs() : first + (uint32_t)std::max<int64_t>(pos, 0);
+    DiiRtmpTimeshift::Cursor cursor;
+    timeshift_->FindKeyframe(target, &cursor);
+    DII_LOG(LS_INFO, stream_id_, DII_CODE_COMMON_INFO) << "Timeshift seek to " << pos << " ms"
+        << (live ? ", back to live" : "");
+    ReplayFrom(cursor, live);
+    return DII_DONE;
+}
+
+int64_t DiiRtmpSource::Position() {
+    if (!timeshift_) {
+        return 0;
+    }
+    std::unique_lock<std::mutex> lck(mtx_);
+    int64_t playing = running_ ? av_decoder_->PlayingTs() : 0;
+    std::unique_lock<std::mutex> slck(shift_mtx_);
+    int64_t duration = WindowMs();
+    if (playing == 0) {
+        return shift_live_ ? duration : 0;
+    }
+    int64_t pos = (int32_t)((uint32_t)playing - timeshift_->FirstTs());
+    return std::min(std::max<int64_t>(pos, 0), duration);
+}
+
+int64_t DiiRtmpSource::Duration() {
+    if (!timeshift_) {
+        return 0;
+    }
+    std::unique_lock<std::mutex> lck(shift_mtx_);
+    return WindowMs();
+}
+
+int64_t DiiRtmpSource::WindowMs() {
+    if (timeshift_->Empty()) {
+        return 0;
+    }
+    return std::max((int32_t)(timeshift_->LastTs() - timeshift_->FirstTs()), 0);
+}
+
+void DiiRtmpSource::ReplayFrom(const DiiRtmpTimeshift::Cursor& pos, bool catch_up) {
+    // the decoder starts over empty and waits for the keyframe at |pos|, it keeps the aac config.
+    // its buffer goes away with it, so it is out of the sync group meanwhile.
+    PlySyncMultiStream::Leave(sync_group_, av_decoder_);
+    av_decoder_->Shutdown();
+    av_decoder_->Start(true);
+    PlySyncMultiStream::Join(sync_group_, av_decoder_);
+    shift_live_ = false;
+    replay_pos_ = pos;
+    replay_catch_up_ = catch_up;
+    if (!shift_paused_) {
+        StartReplay();
+    }
+}
+
+void DiiRtmpSource::StartReplay() {
+    uint32_t ts = 0;
+    replay_anchor_ts_ = timeshift_->PeekTs(&replay_pos_, &ts) ? ts : timeshift_->LastTs();
+    replay_anchor_ms_ = dii_rtc::TimeMillis();
+    dii_rtc::Thread::Clear(this, DII_MSG_TIMESHIFT_FEED);
+    dii_rtc::Thread::Post(RTC_FROM_HERE, this, DII_MSG_TIMESHIFT_FEED);
+}
+
+void DiiRtmpSource::FeedTimeshift() {
+    std::unique_lock<std::mutex> lck(mtx_);
+    std::unique_lock<std::mutex> slck(shift_mtx_);
+    if (!running_ || shift_live_ || shift_paused_) {
+        return;
+    }
+    if (!timeshift_->IsValid(replay_pos_)) {
+        // paused for longer than the window, what came next is gone
+        DiiRtmpTimeshift::Cursor oldest;
+        if (timeshift_->FindKeyframe(timeshift_->FirstTs(), &oldest)) {
+            DII_LOG(LS_WARNING, stream_id_, DII_CODE_COMMON_WARN) << "Timeshift position left the window, "
+                "continue at its start.";
+            ReplayFrom(oldest, false);
+            return;
+        }
+        replay_pos_ = timeshift_->End();
+    }
+
+    int64_t due = dii_rtc::TimeMillis() - replay_anchor_ms_ + TIMESHIFT_FEED_LEAD;
+    DiiRtmpTimeshift::Record record;
+    uint32_t ts = 0;
+    while (timeshift_->PeekTs(&replay_pos_, &ts)) {
+        if (!replay_catch_up_ && (int32_t)(ts - replay_anchor_ts_) > due) {
+            dii_rtc::Thread::PostDelayed(RTC_FROM_HERE, TIMESHIFT_FEED_INTERVAL, this, DII_MSG_TIMESHIFT_FEED);
+            return;
+        }
+        timeshift_->Read(&replay_pos_, &record);
+        ForwardRecord(record);
+    }
+    // caught up, the ingest feeds the decoder again
+    shift_live_ = true;
+    replay_catch_up_ = false;
+    DII_LOG(LS_INFO, stream_id_, DII_CODE_COMMON_INFO) << "Timeshift back to live.";
+}
+
+void DiiRtmpSource::ForwardRecord(const DiiRtmpTimeshift::Record& record) {
+    if (record.video) {
+        av_decoder_->CacheAvcData(record.data, record.ts, record.cts, record.info);
+    } else {
+        av_decoder_->CacheAacData(record.data, record.ts, record.sync_ts);
+    }
+}
+} // namespace dii_media_kit
@@ -0,0 +1,219 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#ifndef __DII_RTMP_SOURCE_H__
+#define __DII_RTMP_SOURCE_H__
+
+#include "dii_common.h"
+#include "dii_rtmp_puller.h"
+#include "dii_rtmp_decoder.h"
+#include "dii_rtmp_recorder.h"
+#include "dii_rtmp_timeshift.h"
+
+#include "webrtc/base/messagehandler.h"
+#include "webrtc/base/thread.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace dii_media_kit {
+class DiiRtmpSourceSink {
+public:
+    virtual ~DiiRtmpSourceSink() {}
+    virtual void OnSourceState(int state, int code, const char* msg) = 0;
+    virtual void OnSourceVideoFrame(dii_media_kit::VideoFrame& frame) = 0;
+};
+
+// One rtmp pull + decode shared by every player opened on the same url.
+// Decoded frames are ref-counted and handed to all attached sinks; audio
+// (and therefore the a/v sync clock) is driven by the primary sink. That is
+// the first attached one until it stops pulling audio (paused, audio playout
+// stopped) and another sink pulls instead. Sinks are called without a lock
+// held, they may detach from inside a callback.
+// With timeshift on every player gets a source of its own, the packets are
+// kept in a DiiRtmpTimeshift and the decoder is fed from it while the player
+// is paused or behind live.
+class DiiRtmpSource : public DiiPullerCallback,
+                      public dii_rtc::Thread,
+                      public dii_rtc::MessageHandler {
+    // the unit tests stand in for the puller and the audio device
+    friend class DiiRtmpSourceTest;
+public:
+    // returns the source already pulling |url|, or starts a new one
+    static std::shared_ptr<DiiRtmpSource> Attach(const std::string& url,
+                                                 int32_t stream_id,
+                                                 DiiRtmpSourceSink* sink);
+    // stops the source once its last sink is gone
+    static void Detach(const std::shared_ptr<DiiRtmpSource>& source, DiiRtmpSourceSink* sink);
+
+    DiiRtmpSource(const std::string& key, const std::string& url, int32_t stream_id);
+    ~DiiRtmpSource();
+
+    // only the primary sink consumes pcm, others get silence (0) and its sync timestamp.
+    // a sink pulling while the primary hasn't for PRIMARY_IDLE_MS becomes the primary
+    int GetMorePcmData(DiiRtmpSourceSink* sink, void *audioSamples, size_t samplesPerSec,
+                       size_t nChannels, uint64_t &sync_ts);
+    // playout delay and sync group are kept per sink, the decoder takes the primary's.
+    // a sink's values apply once it becomes the primary.
+    void SetPlayoutDelay(DiiRtmpSourceSink* sink, int32_t delay_ms);
+    // plays this source on one timeline with the others in |group_id|, 0 leaves.
+    void SetSyncGroup(DiiRtmpSourceSink* sink, int32_t group_id);
+    void DoStatistics(DiiRtmpSourceSink* sink, DiiPlayerStatistics& statistics);
+    int32_t SinkCount();
+    // after a failed or dropped pull the first retry is immediate, the next ones wait
+    // initial_ms doubling up to max_ms, with +-25% jitter so viewers don't retry in step.
+    // the steps start over once media has flowed for a few seconds
+    static void SetReconnectBackoff(int32_t initial_ms, int32_t max_ms);
+    // keep |window_ms| of every stream for pause and seek, |memory_bytes| of it in memory and
+    // the rest spilled to a file in |spill_dir|. 0 (default) turns it off. applies to sources
+    // started afterwards.
+    static void SetTimeshift(int32_t window_ms, int64_t memory_bytes, const std::string& spill_dir);
+    static bool TimeshiftEnabled() { return timeshift_window_ms_ > 0; }
+
+    // timeshift, DII_ERROR when it is off
+    int32_t Pause();
+    int32_t Resume();
+    // |pos| in ms from the start of the window, at the end of it the player goes back to live
+    int32_t Seek(int64_t pos);
+    int64_t Position();
+    // length of the window kept so far
+    int64_t Duration();
+
+    // remux what is pulled into |path| for |sink| until StopRecord, a recording it
+    // already has is closed first. a player that detaches stops its recording.
+    int32_t StartRecord(DiiRtmpSourceSink* sink, const std::string& path, DiiRecordFormat format);
+    int32_t StopRecord(DiiRtmpSourceSink* sink);
+
+protected:
+    void OnServerConnected() override;
+    void OnPullFailed(int32_t errCode, int32_t eventid, const char * errmsg) override;
+    void OnPullVideoData(const dii_rtc::scoped_refptr<PlyBuffer>& frame, uint32_t ts, int32_t cts,
+                         const PlyVideoInfo& info) override;
+    void OnPullAudioData(const dii_rtc::scoped_refptr<PlyBuffer>& frame, uint32_t ts, uint64_t sync_ts) override;
+    void OnPullAudioConfig(const uint8_t* config, int len) override;
+private:
+    //* For MessageHandler
+    virtual void OnMessage(dii_rtc::Message* msg) override;
+
+    void StartPull();
+    void StopPull();
+    void AddSink(DiiRtmpSourceSink* sink);
+    // true while other sinks remain, with the primary role handed on if |sink| had it
+    bool RemoveSink(DiiRtmpSourceSink* sink, bool* handover);
+    // returns once no other thread is calling |sink| any more
+    void WaitSinkCalls(DiiRtmpSourceSink* sink);
+    // calls every attached sink, or |only|, without sinks_mtx_ held
+    void CallSinks(const std::function<void (DiiRtmpSourceSink* sink)>& call, DiiRtmpSourceSink* only = nullptr);
+    void OnVideoFrame(dii_media_kit::VideoFrame& frame);
+    void NotifyState(int state, int code, const char* msg);
+    bool IsPrimary(DiiRtmpSourceSink* sink);
+    // playout delay and sync group of the primary to the decoder
+    void ApplyPrimarySettings();
+    // resets the backoff once media has flowed RECONNECT_STEADY_MS since the last failure
+    void NoteMediaFlow();
+    int32_t NextReconnectDelay();
+    // feeds the decoder the replayed packets that are due, on the source thread
+    void FeedTimeshift();
+    void ForwardRecord(const DiiRtmpTimeshift::Record& record);
+    // restarts the decoder at |pos|, mtx_ and shift_mtx_ held
+    void ReplayFrom(const DiiRtmpTimeshift::Cursor& pos, bool catch_up);
+    void StartReplay();
+    // Duration with shift_mtx_ held
+    int64_t WindowMs();
+    void RecordVideo(const dii_rtc::scoped_refptr<PlyBuffer>& frame, uint32_t ts, int32_t cts,
+                     const PlyVideoInfo& info);
+    void RecordAudio(const dii_rtc::scoped_refptr<PlyBuffer>& frame, uint32_t ts);
+private:
+    static std::mutex                                   sources_mtx_;
+    static std::map<std::string, std::weak_ptr<DiiRtmpSource>> sources_;
+    static std::atomic<int32_t>                         backoff_initial_ms_;
+    static std::atomic<int32_t>                         backoff_max_ms_;
+    static std::atomic<int32_t>                         timeshift_window_ms_;
+    static std::atomic<int64_t>                         timeshift_memory_bytes_;
+    static std::mutex                                   timeshift_dir_mtx_;
+    static std::string                                  timeshift_dir_;
+
+    std::mutex mtx_;
+    bool running_ = false;
+    int32_t stream_id_ = -1;
+    std::string key_;
+    std::string url_;
+
+    DiiRtmpPuller*            rtmp_puller_ = nullptr;
+    DiiRtmpDecoder*           av_decoder_ = nullptr;
+    int32_t                   retry_cnt_ = 0;
+    // retries since media last flowed steadily, picks the backoff step
+    std::atomic<int32_t>      reconnect_attempt_{0};
+    // first packet after the last failure, 0 before it
+    std::atomic<int64_t>      flow_since_ms_{0};
+    std::mt19937              jitter_rng_{std::random_device()()};
+    std::atomic<bool>         playing_{false};
+    std::atomic<uint64_t>     sync_ts_{0};
+    // PlySyncMultiStream group the decoder is in while pulling, under mtx_
+    int32_t                   sync_group_ = 0;
+
+    struct SinkEntry {
+        DiiRtmpSourceSink*  sink = nullptr;
+        int32_t             playout_delay_ms = -1;  // -1 never set
+        int32_t             sync_group = 0;
+    };
+    std::vector<SinkEntry>::iterator FindSink(DiiRtmpSourceSink* sink);
+
+    std::mutex                          sinks_mtx_;
+    std::vector<SinkEntry>              sinks_;
+    DiiRtmpSourceSink*                  primary_ = nullptr;
+    int64_t                             primary_pull_ms_ = 0;
+    // sinks being called and the calling thread, RemoveSink waits for the other threads
+    std::vector<std::pair<DiiRtmpSourceSink*, std::thread::id>> calling_;
+    std::condition_variable             calling_cond_;
+    // snapshot of the primary's last statistics, the decoder resets its counters per call
+    DiiPlayerStatistics                 last_statistics_;
+
+    // ingest and replay hand packets to the decoder under it, in order
+    std::mutex                          shift_mtx_;
+    std::unique_ptr<DiiRtmpTimeshift>   timeshift_;
+    // ingest goes straight to the decoder, otherwise it is fed from replay_pos_
+    bool                                shift_live_ = true;
+    bool                                shift_paused_ = false;
+    DiiRtmpTimeshift::Cursor            replay_pos_;
+    // replayed packets are due in real time from here on
+    uint32_t                            replay_anchor_ts_ = 0;
+    int64_t                             replay_anchor_ms_ = 0;
+    // back to live, feed without pacing until the newest packet
+    bool                                replay_catch_up_ = false;
+
+    // recordings by player, ingest only takes record_mtx_ while there are any
+    std::mutex                          record_mtx_;
+    std::map<DiiRtmpSourceSink*, std::unique_ptr<DiiRtmpRecorder>> recorders_;
+    std::atomic<int32_t>                recorder_count_{0};
+    // for recordings started after the sequence header
+    std::vector<uint8_t>                aac_config_;
+};
+
+}	// namespace dii_media_kit
+
+#endif	// __DII_RTMP_SOURCE_H__
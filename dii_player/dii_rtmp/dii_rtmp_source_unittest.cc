@@ -0,0 +1,255 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#include "dii_rtmp_source.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "webrtc/base/timeutils.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+
+namespace dii_media_kit {
+
+namespace {
+
+// PRIMARY_IDLE_MS and RECONNECT_STEADY_MS in dii_rtmp_source.cc
+const int64_t kPrimaryIdleMs = 200;
+const int64_t kReconnectSteadyMs = 5000;
+// nothing is there, a pull fails at once without any network
+const char kMissingUrl[] = "flvfile:///nonexistent/dii_rtmp_source_unittest.flv";
+
+class FakeSink : public DiiRtmpSourceSink {
+public:
+    void OnSourceState(int state, int code, const char* msg) override {
+        states++;
+        if (on_state) {
+            on_state(state);
+        }
+    }
+    void OnSourceVideoFrame(dii_media_kit::VideoFrame& frame) override {}
+
+    std::function<void (int state)> on_state;
+    std::atomic<int32_t> states{0};
+};
+
+// ScopedFakeClock waits for every message queue on each step, the never started
+// puller and decoder threads of these sources would never answer
+class ScopedManualClock : public dii_rtc::ClockInterface {
+public:
+    ScopedManualClock() { prev_clock_ = dii_rtc::SetClockForTesting(this); }
+    ~ScopedManualClock() { dii_rtc::SetClockForTesting(prev_clock_); }
+    uint64_t TimeNanos() const override { return time_ns_; }
+    void AdvanceMs(int64_t ms) { time_ns_ += ms * dii_rtc::kNumNanosecsPerMillisec; }
+
+private:
+    dii_rtc::ClockInterface* prev_clock_;
+    std::atomic<uint64_t> time_ns_{0};
+};
+
+}  // namespace
+
+// sources made here are never started, the tests call what the puller and
+// the audio device would
+class DiiRtmpSourceTest : public ::testing::Test {
+protected:
+    void TearDown() override {
+        DiiRtmpSource::SetReconnectBackoff(500, 8000);
+        DiiRtmpSource::SetTimeshift(0, 32 << 20, "");
+    }
+
+    std::shared_ptr<DiiRtmpSource> NewSource() {
+        return std::make_shared<DiiRtmpSource>(kMissingUrl, kMissingUrl, 0);
+    }
+    static void AddSink(DiiRtmpSource& source, DiiRtmpSourceSink* sink) { source.AddSink(sink); }
+    static bool IsPrimary(DiiRtmpSource& source, DiiRtmpSourceSink* sink) { return source.IsPrimary(sink); }
+    static void NotifyState(DiiRtmpSource& source, int state) { source.NotifyState(state, 0, "test"); }
+    static void SetSyncTs(DiiRtmpSource& source, uint64_t sync_ts) { source.sync_ts_ = sync_ts; }
+    static int32_t NextReconnectDelay(DiiRtmpSource& source) { return source.NextReconnectDelay(); }
+    // the first packet after a failure, as OnPullFailed leaves it
+    static void PullFailed(DiiRtmpSource& source) { source.flow_since_ms_ = 0; }
+    static void MediaFlows(DiiRtmpSource& source) { source.NoteMediaFlow(); }
+    static int GetMorePcmData(DiiRtmpSource& source, DiiRtmpSourceSink* sink, uint64_t& sync_ts) {
+        int16_t pcm[480 * 2];
+        return source.GetMorePcmData(sink, pcm, 48000, 2, sync_ts);
+    }
+};
+
+TEST_F(DiiRtmpSourceTest, PlayersOfOneUrlShareASource) {
+    FakeSink a, b, c;
+    std::shared_ptr<DiiRtmpSource> source_a = DiiRtmpSource::Attach(kMissingUrl, 1, &a);
+    std::shared_ptr<DiiRtmpSource> source_b = DiiRtmpSource::Attach(kMissingUrl, 2, &b);
+    std::shared_ptr<DiiRtmpSource> source_c = DiiRtmpSource::Attach(std::string(kMissingUrl) + "2", 3, &c);
+    EXPECT_EQ(source_a, source_b);
+    EXPECT_NE(source_a, source_c);
+    EXPECT_EQ(2, source_a->SinkCount());
+    EXPECT_EQ(1, source_c->SinkCount());
+
+    // the source lives on while a player is attached
+    DiiRtmpSource::Detach(source_a, &a);
+    EXPECT_EQ(1, source_b->SinkCount());
+    std::shared_ptr<DiiRtmpSource> source_a2 = DiiRtmpSource::Attach(kMissingUrl, 1, &a);
+    EXPECT_EQ(source_b, source_a2);
+
+    // and a url whose last player left starts over
+    DiiRtmpSource::Detach(source_a2, &a);
+    DiiRtmpSource::Detach(source_b, &b);
+    EXPECT_EQ(0, source_b->SinkCount());
+    std::shared_ptr<DiiRtmpSource> source_b2 = DiiRtmpSource::Attach(kMissingUrl, 2, &b);
+    EXPECT_NE(source_b, source_b2);
+    DiiRtmpSource::Detach(source_b2, &b);
+    DiiRtmpSource::Detach(source_c, &c);
+}
+
+TEST_F(DiiRtmpSourceTest, TimeshiftGivesEveryPlayerItsOwnSource) {
+    DiiRtmpSource::SetTimeshift(10000, 1 << 20, "");
+    FakeSink a, b;
+    std::shared_ptr<DiiRtmpSource> source_a = DiiRtmpSource::Attach(kMissingUrl, 1, &a);
+    std::shared_ptr<DiiRtmpSource> source_b = DiiRtmpSource::Attach(kMissingUrl, 2, &b);
+    EXPECT_NE(source_a, source_b);
+    EXPECT_EQ(1, source_a->SinkCount());
+    EXPECT_EQ(1, source_b->SinkCount());
+    DiiRtmpSource::Detach(source_a, &a);
+    DiiRtmpSource::Detach(source_b, &b);
+}
+
+TEST_F(DiiRtmpSourceTest, IdlePrimaryHandsAudioOver) {
+    ScopedManualClock clock;
+    clock.AdvanceMs(1000);
+    std::shared_ptr<DiiRtmpSource> source = NewSource();
+    FakeSink a, b;
+    AddSink(*source, &a);
+    AddSink(*source, &b);
+    SetSyncTs(*source, 1234);
+    EXPECT_TRUE(IsPrimary(*source, &a));
+
+    // a follower gets silence and the primary's sync timestamp
+    uint64_t sync_ts = 0;
+    EXPECT_EQ(0, GetMorePcmData(*source, &b, sync_ts));
+    EXPECT_EQ(1234u, sync_ts);
+    GetMorePcmData(*source, &a, sync_ts);
+    clock.AdvanceMs(kPrimaryIdleMs - 1);
+    EXPECT_EQ(0, GetMorePcmData(*source, &b, sync_ts));
+    EXPECT_TRUE(IsPrimary(*source, &a));
+
+    // the primary stopped pulling, the next one to pull takes over
+    clock.AdvanceMs(1);
+    GetMorePcmData(*source, &b, sync_ts);
+    EXPECT_TRUE(IsPrimary(*source, &b));
+    sync_ts = 0;
+    EXPECT_EQ(0, GetMorePcmData(*source, &a, sync_ts));
+    EXPECT_EQ(1234u, sync_ts);
+    EXPECT_TRUE(IsPrimary(*source, &b));
+
+    // a primary that detaches hands over at once
+    DiiRtmpSource::Detach(source, &b);
+    EXPECT_TRUE(IsPrimary(*source, &a));
+    DiiRtmpSource::Detach(source, &a);
+}
+
+TEST_F(DiiRtmpSourceTest, SinksDetachFromInsideTheirCallback) {
+    std::shared_ptr<DiiRtmpSource> source = NewSource();
+    FakeSink a, b, c;
+    AddSink(*source, &a);
+    AddSink(*source, &b);
+    AddSink(*source, &c);
+    // no lock is held while a sink is called, and a sink doesn't wait for itself
+    a.on_state = [&](int state) { DiiRtmpSource::Detach(source, &a); };
+    // a sink detached further down the list isn't called any more
+    b.on_state = [&](int state) { DiiRtmpSource::Detach(source, &c); };
+    NotifyState(*source, DII_STATE_PLAYING);
+    EXPECT_EQ(1, a.states);
+    EXPECT_EQ(1, b.states);
+    EXPECT_EQ(0, c.states);
+    EXPECT_EQ(1, source->SinkCount());
+    EXPECT_TRUE(IsPrimary(*source, &b));
+    DiiRtmpSource::Detach(source, &b);
+}
+
+TEST_F(DiiRtmpSourceTest, DetachWaitsForACallOnAnotherThread) {
+    std::shared_ptr<DiiRtmpSource> source = NewSource();
+    FakeSink a;
+    AddSink(*source, &a);
+    std::atomic<bool> entered(false);
+    std::atomic<bool> release(false);
+    a.on_state = [&](int state) {
+        entered = true;
+        while (!release) {
+            std::this_thread::yield();
+        }
+    };
+    std::thread notifier([&] { NotifyState(*source, DII_STATE_PLAYING); });
+    while (!entered) {
+        std::this_thread::yield();
+    }
+
+    std::atomic<bool> detached(false);
+    std::thread detacher([&] {
+        DiiRtmpSource::Detach(source, &a);
+        detached = true;
+    });
+    // the sink is gone from the list while its call is still running
+    while (source->SinkCount() > 0) {
+        std::this_thread::yield();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_FALSE(detached);
+
+    release = true;
+    detacher.join();
+    notifier.join();
+    EXPECT_TRUE(detached);
+    EXPECT_EQ(1, a.states);
+}
+
+TEST_F(DiiRtmpSourceTest, ReconnectBackoffStartsOverOnceMediaFlows) {
+    ScopedManualClock clock;
+    clock.AdvanceMs(1000);
+    DiiRtmpSource::SetReconnectBackoff(100, 400);
+    std::shared_ptr<DiiRtmpSource> source = NewSource();
+
+    // immediate, then doubling with +-25% jitter up to the maximum
+    EXPECT_EQ(0, NextReconnectDelay(*source));
+    const int32_t steps[] = {100, 200, 400, 400};
+    for (int32_t step : steps) {
+        int32_t delay = NextReconnectDelay(*source);
+        EXPECT_GE(delay, step * 3 / 4);
+        EXPECT_LE(delay, step * 5 / 4);
+    }
+
+    // a connection that drops before media flowed steadily keeps backing off
+    PullFailed(*source);
+    MediaFlows(*source);
+    clock.AdvanceMs(kReconnectSteadyMs - 1);
+    MediaFlows(*source);
+    PullFailed(*source);
+    EXPECT_GE(NextReconnectDelay(*source), 300);
+
+    MediaFlows(*source);
+    clock.AdvanceMs(kReconnectSteadyMs);
+    MediaFlows(*source);
+    PullFailed(*source);
+    EXPECT_EQ(0, NextReconnectDelay(*source));
+    int32_t delay = NextReconnectDelay(*source);
+    EXPECT_GE(delay, 75);
+    EXPECT_LE(delay, 125);
+}
+
+}  // namespace dii_media_kit
@@ -0,0 +1,189 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#include "dii_com_def.h"
+#include "dii_rtmp_sync_multi_stream.h"
+#include "webrtc/base/logging.h"
+#include "webrtc/base/timeutils.h"
+
+#include <algorithm>
+#include <limits>
+
+#define DII_MSG_SYNC_ALIGN          1000
+
+#define SYNC_ALIGN_INTERVAL         100     // ms between alignments
+#define SYNC_MAX_CLOCK_AGE          1000    // a member whose audio stalled this long is left out
+#define SYNC_MAX_EXTRAPOLATE        200     // like the video scheduler, not across a stall
+#define SYNC_MAX_GROUP_DELAY        3000    // a member further ahead is not held back fully
+#define SYNC_DELAY_SMOOTHING        0.25f   // share of the change applied per alignment
+
+namespace dii_media_kit {
+std::mutex PlySyncMultiStream::groups_mtx_;
+std::map<int32_t, PlySyncMultiStream*> PlySyncMultiStream::groups_;
+
+void PlySyncMultiStream::Join(int32_t group_id, DiiRtmpDecoder* decoder) {
+    if (group_id == 0 || !decoder) {
+        return;
+    }
+    std::unique_lock<std::mutex> lck(groups_mtx_);
+    PlySyncMultiStream*& group = groups_[group_id];
+    if (!group) {
+        group = new PlySyncMultiStream(group_id);
+    }
+    group->Add(decoder);
+}
+
+void PlySyncMultiStream::Leave(int32_t group_id, DiiRtmpDecoder* decoder) {
+    PlySyncMultiStream* empty = nullptr;
+    {
+        std::unique_lock<std::mutex> lck(groups_mtx_);
+        auto it = groups_.find(group_id);
+        if (it == groups_.end()) {
+            return;
+        }
+        if (!it->second->Remove(decoder)) {
+            empty = it->second;
+            groups_.erase(it);
+        }
+    }
+    // waits for a running alignment, outside the registry lock
+    delete empty;
+}
+
+PlySyncMultiStream::PlySyncMultiStream(int32_t group_id)
+    : group_id_(group_id) {
+    dii_rtc::Thread::Start();
+    dii_rtc::Thread::PostDelayed(RTC_FROM_HERE, SYNC_ALIGN_INTERVAL, this, DII_MSG_SYNC_ALIGN);
+}
+
+PlySyncMultiStream::~PlySyncMultiStream() {
+    dii_rtc::Thread::Clear(this, DII_MSG_SYNC_ALIGN);
+    dii_rtc::Thread::Stop();
+}
+
+void PlySyncMultiStream::OnMessage(dii_rtc::Message* msg) {
+    if (msg->message_id != DII_MSG_SYNC_ALIGN) {
+        return;
+    }
+    Align();
+    dii_rtc::Thread::PostDelayed(RTC_FROM_HERE, SYNC_ALIGN_INTERVAL, this, DII_MSG_SYNC_ALIGN);
+}
+
+void PlySyncMultiStream::Add(DiiRtmpDecoder* decoder) {
+    std::unique_lock<std::mutex> lck(mtx_);
+    for (const Member& member : members_) {
+        if (member.decoder == decoder) {
+            return;
+        }
+    }
+    Member member;
+    member.decoder = decoder;
+    members_.push_back(member);
+    decoder->sync_group_ = group_id_;
+    DII_LOG(LS_INFO, decoder->stream_id_, DII_CODE_COMMON_INFO) << "Sync group " << group_id_
+        << " joined, members: " << members_.size();
+}
+
+bool PlySyncMultiStream::Remove(DiiRtmpDecoder* decoder) {
+    std::unique_lock<std::mutex> lck(mtx_);
+    for (auto it = members_.begin(); it != members_.end(); ++it) {
+        if (it->decoder != decoder) {
+            continue;
+        }
+        // free running again
+        decoder->sync_group_ = 0;
+        decoder->group_delay_ms_ = 0;
+        decoder->group_skew_ms_ = 0;
+        if (decoder->ply_buffer_) {
+            decoder->ply_buffer_->SetGroupDelay(0);
+        }
+        members_.erase(it);
+        DII_LOG(LS_INFO, decoder->stream_id_, DII_CODE_COMMON_INFO) << "Sync group " << group_id_
+            << " left, members: " << members_.size();
+        break;
+    }
+    return !members_.empty();
+}
+
+// where the member plays right now, the audio clock moved on since it was sampled
+int64_t PlySyncMultiStream::PlayoutPos(const Point& point, bool use_sync_ts, int64_t now) {
+    int64_t elapsed = std::min<int64_t>(now - point.update_ms, SYNC_MAX_EXTRAPOLATE);
+    return (use_sync_ts ? (int64_t)point.sync_ts : point.pts) + elapsed;
+}
+
+void PlySyncMultiStream::Align() {
+    std::unique_lock<std::mutex> lck(mtx_);
+    std::vector<Point> points;
+    points.reserve(members_.size());
+    int64_t now = dii_rtc::TimeMillis();
+    bool use_sync_ts = true;
+    for (Member& member : members_) {
+        DiiRtmpBuffer* buffer = member.decoder->ply_buffer_;
+        Point point = {&member, 0, 0, 0, 0};
+        if (!buffer || !buffer->GetPlayoutPoint(point.sync_ts, point.pts, point.cache_ms, point.update_ms) ||
+            now - point.update_ms > SYNC_MAX_CLOCK_AGE) {
+            // buffering or not playing, it catches up with the others once it starts
+            member.decoder->group_skew_ms_ = 0;
+            continue;
+        }
+        use_sync_ts = use_sync_ts && point.sync_ts > 0;
+        points.push_back(point);
+    }
+    if (points.size() < 2) {
+        return;
+    }
+    if (timeline_ != (int32_t)use_sync_ts) {
+        timeline_ = (int32_t)use_sync_ts;
+        DII_LOG(LS_INFO, 0, DII_CODE_COMMON_INFO) << "Sync group " << group_id_ << " aligns "
+            << points.size() << " streams on "
+            << (use_sync_ts ? "metadata sync timestamps." : "rtmp timestamps, not every stream has sync timestamps.");
+    }
+
+    // the newest point on the timeline each member can play with its jitter target still buffered,
+    // the group plays at the oldest of them
+    int64_t group_pos = std::numeric_limits<int64_t>::max();
+    int64_t oldest_pos = std::numeric_limits<int64_t>::max();
+    for (const Point& point : points) {
+        int64_t pos = PlayoutPos(point, use_sync_ts, now);
+        int32_t target = point.member->decoder->ply_buffer_->PlayReadyBufferLen();
+        group_pos = std::min(group_pos, pos + point.cache_ms - target);
+        oldest_pos = std::min(oldest_pos, pos);
+    }
+
+    for (const Point& point : points) {
+        Member& member = *point.member;
+        DiiRtmpDecoder* decoder = member.decoder;
+        int64_t pos = PlayoutPos(point, use_sync_ts, now);
+        int32_t target = decoder->ply_buffer_->PlayReadyBufferLen();
+        int64_t wanted = pos + point.cache_ms - target - group_pos;
+        if (wanted > SYNC_MAX_GROUP_DELAY && !member.capped) {
+            DII_LOG(LS_WARNING, decoder->stream_id_, DII_CODE_COMMON_WARN) << "Sync group " << group_id_
+                << ": stream is " << wanted << " ms ahead of the group, holding back only "
+                << SYNC_MAX_GROUP_DELAY << " ms.";
+        }
+        member.capped = wanted > SYNC_MAX_GROUP_DELAY;
+        wanted = std::min<int64_t>(wanted, SYNC_MAX_GROUP_DELAY);
+        member.delay_ms += (wanted - member.delay_ms) * SYNC_DELAY_SMOOTHING;
+
+        decoder->group_delay_ms_ = (int32_t)member.delay_ms;
+        // how far it plays ahead of the member furthest behind
+        decoder->group_skew_ms_ = (int32_t)(pos - oldest_pos);
+        decoder->ply_buffer_->SetGroupDelay((int32_t)member.delay_ms);
+    }
+}
+}	// namespace dii_media_kit
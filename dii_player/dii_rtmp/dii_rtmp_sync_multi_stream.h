@@ -0,0 +1,88 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#ifndef __DII_RTMP_SYNC_MULTI_STREAM_H__
+#define __DII_RTMP_SYNC_MULTI_STREAM_H__
+
+#include "dii_rtmp_decoder.h"
+
+#include "webrtc/base/messagehandler.h"
+#include "webrtc/base/thread.h"
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace dii_media_kit {
+// Plays the rtmp streams of a group on one timeline, e.g. the teacher camera,
+// screen share and student streams of a classroom. The timeline is the
+// onMetaData sync timestamp when every member carries one, the rtmp
+// timestamps otherwise. One scheduler per group looks at where each member
+// plays and how much it has buffered, and picks the newest point on the
+// timeline every member can play while keeping its own jitter target. Members
+// ahead of it get that much more buffering, which their time-stretch then
+// absorbs, so the stream with the least data in hand adds no delay at all.
+class PlySyncMultiStream : public dii_rtc::Thread,
+                           public dii_rtc::MessageHandler {
+public:
+    // |group_id| 0 is no group. a decoder is in one group at a time.
+    static void Join(int32_t group_id, DiiRtmpDecoder* decoder);
+    // the decoder is no longer touched once this returns
+    static void Leave(int32_t group_id, DiiRtmpDecoder* decoder);
+
+    explicit PlySyncMultiStream(int32_t group_id);
+    ~PlySyncMultiStream();
+
+private:
+    //* For MessageHandler
+    void OnMessage(dii_rtc::Message* msg) override;
+
+    void Add(DiiRtmpDecoder* decoder);
+    // true while members are left
+    bool Remove(DiiRtmpDecoder* decoder);
+    void Align();
+
+private:
+    static std::mutex                                   groups_mtx_;
+    static std::map<int32_t, PlySyncMultiStream*>       groups_;
+
+    struct Member {
+        DiiRtmpDecoder* decoder = nullptr;
+        // smoothed extra buffering, follows arrival noise slowly
+        float           delay_ms = 0.f;
+        bool            capped = false;
+    };
+    // one member's playout point, sampled under its buffer lock
+    struct Point {
+        Member*         member;
+        uint64_t        sync_ts;
+        int64_t         pts;
+        int32_t         cache_ms;
+        int64_t         update_ms;
+    };
+    static int64_t PlayoutPos(const Point& point, bool use_sync_ts, int64_t now);
+
+    int32_t             group_id_ = 0;
+    std::mutex          mtx_;
+    std::vector<Member> members_;
+    // which timeline the last alignment used, logged on a change
+    int32_t             timeline_ = -1;
+};
+}	// namespace dii_media_kit
+
+#endif	// __DII_RTMP_SYNC_MULTI_STREAM_H__
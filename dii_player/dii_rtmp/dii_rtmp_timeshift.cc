@@ -0,0 +1,448 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#include "dii_com_def.h"
+#include "dii_rtmp_timeshift.h"
+#include "webrtc/base/logging.h"
+#include "webrtc/base/timeutils.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <string.h>
+#include <type_traits>
+
+#if defined(WEBRTC_WIN)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#define TIMESHIFT_SEGMENT_SIZE          (4 << 20)  // a multiple of the page and windows allocation granularity
+#define TIMESHIFT_MIN_HOT_SEGMENTS      2
+#define TIMESHIFT_MAX_BYTES_PER_SEC     (10 << 17) // 10 mbps, caps the spill file of a window
+#define TIMESHIFT_TS_JUMP_LEN           10000      // timestamp discontinuity, start over
+
+// fixed header in front of every payload in a segment
+struct TimeshiftRecordHeader {
+    uint32_t    size;
+    uint32_t    ts;
+    int32_t     cts;
+    uint32_t    video;
+    uint64_t    sync_ts;
+    PlyVideoInfo info;
+};
+static_assert(std::is_trivially_copyable<PlyVideoInfo>::value, "PlyVideoInfo is stored as bytes");
+
+static uint32_t RecordSize(int payload) {
+    return (uint32_t)((sizeof(TimeshiftRecordHeader) + payload + 7) & ~(size_t)7);
+}
+
+DiiRtmpTimeshift::DiiRtmpTimeshift(int32_t stream_id, int32_t window_ms, int64_t memory_bytes,
+                                   const std::string& spill_dir)
+    : stream_id_(stream_id)
+    , window_ms_(window_ms)
+    , pool_(PlyPacketPool::Create()) {
+    max_hot_ = (size_t)std::max<int64_t>(memory_bytes / TIMESHIFT_SEGMENT_SIZE, TIMESHIFT_MIN_HOT_SEGMENTS);
+    max_slots_ = (int32_t)((int64_t)window_ms / 1000 * TIMESHIFT_MAX_BYTES_PER_SEC / TIMESHIFT_SEGMENT_SIZE + 2);
+    if (!spill_dir.empty() && !OpenSpillFile(spill_dir)) {
+        DII_LOG(LS_WARNING, stream_id_, DII_CODE_COMMON_WARN) << "Timeshift can't create a spill file in "
+            << spill_dir << ", keeping " << max_hot_ * (TIMESHIFT_SEGMENT_SIZE >> 20) << " MB in memory only.";
+    }
+}
+
+DiiRtmpTimeshift::~DiiRtmpTimeshift() {
+    CloseSpillFile();
+}
+
+void DiiRtmpTimeshift::AppendVideo(const PlyBuffer& frame, uint32_t ts, int32_t cts, const PlyVideoInfo& info) {
+    Append(true, frame, ts, cts, 0, &info);
+}
+
+void DiiRtmpTimeshift::AppendAudio(const PlyBuffer& frame, uint32_t ts, uint64_t sync_ts) {
+    Append(false, frame, ts, 0, sync_ts, nullptr);
+}
+
+void DiiRtmpTimeshift::Append(bool video, const PlyBuffer& frame, uint32_t ts, int32_t cts,
+                              uint64_t sync_ts, const PlyVideoInfo* info) {
+    uint32_t record_size = RecordSize(frame.size());
+    if (record_size > TIMESHIFT_SEGMENT_SIZE) {
+        if (!warned_oversize_) {
+            warned_oversize_ = true;
+            DII_LOG(LS_WARNING, stream_id_, DII_CODE_COMMON_WARN) << "Timeshift drops a packet of "
+                << frame.size() << " bytes, larger than a segment.";
+        }
+        return;
+    }
+    if (!segments_.empty() && std::abs((int32_t)(ts - last_ts_)) > TIMESHIFT_TS_JUMP_LEN) {
+        DII_LOG(LS_INFO, stream_id_, DII_CODE_COMMON_INFO) << "Timeshift timestamp jumps from "
+            << last_ts_ << " to " << ts << ", start over.";
+        Reset();
+    }
+    bool first = segments_.empty();
+    if (first || segments_.back().size + record_size > TIMESHIFT_SEGMENT_SIZE) {
+        StartSegment();
+    }
+
+    Segment& seg = segments_.back();
+    TimeshiftRecordHeader header = TimeshiftRecordHeader();
+    header.size = (uint32_t)frame.size();
+    header.ts = ts;
+    header.cts = cts;
+    header.video = video ? 1 : 0;
+    header.sync_ts = sync_ts;
+    if (info) {
+        header.info = *info;
+    }
+    memcpy(seg.mem.data() + seg.size, &header, sizeof(header));
+    memcpy(seg.mem.data() + seg.size + sizeof(header), frame.data(), frame.size());
+
+    if (video && info->keyframe) {
+        Keyframe key;
+        key.ts = ts;
+        key.pos.seq = seg.seq;
+        key.pos.offset = seg.size;
+        keyframes_.push_back(key);
+    }
+    // audio and video interleave slightly out of order
+    if (seg.size == 0 || (int32_t)(ts - seg.last_ts) > 0) {
+        seg.last_ts = ts;
+    }
+    if (first || (int32_t)(ts - last_ts_) > 0) {
+        last_ts_ = ts;
+    }
+    seg.size += record_size;
+    TrimWindow();
+}
+
+void DiiRtmpTimeshift::StartSegment() {
+    if (hot_count_ >= max_hot_) {
+        SpillOldest();
+    }
+    Segment seg;
+    seg.seq = next_seq_++;
+    if (!free_mem_.empty()) {
+        seg.mem = std::move(free_mem_.back());
+        free_mem_.pop_back();
+    } else {
+        seg.mem.resize(TIMESHIFT_SEGMENT_SIZE);
+    }
+    segments_.push_back(std::move(seg));
+    hot_count_++;
+}
+
+void DiiRtmpTimeshift::SpillOldest() {
+    int32_t slot = TakeSlot();
+    // hot segments are the newest ones, the spilled ones are in front of them
+    Segment& seg = segments_[segments_.size() - hot_count_];
+    if (slot >= 0 && WriteSlot(slot, seg.mem.data(), seg.size)) {
+        seg.slot = slot;
+        free_mem_.push_back(std::move(seg.mem));
+        seg.mem = std::vector<uint8_t>();
+        hot_count_--;
+        return;
+    }
+    if (slot >= 0) {
+        free_slots_.push_back(slot);
+    }
+    // no disk, the window shrinks to what fits in memory
+    int64_t seq = seg.seq;
+    while (!segments_.empty() && segments_.front().seq <= seq) {
+        DropOldest();
+    }
+}
+
+void DiiRtmpTimeshift::DropOldest() {
+    Segment& seg = segments_.front();
+    if (seg.slot < 0) {
+        free_mem_.push_back(std::move(seg.mem));
+        hot_count_--;
+    } else {
+        free_slots_.push_back(seg.slot);
+    }
+    segments_.pop_front();
+    while (!keyframes_.empty() && (segments_.empty() || keyframes_.front().pos.seq < segments_.front().seq)) {
+        keyframes_.pop_front();
+    }
+}
+
+void DiiRtmpTimeshift::TrimWindow() {
+    while (segments_.size() > 1 && (int32_t)(last_ts_ - segments_.front().last_ts) > window_ms_) {
+        DropOldest();
+    }
+}
+
+void DiiRtmpTimeshift::Reset() {
+    while (!segments_.empty()) {
+        DropOldest();
+    }
+}
+
+DiiRtmpTimeshift::Segment* DiiRtmpTimeshift::Find(int64_t seq) {
+    if (segments_.empty() || seq < segments_.front().seq || seq > segments_.back().seq) {
+        return nullptr;
+    }
+    return &segments_[(size_t)(seq - segments_.front().seq)];
+}
+
+DiiRtmpTimeshift::Cursor DiiRtmpTimeshift::End() const {
+    Cursor cursor;
+    if (segments_.empty()) {
+        cursor.seq = next_seq_;
+    } else {
+        cursor.seq = segments_.back().seq;
+        cursor.offset = segments_.back().size;
+    }
+    return cursor;
+}
+
+bool DiiRtmpTimeshift::IsValid(const Cursor& cursor) const {
+    if (segments_.empty()) {
+        return cursor.seq == next_seq_;
+    }
+    return cursor.seq >= segments_.front().seq && cursor.seq <= segments_.back().seq;
+}
+
+bool DiiRtmpTimeshift::AtEnd(const Cursor& cursor) const {
+    if (segments_.empty()) {
+        return true;
+    }
+    const Segment& last = segments_.back();
+    return cursor.seq > last.seq || (cursor.seq == last.seq && cursor.offset >= last.size);
+}
+
+bool DiiRtmpTimeshift::FindKeyframe(uint32_t ts, Cursor* cursor) const {
+    if (keyframes_.empty()) {
+        return false;
+    }
+    *cursor = keyframes_.front().pos;
+    for (const Keyframe& key : keyframes_) {
+        if ((int32_t)(key.ts - ts) > 0) {
+            break;
+        }
+        *cursor = key.pos;
+    }
+    return true;
+}
+
+uint32_t DiiRtmpTimeshift::FirstTs() const {
+    return keyframes_.empty() ? last_ts_ : keyframes_.front().ts;
+}
+
+const uint8_t* DiiRtmpTimeshift::Locate(Cursor* cursor) {
+    Segment* seg = Find(cursor->seq);
+    if (seg && cursor->offset >= seg->size) {
+        seg = Find(cursor->seq + 1);
+        if (!seg) {
+            return nullptr;
+        }
+        cursor->seq = seg->seq;
+        cursor->offset = 0;
+    }
+    if (!seg) {
+        return nullptr;
+    }
+    const uint8_t* base = seg->slot < 0 ? seg->mem.data() : MapSlot(seg->slot);
+    return base ? base + cursor->offset : nullptr;
+}
+
+bool DiiRtmpTimeshift::PeekTs(Cursor* cursor, uint32_t* ts) {
+    const uint8_t* p = Locate(cursor);
+    if (!p) {
+        return false;
+    }
+    TimeshiftRecordHeader header;
+    memcpy(&header, p, sizeof(header));
+    *ts = header.ts;
+    return true;
+}
+
+bool DiiRtmpTimeshift::Read(Cursor* cursor, Record* record) {
+    const uint8_t* p = Locate(cursor);
+    if (!p) {
+        return false;
+    }
+    TimeshiftRecordHeader header;
+    memcpy(&header, p, sizeof(header));
+    record->video = header.video != 0;
+    record->ts = header.ts;
+    record->cts = header.cts;
+    record->sync_ts = header.sync_ts;
+    record->info = header.info;
+    record->data = pool_->Get((int)header.size);
+    record->data->append(p + sizeof(header), (int)header.size);
+    cursor->offset += RecordSize((int)header.size);
+    return true;
+}
+
+int64_t DiiRtmpTimeshift::MemoryBytes() const {
+    return (int64_t)(hot_count_ + free_mem_.size()) * TIMESHIFT_SEGMENT_SIZE;
+}
+
+int64_t DiiRtmpTimeshift::DiskBytes() const {
+    return (int64_t)(segments_.size() - hot_count_) * TIMESHIFT_SEGMENT_SIZE;
+}
+
+int32_t DiiRtmpTimeshift::TakeSlot() {
+#if defined(WEBRTC_WIN)
+    if (!file_) {
+        return -1;
+    }
+#else
+    if (fd_ < 0) {
+        return -1;
+    }
+#endif
+    if (free_slots_.empty() && slot_count_ >= max_slots_ && hot_count_ < segments_.size()) {
+        // the file is as large as the window may need, reuse the oldest slot
+        DropOldest();
+    }
+    if (!free_slots_.empty()) {
+        int32_t slot = free_slots_.back();
+        free_slots_.pop_back();
+        return slot;
+    }
+    if (slot_count_ >= max_slots_) {
+        return -1;
+    }
+
+    int64_t file_size = (int64_t)(slot_count_ + 1) * TIMESHIFT_SEGMENT_SIZE;
+#if defined(WEBRTC_WIN)
+    LARGE_INTEGER size;
+    size.QuadPart = file_size;
+    if (!SetFilePointerEx(file_, size, NULL, FILE_BEGIN) || !SetEndOfFile(file_)) {
+        return -1;
+    }
+    // a mapping has a fixed size, views of the old one stay valid until unmapped
+    UnmapRead();
+    if (mapping_) {
+        CloseHandle(mapping_);
+    }
+    mapping_ = CreateFileMapping(file_, NULL, PAGE_READWRITE, (DWORD)(file_size >> 32),
+                                 (DWORD)file_size, NULL);
+    if (!mapping_) {
+        return -1;
+    }
+#else
+    if (ftruncate(fd_, (off_t)file_size) != 0) {
+        return -1;
+    }
+#endif
+    return slot_count_++;
+}
+
+bool DiiRtmpTimeshift::WriteSlot(int32_t slot, const uint8_t* data, uint32_t size) {
+    int64_t offset = (int64_t)slot * TIMESHIFT_SEGMENT_SIZE;
+    if (read_slot_ == slot) {
+        UnmapRead();
+    }
+    // the copy only dirties the page cache, the kernel writes it back in its own time
+#if defined(WEBRTC_WIN)
+    void* map = MapViewOfFile(mapping_, FILE_MAP_WRITE, (DWORD)(offset >> 32), (DWORD)offset, size);
+    if (!map) {
+        return false;
+    }
+    memcpy(map, data, size);
+    UnmapViewOfFile(map);
+#else
+    void* map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, (off_t)offset);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    memcpy(map, data, size);
+    munmap(map, size);
+#endif
+    return true;
+}
+
+const uint8_t* DiiRtmpTimeshift::MapSlot(int32_t slot) {
+    if (read_slot_ == slot) {
+        return read_map_;
+    }
+    UnmapRead();
+    int64_t offset = (int64_t)slot * TIMESHIFT_SEGMENT_SIZE;
+#if defined(WEBRTC_WIN)
+    void* map = MapViewOfFile(mapping_, FILE_MAP_READ, (DWORD)(offset >> 32), (DWORD)offset,
+                              TIMESHIFT_SEGMENT_SIZE);
+    if (!map) {
+        return nullptr;
+    }
+#else
+    void* map = mmap(NULL, TIMESHIFT_SEGMENT_SIZE, PROT_READ, MAP_SHARED, fd_, (off_t)offset);
+    if (map == MAP_FAILED) {
+        return nullptr;
+    }
+#endif
+    read_slot_ = slot;
+    read_map_ = (uint8_t*)map;
+    return read_map_;
+}
+
+void DiiRtmpTimeshift::UnmapRead() {
+    if (!read_map_) {
+        return;
+    }
+#if defined(WEBRTC_WIN)
+    UnmapViewOfFile(read_map_);
+#else
+    munmap(read_map_, TIMESHIFT_SEGMENT_SIZE);
+#endif
+    read_map_ = nullptr;
+    read_slot_ = -1;
+}
+
+bool DiiRtmpTimeshift::OpenSpillFile(const std::string& dir) {
+    std::string path = dir + "/dii_timeshift_" + std::to_string(stream_id_) + "_"
+                     + std::to_string(dii_rtc::TimeMillis()) + ".tmp";
+#if defined(WEBRTC_WIN)
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                              FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    file_ = file;
+#else
+    fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd_ < 0) {
+        return false;
+    }
+    // nothing else needs the name, the space goes back once the fd is closed
+    unlink(path.c_str());
+#endif
+    return true;
+}
+
+void DiiRtmpTimeshift::CloseSpillFile() {
+    UnmapRead();
+#if defined(WEBRTC_WIN)
+    if (mapping_) {
+        CloseHandle(mapping_);
+        mapping_ = nullptr;
+    }
+    if (file_) {
+        CloseHandle(file_);
+        file_ = nullptr;
+    }
+#else
+    if (fd_ >= 0) {
+        close(fd_);
+        fd_ = -1;
+    }
+#endif
+}
@@ -0,0 +1,140 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#ifndef __DII_RTMP_TIMESHIFT_H__
+#define __DII_RTMP_TIMESHIFT_H__
+
+#include "dii_rtmp_packet_pool.h"
+#include "dii_rtmp_video_info.h"
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+// Keeps the last minutes of a live stream as demuxed packets, so a viewer can
+// pause and jump back. New packets go into memory segments; once more of them
+// are full than the memory budget allows, the oldest is copied into a slot of
+// a mapped spill file and read back from there. Segments older than the
+// window are dropped, a keyframe index maps times to positions for seeking.
+// Not thread safe, DiiRtmpSource serializes the calls.
+class DiiRtmpTimeshift {
+public:
+    // a position in the ring, valid while its segment is inside the window
+    struct Cursor {
+        int64_t  seq = -1;
+        uint32_t offset = 0;
+    };
+    struct Record {
+        bool        video = false;
+        uint32_t    ts = 0;
+        int32_t     cts = 0;
+        uint64_t    sync_ts = 0;
+        PlyVideoInfo info;
+        dii_rtc::scoped_refptr<PlyBuffer> data;
+    };
+
+    // |spill_dir| empty keeps everything in memory, the window is then what fits in |memory_bytes|
+    DiiRtmpTimeshift(int32_t stream_id, int32_t window_ms, int64_t memory_bytes, const std::string& spill_dir);
+    ~DiiRtmpTimeshift();
+
+    void AppendVideo(const PlyBuffer& frame, uint32_t ts, int32_t cts, const PlyVideoInfo& info);
+    void AppendAudio(const PlyBuffer& frame, uint32_t ts, uint64_t sync_ts);
+
+    // one past the newest record
+    Cursor End() const;
+    bool IsValid(const Cursor& cursor) const;
+    bool AtEnd(const Cursor& cursor) const;
+    // the newest keyframe at or before |ts|, the oldest one when |ts| is before it
+    bool FindKeyframe(uint32_t ts, Cursor* cursor) const;
+    // timestamp of the record at |cursor|, false at the end or when it left the window
+    bool PeekTs(Cursor* cursor, uint32_t* ts);
+    // copies the record at |cursor| out and moves past it
+    bool Read(Cursor* cursor, Record* record);
+
+    bool Empty() const { return keyframes_.empty(); }
+    // seekable range, from the oldest keyframe to the newest record
+    uint32_t FirstTs() const;
+    uint32_t LastTs() const { return last_ts_; }
+    int64_t MemoryBytes() const;
+    int64_t DiskBytes() const;
+
+private:
+    struct Segment {
+        int64_t  seq = 0;
+        uint32_t size = 0;
+        uint32_t last_ts = 0;
+        // holds the data while hot, empty once spilled
+        std::vector<uint8_t> mem;
+        int32_t  slot = -1;
+    };
+    struct Keyframe {
+        uint32_t ts;
+        Cursor   pos;
+    };
+
+    void Append(bool video, const PlyBuffer& frame, uint32_t ts, int32_t cts,
+                uint64_t sync_ts, const PlyVideoInfo* info);
+    void StartSegment();
+    // moves the oldest hot segment to disk, drops it when there is no disk
+    void SpillOldest();
+    void DropOldest();
+    void TrimWindow();
+    void Reset();
+    Segment* Find(int64_t seq);
+    // normalizes |cursor| past the end of a full segment, null at the end
+    const uint8_t* Locate(Cursor* cursor);
+
+    bool OpenSpillFile(const std::string& dir);
+    void CloseSpillFile();
+    int32_t TakeSlot();
+    bool WriteSlot(int32_t slot, const uint8_t* data, uint32_t size);
+    const uint8_t* MapSlot(int32_t slot);
+    void UnmapRead();
+
+private:
+    int32_t             stream_id_ = 0;
+    int32_t             window_ms_ = 0;
+    size_t              max_hot_ = 0;
+    int32_t             max_slots_ = 0;
+
+    std::deque<Segment> segments_;
+    size_t              hot_count_ = 0;
+    int64_t             next_seq_ = 0;
+    std::vector<std::vector<uint8_t>> free_mem_;
+    std::deque<Keyframe> keyframes_;
+    uint32_t            last_ts_ = 0;
+    bool                warned_oversize_ = false;
+
+    dii_rtc::scoped_refptr<PlyPacketPool> pool_;
+
+    // spill file, slots of one segment each
+#if defined(WEBRTC_WIN)
+    void*               file_ = nullptr;
+    void*               mapping_ = nullptr;
+#else
+    int                 fd_ = -1;
+#endif
+    int32_t             slot_count_ = 0;
+    std::vector<int32_t> free_slots_;
+    // the slot the reader is in stays mapped
+    int32_t             read_slot_ = -1;
+    uint8_t*            read_map_ = nullptr;
+};
+
+#endif	// __DII_RTMP_TIMESHIFT_H__
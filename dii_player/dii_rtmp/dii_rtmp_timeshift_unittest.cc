@@ -0,0 +1,232 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#include "dii_rtmp_timeshift.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+const int kSegmentBytes = 4 << 20;
+
+class DiiRtmpTimeshiftTest : public ::testing::Test {
+protected:
+    DiiRtmpTimeshiftTest() : pool_(PlyPacketPool::Create()) {}
+
+    // |size| bytes, each one made from |seq| and its offset
+    dii_rtc::scoped_refptr<PlyBuffer> Packet(int seq, int size) {
+        std::vector<uint8_t> data(size);
+        for (int i = 0; i < size; i++) {
+            data[i] = (uint8_t)(seq * 7 + i);
+        }
+        dii_rtc::scoped_refptr<PlyBuffer> buffer = pool_->Get(size);
+        buffer->append(data.data(), size);
+        return buffer;
+    }
+
+    bool IsPacket(const PlyBuffer& buffer, int seq, int size) {
+        if (buffer.size() != size) {
+            return false;
+        }
+        for (int i = 0; i < size; i++) {
+            if (buffer.data()[i] != (uint8_t)(seq * 7 + i)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // video every |interval_ms| from packet |from| on, a keyframe every |gop| packets
+    void AppendVideo(DiiRtmpTimeshift& shift, int from, int count, int size, uint32_t interval_ms, int gop) {
+        for (int seq = from; seq < from + count; seq++) {
+            PlyVideoInfo info;
+            info.keyframe = seq % gop == 0;
+            shift.AppendVideo(*Packet(seq, size), (uint32_t)seq * interval_ms, seq % 3, info);
+        }
+    }
+
+    dii_rtc::scoped_refptr<PlyPacketPool> pool_;
+};
+
+}  // namespace
+
+TEST_F(DiiRtmpTimeshiftTest, ReadsBackWhatWasAppended) {
+    DiiRtmpTimeshift shift(0, 60000, 0, "");
+    EXPECT_TRUE(shift.Empty());
+    AppendVideo(shift, 0, 10, 1000, 40, 5);
+    shift.AppendAudio(*Packet(10, 300), 400, 12345);
+    EXPECT_FALSE(shift.Empty());
+    EXPECT_EQ(0u, shift.FirstTs());
+    EXPECT_EQ(400u, shift.LastTs());
+    EXPECT_EQ(0, shift.DiskBytes());
+
+    DiiRtmpTimeshift::Cursor cursor;
+    ASSERT_TRUE(shift.FindKeyframe(0, &cursor));
+    DiiRtmpTimeshift::Record record;
+    for (int seq = 0; seq < 10; seq++) {
+        uint32_t ts = 0;
+        ASSERT_TRUE(shift.PeekTs(&cursor, &ts));
+        EXPECT_EQ((uint32_t)seq * 40, ts);
+        ASSERT_TRUE(shift.Read(&cursor, &record));
+        EXPECT_TRUE(record.video);
+        EXPECT_EQ((uint32_t)seq * 40, record.ts);
+        EXPECT_EQ(seq % 3, record.cts);
+        EXPECT_EQ(seq % 5 == 0, record.info.keyframe);
+        EXPECT_TRUE(IsPacket(*record.data, seq, 1000));
+    }
+    ASSERT_TRUE(shift.Read(&cursor, &record));
+    EXPECT_FALSE(record.video);
+    EXPECT_EQ(12345u, record.sync_ts);
+    EXPECT_TRUE(IsPacket(*record.data, 10, 300));
+    EXPECT_TRUE(shift.AtEnd(cursor));
+    EXPECT_FALSE(shift.Read(&cursor, &record));
+}
+
+TEST_F(DiiRtmpTimeshiftTest, SpillsOldSegmentsToDisk) {
+    // two segments in memory, 256 KB every 100 ms is about 1.6 s per segment
+    DiiRtmpTimeshift shift(0, 60000, 0, ::testing::TempDir());
+    const int size = 256 << 10;
+    AppendVideo(shift, 0, 100, size, 100, 10);
+    EXPECT_GT(shift.DiskBytes(), 0);
+    EXPECT_EQ(0, shift.DiskBytes() % kSegmentBytes);
+    // the hot two plus the buffers of the spilled ones, kept for reuse
+    EXPECT_LE(shift.MemoryBytes(), 3 * kSegmentBytes);
+    EXPECT_EQ(0u, shift.FirstTs());
+
+    // the oldest packets come back from the spill file
+    DiiRtmpTimeshift::Cursor cursor;
+    ASSERT_TRUE(shift.FindKeyframe(0, &cursor));
+    DiiRtmpTimeshift::Record record;
+    for (int seq = 0; seq < 100; seq++) {
+        ASSERT_TRUE(shift.Read(&cursor, &record)) << seq;
+        EXPECT_EQ((uint32_t)seq * 100, record.ts);
+        EXPECT_TRUE(IsPacket(*record.data, seq, size)) << seq;
+    }
+    EXPECT_TRUE(shift.AtEnd(cursor));
+}
+
+TEST_F(DiiRtmpTimeshiftTest, SpillSlotsAreReused) {
+    // 20 mbps against the 10 mbps the spill file is sized for: 3 slots for
+    // the 5 s window, the oldest slot is taken over once they are used up
+    DiiRtmpTimeshift shift(0, 5000, 0, ::testing::TempDir());
+    const int size = 256 << 10;
+    int64_t max_disk = 0;
+    for (int seq = 0; seq < 400; seq++) {
+        AppendVideo(shift, seq, 1, size, 100, 10);
+        max_disk = std::max(max_disk, shift.DiskBytes());
+    }
+    EXPECT_EQ(3 * kSegmentBytes, max_disk);
+    EXPECT_EQ(39900u, shift.LastTs());
+
+    // what is left reads back with the data of the newer segments
+    DiiRtmpTimeshift::Cursor cursor;
+    ASSERT_TRUE(shift.FindKeyframe(0, &cursor));
+    DiiRtmpTimeshift::Record record;
+    int seq = (int)(shift.FirstTs() / 100);
+    EXPECT_EQ(0, seq % 10);
+    for (; seq < 400; seq++) {
+        ASSERT_TRUE(shift.Read(&cursor, &record)) << seq;
+        EXPECT_EQ((uint32_t)seq * 100, record.ts);
+        EXPECT_TRUE(IsPacket(*record.data, seq, size)) << seq;
+    }
+    EXPECT_TRUE(shift.AtEnd(cursor));
+}
+
+TEST_F(DiiRtmpTimeshiftTest, WindowIsTrimmed) {
+    // 64 KB every 40 ms, about 2.5 s per segment, all in memory
+    DiiRtmpTimeshift shift(0, 10000, 64 << 20, "");
+    const int size = 64 << 10;
+    AppendVideo(shift, 0, 25, size, 40, 25);
+    DiiRtmpTimeshift::Cursor oldest;
+    ASSERT_TRUE(shift.FindKeyframe(0, &oldest));
+
+    AppendVideo(shift, 25, 25 * 30 - 25, size, 40, 25);
+    uint32_t span = shift.LastTs() - shift.FirstTs();
+    EXPECT_GE(span, 9000u);
+    EXPECT_LE(span, 10000u + 2500u);
+    EXPECT_EQ(0, shift.DiskBytes());
+    EXPECT_LE(shift.MemoryBytes(), 7 * kSegmentBytes);
+
+    // a cursor into a dropped segment reads nothing
+    EXPECT_FALSE(shift.IsValid(oldest));
+    uint32_t ts = 0;
+    EXPECT_FALSE(shift.PeekTs(&oldest, &ts));
+}
+
+TEST_F(DiiRtmpTimeshiftTest, WindowShrinksToMemoryWithoutSpillFile) {
+    DiiRtmpTimeshift shift(0, 60000, 0, "");
+    AppendVideo(shift, 0, 200, 256 << 10, 100, 10);
+    EXPECT_EQ(0, shift.DiskBytes());
+    // two segments of 4 MB, 15 packets each
+    EXPECT_LE(shift.LastTs() - shift.FirstTs(), 3000u);
+    EXPECT_FALSE(shift.Empty());
+}
+
+TEST_F(DiiRtmpTimeshiftTest, KeyframeLookupAfterDrop) {
+    DiiRtmpTimeshift shift(0, 10000, 64 << 20, "");
+    const int size = 64 << 10;
+    // a keyframe every second
+    AppendVideo(shift, 0, 25 * 30, size, 40, 25);
+    const uint32_t first = shift.FirstTs();
+    ASSERT_GT(first, 0u);
+    EXPECT_EQ(0u, first % 1000);
+
+    // before the window: the oldest keyframe left
+    DiiRtmpTimeshift::Cursor cursor;
+    DiiRtmpTimeshift::Record record;
+    ASSERT_TRUE(shift.FindKeyframe(0, &cursor));
+    ASSERT_TRUE(shift.Read(&cursor, &record));
+    EXPECT_TRUE(record.info.keyframe);
+    EXPECT_EQ(first, record.ts);
+
+    // inside: the newest keyframe at or before it
+    ASSERT_TRUE(shift.FindKeyframe(first + 2500, &cursor));
+    ASSERT_TRUE(shift.Read(&cursor, &record));
+    EXPECT_TRUE(record.info.keyframe);
+    EXPECT_EQ(first + 2000, record.ts);
+    EXPECT_TRUE(IsPacket(*record.data, (int)(record.ts / 40), size));
+
+    ASSERT_TRUE(shift.FindKeyframe(first + 3000, &cursor));
+    ASSERT_TRUE(shift.Read(&cursor, &record));
+    EXPECT_EQ(first + 3000, record.ts);
+
+    // after the newest record: the newest keyframe
+    ASSERT_TRUE(shift.FindKeyframe(shift.LastTs() + 5000, &cursor));
+    ASSERT_TRUE(shift.Read(&cursor, &record));
+    EXPECT_TRUE(record.info.keyframe);
+    EXPECT_EQ(shift.LastTs() / 1000 * 1000, record.ts);
+}
+
+TEST_F(DiiRtmpTimeshiftTest, TimestampJumpStartsOver) {
+    DiiRtmpTimeshift shift(0, 60000, 0, "");
+    AppendVideo(shift, 0, 50, 1000, 40, 25);
+    DiiRtmpTimeshift::Cursor old_pos;
+    ASSERT_TRUE(shift.FindKeyframe(0, &old_pos));
+
+    PlyVideoInfo info;
+    shift.AppendVideo(*Packet(1, 1000), 60000, 0, info);
+    // no keyframe since
+    EXPECT_TRUE(shift.Empty());
+    DiiRtmpTimeshift::Cursor cursor;
+    EXPECT_FALSE(shift.FindKeyframe(0, &cursor));
+    EXPECT_FALSE(shift.IsValid(old_pos));
+    EXPECT_EQ(60000u, shift.LastTs());
+    EXPECT_EQ(60000u, shift.FirstTs());
+}
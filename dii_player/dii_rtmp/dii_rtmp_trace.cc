@@ -0,0 +1,158 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#include "dii_com_def.h"
+#include "dii_rtmp_trace.h"
+#include "dii_media_utils.h"
+#include "webrtc/base/logging.h"
+#include "webrtc/base/timeutils.h"
+
+#include <string.h>
+#include <algorithm>
+
+#define TRACE_MAGIC_SIZE            8
+#define TRACE_RECORD_HEADER_SIZE    13
+#define TRACE_WRITE_BUFFER_SIZE     (256 << 10)
+#define TRACE_MAX_RECORD_SIZE       (32 << 20)
+
+static void WriteBE(uint8_t* p, uint64_t value, int bytes) {
+    for (int i = bytes - 1; i >= 0; i--) {
+        p[i] = (uint8_t)value;
+        value >>= 8;
+    }
+}
+
+static uint64_t ReadBE(const uint8_t* p, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+bool DiiRtmpTraceWriter::Open(const std::string& path, const std::string& url) {
+    Close();
+    file_ = fopen(path.c_str(), "wb");
+    if (!file_) {
+        DII_LOG(LS_ERROR, stream_id_, DII_CODE_COMMON_ERROR) << "Trace can't create " << path;
+        return false;
+    }
+    setvbuf(file_, nullptr, _IOFBF, TRACE_WRITE_BUFFER_SIZE);
+    path_ = path;
+    start_ms_ = dii_rtc::TimeMillis();
+    bytes_written_ = 0;
+
+    size_t url_len = std::min<size_t>(url.size(), 0xffff);
+    std::vector<uint8_t> header(TRACE_MAGIC_SIZE + 1 + 8 + 2);
+    memcpy(header.data(), DII_TRACE_MAGIC, TRACE_MAGIC_SIZE);
+    header[TRACE_MAGIC_SIZE] = DII_TRACE_VERSION;
+    WriteBE(&header[TRACE_MAGIC_SIZE + 1], (uint64_t)dii_media_kit::DiiUnixTimestampMs(), 8);
+    WriteBE(&header[TRACE_MAGIC_SIZE + 9], url_len, 2);
+    header.insert(header.end(), url.begin(), url.begin() + url_len);
+    if (fwrite(header.data(), 1, header.size(), file_) != header.size()) {
+        DII_LOG(LS_ERROR, stream_id_, DII_CODE_COMMON_ERROR) << "Trace write to " << path_ << " failed.";
+        Close();
+        return false;
+    }
+    bytes_written_ = header.size();
+    DII_LOG(LS_INFO, stream_id_, DII_CODE_COMMON_INFO) << "Trace pulled packets to " << path_;
+    return true;
+}
+
+void DiiRtmpTraceWriter::Close() {
+    if (!file_) {
+        return;
+    }
+    fclose(file_);
+    file_ = nullptr;
+    DII_LOG(LS_INFO, stream_id_, DII_CODE_COMMON_INFO) << "Trace " << path_ << " closed, "
+                    << bytes_written_ / 1024 << " KB.";
+}
+
+void DiiRtmpTraceWriter::Write(char type, uint32_t timestamp, const char* data, int size) {
+    if (!file_ || size < 0) {
+        return;
+    }
+    uint8_t header[TRACE_RECORD_HEADER_SIZE];
+    header[0] = (uint8_t)type;
+    WriteBE(header + 1, (uint32_t)(dii_rtc::TimeMillis() - start_ms_), 4);
+    WriteBE(header + 5, timestamp, 4);
+    WriteBE(header + 9, (uint32_t)size, 4);
+    if (fwrite(header, 1, sizeof(header), file_) != sizeof(header) ||
+        (size > 0 && fwrite(data, 1, size, file_) != (size_t)size)) {
+        DII_LOG(LS_ERROR, stream_id_, DII_CODE_COMMON_ERROR) << "Trace write to " << path_ << " failed, tracing stops.";
+        Close();
+        return;
+    }
+    bytes_written_ += sizeof(header) + size;
+}
+
+bool DiiRtmpTraceReader::Open(const std::string& path) {
+    Close();
+    file_ = fopen(path.c_str(), "rb");
+    if (!file_) {
+        return false;
+    }
+    uint8_t header[TRACE_MAGIC_SIZE + 1 + 8 + 2];
+    if (fread(header, 1, sizeof(header), file_) != sizeof(header) ||
+        memcmp(header, DII_TRACE_MAGIC, TRACE_MAGIC_SIZE) != 0 ||
+        header[TRACE_MAGIC_SIZE] != DII_TRACE_VERSION) {
+        Close();
+        return false;
+    }
+    start_ms_ = (int64_t)ReadBE(&header[TRACE_MAGIC_SIZE + 1], 8);
+    url_.resize((size_t)ReadBE(&header[TRACE_MAGIC_SIZE + 9], 2));
+    if (!url_.empty() && fread(&url_[0], 1, url_.size(), file_) != url_.size()) {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void DiiRtmpTraceReader::Close() {
+    if (file_) {
+        fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+int32_t DiiRtmpTraceReader::Read(DiiTraceRecord& record) {
+    if (!file_) {
+        return -1;
+    }
+    uint8_t header[TRACE_RECORD_HEADER_SIZE];
+    size_t len = fread(header, 1, sizeof(header), file_);
+    if (len == 0 && feof(file_)) {
+        return 0;
+    }
+    if (len != sizeof(header)) {
+        return -1;
+    }
+    uint32_t size = (uint32_t)ReadBE(header + 9, 4);
+    if (size > TRACE_MAX_RECORD_SIZE) {
+        return -1;
+    }
+    record.type = (char)header[0];
+    record.arrival_ms = (uint32_t)ReadBE(header + 1, 4);
+    record.timestamp = (uint32_t)ReadBE(header + 5, 4);
+    record.data.resize(size);
+    if (size > 0 && fread(record.data.data(), 1, size, file_) != size) {
+        return -1;
+    }
+    return 1;
+}
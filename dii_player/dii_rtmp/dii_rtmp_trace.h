@@ -0,0 +1,82 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#ifndef __DII_RTMP_TRACE_H__
+#define __DII_RTMP_TRACE_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// Packet traces: every packet a puller got, as it came off the wire, with the
+// time it arrived, so the arrival pattern can be fed to a decoder again with
+// DiiRtmpTraceReplay of dii_bench. Big endian like flv:
+//   header  "DIITRACE" | version u8 | start unix ms u64 | url length u16 | url
+//   record  type u8 | arrival ms since the start u32 | timestamp u32 | size u32 | data
+#define DII_TRACE_MAGIC             "DIITRACE"
+#define DII_TRACE_VERSION           1
+
+struct DiiTraceRecord {
+    char                type = 0;
+    uint32_t            arrival_ms = 0;
+    uint32_t            timestamp = 0;
+    std::vector<char>   data;
+};
+
+// Called on the ingest thread, writes go through a stdio buffer. Stops
+// tracing at the first failed write.
+class DiiRtmpTraceWriter {
+public:
+    explicit DiiRtmpTraceWriter(int32_t stream_id) : stream_id_(stream_id) {}
+    ~DiiRtmpTraceWriter() { Close(); }
+
+    bool Open(const std::string& path, const std::string& url);
+    void Close();
+    bool IsOpen() const { return file_ != nullptr; }
+    // arrival is now
+    void Write(char type, uint32_t timestamp, const char* data, int size);
+    int64_t BytesWritten() const { return bytes_written_; }
+
+private:
+    int32_t             stream_id_ = -1;
+    FILE*               file_ = nullptr;
+    std::string         path_;
+    int64_t             start_ms_ = 0;
+    int64_t             bytes_written_ = 0;
+};
+
+class DiiRtmpTraceReader {
+public:
+    ~DiiRtmpTraceReader() { Close(); }
+
+    // false when the file can't be read or is no trace
+    bool Open(const std::string& path);
+    void Close();
+    // 1 with the next record, 0 at the end, < 0 when the file is cut short
+    int32_t Read(DiiTraceRecord& record);
+    const std::string& Url() const { return url_; }
+    int64_t StartMs() const { return start_ms_; }
+
+private:
+    FILE*               file_ = nullptr;
+    std::string         url_;
+    int64_t             start_ms_ = 0;
+};
+
+#endif	// __DII_RTMP_TRACE_H__
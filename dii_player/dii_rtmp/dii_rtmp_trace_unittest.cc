@@ -0,0 +1,199 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#include "dii_rtmp_trace.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "webrtc/base/fakeclock.h"
+
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string TracePath(const char* name) {
+    return ::testing::TempDir() + name;
+}
+
+std::vector<char> ReadFile(const std::string& path) {
+    std::vector<char> data;
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return data;
+    }
+    char buf[4096];
+    size_t len = 0;
+    while ((len = fread(buf, 1, sizeof(buf), file)) > 0) {
+        data.insert(data.end(), buf, buf + len);
+    }
+    fclose(file);
+    return data;
+}
+
+void WriteFile(const std::string& path, const std::vector<char>& data) {
+    FILE* file = fopen(path.c_str(), "wb");
+    ASSERT_TRUE(file != nullptr);
+    fwrite(data.data(), 1, data.size(), file);
+    fclose(file);
+}
+
+void AdvanceMs(dii_rtc::FakeClock& clock, int64_t ms) {
+    clock.AdvanceTime(dii_rtc::TimeDelta::FromMilliseconds(ms));
+}
+
+}  // namespace
+
+TEST(DiiRtmpTraceTest, ReadsBackWhatWasWritten) {
+    dii_rtc::ScopedFakeClock clock;
+    AdvanceMs(clock, 1000);
+    const std::string path = TracePath("trace_read_back.trace");
+    const std::string url = "rtmp://127.0.0.1/live/test";
+    const char config[] = {'\xaf', 0, 0x12, 0x10};
+    std::vector<char> video(1000);
+    for (size_t i = 0; i < video.size(); i++) {
+        video[i] = (char)i;
+    }
+
+    DiiRtmpTraceWriter writer(0);
+    ASSERT_TRUE(writer.Open(path, url));
+    EXPECT_TRUE(writer.IsOpen());
+    writer.Write(8, 0, config, sizeof(config));
+    AdvanceMs(clock, 40);
+    writer.Write(9, 33, video.data(), (int)video.size());
+    AdvanceMs(clock, 5);
+    writer.Write(18, 0xfffffff0, nullptr, 0);
+    int64_t bytes = writer.BytesWritten();
+    writer.Close();
+    EXPECT_FALSE(writer.IsOpen());
+    EXPECT_EQ(bytes, (int64_t)ReadFile(path).size());
+
+    DiiRtmpTraceReader reader;
+    ASSERT_TRUE(reader.Open(path));
+    EXPECT_EQ(url, reader.Url());
+    EXPECT_GT(reader.StartMs(), 0);
+
+    DiiTraceRecord record;
+    ASSERT_EQ(1, reader.Read(record));
+    EXPECT_EQ(8, record.type);
+    EXPECT_EQ(0u, record.arrival_ms);
+    EXPECT_EQ(0u, record.timestamp);
+    EXPECT_EQ(std::vector<char>(config, config + sizeof(config)), record.data);
+
+    ASSERT_EQ(1, reader.Read(record));
+    EXPECT_EQ(9, record.type);
+    EXPECT_EQ(40u, record.arrival_ms);
+    EXPECT_EQ(33u, record.timestamp);
+    EXPECT_EQ(video, record.data);
+
+    ASSERT_EQ(1, reader.Read(record));
+    EXPECT_EQ(18, record.type);
+    EXPECT_EQ(45u, record.arrival_ms);
+    EXPECT_EQ(0xfffffff0u, record.timestamp);
+    EXPECT_TRUE(record.data.empty());
+
+    EXPECT_EQ(0, reader.Read(record));
+    remove(path.c_str());
+}
+
+TEST(DiiRtmpTraceTest, CutRecordIsAnError) {
+    dii_rtc::ScopedFakeClock clock;
+    const std::string path = TracePath("trace_cut.trace");
+    const char data[] = {1, 2, 3, 4, 5, 6, 7, 8};
+
+    DiiRtmpTraceWriter writer(0);
+    ASSERT_TRUE(writer.Open(path, "rtmp://127.0.0.1/live/test"));
+    writer.Write(8, 0, data, sizeof(data));
+    writer.Write(8, 23, data, sizeof(data));
+    writer.Close();
+
+    // into the data of the last record, then into its header
+    std::vector<char> file = ReadFile(path);
+    for (size_t cut : {(size_t)3, sizeof(data) + 3}) {
+        WriteFile(path, std::vector<char>(file.begin(), file.end() - cut));
+        DiiRtmpTraceReader reader;
+        ASSERT_TRUE(reader.Open(path));
+        DiiTraceRecord record;
+        EXPECT_EQ(1, reader.Read(record));
+        EXPECT_EQ(-1, reader.Read(record));
+    }
+    remove(path.c_str());
+}
+
+TEST(DiiRtmpTraceTest, RejectsFilesThatAreNoTrace) {
+    dii_rtc::ScopedFakeClock clock;
+    const std::string path = TracePath("trace_bad.trace");
+    DiiRtmpTraceReader reader;
+    EXPECT_FALSE(reader.Open(TracePath("trace_missing.trace")));
+
+    DiiRtmpTraceWriter writer(0);
+    ASSERT_TRUE(writer.Open(path, "rtmp://127.0.0.1/live/test"));
+    writer.Close();
+    std::vector<char> good = ReadFile(path);
+    ASSERT_TRUE(reader.Open(path));
+
+    std::vector<char> flv = good;
+    memcpy(flv.data(), "FLV\x01\x05\0\0\0", 8);
+    WriteFile(path, flv);
+    EXPECT_FALSE(reader.Open(path));
+
+    std::vector<char> version = good;
+    version[strlen(DII_TRACE_MAGIC)] = DII_TRACE_VERSION + 1;
+    WriteFile(path, version);
+    EXPECT_FALSE(reader.Open(path));
+
+    // cut in the url
+    WriteFile(path, std::vector<char>(good.begin(), good.end() - 4));
+    EXPECT_FALSE(reader.Open(path));
+
+    WriteFile(path, std::vector<char>());
+    EXPECT_FALSE(reader.Open(path));
+
+    DiiTraceRecord record;
+    EXPECT_EQ(-1, reader.Read(record));
+    remove(path.c_str());
+}
+
+TEST(DiiRtmpTraceTest, RejectsOversizedRecord) {
+    dii_rtc::ScopedFakeClock clock;
+    const std::string path = TracePath("trace_oversized.trace");
+    DiiRtmpTraceWriter writer(0);
+    ASSERT_TRUE(writer.Open(path, ""));
+    writer.Close();
+
+    // type, arrival, timestamp and a size of 1 GB
+    std::vector<char> file = ReadFile(path);
+    const char header[] = {8, 0, 0, 0, 0, 0, 0, 0, 0, 0x40, 0, 0, 0};
+    file.insert(file.end(), header, header + sizeof(header));
+    WriteFile(path, file);
+
+    DiiRtmpTraceReader reader;
+    ASSERT_TRUE(reader.Open(path));
+    EXPECT_TRUE(reader.Url().empty());
+    DiiTraceRecord record;
+    EXPECT_EQ(-1, reader.Read(record));
+    remove(path.c_str());
+}
+
+TEST(DiiRtmpTraceTest, WriterWithoutFileDoesNothing) {
+    DiiRtmpTraceWriter writer(0);
+    EXPECT_FALSE(writer.Open(TracePath("no_such_dir/trace.trace"), "rtmp://127.0.0.1/live/test"));
+    EXPECT_FALSE(writer.IsOpen());
+    const char data[] = {1, 2, 3};
+    writer.Write(8, 0, data, sizeof(data));
+    EXPECT_EQ(0, writer.BytesWritten());
+}
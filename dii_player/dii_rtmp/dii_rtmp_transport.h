@@ -0,0 +1,54 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#ifndef __DII_RTMP_TRANSPORT_H__
+#define __DII_RTMP_TRANSPORT_H__
+
+#include <string>
+#include <stdint.h>
+
+class DiiTransportCallback
+{
+public:
+	DiiTransportCallback(void){};
+	virtual ~DiiTransportCallback(void){};
+
+	virtual void OnTransportPlaying() = 0;
+	// same contract as srs_rtmp_read_packet: an rtmp message / flv tag body of |type|,
+	// the callee frees |data|. return false to close.
+	virtual bool OnTransportPacket(char type, uint32_t timestamp, char* data, int size) = 0;
+	virtual void OnTransportFailed(int32_t eventid, const char* errmsg) = 0;
+};
+
+// Where DiiRtmpPuller gets its flv tags from: an rtmp connection on the shared
+// io thread, an http-flv GET or a local flv file played out in real time.
+// Everything after the tag, the decoder and the jitter buffer, is the same.
+class DiiRtmpTransport
+{
+public:
+	virtual ~DiiRtmpTransport(void){};
+	// both wait for the transport's thread, no callback runs after Close returns
+	virtual int32_t Open(const std::string& url) = 0;
+	virtual void Close() = 0;
+	// ms from Open to connected (dns included), and from there to the first media
+	virtual void GetTimings(int32_t& connect_ms, int32_t& setup_ms) = 0;
+	// for the statistics
+	virtual const char* Name() const = 0;
+};
+
+#endif	// __DII_RTMP_TRANSPORT_H__
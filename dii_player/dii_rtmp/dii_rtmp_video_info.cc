@@ -0,0 +1,78 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#include "dii_rtmp_video_info.h"
+#include "webrtc/common_video/h264/h264_common.h"
+
+#define HEVC_NALU_TYPE(b)       (((b) >> 1) & 0x3f)
+#define HEVC_NALU_IRAP_FIRST    16
+#define HEVC_NALU_IRAP_LAST     21
+#define HEVC_NALU_VPS           32
+// below are vcl, the even ones up to 14 are sub-layer non-reference
+#define HEVC_NALU_VCL_END       32
+#define HEVC_NALU_NON_REF_LAST  14
+
+void PlyVideoInfo::AddNalu(const uint8_t* nalu, size_t size) {
+    if (!nalu || size == 0) {
+        return;
+    }
+    bool first = nalu_count_++ == 0;
+
+    if (codec == dii_media_kit::kVideoCodecH265) {
+        int type = HEVC_NALU_TYPE(nalu[0]);
+        if (first) {
+            parameter_sets_first_ = type == HEVC_NALU_VPS;
+        }
+        if (type >= HEVC_NALU_VCL_END || got_slice_) {
+            return;
+        }
+        got_slice_ = true;
+        nal_type = (uint8_t)type;
+        idr = type >= HEVC_NALU_IRAP_FIRST && type <= HEVC_NALU_IRAP_LAST;
+        reference = type > HEVC_NALU_NON_REF_LAST || (type & 1) != 0;
+        keyframe = parameter_sets_first_ && idr;
+        return;
+    }
+
+    dii_media_kit::H264::NaluType type = dii_media_kit::H264::ParseNaluType(nalu[0]);
+    if (first) {
+        parameter_sets_first_ = type == dii_media_kit::H264::kSps;
+    }
+    if ((type != dii_media_kit::H264::kSlice && type != dii_media_kit::H264::kIdr) || got_slice_) {
+        return;
+    }
+    got_slice_ = true;
+    nal_type = type;
+    nal_ref_idc = dii_media_kit::H264::ParseNalRefIdc(nalu[0]);
+    idr = type == dii_media_kit::H264::kIdr;
+    reference = nal_ref_idc != 0;
+    keyframe = parameter_sets_first_ && idr;
+    dii_rtc::Optional<dii_media_kit::H264::SliceType> slice =
+        dii_media_kit::H264::ParseSliceType(nalu + dii_media_kit::H264::kNaluTypeSize,
+                                            size - dii_media_kit::H264::kNaluTypeSize);
+    slice_type = slice ? (int8_t)*slice : -1;
+}
+
+void PlyVideoInfo::AddAnnexB(const uint8_t* data, size_t size) {
+    if (!data || size < dii_media_kit::H264::kNaluShortStartSequenceSize) {
+        return;
+    }
+    for (const dii_media_kit::H264::NaluIndex& index : dii_media_kit::H264::FindNaluIndices(data, size)) {
+        AddNalu(data + index.payload_start_offset, index.payload_size);
+    }
+}
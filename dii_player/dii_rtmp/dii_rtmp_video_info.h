@@ -0,0 +1,55 @@
+/*
+*  Copyright (c) 2016 The rtmp_live_kit project authors. All Rights Reserved.
+*
+*  Please visit https://https://github.com/PixPark/DiiPlayer for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#ifndef __DII_RTMP_VIDEO_INFO_H__
+#define __DII_RTMP_VIDEO_INFO_H__
+
+#include "webrtc/common_types.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// What the nal headers of a video frame tell. The demuxer parses them once on
+// ingest and the result travels with the frame, later stages do not scan the
+// payload again.
+struct PlyVideoInfo {
+    dii_media_kit::VideoCodecType codec = dii_media_kit::kVideoCodecH264;
+    // parameter sets first and an IDR / IRAP picture, decoding can start here
+    bool    keyframe = false;
+    bool    idr = false;
+    // false for pictures nothing else refers to: nal_ref_idc 0 in h264,
+    // sub-layer non-reference pictures in h265. true until a slice is seen.
+    bool    reference = true;
+    // of the first slice
+    uint8_t nal_type = 0;
+    uint8_t nal_ref_idc = 0;
+    // H264::SliceType of the first slice, -1 if unknown and for h265
+    int8_t  slice_type = -1;
+
+    // feed every nalu of the frame in order, |nalu| starts at its header
+    void AddNalu(const uint8_t* nalu, size_t size);
+    // same for an annex-b buffer, the nalus are found with H264::FindNaluIndices
+    void AddAnnexB(const uint8_t* data, size_t size);
+
+private:
+    int     nalu_count_ = 0;
+    bool    parameter_sets_first_ = false;
+    bool    got_slice_ = false;
+};
+
+#endif	// __DII_RTMP_VIDEO_INFO_H__
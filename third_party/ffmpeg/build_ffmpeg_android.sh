@@ -30,11 +30,11 @@ function build_android
     --enable-gpl --enable-nonfree --enable-version3 --disable-iconv \
     --enable-jni \
     --enable-mediacodec \
-    --disable-decoders --enable-decoder=vp9 --enable-decoder=h264 --enable-decoder=mpeg4 --enable-decoder=aac --enable-decoder=mp3 --enable-decoder=pcm_s16le \
+    --disable-decoders --enable-decoder=vp9 --enable-decoder=h264 --enable-decoder=hevc --enable-decoder=mpeg4 --enable-decoder=aac --enable-decoder=mp3 --enable-decoder=pcm_s16le \
     --disable-encoders \
     --disable-demuxers --enable-demuxer=rtsp --enable-demuxer=rtp --enable-demuxer=flv --enable-demuxer=h264 --enable-demuxer=wav --enable-demuxer=aac --enable-demuxer=hls \
     --disable-muxers --enable-muxer=rtsp --enable-muxer=rtp --enable-muxer=flv --enable-muxer=h264 --enable-muxer=mp4 --enable-muxer=wav --enable-muxer=adts \
-    --disable-parsers --enable-parser=mpeg4video --enable-parser=aac --enable-parser=h264 --enable-parser=vp9 \
+    --disable-parsers --enable-parser=mpeg4video --enable-parser=aac --enable-parser=h264 --enable-parser=hevc --enable-parser=vp9 \
     --disable-protocols --enable-protocol=rtmp --enable-protocol=rtp --enable-protocol=tcp --enable-protocol=udp --enable-protocol=file \
     --disable-bsfs \
     --disable-indevs --enable-indev=v4l2 \
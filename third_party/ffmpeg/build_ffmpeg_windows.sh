@@ -92,12 +92,12 @@ cd $ffmpeg_dir
 	  --disable-symver \
 	  --disable-programs \
 	  --disable-postproc \
-	  --disable-decoders  --enable-decoder=h264 --enable-decoder=mpeg4 --enable-decoder=aac --enable-decoder=mp3 --enable-decoder=pcm_s16le \
+	  --disable-decoders  --enable-decoder=h264 --enable-decoder=hevc --enable-decoder=mpeg4 --enable-decoder=aac --enable-decoder=mp3 --enable-decoder=pcm_s16le \
       --disable-encoders \
       --disable-demuxers --enable-demuxer=rtsp --enable-demuxer=flv --enable-demuxer=h264 --enable-demuxer=wav --enable-demuxer=aac --enable-demuxer=hls --enable-demuxer=mp3 \
       --disable-muxers --enable-muxer=rtsp --enable-muxer=flv --enable-muxer=h264 --enable-muxer=mp4 --enable-muxer=wav \
 	  --disable-protocols --enable-protocol=rtmp --enable-protocol=hls --enable-protocol=tcp --enable-protocol=https --enable-protocol=http --enable-protocol=file \
-	  --disable-parsers --enable-parser=mpeg4video --enable-parser=aac --enable-parser=h264 \
+	  --disable-parsers --enable-parser=mpeg4video --enable-parser=aac --enable-parser=h264 --enable-parser=hevc \
 	  --disable-bsfs \
       --disable-indevs \
       --disable-outdevs \
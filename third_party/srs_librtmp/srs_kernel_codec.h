@@ -94,6 +94,7 @@ enum SrsCodecVideoAVCType
 //     5 = On2 VP6 with alpha channel
 //     6 = Screen video version 2
 //     7 = AVC
+//     12 = HEVC, not in the spec, but what the chinese CDNs use.
 enum SrsCodecVideo
 {
     // set to the zero to reserved, for array map.
@@ -110,9 +111,44 @@ enum SrsCodecVideo
     SrsCodecVideoOn2VP6WithAlphaChannel = 5,
     SrsCodecVideoScreenVideoVersion2     = 6,
     SrsCodecVideoAVC                     = 7,
+    SrsCodecVideoHEVC                    = 12,
 };
 std::string srs_codec_video2str(SrsCodecVideo codec);
 
+// Enhanced RTMP, veovera enhanced-rtmp-v1.pdf.
+// the IsExHeader bit of the first video byte, when set the byte is
+//      IsExHeader UB[1], FrameType UB[3], PacketType UB[4]
+// followed by a FourCC UI32 instead of the legacy codec id.
+#define SRS_FLV_VIDEO_EX_HEADER 0x80
+// FourCC "hvc1"
+#define SRS_FLV_VIDEO_FOURCC_HEVC 0x68766331
+enum SrsCodecVideoExPacketType
+{
+    SrsCodecVideoExPacketTypeSequenceStart          = 0,
+    // SI24 composition time follows, then the NALUs.
+    SrsCodecVideoExPacketTypeCodedFrames            = 1,
+    SrsCodecVideoExPacketTypeSequenceEnd            = 2,
+    // the NALUs, composition time is zero.
+    SrsCodecVideoExPacketTypeCodedFramesX           = 3,
+    SrsCodecVideoExPacketTypeMetadata               = 4,
+    SrsCodecVideoExPacketTypeMPEG2TSSequenceStart   = 5,
+};
+
+// HEVC NAL unit types, 7.4.2.2 in ITU-T H.265.
+#define SRS_HEVC_NALU_TYPE(b)   (((b) >> 1) & 0x3f)
+enum SrsHevcNaluType
+{
+    // IRAP pictures, BLA_W_LP to CRA_NUT, decoding may start there.
+    SrsHevcNaluTypeIrapFirst    = 16,
+    SrsHevcNaluTypeIrapLast     = 21,
+    SrsHevcNaluTypeVPS          = 32,
+    SrsHevcNaluTypeSPS          = 33,
+    SrsHevcNaluTypePPS          = 34,
+    SrsHevcNaluTypeAUD          = 35,
+    SrsHevcNaluTypePrefixSEI    = 39,
+    SrsHevcNaluTypeSuffixSEI    = 40,
+};
+
 // SoundFormat UB [4] 
 // Format of SoundData. The following values are defined:
 //     0 = Linear PCM, platform endian
@@ -384,7 +420,9 @@ public:
     // video specified
     SrsCodecVideoAVCFrame frame_type;
     SrsCodecVideoAVCType avc_packet_type;
-    // whether sample_units contains IDR frame.
+    // SrsCodecVideoAVC or SrsCodecVideoHEVC, the NALU header differs.
+    SrsCodecVideo vcodec;
+    // whether sample_units contains IDR frame, an IRAP picture for hevc.
     bool has_idr;
     SrsAvcNaluType first_nalu_type;
 public:
@@ -568,6 +606,9 @@ public:
     char*           sequenceParameterSetNALUnit;
     u_int16_t       pictureParameterSetLength;
     char*           pictureParameterSetNALUnit;
+    // hevc only, its sps and pps use the fields above.
+    u_int16_t       videoParameterSetLength;
+    char*           videoParameterSetNALUnit;
 private:
     // the avc payload format.
     SrsAvcPayloadFormat payload_format;
@@ -629,6 +670,8 @@ public:
     * demux the video specified data(frame_type, codec_id, ...) to sample.
     * demux the h.264 sepcified data(avc_profile, ...) to codec from sequence header.
     * demux the h.264 NALUs to sampe units.
+    * h.265 in the legacy codec id 12 or the enhanced rtmp FourCC is demuxed as well,
+    * @see SrsCodecSample.vcodec.
     */
     virtual int video_avc_demux(char* data, int size, SrsCodecSample* sample);
 public:
@@ -657,6 +700,19 @@ private:
     * from H.264-AVC-ISO_IEC_14496-15.pdf, page 20
     */
     virtual int avc_demux_ibmf_format(SrsStream* stream, SrsCodecSample* sample);
+    /**
+    * demux the enhanced rtmp video tag, after the first byte |header|.
+    */
+    virtual int video_ex_demux(int8_t header, SrsCodecSample* sample);
+    /**
+    * demux the hevc sequence header or NALUs of |avc_packet_type|.
+    */
+    virtual int hevc_demux(SrsCodecVideoAVCType avc_packet_type, SrsCodecSample* sample);
+    /**
+    * HEVCDecoderConfigurationRecord, ISO_IEC_14496-15 8.3.3.1.2,
+    * decode the vps, sps and pps.
+    */
+    virtual int hevc_demux_vps_sps_pps(SrsStream* stream);
 };
 
 #endif
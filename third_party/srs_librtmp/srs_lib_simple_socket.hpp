@@ -52,7 +52,12 @@ public:
 public:
     virtual srs_hijack_io_t hijack_io() = 0;
 	virtual int create_socket() = 0;
+	// use a socket connected already instead, e.g. accepted by a server.
+	virtual int attach_socket(int fd) = 0;
 	virtual int connect(const char* server, int port) = 0;
+	// connect to the first address that answers, see srs_hijack_io_connect_any.
+	virtual int connect_any(const char** server_ips, int nb_ips, int port,
+		int64_t timeout_us, const std::atomic<bool>* cancelled, int* index) = 0;
 	virtual int disconnect() = 0;
 // ISrsBufferReader
 public:
@@ -999,7 +999,9 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 //#include <srs_core.hpp>
 
+#include <atomic>
 #include <string>
+#include <vector>
 
 class SrsStream;
 class SrsBitStream;
@@ -1020,6 +1022,17 @@ extern int64_t srs_update_system_time_ms();
 
 // dns resolve utility, return the resolved ip address.
 extern std::string srs_dns_resolve(std::string host);
+/**
+* resolve every ipv4 address of host, answers are cached for a while so a
+* reconnect skips the lookup. the lookup runs on its own thread, the caller
+* gives up once *cancelled is set or timeout_ms passed.
+*/
+extern int srs_dns_resolve_all(std::string host, std::vector<std::string>& ips,
+    int64_t timeout_ms, const std::atomic<bool>* cancelled);
+// try ip first for host next time, it connected.
+extern void srs_dns_cache_prefer(std::string host, std::string ip);
+// forget the answer for host, none of its addresses connected.
+extern void srs_dns_cache_remove(std::string host);
 
 // whether system is little endian
 extern bool srs_is_little_endian();
@@ -5322,6 +5335,13 @@ public:
     */
     virtual int recv_message(SrsCommonMessage** pmsg);
     /**
+    * size of the next whole chunk in buf, as recv_message would parse it now.
+    * @return the chunk size in bytes, 0 when buf does not hold a whole chunk yet.
+    * @remark for non-blocking clients, which feed the protocol one chunk at a time
+    *       so that a read never stops in the middle of a chunk.
+    */
+    virtual int peek_chunk_size(const char* buf, int size);
+    /**
     * decode bytes oriented RTMP message to RTMP packet,
     * @param ppacket, output decoded packet, 
     *       always NULL if error, never NULL if success.
@@ -10830,11 +10850,25 @@ typedef void* srs_hijack_io_t;
     */
     extern int srs_hijack_io_create_socket(srs_hijack_io_t ctx);
     /**
+    * take over a socket connected already, e.g. accepted by a server.
+    * @return 0, success; otherswise, failed.
+    */
+    extern int srs_hijack_io_attach_socket(srs_hijack_io_t ctx, int fd);
+    /**
     * connect socket at server_ip:port.
     * @return 0, success; otherswise, failed.
     */
     extern int srs_hijack_io_connect(srs_hijack_io_t ctx, const char* server_ip, int port);
     /**
+    * connect socket to the first of server_ips:port that answers, a new
+    * address is tried every while until one connects, see RFC 8305.
+    * @param cancelled, give up once it is set by another thread.
+    * @param index, output the index of the address connected.
+    * @return 0, success; otherswise, failed.
+    */
+    extern int srs_hijack_io_connect_any(srs_hijack_io_t ctx, const char** server_ips, int nb_ips,
+        int port, int64_t timeout_us, const std::atomic<bool>* cancelled, int* index);
+    /**
     * read from socket.
     * @return 0, success; otherswise, failed.
     */
@@ -11098,7 +11132,10 @@ public:
 public:
 	virtual srs_hijack_io_t hijack_io();
 	virtual int create_socket();
+	virtual int attach_socket(int fd);
 	virtual int connect(const char* server, int port);
+	virtual int connect_any(const char** server_ips, int nb_ips, int port,
+		int64_t timeout_us, const std::atomic<bool>* cancelled, int* index);
 	virtual int disconnect();
 	// ISrsBufferReader
 public:
@@ -11742,6 +11779,14 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <sys/stat.h>
 #include <fcntl.h>
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
 using namespace std;
 
 //#include <srs_kernel_log.hpp>
@@ -11887,6 +11932,142 @@ string srs_dns_resolve(string host)
     return ipv4;
 }
 
+// how long a resolved host is reused.
+#define SRS_DNS_CACHE_TTL_MS (5 * 60 * 1000)
+// how often a waiting resolve checks for cancel.
+#define SRS_DNS_POLL_MS 20
+
+struct SrsDnsEntry
+{
+    std::vector<std::string> ips;
+    int64_t expire_ms;
+};
+
+// a lookup may outlive the caller that gave up on it.
+struct SrsDnsQuery
+{
+    std::mutex mtx;
+    std::condition_variable cond;
+    bool done;
+    std::vector<std::string> ips;
+    SrsDnsQuery() : done(false) {}
+};
+
+static std::mutex _srs_dns_mtx;
+static std::map<std::string, SrsDnsEntry> _srs_dns_cache;
+
+static int64_t srs_dns_now_ms()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void srs_dns_query(std::string host, std::shared_ptr<SrsDnsQuery> query)
+{
+    std::vector<std::string> ips;
+#ifdef _WIN32
+    // gethostbyname keeps its answer per thread on windows.
+    hostent* answer = gethostbyname(host.c_str());
+    for (int i = 0; answer && answer->h_addr_list[i]; i++) {
+        char ipv4[16];
+        memset(ipv4, 0, sizeof(ipv4));
+        inet_ntop_win32(AF_INET, answer->h_addr_list[i], ipv4, sizeof(ipv4));
+        if (std::find(ips.begin(), ips.end(), ipv4) == ips.end()) {
+            ips.push_back(ipv4);
+        }
+    }
+#else
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* answer = NULL;
+    if (getaddrinfo(host.c_str(), NULL, &hints, &answer) == 0) {
+        for (addrinfo* p = answer; p != NULL; p = p->ai_next) {
+            char ipv4[16];
+            memset(ipv4, 0, sizeof(ipv4));
+            inet_ntop(AF_INET, &((sockaddr_in*)p->ai_addr)->sin_addr, ipv4, sizeof(ipv4));
+            if (std::find(ips.begin(), ips.end(), ipv4) == ips.end()) {
+                ips.push_back(ipv4);
+            }
+        }
+        freeaddrinfo(answer);
+    }
+#endif
+
+    std::unique_lock<std::mutex> lck(query->mtx);
+    query->ips.swap(ips);
+    query->done = true;
+    query->cond.notify_all();
+}
+
+int srs_dns_resolve_all(string host, vector<string>& ips, int64_t timeout_ms, const std::atomic<bool>* cancelled)
+{
+    int ret = ERROR_SUCCESS;
+    
+    ips.clear();
+    if (inet_addr(host.c_str()) != INADDR_NONE) {
+        ips.push_back(host);
+        return ret;
+    }
+    
+    int64_t now = srs_dns_now_ms();
+    if (true) {
+        std::unique_lock<std::mutex> lck(_srs_dns_mtx);
+        std::map<std::string, SrsDnsEntry>::iterator it = _srs_dns_cache.find(host);
+        if (it != _srs_dns_cache.end() && it->second.expire_ms > now) {
+            ips = it->second.ips;
+            return ret;
+        }
+    }
+    
+    std::shared_ptr<SrsDnsQuery> query = std::make_shared<SrsDnsQuery>();
+    std::thread(srs_dns_query, host, query).detach();
+    
+    int64_t deadline = now + timeout_ms;
+    std::unique_lock<std::mutex> lck(query->mtx);
+    while (!query->done) {
+        if (cancelled && *cancelled) {
+            return ERROR_SOCKET_CLOSED;
+        }
+        if (srs_dns_now_ms() >= deadline) {
+            return ERROR_SOCKET_TIMEOUT;
+        }
+        query->cond.wait_for(lck, std::chrono::milliseconds(SRS_DNS_POLL_MS));
+    }
+    if (query->ips.empty()) {
+        return ERROR_SYSTEM_IP_INVALID;
+    }
+    ips = query->ips;
+    
+    std::unique_lock<std::mutex> cache_lck(_srs_dns_mtx);
+    SrsDnsEntry& entry = _srs_dns_cache[host];
+    entry.ips = ips;
+    entry.expire_ms = srs_dns_now_ms() + SRS_DNS_CACHE_TTL_MS;
+    
+    return ret;
+}
+
+void srs_dns_cache_prefer(string host, string ip)
+{
+    std::unique_lock<std::mutex> lck(_srs_dns_mtx);
+    std::map<std::string, SrsDnsEntry>::iterator it = _srs_dns_cache.find(host);
+    if (it == _srs_dns_cache.end()) {
+        return;
+    }
+    std::vector<std::string>& ips = it->second.ips;
+    std::vector<std::string>::iterator pos = std::find(ips.begin(), ips.end(), ip);
+    if (pos != ips.end()) {
+        std::rotate(ips.begin(), pos, pos + 1);
+    }
+}
+
+void srs_dns_cache_remove(string host)
+{
+    std::unique_lock<std::mutex> lck(_srs_dns_mtx);
+    _srs_dns_cache.erase(host);
+}
+
 bool srs_is_little_endian()
 {
     // convert to network(big-endian) order, if not equals, 
@@ -13642,6 +13823,8 @@ string srs_codec_video2str(SrsCodecVideo codec)
     switch (codec) {
         case SrsCodecVideoAVC: 
             return "H264";
+        case SrsCodecVideoHEVC:
+            return "H265";
         case SrsCodecVideoOn2VP6:
         case SrsCodecVideoOn2VP6WithAlphaChannel:
             return "VP6";
@@ -13943,6 +14126,7 @@ void SrsCodecSample::clear()
     cts = 0;
     frame_type = SrsCodecVideoAVCFrameReserved;
     avc_packet_type = SrsCodecVideoAVCTypeReserved;
+    vcodec = SrsCodecVideoReserved;
     has_idr = false;
     first_nalu_type = SrsAvcNaluTypeReserved;
     
@@ -13969,7 +14153,12 @@ int SrsCodecSample::add_sample_unit(char* bytes, int size)
     sample_unit->size = size;
     
     // for video, parse the nalu type, set the IDR flag.
-    if (is_video) {
+    if (is_video && vcodec == SrsCodecVideoHEVC) {
+        int nal_unit_type = SRS_HEVC_NALU_TYPE(bytes[0]);
+        if (nal_unit_type >= SrsHevcNaluTypeIrapFirst && nal_unit_type <= SrsHevcNaluTypeIrapLast) {
+            has_idr = true;
+        }
+    } else if (is_video) {
         SrsAvcNaluType nal_unit_type = (SrsAvcNaluType)(bytes[0] & 0x1f);
         
         if (nal_unit_type == SrsAvcNaluTypeIDR) {
@@ -14016,6 +14205,8 @@ SrsAvcAacCodec::SrsAvcAacCodec()
     sequenceParameterSetNALUnit = NULL;
     pictureParameterSetLength   = 0;
     pictureParameterSetNALUnit  = NULL;
+    videoParameterSetLength     = 0;
+    videoParameterSetNALUnit    = NULL;
 
     payload_format = SrsAvcPayloadFormatGuess;
     stream = new SrsStream();
@@ -14029,6 +14220,7 @@ SrsAvcAacCodec::~SrsAvcAacCodec()
     srs_freep(stream);
     srs_freepa(sequenceParameterSetNALUnit);
     srs_freepa(pictureParameterSetNALUnit);
+    srs_freepa(videoParameterSetNALUnit);
 }
 
 bool SrsAvcAacCodec::is_avc_codec_ok()
@@ -14259,6 +14451,9 @@ int SrsAvcAacCodec::video_avc_demux(char* data, int size, SrsCodecSample* sample
     
     // @see: E.4.3 Video Tags, video_file_format_spec_v10_1.pdf, page 78
     int8_t frame_type = stream->read_1bytes();
+    if (frame_type & SRS_FLV_VIDEO_EX_HEADER) {
+        return video_ex_demux(frame_type, sample);
+    }
     int8_t codec_id = frame_type & 0x0f;
     frame_type = (frame_type >> 4) & 0x0f;
     
@@ -14271,13 +14466,14 @@ int SrsAvcAacCodec::video_avc_demux(char* data, int size, SrsCodecSample* sample
         return ret;
     }
     
-    // only support h.264/avc
-    if (codec_id != SrsCodecVideoAVC) {
+    // only support h.264/avc and h.265/hevc
+    if (codec_id != SrsCodecVideoAVC && codec_id != SrsCodecVideoHEVC) {
         ret = ERROR_HLS_DECODE_ERROR;
-        srs_error("avc only support video h.264/avc codec. actual=%d, ret=%d", codec_id, ret);
+        srs_error("avc only support video h.264/avc and h.265/hevc codec. actual=%d, ret=%d", codec_id, ret);
         return ret;
     }
     video_codec_id = codec_id;
+    sample->vcodec = (SrsCodecVideo)codec_id;
     
     if (!stream->require(4)) {
         ret = ERROR_HLS_DECODE_ERROR;
@@ -14285,12 +14481,17 @@ int SrsAvcAacCodec::video_avc_demux(char* data, int size, SrsCodecSample* sample
         return ret;
     }
     int8_t avc_packet_type = stream->read_1bytes();
-    int32_t composition_time = stream->read_3bytes();
+    // SI24, negative when a frame is presented before it is decoded.
+    int32_t composition_time = (stream->read_3bytes() << 8) >> 8;
     
     // pts = dts + cts.
     sample->cts = composition_time;
     sample->avc_packet_type = (SrsCodecVideoAVCType)avc_packet_type;
     
+    if (codec_id == SrsCodecVideoHEVC) {
+        return hevc_demux(sample->avc_packet_type, sample);
+    }
+    
     if (avc_packet_type == SrsCodecVideoAVCTypeSequenceHeader) {
         if ((ret = avc_demux_sps_pps(stream)) != ERROR_SUCCESS) {
             return ret;
@@ -14360,6 +14561,152 @@ int SrsAvcAacCodec::video_avc_demux(char* data, int size, SrsCodecSample* sample
     return ret;
 }
 
+int SrsAvcAacCodec::video_ex_demux(int8_t header, SrsCodecSample* sample)
+{
+    int ret = ERROR_SUCCESS;
+    
+    sample->frame_type = (SrsCodecVideoAVCFrame)((header >> 4) & 0x07);
+    int8_t packet_type = header & 0x0f;
+    
+    if (!stream->require(4)) {
+        ret = ERROR_HLS_DECODE_ERROR;
+        srs_error("video ex decode fourcc failed. ret=%d", ret);
+        return ret;
+    }
+    u_int32_t fourcc = (u_int32_t)stream->read_4bytes();
+    
+    // the command frame, ignore without error.
+    if (sample->frame_type == SrsCodecVideoAVCFrameVideoInfoFrame) {
+        return ret;
+    }
+    if (fourcc != SRS_FLV_VIDEO_FOURCC_HEVC) {
+        ret = ERROR_HLS_DECODE_ERROR;
+        srs_error("video ex only support hevc. fourcc=%#x, ret=%d", fourcc, ret);
+        return ret;
+    }
+    video_codec_id = SrsCodecVideoHEVC;
+    sample->vcodec = SrsCodecVideoHEVC;
+    
+    switch (packet_type) {
+        case SrsCodecVideoExPacketTypeSequenceStart:
+            sample->avc_packet_type = SrsCodecVideoAVCTypeSequenceHeader;
+            break;
+        case SrsCodecVideoExPacketTypeCodedFrames:
+            if (!stream->require(3)) {
+                ret = ERROR_HLS_DECODE_ERROR;
+                srs_error("video ex decode composition time failed. ret=%d", ret);
+                return ret;
+            }
+            sample->cts = (stream->read_3bytes() << 8) >> 8;
+            sample->avc_packet_type = SrsCodecVideoAVCTypeNALU;
+            break;
+        case SrsCodecVideoExPacketTypeCodedFramesX:
+            sample->avc_packet_type = SrsCodecVideoAVCTypeNALU;
+            break;
+        default:
+            // sequence end, metadata, ignored.
+            sample->avc_packet_type = SrsCodecVideoAVCTypeSequenceHeaderEOF;
+            return ret;
+    }
+    
+    return hevc_demux(sample->avc_packet_type, sample);
+}
+
+int SrsAvcAacCodec::hevc_demux(SrsCodecVideoAVCType avc_packet_type, SrsCodecSample* sample)
+{
+    int ret = ERROR_SUCCESS;
+    
+    if (avc_packet_type == SrsCodecVideoAVCTypeSequenceHeader) {
+        return hevc_demux_vps_sps_pps(stream);
+    }
+    if (avc_packet_type != SrsCodecVideoAVCTypeNALU) {
+        return ret;
+    }
+    
+    // ensure the sequence header demuxed
+    if (!is_avc_codec_ok()) {
+        srs_warn("hevc ignore NALU for no sequence header. ret=%d", ret);
+        return ret;
+    }
+    // hevc in flv is always length prefixed, ISO_IEC_14496-15 8.3.2.
+    return avc_demux_ibmf_format(stream, sample);
+}
+
+int SrsAvcAacCodec::hevc_demux_vps_sps_pps(SrsStream* stream)
+{
+    int ret = ERROR_SUCCESS;
+    
+    // HEVCDecoderConfigurationRecord, ISO_IEC_14496-15 8.3.3.1.2
+    avc_extra_size = stream->size() - stream->pos();
+    if (avc_extra_size > 0) {
+        srs_freepa(avc_extra_data);
+        avc_extra_data = new char[avc_extra_size];
+        memcpy(avc_extra_data, stream->data() + stream->pos(), avc_extra_size);
+    }
+    
+    // configurationVersion to numTemporalLayers/temporalIdNested/lengthSizeMinusOne,
+    // then numOfArrays.
+    if (!stream->require(23)) {
+        ret = ERROR_HLS_DECODE_ERROR;
+        srs_error("hevc decode sequenc header failed. ret=%d", ret);
+        return ret;
+    }
+    stream->skip(21);
+    NAL_unit_length = stream->read_1bytes() & 0x03;
+    if (NAL_unit_length == 2) {
+        ret = ERROR_HLS_DECODE_ERROR;
+        srs_error("hevc lengthSizeMinusOne should never be 2. ret=%d", ret);
+        return ret;
+    }
+    int8_t numOfArrays = stream->read_1bytes();
+    
+    for (int i = 0; i < numOfArrays; i++) {
+        if (!stream->require(3)) {
+            ret = ERROR_HLS_DECODE_ERROR;
+            srs_error("hevc decode sequenc header array failed. ret=%d", ret);
+            return ret;
+        }
+        int8_t nal_unit_type = stream->read_1bytes() & 0x3f;
+        int16_t numNalus = stream->read_2bytes();
+        for (int j = 0; j < numNalus; j++) {
+            if (!stream->require(2)) {
+                ret = ERROR_HLS_DECODE_ERROR;
+                srs_error("hevc decode sequenc header nalu size failed. ret=%d", ret);
+                return ret;
+            }
+            u_int16_t nalUnitLength = stream->read_2bytes();
+            if (!stream->require(nalUnitLength)) {
+                ret = ERROR_HLS_DECODE_ERROR;
+                srs_error("hevc decode sequenc header nalu data failed. ret=%d", ret);
+                return ret;
+            }
+            // the first of each kind, like the avc sequence header.
+            u_int16_t* length = NULL;
+            char** nalu = NULL;
+            if (nal_unit_type == SrsHevcNaluTypeVPS) {
+                length = &videoParameterSetLength;
+                nalu = &videoParameterSetNALUnit;
+            } else if (nal_unit_type == SrsHevcNaluTypeSPS) {
+                length = &sequenceParameterSetLength;
+                nalu = &sequenceParameterSetNALUnit;
+            } else if (nal_unit_type == SrsHevcNaluTypePPS) {
+                length = &pictureParameterSetLength;
+                nalu = &pictureParameterSetNALUnit;
+            }
+            if (j == 0 && length && nalUnitLength > 0) {
+                srs_freepa(*nalu);
+                *nalu = new char[nalUnitLength];
+                *length = nalUnitLength;
+                stream->read_bytes(*nalu, nalUnitLength);
+            } else {
+                stream->skip(nalUnitLength);
+            }
+        }
+    }
+    
+    return ret;
+}
+
 int SrsAvcAacCodec::avc_demux_sps_pps(SrsStream* stream)
 {
     int ret = ERROR_SUCCESS;
@@ -22230,6 +22577,87 @@ int SrsProtocol::read_message_payload(SrsChunkStream* chunk, SrsCommonMessage**
     return ret;
 }
 
+int SrsProtocol::peek_chunk_size(const char* buf, int size)
+{
+    // basic header, @see read_basic_header
+    if (size < 1) {
+        return 0;
+    }
+    int pos = 1;
+    char fmt = (buf[0] >> 6) & 0x03;
+    int cid = buf[0] & 0x3f;
+    if (cid == 0) {
+        if (size < 2) {
+            return 0;
+        }
+        cid = 64 + (u_int8_t)buf[1];
+        pos = 2;
+    } else if (cid == 1) {
+        if (size < 3) {
+            return 0;
+        }
+        cid = 64 + (u_int8_t)buf[1] + ((u_int8_t)buf[2]) * 256;
+        pos = 3;
+    }
+    
+    // the chunk stream state as left by the previous chunk, NULL for a fresh one.
+    SrsChunkStream* chunk = NULL;
+    if (cid < SRS_PERF_CHUNK_STREAM_CACHE) {
+        chunk = cs_cache[cid];
+    } else {
+        std::map<int, SrsChunkStream*>::iterator it = chunk_streams.find(cid);
+        if (it != chunk_streams.end()) {
+            chunk = it->second;
+        }
+    }
+    bool is_first_chunk_of_msg = !chunk || !chunk->msg;
+    bool extended_timestamp = chunk? chunk->extended_timestamp : false;
+    int32_t payload_length = chunk? chunk->header.payload_length : 0;
+    
+    // message header, @see read_message_header
+    static char mh_sizes[] = {11, 7, 3, 0};
+    int mh_size = mh_sizes[(int)fmt];
+    if (size < pos + mh_size) {
+        return 0;
+    }
+    const u_int8_t* p = (const u_int8_t*)buf + pos;
+    if (fmt <= RTMP_FMT_TYPE2) {
+        int32_t timestamp_delta = (p[0] << 16) | (p[1] << 8) | p[2];
+        extended_timestamp = (timestamp_delta >= RTMP_EXTENDED_TIMESTAMP);
+        if (fmt <= RTMP_FMT_TYPE1) {
+            payload_length = (p[3] << 16) | (p[4] << 8) | p[5];
+        }
+    }
+    pos += mh_size;
+    
+    if (extended_timestamp) {
+        if (size < pos + 4) {
+            return 0;
+        }
+        p = (const u_int8_t*)buf + pos;
+        u_int32_t timestamp = ((u_int32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+        timestamp &= 0x7fffffff;
+        
+        // same detection of peers that omit it in the continued chunks.
+        u_int32_t chunk_timestamp = chunk? (u_int32_t)chunk->header.timestamp : 0;
+        if (is_first_chunk_of_msg || chunk_timestamp <= 0 || chunk_timestamp == timestamp) {
+            pos += 4;
+        }
+    }
+    
+    // payload, @see read_message_payload
+    if (payload_length <= 0) {
+        return pos;
+    }
+    int received = (chunk && chunk->msg)? chunk->msg->size : 0;
+    int payload_size = srs_min(payload_length - received, in_chunk_size);
+    if (size < pos + payload_size) {
+        return 0;
+    }
+    
+    return pos + payload_size;
+}
+
 int SrsProtocol::on_recv_message(SrsCommonMessage* msg)
 {
     int ret = ERROR_SUCCESS;
@@ -31852,6 +32280,11 @@ struct Context
     int64_t stimeout;
     int64_t rtimeout;
     
+    // every address of host, ip is the one connected.
+    std::vector<std::string> ips;
+    // set by srs_rtmp_disconnect_server to abort a resolve or connect.
+    std::atomic<bool> cancelled;
+    
     Context() {
         rtmp = NULL;
         skt = NULL;
@@ -31861,6 +32294,7 @@ struct Context
         h264_sps_changed = false;
         h264_pps_changed = false;
         rtimeout = stimeout = -1;
+        cancelled = false;
     }
     virtual ~Context() {
         srs_freep(req);
@@ -32233,11 +32667,11 @@ int srs_librtmp_context_resolve_host(Context* context)
 {
     int ret = ERROR_SUCCESS;
     
-    // connect to server:port
-    context->ip = srs_dns_resolve(context->host);
-    if (context->ip.empty()) {
-        return -1;
+    int64_t timeout_ms = (context->stimeout > 0 ? context->stimeout : SRS_SOCKET_DEFAULT_TIMEOUT) / 1000;
+    if ((ret = srs_dns_resolve_all(context->host, context->ips, timeout_ms, &context->cancelled)) != ERROR_SUCCESS) {
+        return ret;
     }
+    context->ip = context->ips[0];
     
     return ret;
 }
@@ -32248,12 +32682,25 @@ int srs_librtmp_context_connect(Context* context)
     
     srs_assert(context->skt);
     
-    std::string ip = context->ip;
+    if (context->ips.empty()) {
+        context->ips.push_back(context->ip);
+    }
+    std::vector<const char*> ips;
+    for (int i = 0; i < (int)context->ips.size(); i++) {
+        ips.push_back(context->ips[i].c_str());
+    }
     int port = ::atoi(context->port.c_str());
     
-    if ((ret = context->skt->connect(ip.c_str(), port)) != ERROR_SUCCESS) {
+    int index = 0;
+    if ((ret = context->skt->connect_any(&ips[0], (int)ips.size(), port,
+        context->stimeout, &context->cancelled, &index)) != ERROR_SUCCESS) {
+        if (!context->cancelled) {
+            srs_dns_cache_remove(context->host);
+        }
         return ret;
     }
+    context->ip = context->ips[index];
+    srs_dns_cache_prefer(context->host, context->ip);
     
     return ret;
 }
@@ -32271,6 +32718,189 @@ int srs_librtmp_context_disconnect(Context* context)
 	return ret;
 }
 
+/**
+* memory io for the non-blocking session, the caller owns the socket.
+* reads are limited to the bytes fed, a read with nothing left returns
+* ERROR_SOCKET_TIMEOUT, which the protocol stack treats as retryable.
+*/
+class SrsNbStream : public ISrsProtocolReaderWriter
+{
+private:
+    const char* in;
+    int nb_in;
+    std::string out;
+    int64_t recv_bytes;
+    int64_t send_bytes;
+    int64_t recv_timeout;
+    int64_t send_timeout;
+public:
+    SrsNbStream() {
+        in = NULL;
+        nb_in = 0;
+        recv_bytes = send_bytes = 0;
+        recv_timeout = send_timeout = -1; // no timeout, same as ST_UTIME_NO_TIMEOUT
+    }
+    virtual ~SrsNbStream() {
+    }
+public:
+    // expose the next bytes to read, must stay valid until all are read.
+    void feed(const char* buf, int size) {
+        in = buf;
+        nb_in = size;
+    }
+    int fed_size() {
+        return nb_in;
+    }
+    std::string& output() {
+        return out;
+    }
+// ISrsBufferReader
+public:
+    virtual int read(void* buf, size_t size, ssize_t* nread) {
+        if (nb_in <= 0) {
+            return ERROR_SOCKET_TIMEOUT;
+        }
+        int n = srs_min((int)size, nb_in);
+        memcpy(buf, in, n);
+        in += n;
+        nb_in -= n;
+        recv_bytes += n;
+        if (nread) {
+            *nread = n;
+        }
+        return ERROR_SUCCESS;
+    }
+// ISrsProtocolReader
+public:
+    virtual void set_recv_timeout(int64_t timeout_us) {
+        recv_timeout = timeout_us;
+    }
+    virtual int64_t get_recv_timeout() {
+        return recv_timeout;
+    }
+    virtual int64_t get_recv_bytes() {
+        return recv_bytes;
+    }
+// ISrsProtocolWriter
+public:
+    virtual void set_send_timeout(int64_t timeout_us) {
+        send_timeout = timeout_us;
+    }
+    virtual int64_t get_send_timeout() {
+        return send_timeout;
+    }
+    virtual int64_t get_send_bytes() {
+        return send_bytes;
+    }
+    virtual int writev(const iovec *iov, int iov_size, ssize_t* nwrite) {
+        ssize_t n = 0;
+        for (int i = 0; i < iov_size; i++) {
+            out.append((const char*)iov[i].iov_base, iov[i].iov_len);
+            n += iov[i].iov_len;
+        }
+        send_bytes += n;
+        if (nwrite) {
+            *nwrite = n;
+        }
+        return ERROR_SUCCESS;
+    }
+// ISrsProtocolReaderWriter
+public:
+    virtual bool is_never_timeout(int64_t timeout_us) {
+        return timeout_us == -1;
+    }
+    virtual int read_fully(void* buf, size_t size, ssize_t* nread) {
+        if (nb_in < (int)size) {
+            return ERROR_SOCKET_TIMEOUT;
+        }
+        return read(buf, size, nread);
+    }
+    virtual int write(void* buf, size_t size, ssize_t* nwrite) {
+        out.append((const char*)buf, size);
+        send_bytes += size;
+        if (nwrite) {
+            *nwrite = size;
+        }
+        return ERROR_SUCCESS;
+    }
+};
+
+enum SrsNbState
+{
+    SrsNbStateInit = 0,
+    SrsNbStateHandshake,
+    SrsNbStateConnectApp,
+    SrsNbStateCreateStream,
+    SrsNbStatePlaying,
+};
+
+/**
+* the non-blocking play session, never touches a socket.
+*/
+struct NbContext : public Context
+{
+    SrsNbStream io;
+    SrsProtocol* protocol;
+    SrsHandshakeBytes hs_bytes;
+    SrsNbState state;
+    // bytes received but not yet parsed, starting at in_pos.
+    std::string in;
+    int in_pos;
+    
+    NbContext() {
+        protocol = new SrsProtocol(&io);
+        state = SrsNbStateInit;
+        in_pos = 0;
+    }
+    virtual ~NbContext() {
+        srs_freep(protocol);
+    }
+};
+
+/**
+* handle a response while the play commands are in flight, @see SrsRtmpClient.
+*/
+int srs_rtmp_nb_on_command(NbContext* context, SrsCommonMessage* msg)
+{
+    int ret = ERROR_SUCCESS;
+    
+    SrsPacket* packet = NULL;
+    if ((ret = context->protocol->decode_message(msg, &packet)) != ERROR_SUCCESS) {
+        srs_error("decode message failed. ret=%d", ret);
+        srs_freep(packet);
+        return ret;
+    }
+    SrsAutoFree(SrsPacket, packet);
+    
+    if (context->state == SrsNbStateConnectApp && dynamic_cast<SrsConnectAppResPacket*>(packet)) {
+        SrsCreateStreamPacket* pkt = new SrsCreateStreamPacket();
+        if ((ret = context->protocol->send_and_free_packet(pkt, 0)) != ERROR_SUCCESS) {
+            return ret;
+        }
+        context->state = SrsNbStateCreateStream;
+    } else if (context->state == SrsNbStateCreateStream && dynamic_cast<SrsCreateStreamResPacket*>(packet)) {
+        context->stream_id = (int)dynamic_cast<SrsCreateStreamResPacket*>(packet)->stream_id;
+        
+        SrsPlayPacket* play = new SrsPlayPacket();
+        play->stream_name = context->stream;
+        if ((ret = context->protocol->send_and_free_packet(play, context->stream_id)) != ERROR_SUCCESS) {
+            return ret;
+        }
+        
+        // SetBufferLength(500ms)
+        SrsUserControlPacket* pkt = new SrsUserControlPacket();
+        pkt->event_type = SrcPCUCSetBufferLength;
+        pkt->event_data = context->stream_id;
+        pkt->extra_data = 500;
+        if ((ret = context->protocol->send_and_free_packet(pkt, 0)) != ERROR_SUCCESS) {
+            return ret;
+        }
+        context->state = SrsNbStatePlaying;
+    }
+    
+    return ret;
+}
+
 #ifdef __cplusplus
 extern "C"{
 #endif
@@ -32427,6 +33057,7 @@ int srs_rtmp_disconnect_server(srs_rtmp_t rtmp)
 	int ret = ERROR_SUCCESS;
 	srs_assert(rtmp != NULL);
 	Context* context = (Context*)rtmp;
+	context->cancelled = true;
 	if ((ret = srs_librtmp_context_disconnect(context)) != ERROR_SUCCESS) {
 		return ret;
 	}
@@ -32939,6 +33570,328 @@ int srs_rtmp_get_custom_metadata_sync_ts(char* data, int size, double& value)
     return 0;
 }
 
+srs_rtmp_nb_t srs_rtmp_nb_create(const char* url)
+{
+    NbContext* context = new NbContext();
+    context->url = url;
+    
+    srs_librtmp_context_parse_uri(context);
+    // the caller resolves and connects, the tcUrl keeps the host name.
+    context->ip = context->host;
+    
+    return context;
+}
+
+void srs_rtmp_nb_destroy(srs_rtmp_nb_t nb)
+{
+    if (!nb) {
+        return;
+    }
+    
+    NbContext* context = (NbContext*)nb;
+    srs_freep(context);
+}
+
+int srs_rtmp_nb_get_server(srs_rtmp_nb_t nb, char host[128], int* port)
+{
+    srs_assert(nb != NULL);
+    NbContext* context = (NbContext*)nb;
+    
+    snprintf(host, 128, "%s", context->host.c_str());
+    *port = ::atoi(context->port.c_str());
+    
+    return context->host.empty()? -1 : ERROR_SUCCESS;
+}
+
+int srs_rtmp_nb_start(srs_rtmp_nb_t nb)
+{
+    int ret = ERROR_SUCCESS;
+    
+    srs_assert(nb != NULL);
+    NbContext* context = (NbContext*)nb;
+    
+    // simple handshake, @see SrsSimpleHandshake::handshake_with_server
+    if ((ret = context->hs_bytes.create_c0c1()) != ERROR_SUCCESS) {
+        return ret;
+    }
+    context->io.write(context->hs_bytes.c0c1, 1537, NULL);
+    context->state = SrsNbStateHandshake;
+    
+    return ret;
+}
+
+int srs_rtmp_nb_on_recv(srs_rtmp_nb_t nb, const char* data, int size)
+{
+    int ret = ERROR_SUCCESS;
+    
+    srs_assert(nb != NULL);
+    NbContext* context = (NbContext*)nb;
+    
+    // the fed bytes are always consumed before we return, compact safely.
+    srs_assert(context->io.fed_size() == 0);
+    if (context->in_pos > 0 && context->in_pos * 2 >= (int)context->in.size()) {
+        context->in.erase(0, context->in_pos);
+        context->in_pos = 0;
+    }
+    context->in.append(data, size);
+    
+    if (context->state != SrsNbStateHandshake) {
+        return ret;
+    }
+    
+    // s0s1s2
+    if ((int)context->in.size() - context->in_pos < 3073) {
+        return ret;
+    }
+    const char* s0s1s2 = context->in.data() + context->in_pos;
+    if (s0s1s2[0] != 0x03) {
+        ret = ERROR_RTMP_HANDSHAKE;
+        srs_warn("handshake failed, plain text required. ret=%d", ret);
+        return ret;
+    }
+    // for simple handshake, copy s1 to c2.
+    context->io.write((void*)(s0s1s2 + 1), 1536, NULL);
+    context->in_pos += 3073;
+    
+    // Connect(vhost, app), @see SrsRtmpClient::connect_app2
+    string tcUrl = srs_generate_tc_url(
+        context->ip, context->vhost, context->app, context->port,
+        context->param
+    );
+    SrsConnectAppPacket* pkt = new SrsConnectAppPacket();
+    pkt->command_object->set("app", SrsAmf0Any::str(context->app.c_str()));
+    pkt->command_object->set("flashVer", SrsAmf0Any::str("WIN 15,0,0,239"));
+    pkt->command_object->set("swfUrl", SrsAmf0Any::str());
+    pkt->command_object->set("tcUrl", SrsAmf0Any::str(tcUrl.c_str()));
+    pkt->command_object->set("fpad", SrsAmf0Any::boolean(false));
+    pkt->command_object->set("capabilities", SrsAmf0Any::number(239));
+    pkt->command_object->set("audioCodecs", SrsAmf0Any::number(3575));
+    pkt->command_object->set("videoCodecs", SrsAmf0Any::number(252));
+    pkt->command_object->set("videoFunction", SrsAmf0Any::number(1));
+    pkt->command_object->set("pageUrl", SrsAmf0Any::str());
+    pkt->command_object->set("objectEncoding", SrsAmf0Any::number(0));
+    if ((ret = context->protocol->send_and_free_packet(pkt, 0)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    
+    // Set Window Acknowledgement size(2500000)
+    SrsSetWindowAckSizePacket* ack = new SrsSetWindowAckSizePacket();
+    ack->ackowledgement_window_size = 2500000;
+    if ((ret = context->protocol->send_and_free_packet(ack, 0)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    context->state = SrsNbStateConnectApp;
+    
+    return ret;
+}
+
+int srs_rtmp_nb_pending_send(srs_rtmp_nb_t nb, const char** data, int* size)
+{
+    srs_assert(nb != NULL);
+    NbContext* context = (NbContext*)nb;
+    
+    std::string& out = context->io.output();
+    *data = out.data();
+    *size = (int)out.size();
+    
+    return ERROR_SUCCESS;
+}
+
+void srs_rtmp_nb_consume_send(srs_rtmp_nb_t nb, int size)
+{
+    srs_assert(nb != NULL);
+    NbContext* context = (NbContext*)nb;
+    
+    context->io.output().erase(0, size);
+}
+
+srs_bool srs_rtmp_nb_is_playing(srs_rtmp_nb_t nb)
+{
+    srs_assert(nb != NULL);
+    NbContext* context = (NbContext*)nb;
+    
+    return context->state == SrsNbStatePlaying;
+}
+
+int srs_rtmp_nb_read_packet(srs_rtmp_nb_t nb, char* type, u_int32_t* timestamp, char** data, int* size)
+{
+    *type = 0;
+    *timestamp = 0;
+    *data = NULL;
+    *size = 0;
+    
+    int ret = ERROR_SUCCESS;
+    
+    srs_assert(nb != NULL);
+    NbContext* context = (NbContext*)nb;
+    
+    if (context->state < SrsNbStateConnectApp) {
+        return ret;
+    }
+    
+    for (;;) {
+        SrsCommonMessage* msg = NULL;
+        
+        // read from cache first.
+        if (!context->msgs.empty()) {
+            std::vector<SrsCommonMessage*>::iterator it = context->msgs.begin();
+            msg = *it;
+            context->msgs.erase(it);
+        }
+        
+        if (!msg && (ret = context->protocol->recv_message(&msg)) != ERROR_SUCCESS) {
+            if (ret != ERROR_SOCKET_TIMEOUT) {
+                return ret;
+            }
+            ret = ERROR_SUCCESS;
+            
+            // all fed bytes parsed, feed the next whole chunk if there is one.
+            const char* buf = context->in.data() + context->in_pos;
+            int nb_buf = (int)context->in.size() - context->in_pos;
+            int chunk_size = context->protocol->peek_chunk_size(buf, nb_buf);
+            if (chunk_size <= 0) {
+                return ret;
+            }
+            context->io.feed(buf, chunk_size);
+            context->in_pos += chunk_size;
+            continue;
+        }
+        
+        // no msg, try again.
+        if (!msg) {
+            continue;
+        }
+        
+        SrsAutoFree(SrsCommonMessage, msg);
+        
+        if (context->state != SrsNbStatePlaying) {
+            if ((ret = srs_rtmp_nb_on_command(context, msg)) != ERROR_SUCCESS) {
+                return ret;
+            }
+            continue;
+        }
+        
+        // process the got packet, if nothing, try again.
+        bool got_msg;
+        if ((ret = srs_rtmp_go_packet(context, msg, type, timestamp, data, size, &got_msg)) != ERROR_SUCCESS) {
+            return ret;
+        }
+        
+        // got expected message.
+        if (got_msg) {
+            break;
+        }
+    }
+    
+    return ret;
+}
+
+struct ServerContext
+{
+    SimpleSocketStream* skt;
+    SrsRtmpServer* rtmp;
+    SrsRequest* req;
+    int stream_id;
+    
+    ServerContext() {
+        skt = NULL;
+        rtmp = NULL;
+        req = NULL;
+        stream_id = SRS_DEFAULT_SID;
+    }
+    virtual ~ServerContext() {
+        srs_freep(req);
+        srs_freep(rtmp);
+        srs_freep(skt);
+    }
+};
+
+srs_rtmp_server_t srs_rtmp_server_create(int fd)
+{
+    ServerContext* context = new ServerContext();
+    context->skt = new SimpleSocketStreamImpl();
+    context->skt->attach_socket(fd);
+    context->rtmp = new SrsRtmpServer(context->skt);
+    context->req = new SrsRequest();
+    return context;
+}
+
+void srs_rtmp_server_destroy(srs_rtmp_server_t server)
+{
+    srs_assert(server != NULL);
+    ServerContext* context = (ServerContext*)server;
+    
+    srs_freep(context);
+}
+
+int srs_rtmp_server_accept_play(srs_rtmp_server_t server, char app[128], char stream[128])
+{
+    int ret = ERROR_SUCCESS;
+    
+    srs_assert(server != NULL);
+    ServerContext* context = (ServerContext*)server;
+    SrsRtmpServer* rtmp = context->rtmp;
+    SrsRequest* req = context->req;
+    
+    if ((ret = rtmp->handshake()) != ERROR_SUCCESS) {
+        return ret;
+    }
+    if ((ret = rtmp->connect_app(req)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    // the same window and bandwidth srs answers with
+    if ((ret = rtmp->set_window_ack_size((int)(2.5 * 1000 * 1000))) != ERROR_SUCCESS) {
+        return ret;
+    }
+    if ((ret = rtmp->set_peer_bandwidth((int)(2.5 * 1000 * 1000), 2)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    if ((ret = rtmp->response_connect_app(req)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    if ((ret = rtmp->on_bw_done()) != ERROR_SUCCESS) {
+        return ret;
+    }
+    
+    SrsRtmpConnType type = SrsRtmpConnUnknown;
+    if ((ret = rtmp->identify_client(context->stream_id, type, req->stream, req->duration)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    if (type != SrsRtmpConnPlay) {
+        return ERROR_RTMP_ACCESS_DENIED;
+    }
+    if ((ret = rtmp->start_play(context->stream_id)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    if ((ret = rtmp->set_chunk_size(SRS_CONSTS_RTMP_SRS_CHUNK_SIZE)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    
+    snprintf(app, 128, "%s", req->app.c_str());
+    snprintf(stream, 128, "%s", req->stream.c_str());
+    return ret;
+}
+
+int srs_rtmp_server_write_packet(srs_rtmp_server_t server, char type, u_int32_t timestamp, const char* data, int size)
+{
+    int ret = ERROR_SUCCESS;
+    
+    srs_assert(server != NULL);
+    ServerContext* context = (ServerContext*)server;
+    
+    // the message owns its payload
+    char* payload = new char[size];
+    memcpy(payload, data, size);
+    
+    SrsSharedPtrMessage* msg = NULL;
+    if ((ret = srs_rtmp_create_msg(type, timestamp, payload, size, context->stream_id, &msg)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    srs_assert(msg);
+    
+    return context->rtmp->send_and_free_message(msg, context->stream_id);
+}
+
 /**
 * directly write a audio frame.
 */
@@ -34414,6 +35367,8 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
     #include <netinet/in.h>
     #include <arpa/inet.h>
     #include <sys/uio.h>
+    #include <sys/select.h>
+    #include <fcntl.h>
 #endif
 
 #include <sys/types.h>
@@ -34473,6 +35428,16 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #endif    
         return ERROR_SUCCESS;
     }
+    int srs_hijack_io_attach_socket(srs_hijack_io_t ctx, int fd)
+    {
+        SrsBlockSyncSocket* skt = (SrsBlockSyncSocket*)ctx;
+        
+        skt->fd = (SOCKET)fd;
+        if (!SOCKET_VALID(skt->fd)) {
+            return ERROR_SOCKET_CREATE;
+        }
+        return ERROR_SUCCESS;
+    }
     int srs_hijack_io_connect(srs_hijack_io_t ctx, const char* server_ip, int port)
     {
         SrsBlockSyncSocket* skt = (SrsBlockSyncSocket*)ctx;
@@ -34488,9 +35453,161 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
         
         return ERROR_SUCCESS;
     }
+    // start the next address after this long without an answer.
+    #define SRS_CONNECT_RACE_DELAY_MS 250
+    // how often a connect in progress checks for cancel.
+    #define SRS_CONNECT_POLL_MS 20
+    static int64_t srs_connect_now_ms()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    static void srs_socket_set_nonblock(SOCKET fd, bool nonblock)
+    {
+#ifdef _WIN32
+        u_long mode = nonblock ? 1 : 0;
+        ioctlsocket(fd, FIONBIO, &mode);
+#else
+        int flags = fcntl(fd, F_GETFL, 0);
+        fcntl(fd, F_SETFL, nonblock ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK));
+#endif
+    }
+    // non-blocking connect, the socket is reset when it failed at once.
+    static SOCKET srs_connect_start(const char* server_ip, int port)
+    {
+        SOCKET fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (!SOCKET_VALID(fd)) {
+            return fd;
+        }
+#if defined(WEBRTC_IOS)
+        int value = 1;
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &value, sizeof(value));
+#endif
+        srs_socket_set_nonblock(fd, true);
+        
+        sockaddr_in addr;
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = inet_addr(server_ip);
+        if (::connect(fd, (const struct sockaddr*)&addr, sizeof(sockaddr_in)) < 0) {
+#ifdef _WIN32
+            if (SOCKET_ERRNO() != WSAEWOULDBLOCK) {
+#else
+            if (SOCKET_ERRNO() != EINPROGRESS) {
+#endif
+                SOCKET_CLOSE(fd);
+            }
+        }
+        return fd;
+    }
+    int srs_hijack_io_set_recv_timeout(srs_hijack_io_t ctx, int64_t timeout_us);
+    int srs_hijack_io_set_send_timeout(srs_hijack_io_t ctx, int64_t timeout_us);
+    int srs_hijack_io_connect_any(srs_hijack_io_t ctx, const char** server_ips, int nb_ips,
+        int port, int64_t timeout_us, const std::atomic<bool>* cancelled, int* index)
+    {
+        SrsBlockSyncSocket* skt = (SrsBlockSyncSocket*)ctx;
+        
+        int ret = ERROR_SOCKET_CONNECT;
+        std::vector<SOCKET> fds(nb_ips);
+        for (int i = 0; i < nb_ips; i++) {
+            SOCKET_RESET(fds[i]);
+        }
+        int started = 0;
+        int failed = 0;
+        int winner = -1;
+        int64_t start_ms = srs_connect_now_ms();
+        int64_t next_start_ms = start_ms;
+        
+        while (winner < 0 && failed < nb_ips) {
+            if (cancelled && *cancelled) {
+                ret = ERROR_SOCKET_CLOSED;
+                break;
+            }
+            int64_t now = srs_connect_now_ms();
+            if (timeout_us > 0 && (now - start_ms) * 1000 >= timeout_us) {
+                ret = ERROR_SOCKET_TIMEOUT;
+                break;
+            }
+            // next address when the race delay passed or everything started has failed.
+            if (started < nb_ips && (now >= next_start_ms || failed == started)) {
+                fds[started] = srs_connect_start(server_ips[started], port);
+                if (!SOCKET_VALID(fds[started])) {
+                    failed++;
+                }
+                started++;
+                next_start_ms = now + SRS_CONNECT_RACE_DELAY_MS;
+                continue;
+            }
+            
+            fd_set wfds;
+            fd_set efds;
+            FD_ZERO(&wfds);
+            FD_ZERO(&efds);
+            SOCKET max_fd = 0;
+            for (int i = 0; i < started; i++) {
+                if (SOCKET_VALID(fds[i])) {
+                    FD_SET(fds[i], &wfds);
+                    FD_SET(fds[i], &efds);
+                    max_fd = srs_max(max_fd, fds[i]);
+                }
+            }
+            struct timeval tv = { 0, SRS_CONNECT_POLL_MS * 1000 };
+            if (::select((int)max_fd + 1, NULL, &wfds, &efds, &tv) <= 0) {
+                continue;
+            }
+            for (int i = 0; i < started; i++) {
+                if (!SOCKET_VALID(fds[i]) || (!FD_ISSET(fds[i], &wfds) && !FD_ISSET(fds[i], &efds))) {
+                    continue;
+                }
+                int err = 0;
+                socklen_t len = sizeof(err);
+                getsockopt(fds[i], SOL_SOCKET, SO_ERROR, (char*)&err, &len);
+                if (err == 0 && FD_ISSET(fds[i], &wfds)) {
+                    winner = i;
+                    break;
+                }
+                SOCKET_CLOSE(fds[i]);
+                failed++;
+            }
+        }
+        
+        for (int i = 0; i < started; i++) {
+            if (i != winner) {
+                SOCKET_CLOSE(fds[i]);
+            }
+        }
+        if (winner < 0) {
+            return ret;
+        }
+        
+        srs_socket_set_nonblock(fds[winner], false);
+        SOCKET_CLOSE(skt->fd);
+        skt->fd = fds[winner];
+        // the timeouts were set on the socket replaced.
+        if (skt->recv_timeout != ST_UTIME_NO_TIMEOUT) {
+            srs_hijack_io_set_recv_timeout(ctx, skt->recv_timeout);
+        }
+        if (skt->send_timeout != ST_UTIME_NO_TIMEOUT) {
+            srs_hijack_io_set_send_timeout(ctx, skt->send_timeout);
+        }
+        if (index) {
+            *index = winner;
+        }
+        return ERROR_SUCCESS;
+    }
 	int srs_hijack_io_disconnect(srs_hijack_io_t ctx)
 	{
 		SrsBlockSyncSocket* skt = (SrsBlockSyncSocket*)ctx;
+		// wakes up a recv blocked on another thread.
+#ifdef _WIN32
+		if (SOCKET_VALID(skt->fd)) {
+			::shutdown(skt->fd, SD_BOTH);
+		}
+#else
+		if (SOCKET_VALID(skt->fd)) {
+			::shutdown(skt->fd, SHUT_RDWR);
+		}
+#endif
 		SOCKET_CLOSE(skt->fd);
 		return ERROR_SUCCESS;
 	}
@@ -34714,12 +35831,25 @@ int SimpleSocketStreamImpl::create_socket()
     return srs_hijack_io_create_socket(io);
 }
 
+int SimpleSocketStreamImpl::attach_socket(int fd)
+{
+    srs_assert(io);
+    return srs_hijack_io_attach_socket(io, fd);
+}
+
 int SimpleSocketStreamImpl::connect(const char* server_ip, int port)
 {
     srs_assert(io);
     return srs_hijack_io_connect(io, server_ip, port);
 }
 
+int SimpleSocketStreamImpl::connect_any(const char** server_ips, int nb_ips, int port,
+	int64_t timeout_us, const std::atomic<bool>* cancelled, int* index)
+{
+    srs_assert(io);
+    return srs_hijack_io_connect_any(io, server_ips, nb_ips, port, timeout_us, cancelled, index);
+}
+
 int SimpleSocketStreamImpl::disconnect()
 {
 	srs_assert(io);
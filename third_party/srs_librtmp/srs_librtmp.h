@@ -305,6 +305,8 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 
 #ifdef __cplusplus
+// the cancel flag of srs_hijack_io_connect_any
+#include <atomic>
 extern "C"{
 #endif
 
@@ -391,11 +393,11 @@ extern void srs_rtmp_destroy(srs_rtmp_t rtmp);
 * user can use these functions if needed.
 */
 extern int srs_rtmp_handshake(srs_rtmp_t rtmp);
-// parse uri, create socket, resolve host
+// parse uri, create socket, resolve host, answers are cached for 5 minutes
 extern int srs_rtmp_dns_resolve(srs_rtmp_t rtmp);
-// connect socket to server
+// connect socket to server, when the host has several addresses they are raced
 extern int srs_rtmp_connect_server(srs_rtmp_t rtmp);
-// disconnect socket to server
+// disconnect socket to server, also aborts a resolve or connect running on another thread
 extern int srs_rtmp_disconnect_server(srs_rtmp_t rtmp);
 // do simple handshake over socket.
 extern int srs_rtmp_do_simple_handshake(srs_rtmp_t rtmp);
@@ -529,6 +531,84 @@ extern srs_bool srs_rtmp_is_onMetaData(char type, char* data, int size);
  *
  */
 extern int srs_rtmp_get_custom_metadata_sync_ts(char* data, int size, double& sync_ts);
+
+/*************************************************************
+**************************************************************
+* non-blocking play session
+**************************************************************
+*************************************************************/
+/**
+* a play session which never touches a socket, for callers that
+* multiplex many connections on one thread. the caller connects to
+* the server, feeds every byte received by srs_rtmp_nb_on_recv and
+* sends whatever srs_rtmp_nb_pending_send returns. the handshake and
+* the connect/createStream/play commands run as the bytes arrive.
+*/
+typedef void* srs_rtmp_nb_t;
+extern srs_rtmp_nb_t srs_rtmp_nb_create(const char* url);
+extern void srs_rtmp_nb_destroy(srs_rtmp_nb_t nb);
+/**
+* the server to connect to, parsed from the url.
+* @return 0, success; otherswise, failed.
+*/
+extern int srs_rtmp_nb_get_server(srs_rtmp_nb_t nb, char host[128], int* port);
+/**
+* queue the handshake, call when the tcp connection is up.
+*/
+extern int srs_rtmp_nb_start(srs_rtmp_nb_t nb);
+/**
+* feed bytes received from the server.
+* @return 0, success; otherswise, failed and the session is unusable.
+*/
+extern int srs_rtmp_nb_on_recv(srs_rtmp_nb_t nb, const char* data, int size);
+/**
+* bytes waiting to be sent, call srs_rtmp_nb_consume_send with the
+* count actually sent. the data is valid until the next call on nb.
+*/
+extern int srs_rtmp_nb_pending_send(srs_rtmp_nb_t nb, const char** data, int* size);
+extern void srs_rtmp_nb_consume_send(srs_rtmp_nb_t nb, int size);
+/**
+* whether the play command is sent.
+*/
+extern srs_bool srs_rtmp_nb_is_playing(srs_rtmp_nb_t nb);
+/**
+* same as srs_rtmp_read_packet, but never waits: when no whole packet
+* is buffered, return 0 with data set to NULL.
+* @remark, call it until no packet is returned after every srs_rtmp_nb_on_recv,
+*       the commands of the session are processed here as well.
+*/
+extern int srs_rtmp_nb_read_packet(srs_rtmp_nb_t nb, 
+    char* type, u_int32_t* timestamp, char** data, int* size
+);
+
+/*************************************************************
+**************************************************************
+* play server session
+**************************************************************
+*************************************************************/
+/**
+* the server side of one play connection over a blocking socket, for
+* test servers. accepts the handshake and the connect/createStream/play
+* commands of a client, then writes the stream to it.
+* @param fd, a connected socket, closed by srs_rtmp_server_destroy.
+*/
+typedef void* srs_rtmp_server_t;
+extern srs_rtmp_server_t srs_rtmp_server_create(int fd);
+extern void srs_rtmp_server_destroy(srs_rtmp_server_t server);
+/**
+* run the session until the client asks to play.
+* @param app, output the app of the tcUrl, e.g. live.
+* @param stream, output the stream to play, e.g. livestream.
+* @return 0, success; otherswise, failed, also for a publish client.
+*/
+extern int srs_rtmp_server_accept_play(srs_rtmp_server_t server, char app[128], char stream[128]);
+/**
+* same as srs_rtmp_write_packet, but data is copied and stays with the
+* caller, so one packet can go to many clients.
+*/
+extern int srs_rtmp_server_write_packet(srs_rtmp_server_t server, 
+    char type, u_int32_t timestamp, const char* data, int size
+);
 /*************************************************************
 **************************************************************
 * audio raw codec
@@ -1237,11 +1317,25 @@ typedef void* srs_hijack_io_t;
     */
     extern int srs_hijack_io_create_socket(srs_hijack_io_t ctx);
     /**
+    * take over a socket connected already, e.g. accepted by a server.
+    * @return 0, success; otherswise, failed.
+    */
+    extern int srs_hijack_io_attach_socket(srs_hijack_io_t ctx, int fd);
+    /**
     * connect socket at server_ip:port.
     * @return 0, success; otherswise, failed.
     */
     extern int srs_hijack_io_connect(srs_hijack_io_t ctx, const char* server_ip, int port);
     /**
+    * connect socket to the first of server_ips:port that answers, a new
+    * address is tried every while until one connects, see RFC 8305.
+    * @param cancelled, give up once it is set by another thread.
+    * @param index, output the index of the address connected.
+    * @return 0, success; otherswise, failed.
+    */
+    extern int srs_hijack_io_connect_any(srs_hijack_io_t ctx, const char** server_ips, int nb_ips,
+        int port, int64_t timeout_us, const std::atomic<bool>* cancelled, int* index);
+    /**
     * read from socket.
     * @return 0, success; otherswise, failed.
     */
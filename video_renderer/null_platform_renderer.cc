@@ -0,0 +1,21 @@
+/*
+ *  Copyright (c) 2013 The devzhaoyou@dii_media project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+#include "video_renderer.h"
+
+// Headless builds (the linux host build), frames go to the NullRenderer.
+
+namespace dii_media_kit {
+
+VideoRenderer* VideoRenderer::CreatePlatformRenderer(const void* hwnd,
+                                                     size_t width,
+                                                     size_t height) {
+  return NULL;
+}
+}  // namespace dii_media_kit
@@ -29,13 +29,13 @@ void AudioFrameOperations::Add(const AudioFrame& frame_to_add,
                                AudioFrame* result_frame) {
   // Sanity check.
   RTC_DCHECK(result_frame);
-  RTC_DCHECK_GT(result_frame->num_channels_, 0);
+  RTC_DCHECK_GT(result_frame->num_channels_, 0u);
   RTC_DCHECK_EQ(result_frame->num_channels_, frame_to_add.num_channels_);
 
   bool no_previous_data = false;
   if (result_frame->samples_per_channel_ != frame_to_add.samples_per_channel_) {
     // Special case we have no data to start with.
-    RTC_DCHECK_EQ(result_frame->samples_per_channel_, 0);
+    RTC_DCHECK_EQ(result_frame->samples_per_channel_, 0u);
     result_frame->samples_per_channel_ = frame_to_add.samples_per_channel_;
     no_previous_data = true;
   }
@@ -269,7 +269,7 @@ void AudioFrameOperations::Mute(AudioFrame* frame) {
 
 void AudioFrameOperations::ApplyHalfGain(AudioFrame* frame) {
   RTC_DCHECK(frame);
-  RTC_DCHECK_GT(frame->num_channels_, 0);
+  RTC_DCHECK_GT(frame->num_channels_, 0u);
   if (frame->num_channels_ < 1) {
     return;
   }
@@ -128,7 +128,7 @@ LogMessage::LogMessage(const char* file,
                        int code,
                        int err,
                        const char* module)
-    : severity_(sev), code_(code), tag_(kLibjingle) {
+    : severity_(sev), tag_(kLibjingle), code_(code) {
 
     char trace_message[128] = {0};
 #ifndef WEBRTC_WIN
@@ -30,6 +30,10 @@
 #include <signal.h>
 #endif
 
+#if defined(WEBRTC_LINUX)
+#include <linux/sockios.h>  // for SIOCGSTAMP
+#endif
+
 #if defined(WEBRTC_WIN)
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
@@ -643,6 +643,7 @@ enum VideoCodecType {
   kVideoCodecRED,
   kVideoCodecULPFEC,
   kVideoCodecGeneric,
+  kVideoCodecH265,
   kVideoCodecUnknown
 };
 
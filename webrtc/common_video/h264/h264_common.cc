@@ -10,41 +10,118 @@
 
 #include "webrtc/common_video/h264/h264_common.h"
 
+#include "webrtc/base/bitbuffer.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define H264_START_SEQUENCE_SSE2
+#elif defined(WEBRTC_HAS_NEON) || defined(__ARM_NEON__) || \
+    defined(__ARM_NEON)
+#include <arm_neon.h>
+#define H264_START_SEQUENCE_NEON
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 namespace dii_media_kit {
 namespace H264 {
 
 const uint8_t kNaluTypeMask = 0x1F;
+const uint8_t kNalRefIdcMask = 0x60;
 
-std::vector<NaluIndex> FindNaluIndices(const uint8_t* buffer,
-                                       size_t buffer_size) {
+namespace {
+
+#if defined(H264_START_SEQUENCE_SSE2)
+int CountTrailingZeros(uint32_t mask) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return static_cast<int>(index);
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+#endif
+
+}  // namespace
+
+size_t FindStartSequence(const uint8_t* buffer,
+                         size_t buffer_size,
+                         size_t offset) {
+  size_t i = offset;
+  // Compares 16 positions at once: byte i and i + 1 zero, byte i + 2 one.
+  // The three loads overlap, so a block needs 18 readable bytes.
+#if defined(H264_START_SEQUENCE_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i one = _mm_set1_epi8(1);
+  while (i + 18 <= buffer_size) {
+    const __m128i* p = reinterpret_cast<const __m128i*>(buffer + i);
+    __m128i b0 = _mm_loadu_si128(p);
+    __m128i b1 = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(buffer + i + 1));
+    __m128i b2 = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(buffer + i + 2));
+    __m128i hit = _mm_and_si128(
+        _mm_and_si128(_mm_cmpeq_epi8(b0, zero), _mm_cmpeq_epi8(b1, zero)),
+        _mm_cmpeq_epi8(b2, one));
+    uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(hit));
+    if (mask)
+      return i + CountTrailingZeros(mask);
+    i += 16;
+  }
+#elif defined(H264_START_SEQUENCE_NEON)
+  const uint8x16_t zero = vdupq_n_u8(0);
+  const uint8x16_t one = vdupq_n_u8(1);
+  while (i + 18 <= buffer_size) {
+    uint8x16_t hit = vandq_u8(
+        vandq_u8(vceqq_u8(vld1q_u8(buffer + i), zero),
+                 vceqq_u8(vld1q_u8(buffer + i + 1), zero)),
+        vceqq_u8(vld1q_u8(buffer + i + 2), one));
+    uint64x2_t lanes = vreinterpretq_u64_u8(hit);
+    // NEON has no movemask, the scalar loop below locates it in this block.
+    if (vgetq_lane_u64(lanes, 0) | vgetq_lane_u64(lanes, 1))
+      break;
+    i += 16;
+  }
+#endif
   // This is sorta like Boyer-Moore, but with only the first optimization step:
   // given a 3-byte sequence we're looking at, if the 3rd byte isn't 1 or 0,
   // skip ahead to the next 3-byte sequence. 0s and 1s are relatively rare, so
   // this will skip the majority of reads/checks.
-  RTC_CHECK_GE(buffer_size, kNaluShortStartSequenceSize);
-  std::vector<NaluIndex> sequences;
-  const size_t end = buffer_size - kNaluShortStartSequenceSize;
-  for (size_t i = 0; i < end;) {
+  while (i + kNaluShortStartSequenceSize <= buffer_size) {
     if (buffer[i + 2] > 1) {
       i += 3;
     } else if (buffer[i + 2] == 1 && buffer[i + 1] == 0 && buffer[i] == 0) {
-      // We found a start sequence, now check if it was a 3 of 4 byte one.
-      NaluIndex index = {i, i + 3, 0};
-      if (index.start_offset > 0 && buffer[index.start_offset - 1] == 0)
-        --index.start_offset;
-
-      // Update length of previous entry.
-      auto it = sequences.rbegin();
-      if (it != sequences.rend())
-        it->payload_size = index.start_offset - it->payload_start_offset;
-
-      sequences.push_back(index);
-
-      i += 3;
+      return i;
     } else {
       ++i;
     }
   }
+  return buffer_size;
+}
+
+std::vector<NaluIndex> FindNaluIndices(const uint8_t* buffer,
+                                       size_t buffer_size) {
+  RTC_CHECK_GE(buffer_size, kNaluShortStartSequenceSize);
+  std::vector<NaluIndex> sequences;
+  const size_t end = buffer_size - kNaluShortStartSequenceSize;
+  for (size_t i = FindStartSequence(buffer, buffer_size, 0); i < end;
+       i = FindStartSequence(buffer, buffer_size, i + 3)) {
+    // We found a start sequence, now check if it was a 3 of 4 byte one.
+    NaluIndex index = {i, i + 3, 0};
+    if (index.start_offset > 0 && buffer[index.start_offset - 1] == 0)
+      --index.start_offset;
+
+    // Update length of previous entry.
+    auto it = sequences.rbegin();
+    if (it != sequences.rend())
+      it->payload_size = index.start_offset - it->payload_start_offset;
+
+    sequences.push_back(index);
+  }
 
   // Update length of last entry, if any.
   auto it = sequences.rbegin();
@@ -58,6 +135,34 @@ NaluType ParseNaluType(uint8_t data) {
   return static_cast<NaluType>(data & kNaluTypeMask);
 }
 
+uint8_t ParseNalRefIdc(uint8_t data) {
+  return (data & kNalRefIdcMask) >> 5;
+}
+
+dii_rtc::Optional<SliceType> ParseSliceType(const uint8_t* data,
+                                            size_t length) {
+  // Two Exp-Golomb codes of a slice header fit in a few bytes. Unescape just
+  // those instead of the whole NALU.
+  const size_t kMaxHeaderBytes = 16;
+  uint8_t header[kMaxHeaderBytes];
+  size_t size = 0;
+  for (size_t i = 0; i < length && size < kMaxHeaderBytes; ++i) {
+    if (i >= 2 && data[i] == 3 && data[i - 1] == 0 && data[i - 2] == 0)
+      continue;
+    header[size++] = data[i];
+  }
+
+  dii_rtc::BitBuffer bits(header, size);
+  uint32_t first_mb_in_slice;
+  uint32_t slice_type;
+  if (!bits.ReadExponentialGolomb(&first_mb_in_slice) ||
+      !bits.ReadExponentialGolomb(&slice_type) || slice_type > 9) {
+    return dii_rtc::Optional<SliceType>();
+  }
+  // 5 to 9 are the same types, with all slices of the picture alike.
+  return dii_rtc::Optional<SliceType>(static_cast<SliceType>(slice_type % 5));
+}
+
 std::unique_ptr<dii_rtc::Buffer> ParseRbsp(const uint8_t* data, size_t length) {
   std::unique_ptr<dii_rtc::Buffer> rbsp_buffer(new dii_rtc::Buffer(0, length));
   const char* sps_bytes = reinterpret_cast<const char*>(data);
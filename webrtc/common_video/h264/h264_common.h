@@ -16,6 +16,7 @@
 
 #include "webrtc/base/common.h"
 #include "webrtc/base/buffer.h"
+#include "webrtc/base/optional.h"
 
 namespace dii_media_kit {
 
@@ -60,9 +61,24 @@ struct NaluIndex {
 std::vector<NaluIndex> FindNaluIndices(const uint8_t* buffer,
                                        size_t buffer_size);
 
+// Returns the offset of the first short start sequence {0 0 1} at or after
+// |offset|, or |buffer_size| if there is none. Scans 16 bytes at a time with
+// SSE2 or NEON where available.
+size_t FindStartSequence(const uint8_t* buffer,
+                         size_t buffer_size,
+                         size_t offset);
+
 // Get the NAL type from the header byte immediately following start sequence.
 NaluType ParseNaluType(uint8_t data);
 
+// Get nal_ref_idc from the NAL header byte, 0 for non-reference pictures.
+uint8_t ParseNalRefIdc(uint8_t data);
+
+// Parses the slice type of a coded slice NALU. |data| points past the NALU
+// type byte. Only first_mb_in_slice precedes it, so no parameter sets are
+// needed.
+dii_rtc::Optional<SliceType> ParseSliceType(const uint8_t* data, size_t length);
+
 // Methods for parsing and writing RBSP. See section 7.4.1 of the H264 spec.
 //
 // The following sequences are illegal, and need to be escaped when encoding:
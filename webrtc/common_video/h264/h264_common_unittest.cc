@@ -0,0 +1,111 @@
+/*
+ *  Copyright (c) 2016 The devzhaoyou@dii_media project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "webrtc/common_video/h264/h264_common.h"
+
+#include <vector>
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace dii_media_kit {
+
+namespace {
+
+size_t FindStartSequenceBytewise(const uint8_t* buffer,
+                                 size_t buffer_size,
+                                 size_t offset) {
+  for (size_t i = offset; i + 3 <= buffer_size; ++i) {
+    if (buffer[i] == 0 && buffer[i + 1] == 0 && buffer[i + 2] == 1)
+      return i;
+  }
+  return buffer_size;
+}
+
+}  // namespace
+
+TEST(H264CommonTest, FindsNaluIndices) {
+  const uint8_t kBuffer[] = {0, 0, 0, 1, 0x67, 0xAA, 0xBB,  // SPS
+                             0, 0, 0, 1, 0x68, 0xCC,        // PPS
+                             0, 0, 1, 0x65, 0x11, 0x22, 0x33};
+  std::vector<H264::NaluIndex> indices =
+      H264::FindNaluIndices(kBuffer, sizeof(kBuffer));
+  ASSERT_EQ(3u, indices.size());
+  EXPECT_EQ(0u, indices[0].start_offset);
+  EXPECT_EQ(4u, indices[0].payload_start_offset);
+  EXPECT_EQ(3u, indices[0].payload_size);
+  EXPECT_EQ(7u, indices[1].start_offset);
+  EXPECT_EQ(11u, indices[1].payload_start_offset);
+  EXPECT_EQ(2u, indices[1].payload_size);
+  EXPECT_EQ(13u, indices[2].start_offset);
+  EXPECT_EQ(16u, indices[2].payload_start_offset);
+  EXPECT_EQ(4u, indices[2].payload_size);
+}
+
+TEST(H264CommonTest, FindStartSequenceMatchesBytewiseSearch) {
+  // Start sequences at every position relative to a 16 byte block, and
+  // near misses like {0 0 2} and {0 1 1}.
+  std::vector<uint8_t> buffer(200, 0xFF);
+  uint32_t seed = 1;
+  for (uint8_t& byte : buffer) {
+    seed = seed * 1103515245 + 12345;
+    uint32_t r = (seed >> 16) % 8;
+    byte = r < 3 ? 0 : (r < 5 ? 1 : (r < 6 ? 2 : 0xA5));
+  }
+  for (size_t size = 0; size <= buffer.size(); ++size) {
+    for (size_t offset = 0; offset <= size; ++offset) {
+      EXPECT_EQ(FindStartSequenceBytewise(buffer.data(), size, offset),
+                H264::FindStartSequence(buffer.data(), size, offset));
+    }
+  }
+}
+
+TEST(H264CommonTest, FindStartSequenceAtBlockEdges) {
+  for (size_t pos = 0; pos < 48; ++pos) {
+    std::vector<uint8_t> buffer(64, 0xFF);
+    buffer[pos] = 0;
+    buffer[pos + 1] = 0;
+    buffer[pos + 2] = 1;
+    EXPECT_EQ(pos, H264::FindStartSequence(buffer.data(), buffer.size(), 0));
+    EXPECT_EQ(buffer.size(),
+              H264::FindStartSequence(buffer.data(), buffer.size(), pos + 1));
+  }
+}
+
+TEST(H264CommonTest, ParsesNalRefIdc) {
+  EXPECT_EQ(3, H264::ParseNalRefIdc(0x65));
+  EXPECT_EQ(2, H264::ParseNalRefIdc(0x41));
+  EXPECT_EQ(0, H264::ParseNalRefIdc(0x01));
+}
+
+TEST(H264CommonTest, ParsesSliceType) {
+  // first_mb_in_slice 0, slice_type 7: 1 0001000
+  const uint8_t kISlice[] = {0x88, 0x84};
+  dii_rtc::Optional<H264::SliceType> type =
+      H264::ParseSliceType(kISlice, sizeof(kISlice));
+  ASSERT_TRUE(type);
+  EXPECT_EQ(H264::kI, *type);
+
+  // first_mb_in_slice 0, slice_type 1: 1 010
+  const uint8_t kBSlice[] = {0xA0};
+  type = H264::ParseSliceType(kBSlice, sizeof(kBSlice));
+  ASSERT_TRUE(type);
+  EXPECT_EQ(H264::kB, *type);
+
+  // first_mb_in_slice 2^22 - 1 is 22 zeros, 1, 22 bits, then slice_type 0:
+  // 1. The rbsp 00 00 02 needs an emulation byte.
+  const uint8_t kEscaped[] = {0x00, 0x00, 0x03, 0x02, 0x00, 0x00, 0x04};
+  type = H264::ParseSliceType(kEscaped, sizeof(kEscaped));
+  ASSERT_TRUE(type);
+  EXPECT_EQ(H264::kP, *type);
+
+  EXPECT_FALSE(H264::ParseSliceType(nullptr, 0));
+}
+
+}  // namespace dii_media_kit
@@ -10,45 +10,269 @@
 
 #include "webrtc/common_video/include/i420_buffer_pool.h"
 
+#include <atomic>
+#include <limits>
+#include <mutex>
+#include <vector>
+
 #include "webrtc/base/checks.h"
+#include "webrtc/base/timeutils.h"
 
 namespace dii_media_kit {
 
+namespace {
+
+// Resolutions kept at the same time, the least recently used one is dropped
+// for a new one.
+const int kMaxBuckets = 4;
+// Idle buffers older than this are freed.
+const int64_t kIdleTimeoutMs = 10000;
+const int64_t kTrimIntervalMs = 1000;
+
+std::atomic<int64_t> g_default_max_pooled_bytes(0);
+std::atomic<int64_t> g_hits(0);
+std::atomic<int64_t> g_misses(0);
+std::atomic<int64_t> g_allocated_bytes(0);
+std::atomic<int64_t> g_pooled_bytes(0);
+
+uint64_t BucketKey(int width, int height) {
+  return (static_cast<uint64_t>(width) << 32) | static_cast<uint32_t>(height);
+}
+
+}  // namespace
+
+// Returns itself to its bucket instead of being deleted on the last Release.
+class I420BufferPool::PooledI420Buffer : public I420Buffer {
+ public:
+  PooledI420Buffer(const std::shared_ptr<Core>& core,
+                   int width,
+                   int height,
+                   uint32_t generation)
+      : I420Buffer(width, height),
+        core_(core),
+        bytes_(StrideY() * height + (StrideU() + StrideV()) * ((height + 1) / 2)),
+        generation_(generation) {}
+
+  int AddRef() const override { return ++ref_count_; }
+  int Release() const override;
+
+  int64_t bytes() const { return bytes_; }
+  uint32_t generation() const { return generation_; }
+  int64_t idle_since_ms = 0;
+
+  void Destroy() { delete this; }
+
+ private:
+  ~PooledI420Buffer() override {}
+
+  const std::shared_ptr<Core> core_;
+  const int64_t bytes_;
+  const uint32_t generation_;
+  mutable std::atomic<int> ref_count_{0};
+};
+
+struct I420BufferPool::Core {
+  struct Bucket {
+    // BucketKey of the resolution, 0 while unused. Changed under |mutex|.
+    std::atomic<uint64_t> key{0};
+    std::atomic<int64_t> last_used_ms{0};
+    std::mutex mutex;
+    // Most recently returned last, handed out first.
+    std::vector<PooledI420Buffer*> idle;
+  };
+
+  explicit Core(bool zero_initialize)
+      : zero_initialize(zero_initialize),
+        max_pooled_bytes(g_default_max_pooled_bytes.load()) {}
+
+  Bucket* FindBucket(uint64_t key, int64_t now_ms);
+  // Frees the idle buffers of |bucket| returned before |before_ms|, all of
+  // them by default. Called with |bucket->mutex| held.
+  void FreeIdle(Bucket* bucket,
+                int64_t before_ms = std::numeric_limits<int64_t>::max());
+  void Recycle(PooledI420Buffer* buffer);
+  void Trim(int64_t now_ms);
+
+  const bool zero_initialize;
+  Bucket buckets[kMaxBuckets];
+  std::atomic<int64_t> max_pooled_bytes;
+  // Bumped by Release, buffers of an older generation are not kept.
+  std::atomic<uint32_t> generation{0};
+  std::atomic<bool> closed{false};
+  std::atomic<int64_t> last_trim_ms{0};
+
+  std::atomic<int64_t> hits{0};
+  std::atomic<int64_t> misses{0};
+  std::atomic<int64_t> allocated_bytes{0};
+  std::atomic<int64_t> pooled_bytes{0};
+};
+
+int I420BufferPool::PooledI420Buffer::Release() const {
+  int count = --ref_count_;
+  if (count == 0) {
+    core_->Recycle(const_cast<PooledI420Buffer*>(this));
+  }
+  return count;
+}
+
+I420BufferPool::Core::Bucket* I420BufferPool::Core::FindBucket(
+    uint64_t key,
+    int64_t now_ms) {
+  for (Bucket& bucket : buckets) {
+    if (bucket.key.load(std::memory_order_acquire) == key) {
+      bucket.last_used_ms = now_ms;
+      return &bucket;
+    }
+  }
+  // A new resolution takes an unused bucket, or the least recently used one.
+  Bucket* lru = &buckets[0];
+  for (Bucket& bucket : buckets) {
+    uint64_t unused = 0;
+    if (bucket.key.load() == 0 && bucket.key.compare_exchange_strong(unused, key)) {
+      bucket.last_used_ms = now_ms;
+      return &bucket;
+    }
+    if (bucket.last_used_ms < lru->last_used_ms)
+      lru = &bucket;
+  }
+  std::lock_guard<std::mutex> lock(lru->mutex);
+  FreeIdle(lru);
+  lru->key.store(key, std::memory_order_release);
+  lru->last_used_ms = now_ms;
+  return lru;
+}
+
+void I420BufferPool::Core::FreeIdle(Bucket* bucket, int64_t before_ms) {
+  size_t kept = 0;
+  for (PooledI420Buffer* buffer : bucket->idle) {
+    if (buffer->idle_since_ms < before_ms) {
+      pooled_bytes -= buffer->bytes();
+      g_pooled_bytes -= buffer->bytes();
+      allocated_bytes -= buffer->bytes();
+      g_allocated_bytes -= buffer->bytes();
+      buffer->Destroy();
+    } else {
+      bucket->idle[kept++] = buffer;
+    }
+  }
+  bucket->idle.resize(kept);
+}
+
+void I420BufferPool::Core::Recycle(PooledI420Buffer* buffer) {
+  uint64_t key = BucketKey(buffer->width(), buffer->height());
+  int64_t max_bytes = max_pooled_bytes;
+  if (!closed && buffer->generation() == generation &&
+      (max_bytes <= 0 || pooled_bytes + buffer->bytes() <= max_bytes)) {
+    for (Bucket& bucket : buckets) {
+      if (bucket.key.load(std::memory_order_acquire) != key)
+        continue;
+      std::lock_guard<std::mutex> lock(bucket.mutex);
+      // The bucket may have been handed to another resolution meanwhile.
+      if (bucket.key.load(std::memory_order_relaxed) != key)
+        break;
+      buffer->idle_since_ms = dii_rtc::TimeMillis();
+      bucket.idle.push_back(buffer);
+      pooled_bytes += buffer->bytes();
+      g_pooled_bytes += buffer->bytes();
+      return;
+    }
+  }
+  allocated_bytes -= buffer->bytes();
+  g_allocated_bytes -= buffer->bytes();
+  buffer->Destroy();
+}
+
+void I420BufferPool::Core::Trim(int64_t now_ms) {
+  int64_t last = last_trim_ms;
+  if (now_ms - last < kTrimIntervalMs ||
+      !last_trim_ms.compare_exchange_strong(last, now_ms)) {
+    return;
+  }
+  for (Bucket& bucket : buckets) {
+    if (bucket.key.load() == 0)
+      continue;
+    std::lock_guard<std::mutex> lock(bucket.mutex);
+    FreeIdle(&bucket, now_ms - kIdleTimeoutMs);
+  }
+}
+
 I420BufferPool::I420BufferPool(bool zero_initialize)
-    : zero_initialize_(zero_initialize) {
-  thread_checker_.DetachFromThread();
+    : core_(std::make_shared<Core>(zero_initialize)) {
+}
+
+I420BufferPool::~I420BufferPool() {
+  core_->closed = true;
+  Release();
 }
 
 void I420BufferPool::Release() {
-  thread_checker_.DetachFromThread();
-  buffers_.clear();
+  ++core_->generation;
+  for (Core::Bucket& bucket : core_->buckets) {
+    std::lock_guard<std::mutex> lock(bucket.mutex);
+    core_->FreeIdle(&bucket);
+  }
+}
+
+void I420BufferPool::SetMaxPooledBytes(int64_t max_bytes) {
+  core_->max_pooled_bytes = max_bytes;
+}
+
+I420BufferPool::Stats I420BufferPool::GetStats() const {
+  Stats stats;
+  stats.hits = core_->hits;
+  stats.misses = core_->misses;
+  stats.allocated_bytes = core_->allocated_bytes;
+  stats.pooled_bytes = core_->pooled_bytes;
+  return stats;
+}
+
+void I420BufferPool::SetDefaultMaxPooledBytes(int64_t max_bytes) {
+  g_default_max_pooled_bytes = max_bytes;
+}
+
+I420BufferPool::Stats I420BufferPool::GetGlobalStats() {
+  Stats stats;
+  stats.hits = g_hits;
+  stats.misses = g_misses;
+  stats.allocated_bytes = g_allocated_bytes;
+  stats.pooled_bytes = g_pooled_bytes;
+  return stats;
 }
 
 dii_rtc::scoped_refptr<I420Buffer> I420BufferPool::CreateBuffer(int width,
                                                             int height) {
-  RTC_DCHECK(thread_checker_.CalledOnValidThread());
-  // Release buffers with wrong resolution.
-  for (auto it = buffers_.begin(); it != buffers_.end();) {
-    if ((*it)->width() != width || (*it)->height() != height)
-      it = buffers_.erase(it);
-    else
-      ++it;
-  }
-  // Look for a free buffer.
-  for (const dii_rtc::scoped_refptr<PooledI420Buffer>& buffer : buffers_) {
-    // If the buffer is in use, the ref count will be >= 2, one from the list we
-    // are looping over and one from the application. If the ref count is 1,
-    // then the list we are looping over holds the only reference and it's safe
-    // to reuse.
-    if (buffer->HasOneRef())
-      return buffer;
+  RTC_DCHECK_GT(width, 0);
+  RTC_DCHECK_GT(height, 0);
+  int64_t now_ms = dii_rtc::TimeMillis();
+  core_->Trim(now_ms);
+
+  Core::Bucket* bucket = core_->FindBucket(BucketKey(width, height), now_ms);
+  PooledI420Buffer* buffer = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(bucket->mutex);
+    if (bucket->key.load(std::memory_order_relaxed) ==
+            BucketKey(width, height) &&
+        !bucket->idle.empty()) {
+      buffer = bucket->idle.back();
+      bucket->idle.pop_back();
+    }
+  }
+  if (buffer) {
+    core_->pooled_bytes -= buffer->bytes();
+    g_pooled_bytes -= buffer->bytes();
+    ++core_->hits;
+    ++g_hits;
+    return buffer;
   }
+
   // Allocate new buffer.
-  dii_rtc::scoped_refptr<PooledI420Buffer> buffer =
-      new PooledI420Buffer(width, height);
-  if (zero_initialize_)
+  buffer = new PooledI420Buffer(core_, width, height, core_->generation);
+  if (core_->zero_initialize)
     buffer->InitializeData();
-  buffers_.push_back(buffer);
+  core_->allocated_bytes += buffer->bytes();
+  g_allocated_bytes += buffer->bytes();
+  ++core_->misses;
+  ++g_misses;
   return buffer;
 }
 
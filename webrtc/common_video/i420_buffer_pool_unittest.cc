@@ -11,6 +11,7 @@
 #include <string>
 
 #include "testing/gtest/include/gtest/gtest.h"
+#include "webrtc/base/fakeclock.h"
 #include "webrtc/common_video/include/i420_buffer_pool.h"
 
 namespace dii_media_kit {
@@ -63,4 +64,176 @@ TEST(TestI420BufferPool, FrameValidAfterPoolDestruction) {
   memset(buffer->MutableDataY(), 0xA5, 16 * buffer->StrideY());
 }
 
+TEST(TestI420BufferPool, Stats) {
+  I420BufferPool pool;
+  I420BufferPool::Stats global = I420BufferPool::GetGlobalStats();
+  dii_rtc::scoped_refptr<I420Buffer> buffer = pool.CreateBuffer(16, 16);
+  I420BufferPool::Stats stats = pool.GetStats();
+  const int64_t bytes = stats.allocated_bytes;
+  EXPECT_GE(bytes, 16 * 16 * 3 / 2);
+  EXPECT_EQ(0, stats.hits);
+  EXPECT_EQ(1, stats.misses);
+  EXPECT_EQ(0, stats.pooled_bytes);
+
+  buffer = nullptr;
+  stats = pool.GetStats();
+  EXPECT_EQ(bytes, stats.allocated_bytes);
+  EXPECT_EQ(bytes, stats.pooled_bytes);
+
+  buffer = pool.CreateBuffer(16, 16);
+  stats = pool.GetStats();
+  EXPECT_EQ(1, stats.hits);
+  EXPECT_EQ(1, stats.misses);
+  EXPECT_EQ(0, stats.pooled_bytes);
+
+  // The process wide counters moved by as much.
+  I420BufferPool::Stats now = I420BufferPool::GetGlobalStats();
+  EXPECT_EQ(1, now.hits - global.hits);
+  EXPECT_EQ(1, now.misses - global.misses);
+  EXPECT_EQ(bytes, now.allocated_bytes - global.allocated_bytes);
+  EXPECT_EQ(0, now.pooled_bytes - global.pooled_bytes);
+
+  buffer = nullptr;
+  pool.Release();
+  stats = pool.GetStats();
+  EXPECT_EQ(0, stats.allocated_bytes);
+  EXPECT_EQ(0, stats.pooled_bytes);
+}
+
+TEST(TestI420BufferPool, BudgetFreesBuffersAboveIt) {
+  int64_t bytes = 0;
+  {
+    I420BufferPool pool;
+    pool.CreateBuffer(16, 16);
+    bytes = pool.GetStats().allocated_bytes;
+  }
+  I420BufferPool::SetDefaultMaxPooledBytes(bytes);
+  I420BufferPool pool;
+  I420BufferPool::SetDefaultMaxPooledBytes(0);
+  dii_rtc::scoped_refptr<I420Buffer> first = pool.CreateBuffer(16, 16);
+  dii_rtc::scoped_refptr<I420Buffer> second = pool.CreateBuffer(16, 16);
+  const uint8_t* first_y = first->DataY();
+  EXPECT_EQ(2 * bytes, pool.GetStats().allocated_bytes);
+
+  // Only one of them fits.
+  first = nullptr;
+  second = nullptr;
+  I420BufferPool::Stats stats = pool.GetStats();
+  EXPECT_EQ(bytes, stats.pooled_bytes);
+  EXPECT_EQ(bytes, stats.allocated_bytes);
+
+  first = pool.CreateBuffer(16, 16);
+  second = pool.CreateBuffer(16, 16);
+  EXPECT_EQ(first_y, first->DataY());
+  stats = pool.GetStats();
+  EXPECT_EQ(1, stats.hits);
+  EXPECT_EQ(3, stats.misses);
+
+  // A lower budget applies to the next returns.
+  pool.SetMaxPooledBytes(bytes - 1);
+  first = nullptr;
+  second = nullptr;
+  EXPECT_EQ(0, pool.GetStats().pooled_bytes);
+  EXPECT_EQ(0, pool.GetStats().allocated_bytes);
+}
+
+TEST(TestI420BufferPool, BufferInUseAcrossReleaseIsNotPooled) {
+  I420BufferPool pool;
+  dii_rtc::scoped_refptr<I420Buffer> kept = pool.CreateBuffer(16, 16);
+  dii_rtc::scoped_refptr<I420Buffer> idle = pool.CreateBuffer(16, 16);
+  idle = nullptr;
+  EXPECT_GT(pool.GetStats().pooled_bytes, 0);
+
+  pool.Release();
+  I420BufferPool::Stats stats = pool.GetStats();
+  EXPECT_EQ(0, stats.pooled_bytes);
+  EXPECT_GT(stats.allocated_bytes, 0);
+
+  // Freed on its last release instead of going back.
+  kept = nullptr;
+  stats = pool.GetStats();
+  EXPECT_EQ(0, stats.pooled_bytes);
+  EXPECT_EQ(0, stats.allocated_bytes);
+
+  // Buffers created after Release are pooled again.
+  kept = pool.CreateBuffer(16, 16);
+  EXPECT_EQ(3, pool.GetStats().misses);
+  kept = nullptr;
+  EXPECT_GT(pool.GetStats().pooled_bytes, 0);
+}
+
+TEST(TestI420BufferPool, LeastRecentlyUsedResolutionIsDropped) {
+  dii_rtc::ScopedFakeClock clock;
+  I420BufferPool pool;
+  const int widths[] = {16, 32, 48, 64, 80};
+  int64_t bytes[5] = {0};
+  // One buffer for each of the first four, a millisecond apart.
+  for (int i = 0; i < 4; i++) {
+    clock.AdvanceTime(dii_rtc::TimeDelta::FromMilliseconds(1));
+    int64_t allocated = pool.GetStats().allocated_bytes;
+    pool.CreateBuffer(widths[i], 16);
+    bytes[i] = pool.GetStats().allocated_bytes - allocated;
+  }
+  EXPECT_EQ(bytes[0] + bytes[1] + bytes[2] + bytes[3],
+            pool.GetStats().pooled_bytes);
+
+  // Using the first again leaves the second as the least recently used.
+  clock.AdvanceTime(dii_rtc::TimeDelta::FromMilliseconds(1));
+  pool.CreateBuffer(widths[0], 16);
+  EXPECT_EQ(1, pool.GetStats().hits);
+
+  // The fifth resolution takes its place.
+  clock.AdvanceTime(dii_rtc::TimeDelta::FromMilliseconds(1));
+  pool.CreateBuffer(widths[4], 16);
+  I420BufferPool::Stats stats = pool.GetStats();
+  bytes[4] = stats.allocated_bytes - (bytes[0] + bytes[2] + bytes[3]);
+  EXPECT_GT(bytes[4], 0);
+  EXPECT_EQ(bytes[0] + bytes[2] + bytes[3] + bytes[4], stats.pooled_bytes);
+
+  for (int i : {0, 2, 3, 4}) {
+    clock.AdvanceTime(dii_rtc::TimeDelta::FromMilliseconds(1));
+    pool.CreateBuffer(widths[i], 16);
+  }
+  EXPECT_EQ(5, pool.GetStats().hits);
+  clock.AdvanceTime(dii_rtc::TimeDelta::FromMilliseconds(1));
+  pool.CreateBuffer(widths[1], 16);
+  stats = pool.GetStats();
+  EXPECT_EQ(5, stats.hits);
+  EXPECT_EQ(6, stats.misses);
+}
+
+TEST(TestI420BufferPool, IdleBuffersAreTrimmed) {
+  dii_rtc::ScopedFakeClock clock;
+  clock.AdvanceTime(dii_rtc::TimeDelta::FromSeconds(1));
+  I420BufferPool pool;
+  dii_rtc::scoped_refptr<I420Buffer> old_buffer = pool.CreateBuffer(16, 16);
+  dii_rtc::scoped_refptr<I420Buffer> new_buffer = pool.CreateBuffer(16, 16);
+  const int64_t bytes = pool.GetStats().allocated_bytes / 2;
+  const uint8_t* new_y = new_buffer->DataY();
+  old_buffer = nullptr;
+  clock.AdvanceTime(dii_rtc::TimeDelta::FromSeconds(6));
+  new_buffer = nullptr;
+  EXPECT_EQ(2 * bytes, pool.GetStats().pooled_bytes);
+
+  // 11 s after the first went idle, 5 s after the second. Trimming runs in
+  // CreateBuffer, another resolution keeps the 16x16 buffers out of it.
+  clock.AdvanceTime(dii_rtc::TimeDelta::FromSeconds(5));
+  dii_rtc::scoped_refptr<I420Buffer> other = pool.CreateBuffer(32, 32);
+  EXPECT_EQ(bytes, pool.GetStats().pooled_bytes);
+
+  new_buffer = pool.CreateBuffer(16, 16);
+  EXPECT_EQ(new_y, new_buffer->DataY());
+  EXPECT_EQ(1, pool.GetStats().hits);
+  new_buffer = nullptr;
+  other = nullptr;
+
+  // Both idle for more than 10 s, only the one just created is left.
+  clock.AdvanceTime(dii_rtc::TimeDelta::FromSeconds(11));
+  pool.CreateBuffer(16, 16);
+  I420BufferPool::Stats stats = pool.GetStats();
+  EXPECT_EQ(1, stats.hits);
+  EXPECT_EQ(bytes, stats.pooled_bytes);
+  EXPECT_EQ(bytes, stats.allocated_bytes);
+}
+
 }  // namespace dii_media_kit
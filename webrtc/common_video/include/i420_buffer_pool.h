@@ -11,43 +11,57 @@
 #ifndef WEBRTC_COMMON_VIDEO_INCLUDE_I420_BUFFER_POOL_H_
 #define WEBRTC_COMMON_VIDEO_INCLUDE_I420_BUFFER_POOL_H_
 
-#include <list>
+#include <stdint.h>
+
+#include <memory>
 
-#include "webrtc/base/thread_checker.h"
 #include "webrtc/common_video/include/video_frame_buffer.h"
 
 namespace dii_media_kit {
 
-// Simple buffer pool to avoid unnecessary allocations of I420Buffer objects.
-// The pool manages the memory of the I420Buffer returned from CreateBuffer.
-// When the I420Buffer is destructed, the memory is returned to the pool for use
-// by subsequent calls to CreateBuffer. If the resolution passed to CreateBuffer
-// changes, old buffers will be purged from the pool.
+// Buffer pool to avoid unnecessary allocations of I420Buffer objects.
+// A buffer returned from CreateBuffer goes back to the pool when its last
+// reference is released and is handed out again by a later call for the same
+// resolution. Buffers are kept per resolution, so switching back and forth
+// between renditions of an adaptive stream reuses them instead of
+// reallocating. Idle buffers are freed after a while and above the byte
+// budget.
+//
+// Thread safe. Each resolution has its own lock, taken only to push or pop a
+// buffer, so decoder and converter threads at different resolutions do not
+// contend.
 class I420BufferPool {
  public:
+  struct Stats {
+    int64_t hits = 0;             // CreateBuffer calls served from the pool.
+    int64_t misses = 0;           // CreateBuffer calls that allocated.
+    int64_t allocated_bytes = 0;  // Held by all buffers, in use or idle.
+    int64_t pooled_bytes = 0;     // Held by idle buffers.
+  };
+
   I420BufferPool() : I420BufferPool(false) {}
   explicit I420BufferPool(bool zero_initialize);
+  ~I420BufferPool();
 
   // Returns a buffer from the pool, or creates a new buffer if no suitable
   // buffer exists in the pool.
   dii_rtc::scoped_refptr<I420Buffer> CreateBuffer(int width, int height);
-  // Clears buffers_ and detaches the thread checker so that it can be reused
-  // later from another thread.
+  // Frees the idle buffers, buffers in use are freed when they are released.
   void Release();
+  // Idle buffers beyond |max_bytes| are freed instead of kept, 0 is no limit.
+  void SetMaxPooledBytes(int64_t max_bytes);
+  Stats GetStats() const;
+
+  // Budget of pools created afterwards, 0 (default) is no limit.
+  static void SetDefaultMaxPooledBytes(int64_t max_bytes);
+  // Summed over all pools of the process.
+  static Stats GetGlobalStats();
 
  private:
-  // Explicitly use a RefCountedObject to get access to HasOneRef,
-  // needed by the pool to check exclusive access.
-  using PooledI420Buffer = dii_rtc::RefCountedObject<I420Buffer>;
-
-  dii_rtc::ThreadChecker thread_checker_;
-  std::list<dii_rtc::scoped_refptr<PooledI420Buffer>> buffers_;
-  // If true, newly allocated buffers are zero-initialized. Note that recycled
-  // buffers are not zero'd before reuse. This is required of buffers used by
-  // FFmpeg according to http://crbug.com/390941, which only requires it for the
-  // initial allocation (as shown by FFmpeg's own buffer allocation code). It
-  // has to do with "Use-of-uninitialized-value" on "Linux_msan_chrome".
-  bool zero_initialize_;
+  class PooledI420Buffer;
+  struct Core;
+  // Shared with the buffers, which may outlive the pool.
+  std::shared_ptr<Core> core_;
 };
 
 }  // namespace dii_media_kit
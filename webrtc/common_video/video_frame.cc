@@ -180,6 +180,7 @@ size_t EncodedImage::GetBufferPaddingBytes(VideoCodecType codec_type) {
     case kVideoCodecVP9:
       return 0;
     case kVideoCodecH264:
+    case kVideoCodecH265:
       return kBufferPaddingBytesH264;
     case kVideoCodecI420:
     case kVideoCodecRED:
@@ -8,6 +8,8 @@
  *  be found in the AUTHORS file in the root of the source tree.
  */
 
+#include <string.h>
+
 #include <algorithm>
 
 #include "webrtc/common_video/include/video_frame_buffer.h"
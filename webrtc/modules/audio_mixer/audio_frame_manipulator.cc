@@ -34,7 +34,7 @@ void Ramp(float start_gain, float target_gain, AudioFrame* audio_frame) {
   }
 
   size_t samples = audio_frame->samples_per_channel_;
-  RTC_DCHECK_LT(0, samples);
+  RTC_DCHECK_LT(0u, samples);
   float increment = (target_gain - start_gain) / samples;
   float gain = start_gain;
   for (size_t i = 0; i < samples; ++i) {
@@ -48,8 +48,8 @@ void Ramp(float start_gain, float target_gain, AudioFrame* audio_frame) {
 }
 
 void RemixFrame(size_t target_number_of_channels, AudioFrame* frame) {
-  RTC_DCHECK_GE(target_number_of_channels, 1);
-  RTC_DCHECK_LE(target_number_of_channels, 2);
+  RTC_DCHECK_GE(target_number_of_channels, 1u);
+  RTC_DCHECK_LE(target_number_of_channels, 2u);
   if (frame->num_channels_ == 1 && target_number_of_channels == 2) {
     AudioFrameOperations::MonoToStereo(frame);
   } else if (frame->num_channels_ == 2 && target_number_of_channels == 1) {
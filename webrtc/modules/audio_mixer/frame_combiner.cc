@@ -91,7 +91,7 @@ void CombineMultipleFrames(
   // more efficient than addition in place in the int16 audio
   // frame. The audio quality loss due to halving the samples is
   // smaller than 16-bit addition in place.
-  RTC_DCHECK_GE(kMaximalFrameSize, frame_length);
+  RTC_DCHECK_GE(static_cast<size_t>(kMaximalFrameSize), frame_length);
   std::array<int32_t, kMaximalFrameSize> add_buffer;
 
   add_buffer.fill(0);
@@ -104,4 +104,22 @@ bool H264Decoder::IsSupported() {
   return IsH264CodecSupported();
 }
 
+H264Decoder* H264Decoder::CreateH265() {
+#if defined(WEBRTC_USE_H264)
+  if (g_rtc_use_h264) {
+    LOG(LS_INFO) << "Creating H264DecoderImpl for H.265.";
+    return new H264DecoderImpl();
+  }
+#endif
+  return nullptr;
+}
+
+bool H264Decoder::IsH265Supported() {
+#if defined(WEBRTC_USE_H264)
+  return g_rtc_use_h264;
+#else
+  return false;
+#endif
+}
+
 }  // namespace dii_media_kit
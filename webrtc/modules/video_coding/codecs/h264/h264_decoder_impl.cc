@@ -181,6 +181,8 @@ void H264DecoderImpl::AVFreeBuffer2(void* opaque, uint8_t* data) {
 
 H264DecoderImpl::H264DecoderImpl() : pool_(true),
                                      decoded_image_callback_(nullptr),
+                                     codec_type_(kVideoCodecH264),
+                                     frame_threading_(false),
                                      has_reported_init_(false),
                                      has_reported_error_(false) {
 }
@@ -193,10 +195,12 @@ int32_t H264DecoderImpl::InitDecode(const VideoCodec* codec_settings,
                                     int32_t number_of_cores) {
   ReportInit();
   if (codec_settings &&
-      codec_settings->codecType != kVideoCodecH264) {
+      codec_settings->codecType != kVideoCodecH264 &&
+      codec_settings->codecType != kVideoCodecH265) {
     ReportError();
     return WEBRTC_VIDEO_CODEC_ERR_PARAMETER;
   }
+  codec_type_ = codec_settings ? codec_settings->codecType : kVideoCodecH264;
 
   // FFmpeg must have been initialized (with |av_lockmgr_register| and
   // |av_register_all|) before we proceed. |InitializeFFmpeg| does this, which
@@ -222,7 +226,8 @@ int32_t H264DecoderImpl::InitDecode(const VideoCodec* codec_settings,
   av_context_.reset(avcodec_alloc_context3(nullptr));
 
   av_context_->codec_type = AVMEDIA_TYPE_VIDEO;
-  av_context_->codec_id = AV_CODEC_ID_H264;
+  av_context_->codec_id =
+      codec_type_ == kVideoCodecH265 ? AV_CODEC_ID_HEVC : AV_CODEC_ID_H264;
   if (codec_settings) {
     av_context_->coded_width = codec_settings->width;
     av_context_->coded_height = codec_settings->height;
@@ -231,10 +236,15 @@ int32_t H264DecoderImpl::InitDecode(const VideoCodec* codec_settings,
   av_context_->extradata = nullptr;
   av_context_->extradata_size = 0;
 
-  // If this is ever increased, look at |av_context_->thread_safe_callbacks| and
-  // make it possible to disable the thread checker in the frame buffer pool.
-  av_context_->thread_count = 1;
-  av_context_->thread_type = FF_THREAD_SLICE;
+  // |number_of_cores| decoding threads. Slice threads only help streams with
+  // several slices per picture. Frame threads help any stream, but hold back
+  // |thread_count| - 1 frames, see |DecodeDelayFrames|.
+  av_context_->thread_count = std::max(number_of_cores, 1);
+  av_context_->thread_type =
+      frame_threading_ ? FF_THREAD_FRAME | FF_THREAD_SLICE : FF_THREAD_SLICE;
+  // |AVGetBuffer2| is then called from the frame threads, |pool_| is thread
+  // safe.
+  av_context_->thread_safe_callbacks = 1;
 
   // Function used by FFmpeg to get buffers to store decoded frames in.
   av_context_->get_buffer2 = AVGetBuffer2;
@@ -248,7 +258,9 @@ int32_t H264DecoderImpl::InitDecode(const VideoCodec* codec_settings,
   if (!codec) {
     // This is an indication that FFmpeg has not been initialized or it has not
     // been compiled/initialized with the correct set of codecs.
-    LOG(LS_ERROR) << "FFmpeg H.264 decoder not found.";
+    LOG(LS_ERROR) << "FFmpeg "
+                  << (codec_type_ == kVideoCodecH265 ? "H.265" : "H.264")
+                  << " decoder not found.";
     Release();
     ReportError();
     return WEBRTC_VIDEO_CODEC_ERROR;
@@ -262,6 +274,8 @@ int32_t H264DecoderImpl::InitDecode(const VideoCodec* codec_settings,
   }
 
   av_frame_.reset(av_frame_alloc());
+  LOG(LS_INFO) << "FFmpeg decoder threads: " << av_context_->thread_count
+               << (frame_threading_ ? ", frame and slice" : ", slice");
   return WEBRTC_VIDEO_CODEC_OK;
 }
 
@@ -297,7 +311,7 @@ int32_t H264DecoderImpl::Decode(const EncodedImage& input_image,
     return WEBRTC_VIDEO_CODEC_ERR_PARAMETER;
   }
   if (codec_specific_info &&
-      codec_specific_info->codecType != kVideoCodecH264) {
+      codec_specific_info->codecType != codec_type_) {
     ReportError();
     return WEBRTC_VIDEO_CODEC_ERR_PARAMETER;
   }
@@ -322,7 +336,10 @@ int32_t H264DecoderImpl::Decode(const EncodedImage& input_image,
     return WEBRTC_VIDEO_CODEC_ERROR;
   }
   packet.size = static_cast<int>(input_image._length);
-  av_context_->reordered_opaque = input_image.ntp_time_ms_ * 1000;  // ms -> μs
+  // Frames with B-slices come out in presentation order, later than they went
+  // in. The timestamp travels with the picture so the output is stamped with
+  // its own, not with the one of the packet that happened to release it.
+  av_context_->reordered_opaque = input_image._timeStamp;
 
   int frame_decoded = 0;
   int result = avcodec_decode_video2(av_context_.get(),
@@ -358,7 +375,8 @@ int32_t H264DecoderImpl::Decode(const EncodedImage& input_image,
                video_frame->video_frame_buffer()->DataU());
   RTC_CHECK_EQ(av_frame_->data[kVPlane],
                video_frame->video_frame_buffer()->DataV());
-  video_frame->set_timestamp(input_image._timeStamp);
+  video_frame->set_timestamp(
+      static_cast<uint32_t>(av_frame_->reordered_opaque));
 
   int32_t ret;
 
@@ -396,7 +414,21 @@ int32_t H264DecoderImpl::Decode(const EncodedImage& input_image,
 }
 
 const char* H264DecoderImpl::ImplementationName() const {
-  return "FFmpeg";
+  return codec_type_ == kVideoCodecH265 ? "FFmpeg HEVC" : "FFmpeg";
+}
+
+bool H264DecoderImpl::ReordersOutput() const {
+  return true;
+}
+
+void H264DecoderImpl::SetFrameThreading(bool enable) {
+  frame_threading_ = enable;
+}
+
+int H264DecoderImpl::DecodeDelayFrames() const {
+  if (!av_context_ || !(av_context_->active_thread_type & FF_THREAD_FRAME))
+    return 0;
+  return av_context_->thread_count - 1;
 }
 
 bool H264DecoderImpl::IsInitialized() const {
@@ -36,8 +36,10 @@ class H264DecoderImpl : public H264Decoder {
   H264DecoderImpl();
   ~H264DecoderImpl() override;
 
+  // Decodes with |number_of_cores| threads, see |SetFrameThreading|.
   // If |codec_settings| is NULL it is ignored. If it is not NULL,
-  // |codec_settings->codecType| must be |kVideoCodecH264|.
+  // |codec_settings->codecType| must be |kVideoCodecH264| or |kVideoCodecH265|,
+  // the latter decodes H.265 with libavcodec's HEVC decoder.
   int32_t InitDecode(const VideoCodec* codec_settings,
                      int32_t number_of_cores) override;
   int32_t Release() override;
@@ -53,6 +55,9 @@ class H264DecoderImpl : public H264Decoder {
                  int64_t render_time_ms = -1) override;
 
   const char* ImplementationName() const override;
+  bool ReordersOutput() const override;
+  void SetFrameThreading(bool enable) override;
+  int DecodeDelayFrames() const override;
 
  private:
   // Called by FFmpeg when it needs a frame buffer to store decoded frames in.
@@ -74,6 +79,8 @@ class H264DecoderImpl : public H264Decoder {
   std::unique_ptr<AVFrame, AVFrameDeleter> av_frame_;
 
   DecodedImageCallback* decoded_image_callback_;
+  VideoCodecType codec_type_;
+  bool frame_threading_;
 
   bool has_reported_init_;
   bool has_reported_error_;
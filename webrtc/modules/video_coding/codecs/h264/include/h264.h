@@ -15,8 +15,8 @@
 #if defined(WEBRTC_IOS) || defined(WEBRTC_MAC)
 
 #include <Availability.h>
-//#if (defined(__IPHONE_8_0) &&                            \
-//     __IPHONE_OS_VERSION_MAX_ALLOWED >= __IPHONE_8_0) || \
+//#if (defined(__IPHONE_8_0) &&
+//     __IPHONE_OS_VERSION_MAX_ALLOWED >= __IPHONE_8_0) ||
 //    (defined(__MAC_10_8) && __MAC_OS_X_VERSION_MAX_ALLOWED >= __MAC_10_8)
 //#define WEBRTC_VIDEO_TOOLBOX_SUPPORTED 1
 //#endif
@@ -46,6 +46,20 @@ class H264Decoder : public VideoDecoder {
  public:
   static H264Decoder* Create();
   static bool IsSupported();
+  // H.265 is decoded by libavcodec only, init the decoder with
+  // |kVideoCodecH265|. Returns nullptr when it is not built in.
+  static H264Decoder* CreateH265();
+  static bool IsH265Supported();
+
+  // True if decoded frames are returned in presentation order, stamped with
+  // the |_timeStamp| of their own input. Otherwise frames come out in decode
+  // order and the caller reorders streams with B-frames itself.
+  virtual bool ReordersOutput() const { return false; }
+  // Multi-threaded backends split the work across pictures, not only across
+  // the slices of one, with |number_of_cores| > 1 in |InitDecode|. Call
+  // before it. Frames then come out |DecodeDelayFrames| later.
+  virtual void SetFrameThreading(bool enable) {}
+  virtual int DecodeDelayFrames() const { return 0; }
 
   ~H264Decoder() override {}
 };
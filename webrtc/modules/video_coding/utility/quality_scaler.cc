@@ -10,6 +10,8 @@
 
 #include "webrtc/modules/video_coding/utility/quality_scaler.h"
 
+#include "webrtc/base/checks.h"
+
 namespace dii_media_kit {
 
 namespace {